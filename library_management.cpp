@@ -1,20 +1,64 @@
 #include <iostream>
+#include <algorithm>
 #include <cstring>
 #include <cctype>
 #include <limits>
 #include <string> // Added for std::string
+#include <cstdio>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <condition_variable>
+
+#ifdef _WIN32
+    #include <io.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
 
 using namespace std;
 
 // Constants for validation
 const int MAX_ID_LENGTH = 20;
 const int MAX_ISBN_LENGTH = 20;
+const int MAX_ISSN_LENGTH = 12;
 const int MAX_TITLE_LENGTH = 100;
 const int MAX_AUTHOR_LENGTH = 50;
 const int MAX_EDITION_LENGTH = 20;
 const int MAX_PUBLICATION_LENGTH = 50;
 const int MAX_CATEGORY_LENGTH = 20;
+const int MAX_PATRON_NAME_LENGTH = 44;
 const int DEFAULT_LIBRARY_CAPACITY = 100;
+const int DEFAULT_PATRON_CAPACITY = 100;
+const int MAX_PATH_LENGTH = 260;
+
+// Catalogue file format
+const char CATALOGUE_MAGIC[8] = {'L', 'M', 'S', 'C', 'A', 'T', '\0', '\0'};
+const uint32_t CATALOGUE_VERSION = 1;
+const uint32_t CATALOGUE_BYTE_ORDER = 0x01020304;
+const char* const CATALOGUE_FILE = "library.dat";
+
+// Journal file format
+const char JOURNAL_MAGIC[8] = {'L', 'M', 'S', 'W', 'A', 'L', '\0', '\0'};
+const uint32_t JOURNAL_VERSION = 1;
+const char* const JOURNAL_FILE = "library.wal";
+
+// Patron file format
+const char PATRON_MAGIC[8] = {'L', 'M', 'S', 'P', 'A', 'T', '\0', '\0'};
+const uint32_t PATRON_VERSION = 1;
+const char* const PATRON_FILE = "patrons.dat";
+
+// Circulation
+const int DEFAULT_LOAN_LIMIT = 20;
+const int DEFAULT_PICKUP_DAYS = 7;
+const int DEFAULT_PATRON_LIMIT = 1 << 20; // Patron numbers Circulation accepts, see setPatronLimit
+const int MAX_PATRON_LIMIT = 1 << 30;
 
 /**
  * Helper function to clear input buffer
@@ -26,457 +70,8293 @@ void clearInputBuffer() {
 }
 
 /**
- * Helper function to validate if a string contains only alphanumeric characters
- * Returns true if the string is alphanumeric, false otherwise
+ * CharClass enum - character classes a field can be restricted to, as bits
+ */
+enum CharClass : unsigned char {
+    CHAR_TEXT = 1 << 0,     // Any character but the terminator
+    CHAR_ALNUM = 1 << 1,    // ASCII letters and digits (IDs)
+    CHAR_ISBN = 1 << 2      // Digits, X, hyphen and space
+};
+
+/**
+ * CharClassTable struct - class bits of every byte value, built at compile time
+ * Lets validation test a character with one table load instead of isalnum and friends.
+ */
+struct CharClassTable {
+    unsigned char classes[256];
+
+    constexpr CharClassTable() : classes() {
+        for (int c = 1; c < 256; c++) {
+            bool digit = c >= '0' && c <= '9';
+            bool letter = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+            classes[c] = CHAR_TEXT;
+            if (digit || letter) {
+                classes[c] |= CHAR_ALNUM;
+            }
+            if (digit || c == 'X' || c == 'x' || c == '-' || c == ' ') {
+                classes[c] |= CHAR_ISBN;
+            }
+        }
+    }
+};
+
+constexpr CharClassTable CHAR_CLASSES;
+
+/**
+ * Helper function to validate a text field in a single pass
+ * Checks that value is not null or empty, fits a buffer of maxLength (terminator included)
+ * and has only characters of charClass, reading at most maxLength bytes. The length is
+ * stored in lengthOut so callers never measure the field again.
+ * Returns true if the field is valid, false otherwise
  */
-bool isAlphanumeric(const char* str) {
-    if (str == nullptr || strlen(str) == 0) {
+bool checkField(const char* value, size_t maxLength, unsigned char charClass, size_t& lengthOut) {
+    if (value == nullptr) {
         return false;
     }
-    
-    for (size_t i = 0; i < strlen(str); ++i) {
-        if (!isalnum(str[i])) {
-            return false;
-        }
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(value);
+    size_t length = 0;
+    // The terminator has no class bits, so it ends the loop like a bad character would
+    while (length < maxLength && (CHAR_CLASSES.classes[bytes[length]] & charClass) != 0) {
+        length++;
+    }
+    if (length == 0 || length == maxLength || bytes[length] != '\0') {
+        return false;
     }
+    lengthOut = length;
     return true;
 }
 
 /**
- * LibraryItem abstract base class - demonstrates ABSTRACTION through virtual functions
- * Defines the interface for all library items
+ * BookCategory enum - the categories a book can be filed under, stored in one byte
+ * CATEGORY_NONE marks a book whose category has not been set.
  */
-class LibraryItem {
-protected:
-    // Protected data members accessible to derived classes
-    char id[MAX_ID_LENGTH];
-    char title[MAX_TITLE_LENGTH];
-    char category[MAX_CATEGORY_LENGTH];
+enum BookCategory : unsigned char {
+    CATEGORY_NONE = 0,
+    CATEGORY_FICTION,
+    CATEGORY_NON_FICTION,
+    CATEGORY_COUNT
+};
 
-public:
-    // Constructor
-    LibraryItem() {
-        id[0] = '\0';
-        title[0] = '\0';
-        category[0] = '\0';
+/**
+ * Helper function to get the display name of a category
+ * Returns an empty string for CATEGORY_NONE
+ */
+const char* categoryName(BookCategory category) {
+    switch (category) {
+        case CATEGORY_FICTION:
+            return "Fiction";
+        case CATEGORY_NON_FICTION:
+            return "Non-fiction";
+        default:
+            return "";
     }
-    
-    // Virtual destructor for proper cleanup in derived classes
-    virtual ~LibraryItem() {}
+}
 
-    // Getters
-    const char* getId() const { return id; }
-    const char* getTitle() const { return title; }
-    const char* getCategory() const { return category; }
+/**
+ * Helper function to parse a category name of known length (case-sensitive)
+ * The length picks the only candidate, so at most one memcmp runs.
+ * Returns CATEGORY_NONE if the name is not exactly "Fiction" or "Non-fiction"
+ */
+BookCategory parseCategory(const char* name, size_t length) {
+    if (name == nullptr) {
+        return CATEGORY_NONE;
+    }
+    if (length == 7 && memcmp(name, "Fiction", 7) == 0) {
+        return CATEGORY_FICTION;
+    }
+    if (length == 11 && memcmp(name, "Non-fiction", 11) == 0) {
+        return CATEGORY_NON_FICTION;
+    }
+    return CATEGORY_NONE;
+}
 
-    // Setters with validation
-    bool setId(const char* newId) {
-        // Validate ID is not null or empty
-        if (newId == nullptr || strlen(newId) == 0) {
+/**
+ * Helper function to parse a null-terminated category name (case-sensitive)
+ * Returns CATEGORY_NONE if the name is not exactly "Fiction" or "Non-fiction"
+ */
+BookCategory parseCategory(const char* name) {
+    size_t length = 0;
+    if (!checkField(name, MAX_CATEGORY_LENGTH, CHAR_TEXT, length)) {
+        return CATEGORY_NONE;
+    }
+    return parseCategory(name, length);
+}
+
+/**
+ * Helper function to check whether a file exists and can be opened for reading
+ */
+bool fileExists(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * Helper function to flush a stdio stream all the way to the storage device
+ * Returns true if both the stdio buffer and the OS cache were flushed
+ */
+bool syncFile(FILE* file) {
+    if (fflush(file) != 0) {
+        return false;
+    }
+    #ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+    #else
+        return fsync(fileno(file)) == 0;
+    #endif
+}
+
+/**
+ * Helper function to compute the FNV-1a checksum of a byte range
+ * Used to detect torn or corrupted journal records
+ */
+uint32_t checksumBytes(const void* data, size_t size, uint32_t seed = 2166136261u) {
+    uint32_t hash = seed;
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Helper function to check a 13-digit ISBN held as an integer
+ * The number must carry the 978 or 979 prefix and a correct EAN-13 check digit
+ */
+bool isValidIsbn13(uint64_t isbn) {
+    if (isbn < 9780000000000ULL || isbn > 9799999999999ULL) {
+        return false;
+    }
+    int sum = 0;
+    for (int position = 0; position < 13; position++) {
+        int digit = static_cast<int>(isbn % 10);
+        isbn /= 10;
+        sum += (position % 2 == 0) ? digit : digit * 3; // position 0 is the check digit
+    }
+    return sum % 10 == 0;
+}
+
+/**
+ * Helper function to parse an ISBN-10 or ISBN-13, ignoring hyphens and spaces
+ * Check digits are verified and ISBN-10s are converted to ISBN-13 (978 prefix),
+ * so every valid spelling of a book's ISBN gives the same number.
+ * Returns true and sets isbnOut only if the text is a valid ISBN.
+ */
+bool parseIsbn(const char* text, uint64_t& isbnOut) {
+    if (text == nullptr) {
+        return false;
+    }
+
+    int digits[13];
+    int digitCount = 0;
+    for (const char* p = text; *p != '\0'; ++p) {
+        if (*p == '-' || *p == ' ') {
+            continue;
+        }
+        if (digitCount == 13) {
             return false;
         }
-        
-        // Validate ID length
-        if (strlen(newId) > MAX_ID_LENGTH - 1) {
+        if (*p >= '0' && *p <= '9') {
+            digits[digitCount++] = *p - '0';
+        } else if ((*p == 'X' || *p == 'x') && digitCount == 9 && p[1 + strspn(p + 1, "- ")] == '\0') {
+            digits[digitCount++] = 10; // ISBN-10 check digit for ten, followed by separators at most
+        } else {
             return false;
         }
-        
-        // Check if ID contains only alphanumeric characters
-        if (!isAlphanumeric(newId)) {
+    }
+
+    uint64_t isbn = 0;
+    if (digitCount == 10) {
+        // ISBN-10: weighted sum 10..1 must be divisible by 11
+        int sum = 0;
+        for (int i = 0; i < 10; i++) {
+            sum += digits[i] * (10 - i);
+        }
+        if (sum % 11 != 0) {
             return false;
         }
-        
-        // Copy ID with bounds checking
-        strncpy(id, newId, MAX_ID_LENGTH - 1);
-        id[MAX_ID_LENGTH - 1] = '\0';
-        return true;
+        isbn = 978;
+        int eanSum = 9 + 7 * 3 + 8;
+        for (int i = 0; i < 9; i++) {
+            isbn = isbn * 10 + digits[i];
+            eanSum += (i % 2 == 0) ? digits[i] * 3 : digits[i];
+        }
+        isbn = isbn * 10 + (10 - eanSum % 10) % 10;
+    } else if (digitCount == 13) {
+        for (int i = 0; i < 13; i++) {
+            if (digits[i] == 10) {
+                return false;
+            }
+            isbn = isbn * 10 + digits[i];
+        }
+    } else {
+        return false;
     }
 
-    bool setTitle(const char* newTitle) {
-        // Validate title is not null or empty
-        if (newTitle == nullptr || strlen(newTitle) == 0) {
+    if (!isValidIsbn13(isbn)) {
+        return false;
+    }
+    isbnOut = isbn;
+    return true;
+}
+
+/**
+ * Helper function to write an ISBN as 13 digits into a buffer of MAX_ISBN_LENGTH
+ * An unset ISBN (0) is written as an empty string
+ */
+void formatIsbn(uint64_t isbn, char* buffer) {
+    if (isbn == 0) {
+        buffer[0] = '\0';
+        return;
+    }
+    for (int i = 12; i >= 0; i--) {
+        buffer[i] = static_cast<char>('0' + isbn % 10);
+        isbn /= 10;
+    }
+    buffer[13] = '\0';
+}
+
+/**
+ * Helper function to parse an ISSN such as "0317-8471", ignoring hyphens and spaces
+ * The check digit (X for ten) is verified and dropped: the number kept is the seven digits
+ * before it, which determine it. Returns true and sets issnOut only if the text is a valid ISSN.
+ */
+bool parseIssn(const char* text, uint32_t& issnOut) {
+    if (text == nullptr) {
+        return false;
+    }
+
+    int digits[8];
+    int digitCount = 0;
+    for (const char* p = text; *p != '\0'; ++p) {
+        if (*p == '-' || *p == ' ') {
+            continue;
+        }
+        if (digitCount == 8) {
             return false;
         }
-        
-        // Validate title length
-        if (strlen(newTitle) > MAX_TITLE_LENGTH - 1) {
+        if (*p >= '0' && *p <= '9') {
+            digits[digitCount++] = *p - '0';
+        } else if ((*p == 'X' || *p == 'x') && digitCount == 7 && p[1 + strspn(p + 1, "- ")] == '\0') {
+            digits[digitCount++] = 10; // Check digit for ten, followed by separators at most
+        } else {
             return false;
         }
-        
-        // Copy title with bounds checking
-        strncpy(title, newTitle, MAX_TITLE_LENGTH - 1);
-        title[MAX_TITLE_LENGTH - 1] = '\0';
-        return true;
+    }
+    if (digitCount != 8) {
+        return false;
     }
 
-    // Pure virtual functions - ABSTRACTION
-    virtual bool setCategory(const char* newCategory) = 0;
-    virtual void displayDetails() const = 0;
-    virtual void displayInTable() const = 0;
-};
+    // Weighted sum 8..2 of the digits, plus the check digit, must be divisible by 11
+    uint32_t issn = 0;
+    int sum = digits[7];
+    for (int i = 0; i < 7; i++) {
+        sum += digits[i] * (8 - i);
+        issn = issn * 10 + static_cast<uint32_t>(digits[i]);
+    }
+    if (sum % 11 != 0) {
+        return false;
+    }
+    issnOut = issn;
+    return true;
+}
 
 /**
- * Book class - inherits from LibraryItem
- * Implements the abstract methods defined in the base class
+ * Helper function to write an ISSN as "NNNN-NNNC" into a buffer of MAX_ISSN_LENGTH
+ * A number of more than seven digits (an unset ISSN) is written as an empty string
  */
-class Book : public LibraryItem {
-private:
-    // Private data members - ENCAPSULATION
+void formatIssn(uint32_t issn, char* buffer) {
+    if (issn > 9999999) {
+        buffer[0] = '\0';
+        return;
+    }
+    int digits[7];
+    int sum = 0;
+    for (int i = 6; i >= 0; i--) {
+        digits[i] = static_cast<int>(issn % 10);
+        issn /= 10;
+        sum += digits[i] * (8 - i);
+    }
+    int check = (11 - sum % 11) % 11;
+    for (int i = 0, out = 0; i < 7; i++) {
+        if (i == 4) {
+            buffer[out++] = '-';
+        }
+        buffer[out++] = static_cast<char>('0' + digits[i]);
+    }
+    buffer[8] = check == 10 ? 'X' : static_cast<char>('0' + check);
+    buffer[9] = '\0';
+}
+
+/**
+ * CatalogRecord struct - fixed-width on-disk layout of one book
+ * Every field is null-padded to its full width, so a catalogue file is a plain
+ * array of identical records that can be mapped into memory and read in place.
+ */
+struct CatalogRecord {
+    char id[MAX_ID_LENGTH];
     char isbn[MAX_ISBN_LENGTH];
+    char title[MAX_TITLE_LENGTH];
     char author[MAX_AUTHOR_LENGTH];
     char edition[MAX_EDITION_LENGTH];
     char publication[MAX_PUBLICATION_LENGTH];
+    char category[MAX_CATEGORY_LENGTH];
+};
+
+/**
+ * CatalogHeader struct - header at the start of a catalogue file
+ * The records follow immediately after the header.
+ */
+struct CatalogHeader {
+    char magic[8];        // CATALOGUE_MAGIC
+    uint32_t version;     // CATALOGUE_VERSION
+    uint32_t recordSize;  // sizeof(CatalogRecord), rejects files written with another layout
+    uint32_t byteOrder;   // CATALOGUE_BYTE_ORDER in the byte order of the writing machine
+    uint32_t checkpoint;  // Journal generation this snapshot was taken at, zero if none
+    uint64_t recordCount; // Number of records after the header
+};
+
+/**
+ * MappedFile class - read-only view of a whole file
+ * Uses mmap where available, so a large file is paged in on demand instead of
+ * being read and copied up front; falls back to reading the file on Windows.
+ */
+class MappedFile {
+private:
+    // Private data members - ENCAPSULATION
+    const char* data; // Start of the file contents, nullptr when closed or empty
+    size_t length;    // Size of the file in bytes
+    bool mapped;      // true if data is an mmap region, false if it is a heap buffer
 
 public:
     // Constructor
-    Book() : LibraryItem() {
-        isbn[0] = '\0';
-        author[0] = '\0';
-        edition[0] = '\0';
-        publication[0] = '\0';
+    MappedFile() {
+        data = nullptr;
+        length = 0;
+        mapped = false;
     }
 
-    // Getters
-    const char* getIsbn() const { return isbn; }
-    const char* getAuthor() const { return author; }
-    const char* getEdition() const { return edition; }
-    const char* getPublication() const { return publication; }
+    // Destructor to release the mapping
+    ~MappedFile() {
+        close();
+    }
 
-    // Setters with validation
-    bool setIsbn(const char* newIsbn) {
-        // Validate ISBN is not null or empty
-        if (newIsbn == nullptr || strlen(newIsbn) == 0) {
-            return false;
-        }
-        
-        // Validate ISBN length
-        if (strlen(newIsbn) > MAX_ISBN_LENGTH - 1) {
+    // A mapping has a single owner, so it cannot be copied
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map a file for reading; returns false if it cannot be opened
+    bool open(const char* path) {
+        close();
+        if (path == nullptr) {
             return false;
         }
-        
-        // Copy ISBN with bounds checking
-        strncpy(isbn, newIsbn, MAX_ISBN_LENGTH - 1);
-        isbn[MAX_ISBN_LENGTH - 1] = '\0';
+
+        #ifdef _WIN32
+            FILE* file = fopen(path, "rb");
+            if (file == nullptr) {
+                return false;
+            }
+            fseek(file, 0, SEEK_END);
+            long fileSize = ftell(file);
+            fseek(file, 0, SEEK_SET);
+            if (fileSize < 0) {
+                fclose(file);
+                return false;
+            }
+            char* buffer = fileSize > 0 ? new char[fileSize] : nullptr;
+            if (fileSize > 0 && fread(buffer, 1, fileSize, file) != static_cast<size_t>(fileSize)) {
+                delete[] buffer;
+                fclose(file);
+                return false;
+            }
+            fclose(file);
+            data = buffer;
+            length = static_cast<size_t>(fileSize);
+            mapped = false;
+        #else
+            int fd = ::open(path, O_RDONLY);
+            if (fd == -1) {
+                return false;
+            }
+            struct stat info;
+            if (fstat(fd, &info) != 0) {
+                ::close(fd);
+                return false;
+            }
+            length = static_cast<size_t>(info.st_size);
+            if (length > 0) {
+                void* region = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (region == MAP_FAILED) {
+                    ::close(fd);
+                    length = 0;
+                    return false;
+                }
+                madvise(region, length, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(region);
+                mapped = true;
+            }
+            ::close(fd); // The mapping stays valid after the descriptor is closed
+        #endif
         return true;
     }
 
-    bool setAuthor(const char* newAuthor) {
-        // Validate author is not null or empty
-        if (newAuthor == nullptr || strlen(newAuthor) == 0) {
-            return false;
-        }
-        
-        // Validate author length
-        if (strlen(newAuthor) > MAX_AUTHOR_LENGTH - 1) {
-            return false;
+    // Release the mapping
+    void close() {
+        if (data != nullptr) {
+            #ifdef _WIN32
+                delete[] data;
+            #else
+                if (mapped) {
+                    munmap(const_cast<char*>(data), length);
+                } else {
+                    delete[] data;
+                }
+            #endif
         }
-        
-        // Copy author with bounds checking
-        strncpy(author, newAuthor, MAX_AUTHOR_LENGTH - 1);
-        author[MAX_AUTHOR_LENGTH - 1] = '\0';
-        return true;
+        data = nullptr;
+        length = 0;
+        mapped = false;
     }
 
-    bool setEdition(const char* newEdition) {
-        // Validate edition is not null or empty
-        if (newEdition == nullptr || strlen(newEdition) == 0) {
-            return false;
-        }
-        
-        // Validate edition length
-        if (strlen(newEdition) > MAX_EDITION_LENGTH - 1) {
-            return false;
-        }
-        
-        // Copy edition with bounds checking
-        strncpy(edition, newEdition, MAX_EDITION_LENGTH - 1);
-        edition[MAX_EDITION_LENGTH - 1] = '\0';
-        return true;
+    // Getters
+    const char* getData() const { return data; }
+    size_t getSize() const { return length; }
+};
+
+/**
+ * StringArena class - append-only storage for short strings
+ * Strings are copied, null-terminated, into 1 MB chunks that never move, so the pointer
+ * for a handle stays valid until the arena is cleared. A 32-bit handle packs the chunk
+ * number and the offset inside the chunk. Handle 0 is always the empty string: it lies
+ * in chunk 0, a one-byte chunk shared by every arena, so an arena allocates no chunk of
+ * its own until its first string.
+ * The chunk table is allocated at full size up front and never moves, so get() may run
+ * on one thread while add() runs on another, as long as the handle was handed over
+ * through a lock.
+ */
+class StringArena {
+public:
+    static const uint32_t EMPTY_HANDLE = 0;
+
+private:
+    static const int CHUNK_BITS = 20;
+    static const size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+    static const int MAX_CHUNKS = 1 << (32 - CHUNK_BITS);
+
+    // Private data members - ENCAPSULATION
+    char** chunks;      // MAX_CHUNKS chunk pointers; chunks[chunkCount - 1] is being filled
+    int chunkCount;     // Chunk 0, the shared empty string, included
+    size_t lastUsed;    // Bytes used in the last chunk; CHUNK_SIZE while there is only chunk 0
+
+public:
+    // Constructor
+    StringArena() {
+        chunks = new char*[MAX_CHUNKS];
+        chunks[0] = emptyChunk();
+        chunkCount = 1;
+        lastUsed = CHUNK_SIZE;
     }
 
-    bool setPublication(const char* newPublication) {
-        // Validate publication is not null or empty
-        if (newPublication == nullptr || strlen(newPublication) == 0) {
-            return false;
-        }
-        
-        // Validate publication length
-        if (strlen(newPublication) > MAX_PUBLICATION_LENGTH - 1) {
-            return false;
+    // Destructor to free memory
+    ~StringArena() {
+        for (int c = 1; c < chunkCount; c++) {
+            delete[] chunks[c];
         }
-        
-        // Copy publication with bounds checking
-        strncpy(publication, newPublication, MAX_PUBLICATION_LENGTH - 1);
-        publication[MAX_PUBLICATION_LENGTH - 1] = '\0';
-        return true;
+        delete[] chunks;
     }
 
-    // Implementation of virtual function - ABSTRACTION
-    virtual bool setCategory(const char* newCategory) override {
-        // Validate category is not null or empty
-        if (newCategory == nullptr || strlen(newCategory) == 0) {
-            return false;
+    // The arena owns its chunks, so it cannot be copied
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    // Copy a string of the given length into the arena and return its handle
+    // Empty strings, strings of a chunk or more, and a full arena all give EMPTY_HANDLE
+    uint32_t add(const char* value, size_t length) {
+        if (value == nullptr || length == 0 || length >= CHUNK_SIZE) {
+            return EMPTY_HANDLE;
         }
-        
-        // Validate category length
-        if (strlen(newCategory) > MAX_CATEGORY_LENGTH - 1) {
-            return false;
+        if (lastUsed + length + 1 > CHUNK_SIZE) {
+            if (chunkCount == MAX_CHUNKS) {
+                return EMPTY_HANDLE;
+            }
+            chunks[chunkCount++] = new char[CHUNK_SIZE];
+            lastUsed = 0;
         }
-        
-        // Case-sensitive validation for category
-        if (strcmp(newCategory, "Fiction") == 0 || strcmp(newCategory, "Non-fiction") == 0) {
-            strncpy(category, newCategory, MAX_CATEGORY_LENGTH - 1);
-            category[MAX_CATEGORY_LENGTH - 1] = '\0';
-            return true;
+
+        uint32_t handle = (static_cast<uint32_t>(chunkCount - 1) << CHUNK_BITS) | static_cast<uint32_t>(lastUsed);
+        char* target = chunks[chunkCount - 1] + lastUsed;
+        memcpy(target, value, length);
+        target[length] = '\0';
+        lastUsed += length + 1;
+        return handle;
+    }
+
+    // Copy a null-terminated string into the arena
+    uint32_t add(const char* value) {
+        return value != nullptr ? add(value, strlen(value)) : EMPTY_HANDLE;
+    }
+
+    // Get the string for a handle
+    const char* get(uint32_t handle) const {
+        return chunks[handle >> CHUNK_BITS] + (handle & (CHUNK_SIZE - 1));
+    }
+
+    // Get the number of bytes allocated for strings
+    size_t getAllocatedBytes() const {
+        return static_cast<size_t>(chunkCount - 1) * CHUNK_SIZE;
+    }
+
+    // Get the number of bytes filled with strings, counting the unused tail of full chunks
+    size_t getUsedBytes() const {
+        return chunkCount > 1 ? static_cast<size_t>(chunkCount - 2) * CHUNK_SIZE + lastUsed : 0;
+    }
+
+    // Drop every string, keeping the first chunk of the arena's own, if any, for reuse
+    void clear() {
+        for (int c = 2; c < chunkCount; c++) {
+            delete[] chunks[c];
         }
-        return false;
+        chunkCount = chunkCount > 1 ? 2 : 1;
+        lastUsed = chunkCount > 1 ? 0 : CHUNK_SIZE;
     }
 
-    // Implementation of virtual function - ABSTRACTION
-    virtual void displayDetails() const override {
-        cout << "ID: " << id << endl;
-        cout << "ISBN: " << isbn << endl;
-        cout << "Title: " << title << endl;
-        cout << "Author: " << author << endl;
-        cout << "Edition: " << edition << endl;
-        cout << "Publication: " << publication << endl;
-        cout << "Category: " << category << endl;
+    // Exchange contents with another arena, e.g. to install a compacted copy
+    void swap(StringArena& other) {
+        char** chunksTemp = chunks;
+        chunks = other.chunks;
+        other.chunks = chunksTemp;
+        int countTemp = chunkCount;
+        chunkCount = other.chunkCount;
+        other.chunkCount = countTemp;
+        size_t usedTemp = lastUsed;
+        lastUsed = other.lastUsed;
+        other.lastUsed = usedTemp;
     }
-    
-    // Implementation of virtual function - ABSTRACTION
-    virtual void displayInTable() const override {
-        printf("| %-6.6s | %-13.13s | %-30.30s | %-20.20s | %-8.8s | %-20.20s | %-11.11s |\n", 
-               id, isbn, title, author, edition, publication, category);
+
+private:
+    // Helper method to get chunk 0, which holds only the empty string - ENCAPSULATION
+    // It is never written, so every arena can point at the same byte
+    static char* emptyChunk() {
+        static char empty[1] = { '\0' };
+        return empty;
+    }
+};
+
+/**
+ * StringPool class - interns strings in a StringArena
+ * Equal strings get the same handle, so a value that repeats across many books
+ * (an author, a publisher) is stored once and two values compare equal exactly
+ * when their handles do. Strings live until the pool is cleared or destroyed, so an
+ * owner that replaces values reclaims the space by copying what is still live into a
+ * fresh pool (see Library::compactText).
+ * Each interned string counts the intern() calls that returned it, less the release()
+ * calls for it, so an owner can tell when the last user of a value goes away.
+ * The pool may be shared between threads: intern(), store() and release() are serialized
+ * by an internal lock, and get() needs none.
+ */
+class StringPool {
+private:
+    static const int MIN_BUCKETS = 1024;
+
+    // Private data members - ENCAPSULATION
+    StringArena strings;   // Characters of every interned string
+    uint32_t* buckets;     // Open-addressing table of handles, EMPTY_HANDLE marks a free bucket
+    uint32_t* hashes;      // Hash of the string in the matching bucket
+    uint32_t* uses;        // Uses of the string in the matching bucket, see release()
+    int bucketCount;       // Always a power of two
+    int used;              // Number of interned strings
+    mutable mutex lock;    // Serializes changes to strings and the table
+
+public:
+    // Constructor
+    StringPool() {
+        bucketCount = MIN_BUCKETS;
+        used = 0;
+        buckets = new uint32_t[bucketCount]();
+        hashes = new uint32_t[bucketCount];
+        uses = new uint32_t[bucketCount];
+    }
+
+    // Destructor to free memory
+    ~StringPool() {
+        delete[] buckets;
+        delete[] hashes;
+        delete[] uses;
+    }
+
+    // The pool owns its table, so it cannot be copied
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    // Get the handle for a string, adding it on first use; the empty string is EMPTY_HANDLE
+    uint32_t intern(const char* value, size_t length) {
+        if (value == nullptr || length == 0) {
+            return StringArena::EMPTY_HANDLE;
+        }
+        lock_guard<mutex> guard(lock);
+        if ((used + 1) * 10 > bucketCount * 7) {
+            rehash(bucketCount * 2);
+        }
+
+        uint32_t hash = checksumBytes(value, length);
+        int mask = bucketCount - 1;
+        int b = static_cast<int>(hash) & mask;
+        for (; buckets[b] != StringArena::EMPTY_HANDLE; b = (b + 1) & mask) {
+            if (hashes[b] == hash) {
+                const char* stored = strings.get(buckets[b]);
+                if (strncmp(stored, value, length) == 0 && stored[length] == '\0') {
+                    uses[b]++;
+                    return buckets[b];
+                }
+            }
+        }
+
+        uint32_t handle = strings.add(value, length);
+        if (handle != StringArena::EMPTY_HANDLE) {
+            buckets[b] = handle;
+            hashes[b] = hash;
+            uses[b] = 1;
+            used++;
+        }
+        return handle;
+    }
+
+    // Give back one use of an interned string
+    // Returns the bytes the string takes up once its last use is given back, 0 otherwise
+    // (or if it was never interned). The bytes stay in the pool until it is cleared.
+    size_t release(const char* value) {
+        size_t length = value != nullptr ? strlen(value) : 0;
+        if (length == 0) {
+            return 0;
+        }
+        lock_guard<mutex> guard(lock);
+        uint32_t hash = checksumBytes(value, length);
+        int mask = bucketCount - 1;
+        for (int b = static_cast<int>(hash) & mask; buckets[b] != StringArena::EMPTY_HANDLE; b = (b + 1) & mask) {
+            if (hashes[b] == hash && strcmp(strings.get(buckets[b]), value) == 0) {
+                return uses[b] > 0 && --uses[b] == 0 ? length + 1 : 0;
+            }
+        }
+        return 0;
+    }
+
+    // Copy a string into the pool without interning it, for values that rarely repeat
+    uint32_t store(const char* value, size_t length) {
+        lock_guard<mutex> guard(lock);
+        return strings.add(value, length);
+    }
+
+    // Get the string for a handle
+    const char* get(uint32_t handle) const {
+        return strings.get(handle);
+    }
+
+    // Copy the string behind a handle of another pool into this one
+    // Returns false if this pool is full; handleOut is then EMPTY_HANDLE
+    bool copyFrom(const StringPool& source, uint32_t handle, bool interned, uint32_t& handleOut) {
+        const char* value = source.get(handle);
+        size_t length = strlen(value);
+        handleOut = interned ? intern(value, length) : store(value, length);
+        return length == 0 || handleOut != StringArena::EMPTY_HANDLE;
+    }
+
+    // Get the number of distinct strings interned
+    int getCount() const {
+        lock_guard<mutex> guard(lock);
+        return used;
+    }
+
+    // Get the number of bytes the pool's strings take up
+    size_t getUsedBytes() const {
+        lock_guard<mutex> guard(lock);
+        return strings.getUsedBytes();
+    }
+
+    // Drop every string, keeping the first chunk and the table
+    // Handles from before are no longer valid
+    void clear() {
+        lock_guard<mutex> guard(lock);
+        strings.clear();
+        memset(buckets, 0, bucketCount * sizeof(uint32_t));
+        used = 0;
+    }
+
+private:
+    // Helper method to move every handle into a larger table - ENCAPSULATION
+    void rehash(int newBucketCount) {
+        uint32_t* oldBuckets = buckets;
+        uint32_t* oldHashes = hashes;
+        uint32_t* oldUses = uses;
+        int oldCount = bucketCount;
+
+        bucketCount = newBucketCount;
+        buckets = new uint32_t[bucketCount]();
+        hashes = new uint32_t[bucketCount];
+        uses = new uint32_t[bucketCount];
+        int mask = bucketCount - 1;
+        for (int i = 0; i < oldCount; i++) {
+            if (oldBuckets[i] != StringArena::EMPTY_HANDLE) {
+                int b = static_cast<int>(oldHashes[i]) & mask;
+                while (buckets[b] != StringArena::EMPTY_HANDLE) {
+                    b = (b + 1) & mask;
+                }
+                buckets[b] = oldBuckets[i];
+                hashes[b] = oldHashes[i];
+                uses[b] = oldUses[i];
+            }
+        }
+
+        delete[] oldBuckets;
+        delete[] oldHashes;
+        delete[] oldUses;
+    }
+};
+
+/**
+ * Helper function to get the pool for the text of books built outside a library
+ * A default-constructed Book or BookPatch keeps its text here until a Library copies it
+ * into its own pool, which it compacts. Only text typed in one book at a time should
+ * land here, along with books copied out of a library (see Book::copyFrom), which intern
+ * every field so fetching a book again adds nothing. Bulk producers (the importer,
+ * journal replay) bind their books to a pool of their own that they clear between
+ * batches, and so do threads that build or fetch books in parallel, since this pool's
+ * lock is shared by every caller.
+ * Authors, editions and publications are interned. Titles are mostly unique, so they are
+ * stored without interning.
+ */
+StringPool& bookFieldPool() {
+    static StringPool pool;
+    return pool;
+}
+
+/**
+ * BookPatch struct - the fields to change in an existing book, for Library::patchBook
+ * Each setter validates its value like the Book setter of the same name and marks the
+ * field in the mask; fields left unset are not touched by the patch. Text is held as
+ * handles into the patch's pool (bookFieldPool() unless given another), so a patch is
+ * small and applying it to a book in the same pool copies no strings.
+ * A patch seeded with Book::startPatch holds the book's current values, and a setter
+ * given the value a field already holds neither stores it nor marks the field.
+ */
+struct BookPatch {
+    enum Field : unsigned {
+        FIELD_CATEGORY = 1 << 0,
+        FIELD_ISBN = 1 << 1,
+        FIELD_TITLE = 1 << 2,
+        FIELD_AUTHOR = 1 << 3,
+        FIELD_EDITION = 1 << 4,
+        FIELD_PUBLICATION = 1 << 5,
+        ALL_FIELDS = (1 << 6) - 1
+    };
+
+    unsigned fields;         // Mask of the fields set
+    BookCategory category;
+    uint64_t isbn;           // Normalized ISBN-13
+    uint32_t title;          // Handles into text
+    uint32_t author;
+    uint32_t edition;
+    uint32_t publication;
+    StringPool* text;        // Pool holding the patch's text
+
+    // Constructor - an empty patch changes nothing
+    BookPatch() {
+        clearFields(bookFieldPool());
+    }
+
+    // Constructor - an empty patch whose text goes into the given pool
+    explicit BookPatch(StringPool& pool) {
+        clearFields(pool);
+    }
+
+    // Getters for the text fields
+    const char* getTitle() const { return text->get(title); }
+    const char* getAuthor() const { return text->get(author); }
+    const char* getEdition() const { return text->get(edition); }
+    const char* getPublication() const { return text->get(publication); }
+
+    // Check if the patch changes a field
+    bool has(Field field) const {
+        return (fields & field) != 0;
+    }
+
+    // Copy the text of the fields set into another pool and refer to it there from now on
+    // Returns false if the pool is full; the patch is then unchanged
+    bool moveTextTo(StringPool& pool) {
+        if (&pool == text) {
+            return true;
+        }
+        uint32_t moved[4] = {title, author, edition, publication};
+        if ((has(FIELD_TITLE) && !pool.copyFrom(*text, title, false, moved[0])) ||
+            (has(FIELD_AUTHOR) && !pool.copyFrom(*text, author, true, moved[1])) ||
+            (has(FIELD_EDITION) && !pool.copyFrom(*text, edition, true, moved[2])) ||
+            (has(FIELD_PUBLICATION) && !pool.copyFrom(*text, publication, true, moved[3]))) {
+            return false;
+        }
+        // Handles of fields not set are meaningless in the new pool
+        title = has(FIELD_TITLE) ? moved[0] : StringArena::EMPTY_HANDLE;
+        author = has(FIELD_AUTHOR) ? moved[1] : StringArena::EMPTY_HANDLE;
+        edition = has(FIELD_EDITION) ? moved[2] : StringArena::EMPTY_HANDLE;
+        publication = has(FIELD_PUBLICATION) ? moved[3] : StringArena::EMPTY_HANDLE;
+        text = &pool;
+        return true;
+    }
+
+    // Setters with validation; a rejected value leaves the field unset
+    bool setCategory(const char* newCategory) {
+        BookCategory parsed = parseCategory(newCategory);
+        if (parsed == CATEGORY_NONE) {
+            return false;
+        }
+        if (parsed == category) {
+            return true;
+        }
+        category = parsed;
+        fields |= FIELD_CATEGORY;
+        return true;
+    }
+
+    bool setIsbn(const char* newIsbn) {
+        size_t length;
+        uint64_t parsed;
+        if (!checkField(newIsbn, MAX_ISBN_LENGTH, CHAR_ISBN, length) || !parseIsbn(newIsbn, parsed)) {
+            return false;
+        }
+        if (parsed == isbn) {
+            return true;
+        }
+        isbn = parsed;
+        fields |= FIELD_ISBN;
+        return true;
+    }
+
+    bool setTitle(const char* newTitle) {
+        return setText(newTitle, MAX_TITLE_LENGTH, false, title, FIELD_TITLE);
+    }
+
+    bool setAuthor(const char* newAuthor) {
+        return setText(newAuthor, MAX_AUTHOR_LENGTH, true, author, FIELD_AUTHOR);
+    }
+
+    bool setEdition(const char* newEdition) {
+        return setText(newEdition, MAX_EDITION_LENGTH, true, edition, FIELD_EDITION);
+    }
+
+    bool setPublication(const char* newPublication) {
+        return setText(newPublication, MAX_PUBLICATION_LENGTH, true, publication, FIELD_PUBLICATION);
+    }
+
+private:
+    // Helper method to validate a text field and keep its pool handle - ENCAPSULATION
+    // Titles are stored, the other fields interned, as in Book.
+    bool setText(const char* value, int maxLength, bool intern, uint32_t& handle, Field field) {
+        size_t length;
+        if (!checkField(value, maxLength, CHAR_TEXT, length)) {
+            return false;
+        }
+        // The value the field already holds is not stored again
+        if (strcmp(value, text->get(handle)) == 0) {
+            return true;
+        }
+        uint32_t stored = intern ? text->intern(value, length) : text->store(value, length);
+        if (stored == StringArena::EMPTY_HANDLE) {
+            return false; // The pool is full
+        }
+        handle = stored;
+        fields |= field;
+        return true;
+    }
+
+    // Helper method to empty every field and bind the patch to a pool - ENCAPSULATION
+    void clearFields(StringPool& pool) {
+        fields = 0;
+        category = CATEGORY_NONE;
+        isbn = 0;
+        title = StringArena::EMPTY_HANDLE;
+        author = StringArena::EMPTY_HANDLE;
+        edition = StringArena::EMPTY_HANDLE;
+        publication = StringArena::EMPTY_HANDLE;
+        text = &pool;
+    }
+};
+
+/**
+ * ItemKind enum - the concrete type of a LibraryItem, stored in the item itself
+ * Code that needs the concrete type checks the tag and uses static_cast (see asBook and
+ * Library::addItem), so items carry no vtable pointer and nothing on the hot path needs
+ * RTTI. Library keeps each kind in a contiguous array of its own type; the other managers
+ * hold books only.
+ */
+enum ItemKind : unsigned char {
+    ITEM_KIND_BOOK,
+    ITEM_KIND_JOURNAL,
+    ITEM_KIND_COUNT
+};
+
+/**
+ * LibraryItem base class - the fields and validation shared by every kind of item
+ * Behaviour that differs between kinds is dispatched statically on the kind tag
+ * (see asBook), so an item is a plain record that copies like a struct.
+ * Text fields are handles into the StringPool the item is bound to. A plain copy shares the
+ * pool and stays readable only as long as the pool keeps its strings; Book::copyFrom
+ * makes a copy whose text lives in a pool of the caller's.
+ */
+class LibraryItem {
+protected:
+    // Protected data members accessible to derived classes
+    char id[MAX_ID_LENGTH];
+    BookCategory category;
+    ItemKind kind;         // Set once by the derived class; sits in category's padding
+    uint32_t title;        // Handle into text
+    StringPool* text;      // Pool holding the item's text
+
+    // Constructor - only derived classes create items, tagging them with their kind
+    LibraryItem(ItemKind itemKind, StringPool& pool) {
+        id[0] = '\0';
+        category = CATEGORY_NONE;
+        kind = itemKind;
+        title = StringArena::EMPTY_HANDLE;
+        text = &pool;
+    }
+
+    // Not virtual: items are never deleted through a LibraryItem pointer, and the
+    // protected destructor keeps it that way
+    ~LibraryItem() = default;
+
+    // Helper method to write a table column prefix and a field cut or padded to width - ENCAPSULATION
+    static char* putColumn(char* out, const char* prefix, const char* text, int width) {
+        while (*prefix != '\0') {
+            *out++ = *prefix++;
+        }
+        int n = 0;
+        while (n < width && text[n] != '\0') {
+            out[n] = text[n];
+            n++;
+        }
+        while (n < width) {
+            out[n++] = ' ';
+        }
+        return out + width;
+    }
+
+public:
+    // Getters
+    ItemKind getKind() const { return kind; }
+    const char* getId() const { return id; }
+    const char* getTitle() const { return text->get(title); }
+    const char* getCategory() const { return categoryName(category); }
+    BookCategory getCategoryCode() const { return category; }
+    StringPool& getTextPool() const { return *text; }
+
+    // Setters with validation
+    bool setId(const char* newId) {
+        // Validate the ID is non-empty, fits and is alphanumeric in one pass
+        size_t length;
+        if (!checkField(newId, MAX_ID_LENGTH, CHAR_ALNUM, length)) {
+            return false;
+        }
+        
+        // Copy ID with its terminator
+        memcpy(id, newId, length + 1);
+        return true;
+    }
+
+    bool setTitle(const char* newTitle) {
+        // Validate title is non-empty and fits
+        size_t length;
+        if (!checkField(newTitle, MAX_TITLE_LENGTH, CHAR_TEXT, length)) {
+            return false;
+        }
+        
+        // Store the title unless it is this item's current title already
+        if (strcmp(newTitle, getTitle()) == 0) {
+            return true;
+        }
+        uint32_t stored = text->store(newTitle, length);
+        if (stored == StringArena::EMPTY_HANDLE) {
+            return false; // The pool is full
+        }
+        title = stored;
+        return true;
+    }
+
+    bool setCategory(const char* newCategory) {
+        // Validate category is non-empty and fits
+        size_t length;
+        if (!checkField(newCategory, MAX_CATEGORY_LENGTH, CHAR_TEXT, length)) {
+            return false;
+        }
+        
+        // Case-sensitive validation for category
+        BookCategory parsed = parseCategory(newCategory, length);
+        if (parsed != CATEGORY_NONE) {
+            category = parsed;
+            return true;
+        }
+        return false;
+    }
+};
+
+/**
+ * Book class - inherits from LibraryItem
+ * Adds the ISBN, author, edition and publication, and the book's display formats
+ */
+class Book : public LibraryItem {
+public:
+    // Length of a table row from formatTableRow, newline included
+    static const int TABLE_ROW_LENGTH = 2 + 6 + 3 + 13 + 3 + 30 + 3 + 20 + 3 + 8 + 3 + 20 + 3 + 11 + 3;
+
+private:
+    // Private data members - ENCAPSULATION
+    uint64_t isbn;         // Normalized ISBN-13, 0 if not set
+    uint32_t author;       // Handles into text
+    uint32_t edition;
+    uint32_t publication;
+
+public:
+    // Constructor - a book built on its own keeps its text in bookFieldPool()
+    Book() : LibraryItem(ITEM_KIND_BOOK, bookFieldPool()) {
+        clearFields();
+    }
+
+    // Constructor - an empty book whose text goes into the given pool
+    explicit Book(StringPool& pool) : LibraryItem(ITEM_KIND_BOOK, pool) {
+        clearFields();
+    }
+
+    // Getters
+    uint64_t getIsbn() const { return isbn; }
+    const char* getAuthor() const { return text->get(author); }
+    const char* getEdition() const { return text->get(edition); }
+    const char* getPublication() const { return text->get(publication); }
+
+    // Setters with validation
+    bool setIsbn(const char* newIsbn) {
+        // Validate ISBN is non-empty, fits and uses only ISBN characters
+        size_t length;
+        if (!checkField(newIsbn, MAX_ISBN_LENGTH, CHAR_ISBN, length)) {
+            return false;
+        }
+        
+        // Validate the check digit and store the normalized ISBN-13
+        return parseIsbn(newIsbn, isbn);
+    }
+
+    bool setIsbnValue(uint64_t newIsbn) {
+        // Validate the number is a real ISBN-13
+        if (!isValidIsbn13(newIsbn)) {
+            return false;
+        }
+
+        isbn = newIsbn;
+        return true;
+    }
+
+    bool setAuthor(const char* newAuthor) {
+        // Validate author is non-empty and fits
+        size_t length;
+        if (!checkField(newAuthor, MAX_AUTHOR_LENGTH, CHAR_TEXT, length)) {
+            return false;
+        }
+        
+        return internField(newAuthor, length, author);
+    }
+
+    bool setEdition(const char* newEdition) {
+        // Validate edition is non-empty and fits
+        size_t length;
+        if (!checkField(newEdition, MAX_EDITION_LENGTH, CHAR_TEXT, length)) {
+            return false;
+        }
+        
+        return internField(newEdition, length, edition);
+    }
+
+    bool setPublication(const char* newPublication) {
+        // Validate publication is non-empty and fits
+        size_t length;
+        if (!checkField(newPublication, MAX_PUBLICATION_LENGTH, CHAR_TEXT, length)) {
+            return false;
+        }
+        
+        return internField(newPublication, length, publication);
+    }
+
+    // Display every field, one per line
+    void displayDetails() const {
+        cout << "ID: " << id << endl;
+        char isbnText[MAX_ISBN_LENGTH];
+        formatIsbn(isbn, isbnText);
+        cout << "ISBN: " << isbnText << endl;
+        cout << "Title: " << getTitle() << endl;
+        cout << "Author: " << getAuthor() << endl;
+        cout << "Edition: " << getEdition() << endl;
+        cout << "Publication: " << getPublication() << endl;
+        cout << "Category: " << getCategory() << endl;
+    }
+    
+    // Display the book as one row of the book table
+    void displayInTable() const {
+        char row[TABLE_ROW_LENGTH];
+        fwrite(row, 1, formatTableRow(row), stdout);
+    }
+
+    // Write the book's table row, newline included, into a buffer of TABLE_ROW_LENGTH
+    // Each field is cut or space-padded to its column width; returns the row length
+    int formatTableRow(char* out) const {
+        char isbnText[MAX_ISBN_LENGTH];
+        formatIsbn(isbn, isbnText);
+        char* cursor = out;
+        cursor = putColumn(cursor, "| ", id, 6);
+        cursor = putColumn(cursor, " | ", isbnText, 13);
+        cursor = putColumn(cursor, " | ", getTitle(), 30);
+        cursor = putColumn(cursor, " | ", getAuthor(), 20);
+        cursor = putColumn(cursor, " | ", getEdition(), 8);
+        cursor = putColumn(cursor, " | ", getPublication(), 20);
+        cursor = putColumn(cursor, " | ", getCategory(), 11);
+        memcpy(cursor, " |\n", 3);
+        return static_cast<int>(cursor + 3 - out);
+    }
+
+    // Overwrite the fields set in a patch, leaving the ID and every other field in place
+    // Text from a patch in another pool is copied into this book's pool first; returns
+    // false, leaving the book unchanged, if that pool is full
+    bool applyPatch(const BookPatch& source) {
+        BookPatch patch = source;
+        if (!patch.moveTextTo(*text)) {
+            return false;
+        }
+        if (patch.has(BookPatch::FIELD_CATEGORY)) {
+            category = patch.category;
+        }
+        if (patch.has(BookPatch::FIELD_ISBN)) {
+            isbn = patch.isbn;
+        }
+        if (patch.has(BookPatch::FIELD_TITLE)) {
+            title = patch.title;
+        }
+        if (patch.has(BookPatch::FIELD_AUTHOR)) {
+            author = patch.author;
+        }
+        if (patch.has(BookPatch::FIELD_EDITION)) {
+            edition = patch.edition;
+        }
+        if (patch.has(BookPatch::FIELD_PUBLICATION)) {
+            publication = patch.publication;
+        }
+        return true;
+    }
+
+    // Copy the book's text into another pool and refer to it there from now on
+    // Returns false if the pool is full; the book is then unchanged
+    bool moveTextTo(StringPool& pool) {
+        return moveText(pool, false);
+    }
+
+    // Copy another book into this one, text included, keeping this book's pool
+    // The copy-out methods (getBookById, fetchPage and the like) fill books this way, so
+    // the caller owns the result: it stays readable after the library clears or compacts
+    // its pool, or the snapshot it came from is released. Titles are interned here, so
+    // copying the same book out again adds nothing to the pool. Returns false if the pool
+    // is full; the book is then unchanged.
+    bool copyFrom(const Book& source) {
+        Book copy = source;
+        if (!copy.moveText(*text, true)) {
+            return false;
+        }
+        *this = copy;
+        return true;
+    }
+
+    // Seed a patch with this book's values and no fields set, so its setters mark only real changes
+    void startPatch(BookPatch& patch) const {
+        toPatch(patch);
+        patch.fields = 0;
+    }
+
+    // Fill a patch that sets every field except the ID to this book's values
+    void toPatch(BookPatch& patch) const {
+        patch.text = text;
+        patch.fields = BookPatch::ALL_FIELDS;
+        patch.category = category;
+        patch.isbn = isbn;
+        patch.title = title;
+        patch.author = author;
+        patch.edition = edition;
+        patch.publication = publication;
+    }
+
+    // Copy the book into its fixed-width on-disk record, zero-padding every field
+    void toRecord(CatalogRecord& record) const {
+        strncpy(record.id, id, MAX_ID_LENGTH);
+        memset(record.isbn, 0, MAX_ISBN_LENGTH);
+        formatIsbn(isbn, record.isbn);
+        strncpy(record.title, getTitle(), MAX_TITLE_LENGTH);
+        strncpy(record.author, getAuthor(), MAX_AUTHOR_LENGTH);
+        strncpy(record.edition, getEdition(), MAX_EDITION_LENGTH);
+        strncpy(record.publication, getPublication(), MAX_PUBLICATION_LENGTH);
+        strncpy(record.category, getCategory(), MAX_CATEGORY_LENGTH);
+    }
+
+    // Fill the book from an on-disk record
+    // Returns false if a field is not null-terminated, the ID, ISBN or category fails
+    // validation, or the book's pool is full
+    bool fromRecord(const CatalogRecord& record) {
+        if (memchr(record.id, '\0', MAX_ID_LENGTH) == nullptr ||
+            memchr(record.isbn, '\0', MAX_ISBN_LENGTH) == nullptr ||
+            memchr(record.title, '\0', MAX_TITLE_LENGTH) == nullptr ||
+            memchr(record.author, '\0', MAX_AUTHOR_LENGTH) == nullptr ||
+            memchr(record.edition, '\0', MAX_EDITION_LENGTH) == nullptr ||
+            memchr(record.publication, '\0', MAX_PUBLICATION_LENGTH) == nullptr ||
+            memchr(record.category, '\0', MAX_CATEGORY_LENGTH) == nullptr) {
+            return false;
+        }
+
+        // The ID, ISBN and category key indexes, so they are validated
+        if (!setId(record.id) || !setIsbn(record.isbn) || !setCategory(record.category)) {
+            return false;
+        }
+
+        size_t titleLength = strlen(record.title);
+        title = text->store(record.title, titleLength);
+        return (titleLength == 0 || title != StringArena::EMPTY_HANDLE) &&
+               internField(record.author, strlen(record.author), author) &&
+               internField(record.edition, strlen(record.edition), edition) &&
+               internField(record.publication, strlen(record.publication), publication);
+    }
+
+private:
+    // Helper method to copy the book's text into another pool, titles interned or stored - ENCAPSULATION
+    bool moveText(StringPool& pool, bool internTitle) {
+        if (&pool == text) {
+            return true;
+        }
+        uint32_t moved[4];
+        if (!pool.copyFrom(*text, title, internTitle, moved[0]) ||
+            !pool.copyFrom(*text, author, true, moved[1]) ||
+            !pool.copyFrom(*text, edition, true, moved[2]) ||
+            !pool.copyFrom(*text, publication, true, moved[3])) {
+            return false;
+        }
+        title = moved[0];
+        author = moved[1];
+        edition = moved[2];
+        publication = moved[3];
+        text = &pool;
+        return true;
+    }
+
+    // Helper method to empty the book's own fields - ENCAPSULATION
+    void clearFields() {
+        isbn = 0;
+        author = StringArena::EMPTY_HANDLE;
+        edition = StringArena::EMPTY_HANDLE;
+        publication = StringArena::EMPTY_HANDLE;
+    }
+
+    // Helper method to intern a text field; false if the pool is full - ENCAPSULATION
+    bool internField(const char* value, size_t length, uint32_t& handle) {
+        uint32_t stored = text->intern(value, length);
+        if (length > 0 && stored == StringArena::EMPTY_HANDLE) {
+            return false;
+        }
+        handle = stored;
+        return true;
+    }
+
+};
+
+// Books are stored, copied and memcpy'd as plain records; a vtable pointer would break that
+static_assert(is_trivially_copyable<Book>::value, "Book must stay a plain record");
+static_assert(sizeof(Book) <= 64, "Book must fit in one cache line");
+
+/**
+ * Journal class - inherits from LibraryItem
+ * One issue of a periodical: its ISSN, volume, issue number and publisher. Library keeps
+ * journals in a contiguous array of their own next to the books (see ItemArray).
+ */
+class Journal : public LibraryItem {
+public:
+    static const int MAX_VOLUME = 9999;
+    static const int MAX_ISSUE = 999;
+    static const uint32_t NO_ISSN = 0xFFFFFFFFu;
+
+    // Length of a table row from formatTableRow, newline included
+    static const int TABLE_ROW_LENGTH = 2 + 6 + 3 + 9 + 3 + 30 + 3 + 4 + 3 + 3 + 3 + 20 + 3 + 11 + 3;
+
+private:
+    // Private data members - ENCAPSULATION
+    uint32_t issn;         // Seven digits before the check digit, NO_ISSN if not set
+    uint16_t volume;       // 0 if not set
+    uint16_t issue;        // 0 if not set
+    uint32_t publisher;    // Handle into text
+
+public:
+    // Constructor - a journal built on its own keeps its text in bookFieldPool()
+    Journal() : LibraryItem(ITEM_KIND_JOURNAL, bookFieldPool()) {
+        clearFields();
+    }
+
+    // Constructor - an empty journal whose text goes into the given pool
+    explicit Journal(StringPool& pool) : LibraryItem(ITEM_KIND_JOURNAL, pool) {
+        clearFields();
+    }
+
+    // Getters
+    uint32_t getIssn() const { return issn; }
+    int getVolume() const { return volume; }
+    int getIssue() const { return issue; }
+    const char* getPublisher() const { return text->get(publisher); }
+
+    // Setters with validation
+    bool setIssn(const char* newIssn) {
+        // Validate ISSN is non-empty, fits and uses only ISSN characters
+        size_t length;
+        if (!checkField(newIssn, MAX_ISSN_LENGTH, CHAR_ISBN, length)) {
+            return false;
+        }
+
+        // Validate the check digit and store the seven digits before it
+        return parseIssn(newIssn, issn);
+    }
+
+    bool setVolume(int newVolume) {
+        if (newVolume < 1 || newVolume > MAX_VOLUME) {
+            return false;
+        }
+        volume = static_cast<uint16_t>(newVolume);
+        return true;
+    }
+
+    bool setIssue(int newIssue) {
+        if (newIssue < 1 || newIssue > MAX_ISSUE) {
+            return false;
+        }
+        issue = static_cast<uint16_t>(newIssue);
+        return true;
+    }
+
+    bool setPublisher(const char* newPublisher) {
+        // Validate publisher is non-empty and fits
+        size_t length;
+        if (!checkField(newPublisher, MAX_PUBLICATION_LENGTH, CHAR_TEXT, length)) {
+            return false;
+        }
+
+        uint32_t stored = text->intern(newPublisher, length);
+        if (stored == StringArena::EMPTY_HANDLE) {
+            return false; // The pool is full
+        }
+        publisher = stored;
+        return true;
+    }
+
+    // Display every field, one per line
+    void displayDetails() const {
+        cout << "ID: " << id << endl;
+        char issnText[MAX_ISSN_LENGTH];
+        formatIssn(issn, issnText);
+        cout << "ISSN: " << issnText << endl;
+        cout << "Title: " << getTitle() << endl;
+        cout << "Volume: " << volume << endl;
+        cout << "Issue: " << issue << endl;
+        cout << "Publisher: " << getPublisher() << endl;
+        cout << "Category: " << getCategory() << endl;
+    }
+
+    // Write the journal's table row, newline included, into a buffer of TABLE_ROW_LENGTH
+    // Each field is cut or space-padded to its column width; returns the row length
+    int formatTableRow(char* out) const {
+        char issnText[MAX_ISSN_LENGTH];
+        formatIssn(issn, issnText);
+        char volumeText[8];
+        char issueText[8];
+        snprintf(volumeText, sizeof(volumeText), "%d", volume);
+        snprintf(issueText, sizeof(issueText), "%d", issue);
+        char* cursor = out;
+        cursor = putColumn(cursor, "| ", id, 6);
+        cursor = putColumn(cursor, " | ", issnText, 9);
+        cursor = putColumn(cursor, " | ", getTitle(), 30);
+        cursor = putColumn(cursor, " | ", volumeText, 4);
+        cursor = putColumn(cursor, " | ", issueText, 3);
+        cursor = putColumn(cursor, " | ", getPublisher(), 20);
+        cursor = putColumn(cursor, " | ", getCategory(), 11);
+        memcpy(cursor, " |\n", 3);
+        return static_cast<int>(cursor + 3 - out);
+    }
+
+    // Copy the journal's text into another pool and refer to it there from now on
+    // Returns false if the pool is full; the journal is then unchanged
+    bool moveTextTo(StringPool& pool) {
+        if (&pool == text) {
+            return true;
+        }
+        uint32_t moved[2];
+        if (!pool.copyFrom(*text, title, false, moved[0]) ||
+            !pool.copyFrom(*text, publisher, true, moved[1])) {
+            return false;
+        }
+        title = moved[0];
+        publisher = moved[1];
+        text = &pool;
+        return true;
+    }
+
+private:
+    // Helper method to empty the journal's own fields - ENCAPSULATION
+    void clearFields() {
+        issn = NO_ISSN;
+        volume = 0;
+        issue = 0;
+        publisher = StringArena::EMPTY_HANDLE;
+    }
+};
+
+// Journals are stored and copied as plain records, like books
+static_assert(is_trivially_copyable<Journal>::value, "Journal must stay a plain record");
+static_assert(sizeof(Journal) <= 64, "Journal must fit in one cache line");
+
+/**
+ * Helper function to view an item as a Book, or nullptr if it is another kind
+ * Checks the kind tag instead of using dynamic_cast
+ */
+const Book* asBook(const LibraryItem* item) {
+    if (item == nullptr || item->getKind() != ITEM_KIND_BOOK) {
+        return nullptr;
+    }
+    return static_cast<const Book*>(item);
+}
+
+/**
+ * Helper function to view an item as a Journal, or nullptr if it is another kind
+ */
+const Journal* asJournal(const LibraryItem* item) {
+    if (item == nullptr || item->getKind() != ITEM_KIND_JOURNAL) {
+        return nullptr;
+    }
+    return static_cast<const Journal*>(item);
+}
+
+/**
+ * TableWriter class - renders the book and journal tables into a large buffer
+ * Rows are formatted with Book::formatTableRow or Journal::formatTableRow and written to
+ * the output with one fwrite per buffer-full (and when the writer is flushed or
+ * destroyed), rather than a flushed line at a time. Shared by every collection that lists books.
+ */
+class TableWriter {
+private:
+    static const size_t BUFFER_SIZE = size_t(1) << 20;
+    static const char* const SEPARATOR;
+    static const char* const HEADER;
+    static const char* const JOURNAL_SEPARATOR;
+    static const char* const JOURNAL_HEADER;
+
+    // Private data members - ENCAPSULATION
+    char* buffer;
+    size_t used;
+    FILE* output;
+    int rowCount; // Rows written so far
+
+public:
+    // Constructor
+    explicit TableWriter(FILE* out = stdout) {
+        buffer = new char[BUFFER_SIZE];
+        used = 0;
+        output = out;
+        rowCount = 0;
+    }
+
+    // Destructor - writes out anything still buffered
+    ~TableWriter() {
+        flush();
+        delete[] buffer;
+    }
+
+    // The writer owns its buffer, so it cannot be copied
+    TableWriter(const TableWriter&) = delete;
+    TableWriter& operator=(const TableWriter&) = delete;
+
+    // Write the column headings framed by separators
+    void writeHeader() {
+        writeText(SEPARATOR);
+        writeText(HEADER);
+        writeText(SEPARATOR);
+    }
+
+    // Write one book's row followed by a separator
+    void writeBook(const Book& book) {
+        makeRoom(Book::TABLE_ROW_LENGTH + strlen(SEPARATOR));
+        used += book.formatTableRow(buffer + used);
+        writeText(SEPARATOR);
+        rowCount++;
+    }
+
+    // Write the journal table's column headings framed by separators
+    void writeJournalHeader() {
+        writeText(JOURNAL_SEPARATOR);
+        writeText(JOURNAL_HEADER);
+        writeText(JOURNAL_SEPARATOR);
+    }
+
+    // Write one journal's row followed by a separator
+    void writeJournal(const Journal& journal) {
+        makeRoom(Journal::TABLE_ROW_LENGTH + strlen(JOURNAL_SEPARATOR));
+        used += journal.formatTableRow(buffer + used);
+        writeText(JOURNAL_SEPARATOR);
+        rowCount++;
+    }
+
+    // Get the number of rows written
+    int getRowCount() const {
+        return rowCount;
+    }
+
+    // Write out the buffered text; call before printing to the same output another way
+    void flush() {
+        if (used > 0) {
+            fwrite(buffer, 1, used, output);
+            used = 0;
+        }
+        fflush(output);
+    }
+
+private:
+    // Helper method to append text to the buffer - ENCAPSULATION
+    void writeText(const char* text) {
+        size_t length = strlen(text);
+        makeRoom(length);
+        memcpy(buffer + used, text, length);
+        used += length;
+    }
+
+    // Helper method to write the buffer out if it cannot take more bytes - ENCAPSULATION
+    void makeRoom(size_t length) {
+        if (used + length > BUFFER_SIZE) {
+            fwrite(buffer, 1, used, output);
+            used = 0;
+        }
+    }
+};
+
+const char* const TableWriter::SEPARATOR =
+    "+--------+---------------+--------------------------------+----------------------+----------+----------------------+-------------+\n";
+const char* const TableWriter::HEADER =
+    "| ID     | ISBN          | Title                          | Author               | Edition  | Publication          | Category    |\n";
+const char* const TableWriter::JOURNAL_SEPARATOR =
+    "+--------+-----------+--------------------------------+------+-----+----------------------+-------------+\n";
+const char* const TableWriter::JOURNAL_HEADER =
+    "| ID     | ISSN      | Title                          | Vol  | No  | Publisher            | Category    |\n";
+
+// Callback for the book-visiting methods; returning false stops the walk
+typedef bool (*BookVisitor)(const Book& book, void* context);
+
+// Filter for the scanning methods; may be called from several threads at once
+typedef bool (*BookPredicate)(const Book& book, const void* context);
+
+// Text fields that Library can keep a sorted order of
+enum SortField {
+    SORT_BY_TITLE,
+    SORT_BY_AUTHOR,
+    SORT_BY_PUBLICATION,
+    SORT_FIELD_COUNT
+};
+
+/**
+ * SortedCursor struct - position in a paged listing sorted by a field
+ * Holds the key and serial of the last book returned, so the next page starts strictly after
+ * it however many books were added or removed in between. from and to bound the range:
+ * keys not less than from, up to every key that starts with to (so "A" to "C" takes in
+ * "Cz..."); both ignore case and an empty bound is open.
+ */
+struct SortedCursor {
+    SortField field;
+    char from[MAX_TITLE_LENGTH];
+    char to[MAX_TITLE_LENGTH];
+    char lastKey[MAX_TITLE_LENGTH];
+    int64_t lastSerial;  // Serial of the last book returned, -1 until the first page has been fetched
+
+    SortedCursor(SortField sortField, const char* rangeFrom = "", const char* rangeTo = "") {
+        field = sortField;
+        strncpy(from, rangeFrom != nullptr ? rangeFrom : "", MAX_TITLE_LENGTH - 1);
+        from[MAX_TITLE_LENGTH - 1] = '\0';
+        strncpy(to, rangeTo != nullptr ? rangeTo : "", MAX_TITLE_LENGTH - 1);
+        to[MAX_TITLE_LENGTH - 1] = '\0';
+        lastKey[0] = '\0';
+        lastSerial = -1;
+    }
+};
+
+/**
+ * BookHandle struct - lightweight reference to a book in a Library
+ * Holds the book's serial, the number it was given when added and that no other book ever
+ * gets (not even after clear()), and its row as a hint. The row survives edits and the slot
+ * moves of deletes; when the library renumbers its rows the serial finds the book again.
+ * Resolving a handle (Library::resolveBook) yields nullptr once the book is gone instead
+ * of another book.
+ */
+struct BookHandle {
+    int row;
+    int64_t serial;  // -1 never matches a book
+
+    BookHandle() {
+        row = -1;
+        serial = -1;
+    }
+};
+
+/**
+ * BookCursor struct - position in a paged listing of books
+ * Pages are keyed by serial, the per-book number assigned in insertion order and never
+ * reused, rather than by offset or row. Books added while paging land after every
+ * existing serial, and deleted books are skipped, so no book is repeated or missed. A
+ * cursor can be stored between requests as its serial (and category).
+ */
+struct BookCursor {
+    int64_t nextSerial;    // Lowest serial the next page may return
+    BookCategory category; // Only books in this category, or CATEGORY_NONE for every book
+
+    BookCursor(BookCategory filter = CATEGORY_NONE, int64_t startSerial = 0) {
+        nextSerial = startSerial;
+        category = filter;
+    }
+};
+
+/**
+ * ItemOutcome enum - what a batch mutation did with one item
+ */
+enum ItemOutcome : unsigned char {
+    ITEM_ADDED,
+    ITEM_UPDATED,
+    ITEM_DELETED,
+    ITEM_DUPLICATE,  // Add of an ID that is already present, or repeated earlier in the batch
+    ITEM_NOT_FOUND,  // Delete of an ID that is not present
+    ITEM_INVALID,    // Not an item this manager holds, or no ID
+    ITEM_FAILED      // Could not be stored or logged, or its batch could not be committed to the log
+};
+
+/**
+ * ItemManager abstract base class - demonstrates ABSTRACTION through virtual functions
+ * Defines the interface for managing collections of items
+ */
+class ItemManager {
+public:
+    virtual ~ItemManager() {}
+    
+    // Pure virtual functions - ABSTRACTION
+    virtual bool addItem(const LibraryItem& item) = 0;
+    virtual bool deleteItem(const char* id) = 0;
+
+    // Batch mutations - each writes the outcome of item i to outcomes[i] (if not nullptr)
+    // and returns the number of items added, updated or deleted. Items are applied in
+    // order, so a later entry for the same ID sees the effect of an earlier one.
+    virtual int addItems(const LibraryItem* const* items, int itemCount, ItemOutcome* outcomes) = 0;
+    virtual int upsertItems(const LibraryItem* const* items, int itemCount, ItemOutcome* outcomes) = 0;
+    virtual int deleteItems(const char* const* ids, int idCount, ItemOutcome* outcomes) = 0;
+    virtual bool displayItemById(const char* id) const = 0;
+    virtual void displayAllItems() const = 0;
+    virtual int getItemCount() const = 0;
+};
+
+/**
+ * IdIndex class - open-addressing hash index from an item ID to its array slot
+ * Keys are not copied: the owner supplies a callback that returns the ID stored at a slot,
+ * so the index only holds a cached hash and a slot number per entry.
+ * Uses linear probing with backward-shift deletion, so lookups stay O(1) on average
+ * and no tombstones build up after many deletes.
+ */
+class IdIndex {
+public:
+    // Callback used to read the ID currently stored at a slot of the owner's array
+    typedef const char* (*KeyAccessor)(const void* owner, int slot);
+
+private:
+    struct Entry {
+        unsigned int hash;
+        int slot; // EMPTY_SLOT marks a free bucket
+    };
+
+    static const int EMPTY_SLOT = -1;
+    static const int MIN_BUCKETS = 16;
+
+    // Private data members - ENCAPSULATION
+    Entry* entries;          // Bucket array, size is always a power of two
+    int bucketCount;         // Number of buckets
+    int used;                // Number of occupied buckets
+    const void* owner;       // Object passed back to keyAt
+    KeyAccessor keyAt;       // Resolves a slot to its stored ID
+
+public:
+    // Constructor
+    IdIndex(const void* indexOwner, KeyAccessor accessor) {
+        owner = indexOwner;
+        keyAt = accessor;
+        bucketCount = 0;
+        used = 0;
+        entries = nullptr;
+        allocateBuckets(MIN_BUCKETS);
+    }
+
+    // Destructor to free memory
+    ~IdIndex() {
+        delete[] entries;
+    }
+
+    // The index refers back to its owner, so it cannot be copied
+    IdIndex(const IdIndex&) = delete;
+    IdIndex& operator=(const IdIndex&) = delete;
+
+    // FNV-1a hash of a null-terminated ID
+    static unsigned int hashId(const char* id) {
+        unsigned int hash = 2166136261u;
+        for (const unsigned char* p = reinterpret_cast<const unsigned char*>(id); *p != '\0'; ++p) {
+            hash ^= *p;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    // Find the slot stored for an ID, or -1 if the ID is not indexed
+    int find(const char* id) const {
+        unsigned int hash = hashId(id);
+        int mask = bucketCount - 1;
+        for (int b = static_cast<int>(hash) & mask; entries[b].slot != EMPTY_SLOT; b = (b + 1) & mask) {
+            if (entries[b].hash == hash && strcmp(keyAt(owner, entries[b].slot), id) == 0) {
+                return entries[b].slot;
+            }
+        }
+        return -1;
+    }
+
+    // Index an ID at the given slot; returns false if the ID is already indexed
+    bool insert(const char* id, int slot) {
+        if ((used + 1) * 10 > bucketCount * 7) {
+            rehash(bucketCount * 2);
+        }
+
+        unsigned int hash = hashId(id);
+        int mask = bucketCount - 1;
+        int b = static_cast<int>(hash) & mask;
+        for (; entries[b].slot != EMPTY_SLOT; b = (b + 1) & mask) {
+            if (entries[b].hash == hash && strcmp(keyAt(owner, entries[b].slot), id) == 0) {
+                return false;
+            }
+        }
+        entries[b].hash = hash;
+        entries[b].slot = slot;
+        used++;
+        return true;
+    }
+
+    // Point an indexed ID at a new slot after its item has moved; returns false if not indexed
+    bool updateSlot(const char* id, int newSlot) {
+        int b = findBucket(id);
+        if (b == -1) {
+            return false;
+        }
+        entries[b].slot = newSlot;
+        return true;
+    }
+
+    // Remove an ID from the index; returns false if it was not indexed
+    bool erase(const char* id) {
+        int b = findBucket(id);
+        if (b == -1) {
+            return false;
+        }
+
+        // Backward-shift deletion: pull later entries of the probe run into the hole
+        int mask = bucketCount - 1;
+        int hole = b;
+        for (int next = (hole + 1) & mask; entries[next].slot != EMPTY_SLOT; next = (next + 1) & mask) {
+            int home = static_cast<int>(entries[next].hash) & mask;
+            // Move the entry only if its home bucket is not inside (hole, next]
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                entries[hole] = entries[next];
+                hole = next;
+            }
+        }
+        entries[hole].slot = EMPTY_SLOT;
+        used--;
+        return true;
+    }
+
+    // Make room for at least the given number of IDs without rehashing
+    void reserve(int expectedCount) {
+        int needed = bucketsFor(expectedCount);
+        if (needed > bucketCount) {
+            rehash(needed);
+        }
+    }
+
+    // Release buckets no longer needed for the current number of IDs
+    void shrinkToFit() {
+        int needed = bucketsFor(used);
+        if (needed < bucketCount) {
+            rehash(needed);
+        }
+    }
+
+    // Remove every entry
+    void clear() {
+        for (int b = 0; b < bucketCount; b++) {
+            entries[b].slot = EMPTY_SLOT;
+        }
+        used = 0;
+    }
+
+    // Get the number of indexed IDs
+    int size() const {
+        return used;
+    }
+
+private:
+    // Helper method to compute the bucket count that keeps the load factor under 0.7 - ENCAPSULATION
+    static int bucketsFor(int expectedCount) {
+        int needed = MIN_BUCKETS;
+        while (static_cast<long long>(needed) * 7 < static_cast<long long>(expectedCount) * 10) {
+            needed *= 2;
+        }
+        return needed;
+    }
+
+    // Helper method to locate the bucket holding an ID - ENCAPSULATION
+    int findBucket(const char* id) const {
+        unsigned int hash = hashId(id);
+        int mask = bucketCount - 1;
+        for (int b = static_cast<int>(hash) & mask; entries[b].slot != EMPTY_SLOT; b = (b + 1) & mask) {
+            if (entries[b].hash == hash && strcmp(keyAt(owner, entries[b].slot), id) == 0) {
+                return b;
+            }
+        }
+        return -1;
+    }
+
+    // Helper method to allocate an empty bucket array - ENCAPSULATION
+    void allocateBuckets(int newBucketCount) {
+        entries = new Entry[newBucketCount];
+        bucketCount = newBucketCount;
+        for (int b = 0; b < bucketCount; b++) {
+            entries[b].slot = EMPTY_SLOT;
+        }
+    }
+
+    // Helper method to grow the bucket array, reusing the cached hashes - ENCAPSULATION
+    void rehash(int newBucketCount) {
+        Entry* oldEntries = entries;
+        int oldBucketCount = bucketCount;
+        allocateBuckets(newBucketCount);
+
+        int mask = bucketCount - 1;
+        for (int i = 0; i < oldBucketCount; i++) {
+            if (oldEntries[i].slot == EMPTY_SLOT) {
+                continue;
+            }
+            int b = static_cast<int>(oldEntries[i].hash) & mask;
+            while (entries[b].slot != EMPTY_SLOT) {
+                b = (b + 1) & mask;
+            }
+            entries[b] = oldEntries[i];
+        }
+        delete[] oldEntries;
+    }
+};
+
+/**
+ * ItemArray class template - a contiguous array of one kind of item, indexed by ID
+ * Holds items of a single concrete type by value, so walking them is a tight loop over
+ * plain records with no per-item dispatch, and keeps their text in a pool of its own.
+ * Deletes move the last item into the hole. Library uses it for every kind besides
+ * books, whose array carries the extra indexes and rows of Library itself.
+ * Item must be trivially copyable and provide getId() and moveTextTo(StringPool&).
+ */
+template <typename Item>
+class ItemArray {
+private:
+    static const int MIN_CAPACITY = 16;
+
+    // Private data members - ENCAPSULATION
+    Item* items;       // The items, in slots 0..count-1
+    int count;
+    int capacity;
+    StringPool text;   // Text of every item stored
+    IdIndex idIndex;   // Hash index from item ID to its slot
+
+public:
+    // Constructor
+    ItemArray() : idIndex(this, &ItemArray::idAtSlot) {
+        capacity = MIN_CAPACITY;
+        count = 0;
+        items = new Item[capacity];
+        idIndex.reserve(capacity);
+    }
+
+    // Destructor to free memory
+    ~ItemArray() {
+        delete[] items;
+    }
+
+    // The array owns its items and the index refers back to it, so it cannot be copied
+    ItemArray(const ItemArray&) = delete;
+    ItemArray& operator=(const ItemArray&) = delete;
+
+    // Add a copy of an item, its text copied into the array's pool
+    ItemOutcome add(const Item& item) {
+        if (item.getId()[0] == '\0') {
+            return ITEM_INVALID;
+        }
+        if (count == capacity) {
+            grow();
+        }
+        items[count] = item;
+        if (!idIndex.insert(items[count].getId(), count)) {
+            return ITEM_DUPLICATE;
+        }
+        if (!items[count].moveTextTo(text)) {
+            idIndex.erase(items[count].getId());
+            return ITEM_FAILED;
+        }
+        count++;
+        return ITEM_ADDED;
+    }
+
+    // Replace the item stored under an ID with a copy of another, keeping the ID
+    ItemOutcome replace(const char* id, const Item& item) {
+        int slot = id != nullptr ? idIndex.find(id) : -1;
+        if (slot == -1) {
+            return ITEM_NOT_FOUND;
+        }
+        Item updated = item;
+        if (!updated.moveTextTo(text) || !updated.setId(items[slot].getId())) {
+            return ITEM_FAILED;
+        }
+        items[slot] = updated;
+        return ITEM_UPDATED;
+    }
+
+    // Remove the item stored under an ID; returns false if there is none
+    bool remove(const char* id) {
+        int slot = id != nullptr ? idIndex.find(id) : -1;
+        if (slot == -1) {
+            return false;
+        }
+        idIndex.erase(id);
+        count--;
+        if (slot != count) {
+            items[slot] = items[count];
+            idIndex.updateSlot(items[slot].getId(), slot);
+        }
+        return true;
+    }
+
+    // Find the item stored under an ID, or nullptr
+    const Item* find(const char* id) const {
+        int slot = id != nullptr ? idIndex.find(id) : -1;
+        return slot != -1 ? &items[slot] : nullptr;
+    }
+
+    // Visit every item in slot order until the visitor returns false
+    // The visitor is called with const Item&, so the call is resolved at compile time
+    template <typename Visitor>
+    bool forEach(Visitor& visit) const {
+        for (int i = 0; i < count; i++) {
+            if (!visit(items[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Get the number of items
+    int getCount() const {
+        return count;
+    }
+
+    // Remove every item and the text they held, keeping the allocated storage
+    void clear() {
+        count = 0;
+        idIndex.clear();
+        text.clear();
+    }
+
+private:
+    // Helper method to double the capacity - ENCAPSULATION
+    void grow() {
+        int newCapacity = capacity > numeric_limits<int>::max() / 2 ? numeric_limits<int>::max() : capacity * 2;
+        Item* grown = new Item[newCapacity];
+        memcpy(static_cast<void*>(grown), items, count * sizeof(Item));
+        delete[] items;
+        items = grown;
+        capacity = newCapacity;
+        idIndex.reserve(capacity);
+    }
+
+    // Key accessor handed to idIndex - resolves a slot to the ID of the item stored there
+    static const char* idAtSlot(const void* owner, int slot) {
+        return static_cast<const ItemArray*>(owner)->items[slot].getId();
+    }
+};
+
+/**
+ * IsbnIndex class - hash index from a normalized ISBN to the rows of every copy
+ * Several books (copies) may share an ISBN. The table maps each ISBN to the most recently
+ * added row, and the rows of one ISBN are chained through per-row links, so lookup, add
+ * and remove are all O(1). Rows are stable per-book numbers, so nothing changes when a
+ * book moves to another slot.
+ */
+class IsbnIndex {
+private:
+    struct Entry {
+        uint64_t isbn; // 0 marks a free bucket
+        int head;      // Most recently added row with this ISBN
+    };
+
+    static const int MIN_BUCKETS = 16;
+
+    // Private data members - ENCAPSULATION
+    Entry* entries;      // Bucket array, size is always a power of two
+    int bucketCount;     // Number of buckets
+    int used;            // Number of distinct ISBNs
+    int* nextRows;       // Next row with the same ISBN, -1 at the end of a chain
+    int* prevRows;       // Previous row with the same ISBN, -1 at the head
+    int rowCapacity;     // Allocated entries in nextRows and prevRows
+
+public:
+    // Constructor
+    IsbnIndex() {
+        bucketCount = MIN_BUCKETS;
+        used = 0;
+        entries = new Entry[bucketCount]();
+        rowCapacity = MIN_BUCKETS;
+        nextRows = new int[rowCapacity];
+        prevRows = new int[rowCapacity];
+    }
+
+    // Destructor to free memory
+    ~IsbnIndex() {
+        delete[] entries;
+        delete[] nextRows;
+        delete[] prevRows;
+    }
+
+    // The index owns its arrays, so it cannot be copied
+    IsbnIndex(const IsbnIndex&) = delete;
+    IsbnIndex& operator=(const IsbnIndex&) = delete;
+
+    // Get the first row with an ISBN, or -1 if no book has it
+    int first(uint64_t isbn) const {
+        if (isbn == 0) {
+            return -1;
+        }
+        int b = findBucket(isbn);
+        return entries[b].isbn == isbn ? entries[b].head : -1;
+    }
+
+    // Get the next row with the same ISBN as a row, or -1 after the last one
+    int next(int row) const {
+        return nextRows[row];
+    }
+
+    // Index a row under an ISBN; unset ISBNs (0) are not indexed
+    void add(uint64_t isbn, int row) {
+        if (isbn == 0) {
+            return;
+        }
+        ensureRows(row + 1);
+        if ((used + 1) * 10 > bucketCount * 7) {
+            rehash(bucketCount * 2);
+        }
+
+        int b = findBucket(isbn);
+        prevRows[row] = -1;
+        if (entries[b].isbn == isbn) {
+            nextRows[row] = entries[b].head;
+            prevRows[entries[b].head] = row;
+        } else {
+            nextRows[row] = -1;
+            entries[b].isbn = isbn;
+            used++;
+        }
+        entries[b].head = row;
+    }
+
+    // Remove a row from an ISBN's chain, dropping the ISBN when no rows are left
+    void remove(uint64_t isbn, int row) {
+        if (isbn == 0) {
+            return;
+        }
+        int b = findBucket(isbn);
+        if (entries[b].isbn != isbn) {
+            return;
+        }
+
+        int prev = prevRows[row];
+        int next = nextRows[row];
+        if (next != -1) {
+            prevRows[next] = prev;
+        }
+        if (prev != -1) {
+            nextRows[prev] = next;
+        } else if (next != -1) {
+            entries[b].head = next;
+        } else {
+            eraseBucket(b);
+        }
+    }
+
+    // Remove every entry, keeping the allocated storage
+    void clear() {
+        memset(entries, 0, bucketCount * sizeof(Entry));
+        used = 0;
+    }
+
+    // Mix an ISBN into a well-spread hash; shared with the other tables keyed by ISBN
+    static uint64_t hashIsbn(uint64_t isbn) {
+        isbn ^= isbn >> 33;
+        isbn *= 0xff51afd7ed558ccdULL;
+        isbn ^= isbn >> 33;
+        return isbn;
+    }
+
+private:
+
+    // Helper method to find the bucket holding an ISBN, or the free bucket where it would go - ENCAPSULATION
+    int findBucket(uint64_t isbn) const {
+        int mask = bucketCount - 1;
+        int b = static_cast<int>(hashIsbn(isbn)) & mask;
+        while (entries[b].isbn != 0 && entries[b].isbn != isbn) {
+            b = (b + 1) & mask;
+        }
+        return b;
+    }
+
+    // Helper method to empty a bucket and shift later entries of its cluster back - ENCAPSULATION
+    void eraseBucket(int b) {
+        int mask = bucketCount - 1;
+        int hole = b;
+        for (int next = (b + 1) & mask; entries[next].isbn != 0; next = (next + 1) & mask) {
+            int home = static_cast<int>(hashIsbn(entries[next].isbn)) & mask;
+            // Move the entry into the hole if the hole lies on its probe path
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                entries[hole] = entries[next];
+                hole = next;
+            }
+        }
+        entries[hole].isbn = 0;
+        used--;
+    }
+
+    // Helper method to grow the per-row links to cover a row count - ENCAPSULATION
+    void ensureRows(int rows) {
+        if (rows <= rowCapacity) {
+            return;
+        }
+        int newCapacity = rowCapacity;
+        while (newCapacity < rows) {
+            newCapacity = newCapacity > numeric_limits<int>::max() / 2 ? numeric_limits<int>::max() : newCapacity * 2;
+        }
+        int* grownNext = new int[newCapacity];
+        int* grownPrev = new int[newCapacity];
+        memcpy(grownNext, nextRows, rowCapacity * sizeof(int));
+        memcpy(grownPrev, prevRows, rowCapacity * sizeof(int));
+        delete[] nextRows;
+        delete[] prevRows;
+        nextRows = grownNext;
+        prevRows = grownPrev;
+        rowCapacity = newCapacity;
+    }
+
+    // Helper method to move every entry into a larger bucket array - ENCAPSULATION
+    void rehash(int newBucketCount) {
+        Entry* oldEntries = entries;
+        int oldCount = bucketCount;
+
+        bucketCount = newBucketCount;
+        entries = new Entry[bucketCount]();
+        for (int i = 0; i < oldCount; i++) {
+            if (oldEntries[i].isbn != 0) {
+                entries[findBucket(oldEntries[i].isbn)] = oldEntries[i];
+            }
+        }
+
+        delete[] oldEntries;
+    }
+};
+
+/**
+ * TextIndex class - inverted index from title and author words to book rows
+ * Text is split into runs of letters and digits and folded to lower case. Each distinct
+ * word keeps a posting list of the rows that contain it, sorted ascending. A multi-word
+ * query is an AND: the shortest list drives the intersection and the longer lists are
+ * searched by galloping (exponential then binary search), so the cost follows the
+ * shortest list rather than the longest.
+ * Rows are stable per-book numbers assigned by Library, so postings stay valid when a
+ * book changes slots.
+ */
+class TextIndex {
+public:
+    static const int MAX_TOKEN_LENGTH = 32;    // Longer words are indexed by their first 32 characters
+    static const int MAX_QUERY_TERMS = 16;     // Longer queries are rejected, not truncated
+    static const int MAX_DOCUMENT_TOKENS = 80; // Enough for a full title plus author
+
+private:
+    struct PostingList {
+        int* rows;    // Rows containing the term, ascending
+        int size;
+        int capacity;
+    };
+
+    struct TermSlot {
+        unsigned int hash;
+        int term; // -1 marks a free slot
+    };
+
+    struct Token {
+        char text[MAX_TOKEN_LENGTH];
+        int length;
+        unsigned int hash;
+    };
+
+    // Private data members - ENCAPSULATION
+    TermSlot* table;         // Open-addressing term dictionary, size is a power of two
+    int tableSize;
+    char* termText;          // Arena holding the characters of every term
+    size_t termTextUsed;
+    size_t termTextCapacity;
+    size_t* termOffsets;     // Start of each term in termText
+    unsigned char* termLengths;
+    PostingList* postings;   // Posting list of each term
+    int termCount;
+    int termCapacity;
+
+public:
+    // Constructor
+    TextIndex() {
+        table = nullptr;
+        tableSize = 0;
+        termText = nullptr;
+        termTextUsed = 0;
+        termTextCapacity = 0;
+        termOffsets = nullptr;
+        termLengths = nullptr;
+        postings = nullptr;
+        termCount = 0;
+        termCapacity = 0;
+        resizeTable(1024);
+    }
+
+    // Destructor to free memory
+    ~TextIndex() {
+        clear();
+        delete[] table;
+        delete[] termText;
+        delete[] termOffsets;
+        delete[] termLengths;
+        delete[] postings;
+    }
+
+    // The index owns its posting lists, so it cannot be copied
+    TextIndex(const TextIndex&) = delete;
+    TextIndex& operator=(const TextIndex&) = delete;
+
+    // Index the words of a book's title and author under its row
+    void addDocument(int row, const char* title, const char* author) {
+        Token tokens[MAX_DOCUMENT_TOKENS];
+        int tokenCount = tokenize(title, tokens, 0, MAX_DOCUMENT_TOKENS);
+        tokenCount = tokenize(author, tokens, tokenCount, MAX_DOCUMENT_TOKENS);
+        for (int i = 0; i < tokenCount; i++) {
+            int term = findTerm(tokens[i].text, tokens[i].length, tokens[i].hash);
+            if (term == -1) {
+                term = addTerm(tokens[i].text, tokens[i].length, tokens[i].hash);
+            }
+            insertRow(postings[term], row);
+        }
+    }
+
+    // Remove a row from the postings of the words it was indexed under
+    // The title and author must be the ones passed to addDocument
+    void removeDocument(int row, const char* title, const char* author) {
+        Token tokens[MAX_DOCUMENT_TOKENS];
+        int tokenCount = tokenize(title, tokens, 0, MAX_DOCUMENT_TOKENS);
+        tokenCount = tokenize(author, tokens, tokenCount, MAX_DOCUMENT_TOKENS);
+        for (int i = 0; i < tokenCount; i++) {
+            int term = findTerm(tokens[i].text, tokens[i].length, tokens[i].hash);
+            if (term != -1) {
+                eraseRow(postings[term], row);
+            }
+        }
+    }
+
+    // Find the rows whose title or author contain every word of the query
+    // Writes at most maxResults rows in ascending order and returns how many were written,
+    // or -1 if the query has more than MAX_QUERY_TERMS distinct words (dropping the rest
+    // would silently widen the AND)
+    int search(const char* query, int* rowsOut, int maxResults) const {
+        Token tokens[MAX_QUERY_TERMS + 1];
+        int tokenCount = tokenize(query, tokens, 0, MAX_QUERY_TERMS + 1);
+        if (tokenCount > MAX_QUERY_TERMS) {
+            return -1;
+        }
+        if (tokenCount == 0 || rowsOut == nullptr || maxResults <= 0) {
+            return 0;
+        }
+
+        // Every term must exist; order the lists shortest first
+        const PostingList* lists[MAX_QUERY_TERMS];
+        for (int i = 0; i < tokenCount; i++) {
+            int term = findTerm(tokens[i].text, tokens[i].length, tokens[i].hash);
+            if (term == -1 || postings[term].size == 0) {
+                return 0;
+            }
+            const PostingList* list = &postings[term];
+            int j = i;
+            for (; j > 0 && lists[j - 1]->size > list->size; j--) {
+                lists[j] = lists[j - 1];
+            }
+            lists[j] = list;
+        }
+
+        // Leapfrog intersection: advance every list to the current candidate, and on a
+        // mismatch jump the driving list forward to the larger value
+        int positions[MAX_QUERY_TERMS] = {0};
+        const PostingList* driver = lists[0];
+        int found = 0;
+        int i = 0;
+        while (i < driver->size && found < maxResults) {
+            int candidate = driver->rows[i];
+            bool inAll = true;
+            for (int t = 1; t < tokenCount; t++) {
+                positions[t] = gallop(*lists[t], positions[t], candidate);
+                if (positions[t] == lists[t]->size) {
+                    return found;
+                }
+                int value = lists[t]->rows[positions[t]];
+                if (value != candidate) {
+                    i = gallop(*driver, i + 1, value);
+                    inAll = false;
+                    break;
+                }
+            }
+            if (inAll) {
+                rowsOut[found++] = candidate;
+                i++;
+            }
+        }
+        return found;
+    }
+
+    // Give every indexed row a new number; newRows maps each old row to its new one
+    // The mapping must keep rows in order, so each posting list stays sorted as it is rewritten
+    void renumberRows(const int* newRows) {
+        for (int t = 0; t < termCount; t++) {
+            for (int i = 0; i < postings[t].size; i++) {
+                postings[t].rows[i] = newRows[postings[t].rows[i]];
+            }
+        }
+    }
+
+    // Remove every term and posting
+    void clear() {
+        for (int t = 0; t < termCount; t++) {
+            delete[] postings[t].rows;
+        }
+        termCount = 0;
+        termTextUsed = 0;
+        for (int b = 0; b < tableSize; b++) {
+            table[b].term = -1;
+        }
+    }
+
+private:
+    // Helper method to split text into unique, lower-cased words - ENCAPSULATION
+    // Appends to tokens starting at tokenCount and returns the new count
+    static int tokenize(const char* text, Token* tokens, int tokenCount, int maxTokens) {
+        if (text == nullptr) {
+            return tokenCount;
+        }
+
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(text);
+        while (*p != '\0' && tokenCount < maxTokens) {
+            // Bytes of multi-byte UTF-8 characters count as word characters
+            while (*p != '\0' && !(isalnum(*p) || *p >= 0x80)) {
+                p++;
+            }
+            if (*p == '\0') {
+                break;
+            }
+
+            Token& token = tokens[tokenCount];
+            token.length = 0;
+            token.hash = 2166136261u;
+            for (; *p != '\0' && (isalnum(*p) || *p >= 0x80); p++) {
+                if (token.length < MAX_TOKEN_LENGTH) {
+                    unsigned char folded = static_cast<unsigned char>(tolower(*p));
+                    token.text[token.length++] = static_cast<char>(folded);
+                    token.hash = (token.hash ^ folded) * 16777619u;
+                }
+            }
+
+            // Keep each word once per document
+            bool duplicate = false;
+            for (int i = 0; i < tokenCount && !duplicate; i++) {
+                duplicate = tokens[i].hash == token.hash && tokens[i].length == token.length &&
+                            memcmp(tokens[i].text, token.text, token.length) == 0;
+            }
+            if (!duplicate) {
+                tokenCount++;
+            }
+        }
+        return tokenCount;
+    }
+
+    // Helper method to find the first position at or after start holding a row >= target - ENCAPSULATION
+    static int gallop(const PostingList& list, int start, int target) {
+        if (start >= list.size || list.rows[start] >= target) {
+            return start;
+        }
+        // Exponential search for a range that brackets target, then binary search inside it
+        int low = start;
+        int step = 1;
+        while (low + step < list.size && list.rows[low + step] < target) {
+            low += step;
+            step *= 2;
+        }
+        int high = low + step < list.size ? low + step : list.size;
+        while (low + 1 < high) {
+            int mid = low + (high - low) / 2;
+            if (list.rows[mid] < target) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        return high;
+    }
+
+    // Helper method to look up a term - ENCAPSULATION
+    int findTerm(const char* text, int length, unsigned int hash) const {
+        int mask = tableSize - 1;
+        for (int b = static_cast<int>(hash) & mask; table[b].term != -1; b = (b + 1) & mask) {
+            int term = table[b].term;
+            if (table[b].hash == hash && termLengths[term] == length &&
+                memcmp(termText + termOffsets[term], text, length) == 0) {
+                return term;
+            }
+        }
+        return -1;
+    }
+
+    // Helper method to add a new term with an empty posting list - ENCAPSULATION
+    int addTerm(const char* text, int length, unsigned int hash) {
+        if ((termCount + 1) * 10 > tableSize * 7) {
+            resizeTable(tableSize * 2);
+        }
+        if (termCount == termCapacity) {
+            growTerms(termCapacity > 0 ? termCapacity * 2 : 1024);
+        }
+        if (termTextUsed + length > termTextCapacity) {
+            size_t newCapacity = termTextCapacity > 0 ? termTextCapacity * 2 : 16 * 1024;
+            while (newCapacity < termTextUsed + length) {
+                newCapacity *= 2;
+            }
+            char* grown = new char[newCapacity];
+            if (termTextUsed > 0) {
+                memcpy(grown, termText, termTextUsed);
+            }
+            delete[] termText;
+            termText = grown;
+            termTextCapacity = newCapacity;
+        }
+
+        int term = termCount++;
+        memcpy(termText + termTextUsed, text, length);
+        termOffsets[term] = termTextUsed;
+        termLengths[term] = static_cast<unsigned char>(length);
+        termTextUsed += length;
+        postings[term].rows = nullptr;
+        postings[term].size = 0;
+        postings[term].capacity = 0;
+
+        int mask = tableSize - 1;
+        int b = static_cast<int>(hash) & mask;
+        while (table[b].term != -1) {
+            b = (b + 1) & mask;
+        }
+        table[b].hash = hash;
+        table[b].term = term;
+        return term;
+    }
+
+    // Helper method to grow the per-term arrays - ENCAPSULATION
+    void growTerms(int newCapacity) {
+        size_t* offsets = new size_t[newCapacity];
+        unsigned char* lengths = new unsigned char[newCapacity];
+        PostingList* lists = new PostingList[newCapacity];
+        for (int t = 0; t < termCount; t++) {
+            offsets[t] = termOffsets[t];
+            lengths[t] = termLengths[t];
+            lists[t] = postings[t];
+        }
+        delete[] termOffsets;
+        delete[] termLengths;
+        delete[] postings;
+        termOffsets = offsets;
+        termLengths = lengths;
+        postings = lists;
+        termCapacity = newCapacity;
+    }
+
+    // Helper method to rebuild the term dictionary at a new size - ENCAPSULATION
+    void resizeTable(int newSize) {
+        delete[] table;
+        table = new TermSlot[newSize];
+        tableSize = newSize;
+        for (int b = 0; b < tableSize; b++) {
+            table[b].term = -1;
+        }
+
+        int mask = tableSize - 1;
+        for (int t = 0; t < termCount; t++) {
+            unsigned int hash = 2166136261u;
+            for (int i = 0; i < termLengths[t]; i++) {
+                hash = (hash ^ static_cast<unsigned char>(termText[termOffsets[t] + i])) * 16777619u;
+            }
+            int b = static_cast<int>(hash) & mask;
+            while (table[b].term != -1) {
+                b = (b + 1) & mask;
+            }
+            table[b].hash = hash;
+            table[b].term = t;
+        }
+    }
+
+    // Helper method to add a row to a posting list, keeping it sorted - ENCAPSULATION
+    // New books get the highest row so far, which makes the common case an append
+    static void insertRow(PostingList& list, int row) {
+        int position = list.size;
+        if (list.size > 0 && list.rows[list.size - 1] >= row) {
+            position = gallop(list, 0, row);
+            if (list.rows[position] == row) {
+                return;
+            }
+        }
+
+        if (list.size == list.capacity) {
+            int newCapacity = list.capacity > 0 ? list.capacity * 2 : 4;
+            int* grown = new int[newCapacity];
+            if (list.size > 0) {
+                memcpy(grown, list.rows, list.size * sizeof(int));
+            }
+            delete[] list.rows;
+            list.rows = grown;
+            list.capacity = newCapacity;
+        }
+        memmove(list.rows + position + 1, list.rows + position, (list.size - position) * sizeof(int));
+        list.rows[position] = row;
+        list.size++;
+    }
+
+    // Helper method to remove a row from a posting list - ENCAPSULATION
+    static void eraseRow(PostingList& list, int row) {
+        int position = gallop(list, 0, row);
+        if (position < list.size && list.rows[position] == row) {
+            memmove(list.rows + position, list.rows + position + 1, (list.size - position - 1) * sizeof(int));
+            list.size--;
+        }
+    }
+};
+
+/**
+ * CategoryIndex class - one bitmap of slots per category
+ * Bit i of a category's bitmap is set when the book in slot i has that category, so a
+ * category listing visits only the matching slots (in slot order) and skips 64
+ * non-matching slots per zero word. Per-category counts are kept alongside.
+ */
+class CategoryIndex {
+private:
+    // Private data members - ENCAPSULATION
+    uint64_t* bits[CATEGORY_COUNT]; // Slot bitmap of each category
+    int counts[CATEGORY_COUNT];     // Books in each category
+    int wordCount;                  // Words allocated per bitmap
+
+public:
+    // Constructor
+    CategoryIndex() {
+        wordCount = 0;
+        for (int c = 0; c < CATEGORY_COUNT; c++) {
+            bits[c] = nullptr;
+            counts[c] = 0;
+        }
+    }
+
+    // Destructor to free memory
+    ~CategoryIndex() {
+        for (int c = 0; c < CATEGORY_COUNT; c++) {
+            delete[] bits[c];
+        }
+    }
+
+    // The index owns its bitmaps, so it cannot be copied
+    CategoryIndex(const CategoryIndex&) = delete;
+    CategoryIndex& operator=(const CategoryIndex&) = delete;
+
+    // Make the bitmaps cover the given number of slots, keeping the bits already set
+    void resize(int slotCapacity) {
+        int newWordCount = (slotCapacity + 63) / 64;
+        if (newWordCount == wordCount) {
+            return;
+        }
+        for (int c = 0; c < CATEGORY_COUNT; c++) {
+            uint64_t* resized = new uint64_t[newWordCount];
+            int kept = wordCount < newWordCount ? wordCount : newWordCount;
+            if (kept > 0) {
+                memcpy(resized, bits[c], kept * sizeof(uint64_t));
+            }
+            memset(resized + kept, 0, (newWordCount - kept) * sizeof(uint64_t));
+            delete[] bits[c];
+            bits[c] = resized;
+        }
+        wordCount = newWordCount;
+    }
+
+    // Record that a slot holds a book of the given category
+    void set(int slot, BookCategory category) {
+        bits[category][slot >> 6] |= uint64_t(1) << (slot & 63);
+        counts[category]++;
+    }
+
+    // Record that a slot no longer holds a book of the given category
+    void clear(int slot, BookCategory category) {
+        bits[category][slot >> 6] &= ~(uint64_t(1) << (slot & 63));
+        counts[category]--;
+    }
+
+    // Find the first slot at or after fromSlot holding a book of the category, or -1
+    int next(BookCategory category, int fromSlot) const {
+        int word = fromSlot >> 6;
+        if (fromSlot < 0 || word >= wordCount) {
+            return -1;
+        }
+        uint64_t pending = bits[category][word] & (~uint64_t(0) << (fromSlot & 63));
+        while (pending == 0) {
+            if (++word == wordCount) {
+                return -1;
+            }
+            pending = bits[category][word];
+        }
+        return word * 64 + lowestBit(pending);
+    }
+
+    // Find the first slot at or after fromSlot holding a book of any category, or -1
+    int nextAny(int fromSlot) const {
+        int word = fromSlot >> 6;
+        if (fromSlot < 0 || word >= wordCount) {
+            return -1;
+        }
+        uint64_t pending = anyWord(word) & (~uint64_t(0) << (fromSlot & 63));
+        while (pending == 0) {
+            if (++word == wordCount) {
+                return -1;
+            }
+            pending = anyWord(word);
+        }
+        return word * 64 + lowestBit(pending);
+    }
+
+    // Get the number of books in a category
+    int getCount(BookCategory category) const {
+        return counts[category];
+    }
+
+    // Remove every slot from every category
+    void clearAll() {
+        for (int c = 0; c < CATEGORY_COUNT; c++) {
+            if (wordCount > 0) {
+                memset(bits[c], 0, wordCount * sizeof(uint64_t));
+            }
+            counts[c] = 0;
+        }
+    }
+
+private:
+    // Helper method to get one word of the union of every category's bitmap - ENCAPSULATION
+    uint64_t anyWord(int word) const {
+        uint64_t merged = 0;
+        for (int c = 0; c < CATEGORY_COUNT; c++) {
+            merged |= bits[c][word];
+        }
+        return merged;
+    }
+
+    // Helper method to get the position of the lowest set bit of a non-zero word - ENCAPSULATION
+    static int lowestBit(uint64_t word) {
+        #if defined(__GNUC__) || defined(__clang__)
+            return __builtin_ctzll(word);
+        #else
+            int position = 0;
+            while ((word & 1) == 0) {
+                word >>= 1;
+                position++;
+            }
+            return position;
+        #endif
+    }
+};
+
+/**
+ * Suggestion struct - one type-ahead completion
+ */
+struct Suggestion {
+    char text[MAX_TITLE_LENGTH]; // Completed title or author, as first entered
+    int count;                   // Number of books with exactly this text
+};
+
+/**
+ * PrefixIndex class - radix trie of whole titles or authors for type-ahead
+ * Matching ignores ASCII case. Each node stores the highest book count found in its
+ * subtree, so the top-k completions of a prefix are found best-first without visiting
+ * the rest of the subtree. Adding or removing a value walks one path and fixes the
+ * stored maxima on the way back up. Nodes and text of values that no longer have any
+ * books stay in the trie with a count of zero and are reused if the value comes back,
+ * until the owner clears the trie and adds its live values again (Library::compactText).
+ * Text offsets are int, so the text arena holds at most INT_MAX bytes; a value that does
+ * not fit is not added.
+ */
+class PrefixIndex {
+private:
+    struct Node {
+        int labelOffset;     // Edge label leading to this node, in text
+        int labelLength;
+        int textOffset;      // Full value ending at this node, in text; -1 if none
+        int textLength;
+        int count;           // Books whose value ends exactly here
+        int best;            // Highest count in this subtree, including this node
+        int parent;
+        int firstChild;
+        int nextSibling;
+    };
+
+    struct HeapItem {
+        int key;       // count for a value, best for a subtree
+        int node;
+        bool isValue;  // true: emit this node's value; false: expand this subtree
+    };
+
+    // Private data members - ENCAPSULATION
+    Node* nodes;        // Node pool, nodes[0] is the root
+    int nodeCount;
+    int nodeCapacity;
+    char* text;         // Arena holding every value; edge labels point into it
+    size_t textUsed;
+    size_t textCapacity;
+
+public:
+    // Constructor
+    PrefixIndex() {
+        nodes = nullptr;
+        nodeCount = 0;
+        nodeCapacity = 0;
+        text = nullptr;
+        textUsed = 0;
+        textCapacity = 0;
+        clear();
+    }
+
+    // Destructor to free memory
+    ~PrefixIndex() {
+        delete[] nodes;
+        delete[] text;
+    }
+
+    // The index owns its node pool, so it cannot be copied
+    PrefixIndex(const PrefixIndex&) = delete;
+    PrefixIndex& operator=(const PrefixIndex&) = delete;
+
+    // Count one more book with this value
+    void add(const char* value) {
+        int length = value != nullptr ? static_cast<int>(strlen(value)) : 0;
+        if (length == 0) {
+            return;
+        }
+
+        int node = 0;
+        int pos = 0;
+        while (pos < length) {
+            int child = findChild(node, value[pos]);
+            if (child == -1) {
+                // New leaf carrying the rest of the value
+                int offset = storeText(value, length);
+                if (offset == -1) {
+                    return; // The text arena is full
+                }
+                child = newNode(node, offset + pos, length - pos);
+                nodes[child].textOffset = offset;
+                nodes[child].textLength = length;
+                node = child;
+                pos = length;
+                break;
+            }
+
+            int matched = matchLabel(child, value + pos, length - pos);
+            if (matched < nodes[child].labelLength) {
+                child = splitNode(child, matched);
+            }
+            node = child;
+            pos += matched;
+        }
+
+        if (nodes[node].textOffset == -1) {
+            int offset = storeText(value, length);
+            if (offset == -1) {
+                return; // The text arena is full
+            }
+            nodes[node].textOffset = offset;
+            nodes[node].textLength = length;
+        }
+        nodes[node].count++;
+
+        // Raise the subtree maxima along the path
+        int raised = nodes[node].count;
+        for (int n = node; n != -1 && nodes[n].best < raised; n = nodes[n].parent) {
+            nodes[n].best = raised;
+        }
+    }
+
+    // Count one book fewer with this value
+    void remove(const char* value) {
+        int node = findNode(value, false);
+        if (node == -1 || nodes[node].count == 0) {
+            return;
+        }
+        nodes[node].count--;
+
+        // Recompute the subtree maxima along the path until one does not change
+        for (int n = node; n != -1; n = nodes[n].parent) {
+            int best = nodes[n].count;
+            for (int c = nodes[n].firstChild; c != -1; c = nodes[c].nextSibling) {
+                if (nodes[c].best > best) {
+                    best = nodes[c].best;
+                }
+            }
+            if (best == nodes[n].best) {
+                break;
+            }
+            nodes[n].best = best;
+        }
+    }
+
+    // Find the values starting with prefix that have the most books
+    // Writes at most maxResults suggestions, most books first, and returns how many were written
+    int suggest(const char* prefix, Suggestion* out, int maxResults) const {
+        if (prefix == nullptr || out == nullptr || maxResults <= 0) {
+            return 0;
+        }
+        int start = findNode(prefix, true);
+        if (start == -1 || nodes[start].best == 0) {
+            return 0;
+        }
+
+        // Best-first walk: a subtree is only expanded when its maximum could still make the top k
+        int heapCapacity = 64;
+        HeapItem* heap = new HeapItem[heapCapacity];
+        int heapSize = 0;
+        pushHeap(heap, heapSize, heapCapacity, nodes[start].best, start, false);
+
+        int found = 0;
+        while (heapSize > 0 && found < maxResults) {
+            HeapItem top = popHeap(heap, heapSize);
+            const Node& n = nodes[top.node];
+            if (top.isValue) {
+                int length = n.textLength < MAX_TITLE_LENGTH - 1 ? n.textLength : MAX_TITLE_LENGTH - 1;
+                memcpy(out[found].text, text + n.textOffset, length);
+                out[found].text[length] = '\0';
+                out[found].count = n.count;
+                found++;
+                continue;
+            }
+            if (n.count > 0) {
+                pushHeap(heap, heapSize, heapCapacity, n.count, top.node, true);
+            }
+            for (int c = n.firstChild; c != -1; c = nodes[c].nextSibling) {
+                if (nodes[c].best > 0) {
+                    pushHeap(heap, heapSize, heapCapacity, nodes[c].best, c, false);
+                }
+            }
+        }
+        delete[] heap;
+        return found;
+    }
+
+    // Get the number of bytes of value text the trie holds, counting values with no books
+    size_t getTextBytes() const {
+        return textUsed;
+    }
+
+    // Remove every value
+    void clear() {
+        nodeCount = 0;
+        textUsed = 0;
+        newNode(-1, 0, 0); // Root
+    }
+
+private:
+    // Helper method to fold a character for case-insensitive matching - ENCAPSULATION
+    static char fold(char c) {
+        return static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+
+    // Helper method to find the child whose edge starts with a character - ENCAPSULATION
+    int findChild(int node, char c) const {
+        char folded = fold(c);
+        for (int child = nodes[node].firstChild; child != -1; child = nodes[child].nextSibling) {
+            if (fold(text[nodes[child].labelOffset]) == folded) {
+                return child;
+            }
+        }
+        return -1;
+    }
+
+    // Helper method to count how many characters of an edge label match - ENCAPSULATION
+    int matchLabel(int node, const char* value, int length) const {
+        const char* label = text + nodes[node].labelOffset;
+        int limit = nodes[node].labelLength < length ? nodes[node].labelLength : length;
+        int matched = 0;
+        while (matched < limit && fold(label[matched]) == fold(value[matched])) {
+            matched++;
+        }
+        return matched;
+    }
+
+    // Helper method to walk to the node for a value - ENCAPSULATION
+    // With allowPartialEdge the value may end inside an edge (prefix search); returns -1 if absent
+    int findNode(const char* value, bool allowPartialEdge) const {
+        if (value == nullptr) {
+            return -1;
+        }
+        int length = static_cast<int>(strlen(value));
+        int node = 0;
+        int pos = 0;
+        while (pos < length) {
+            int child = findChild(node, value[pos]);
+            if (child == -1) {
+                return -1;
+            }
+            int matched = matchLabel(child, value + pos, length - pos);
+            if (matched < nodes[child].labelLength) {
+                return allowPartialEdge && pos + matched == length ? child : -1;
+            }
+            node = child;
+            pos += matched;
+        }
+        return node;
+    }
+
+    // Helper method to split an edge so a node ends after its first characters - ENCAPSULATION
+    // Returns the new node holding the first part; the original node becomes its only child
+    int splitNode(int node, int splitAt) {
+        int parent = nodes[node].parent;
+        int middle = newNode(parent, nodes[node].labelOffset, splitAt);
+
+        // newNode linked middle as the parent's first child; unlink the original node instead
+        nodes[parent].firstChild = nodes[middle].nextSibling;
+        nodes[middle].nextSibling = nodes[node].nextSibling;
+        for (int* link = &nodes[parent].firstChild; ; link = &nodes[*link].nextSibling) {
+            if (*link == node) {
+                *link = middle;
+                break;
+            }
+        }
+
+        nodes[node].parent = middle;
+        nodes[node].nextSibling = -1;
+        nodes[node].labelOffset += splitAt;
+        nodes[node].labelLength -= splitAt;
+        nodes[middle].firstChild = node;
+        nodes[middle].best = nodes[node].best;
+        return middle;
+    }
+
+    // Helper method to allocate a node and link it as the parent's first child - ENCAPSULATION
+    int newNode(int parent, int labelOffset, int labelLength) {
+        if (nodeCount == nodeCapacity) {
+            int newCapacity = nodeCapacity > 0 ? nodeCapacity * 2 : 1024;
+            Node* grown = new Node[newCapacity];
+            if (nodeCount > 0) {
+                memcpy(grown, nodes, nodeCount * sizeof(Node));
+            }
+            delete[] nodes;
+            nodes = grown;
+            nodeCapacity = newCapacity;
+        }
+
+        int node = nodeCount++;
+        Node& n = nodes[node];
+        n.labelOffset = labelOffset;
+        n.labelLength = labelLength;
+        n.textOffset = -1;
+        n.textLength = 0;
+        n.count = 0;
+        n.best = 0;
+        n.parent = parent;
+        n.firstChild = -1;
+        n.nextSibling = -1;
+        if (parent != -1) {
+            n.nextSibling = nodes[parent].firstChild;
+            nodes[parent].firstChild = node;
+        }
+        return node;
+    }
+
+    // Helper method to append a value to the text arena - ENCAPSULATION
+    // Returns its offset, or -1 if the arena would pass the largest offset a node can hold
+    int storeText(const char* value, int length) {
+        const size_t maxText = static_cast<size_t>(numeric_limits<int>::max());
+        if (textUsed + length > maxText) {
+            return -1;
+        }
+        if (textUsed + length > textCapacity) {
+            size_t newCapacity = textCapacity > 0 ? textCapacity : 64 * 1024;
+            while (newCapacity < textUsed + length) {
+                newCapacity = newCapacity > maxText / 2 ? maxText : newCapacity * 2;
+            }
+            char* grown = new char[newCapacity];
+            if (textUsed > 0) {
+                memcpy(grown, text, textUsed);
+            }
+            delete[] text;
+            text = grown;
+            textCapacity = newCapacity;
+        }
+        int offset = static_cast<int>(textUsed);
+        memcpy(text + offset, value, length);
+        textUsed += length;
+        return offset;
+    }
+
+    // Helper methods for the max-heap used by suggest - ENCAPSULATION
+    static void pushHeap(HeapItem*& heap, int& size, int& capacity, int key, int node, bool isValue) {
+        if (size == capacity) {
+            HeapItem* grown = new HeapItem[capacity * 2];
+            memcpy(grown, heap, size * sizeof(HeapItem));
+            delete[] heap;
+            heap = grown;
+            capacity *= 2;
+        }
+        int i = size++;
+        while (i > 0 && heap[(i - 1) / 2].key < key) {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i].key = key;
+        heap[i].node = node;
+        heap[i].isValue = isValue;
+    }
+
+    static HeapItem popHeap(HeapItem* heap, int& size) {
+        HeapItem top = heap[0];
+        HeapItem last = heap[--size];
+        int i = 0;
+        while (2 * i + 1 < size) {
+            int child = 2 * i + 1;
+            if (child + 1 < size && heap[child + 1].key > heap[child].key) {
+                child++;
+            }
+            if (heap[child].key <= last.key) {
+                break;
+            }
+            heap[i] = heap[child];
+            i = child;
+        }
+        heap[i] = last;
+        return top;
+    }
+};
+
+/**
+ * Helper function to compare two strings ignoring ASCII case
+ * Returns a negative, zero or positive value like strcmp
+ */
+int compareFolded(const char* a, const char* b) {
+    const unsigned char* x = reinterpret_cast<const unsigned char*>(a);
+    const unsigned char* y = reinterpret_cast<const unsigned char*>(b);
+    while (true) {
+        int cx = (*x >= 'A' && *x <= 'Z') ? *x + ('a' - 'A') : *x;
+        int cy = (*y >= 'A' && *y <= 'Z') ? *y + ('a' - 'A') : *y;
+        if (cx != cy || cx == 0) {
+            return cx - cy;
+        }
+        ++x;
+        ++y;
+    }
+}
+
+/**
+ * Helper function to compare the start of a string with a prefix, ignoring ASCII case
+ * Returns zero if text starts with prefix, otherwise the sign of comparing the two
+ */
+int compareFoldedPrefix(const char* text, const char* prefix) {
+    const unsigned char* x = reinterpret_cast<const unsigned char*>(text);
+    const unsigned char* y = reinterpret_cast<const unsigned char*>(prefix);
+    for (; *y != '\0'; ++x, ++y) {
+        int cx = (*x >= 'A' && *x <= 'Z') ? *x + ('a' - 'A') : *x;
+        int cy = (*y >= 'A' && *y <= 'Z') ? *y + ('a' - 'A') : *y;
+        if (cx != cy) {
+            return cx - cy;
+        }
+    }
+    return 0;
+}
+
+/**
+ * OrderIndex class - B+ tree that keeps rows sorted by a text field
+ * Entries are (key, row) pairs ordered by the key ignoring case, then by row, so equal
+ * keys list in insertion order. Keys are not copied: they point at text in the shared
+ * string pool, which never moves or frees it. Each entry also carries the first 8 case-folded
+ * bytes of its key, so most comparisons are one integer compare instead of a cache miss
+ * into the pool. Leaves are linked, so a sorted listing or a range query is a walk along
+ * the leaves from one O(log n) descent.
+ * Removal takes the entry out of its leaf without rebalancing; once as many entries have
+ * been removed as remain, the tree is rebuilt packed.
+ */
+class OrderIndex {
+public:
+    struct Entry {
+        uint64_t prefix; // First 8 bytes of the key, case-folded, big-endian, zero padded
+        const char* key;
+        int row;
+    };
+
+    // Callback for walk; returning false stops the walk
+    typedef bool (*EntryVisitor)(const Entry& entry, void* context);
+
+private:
+    static const int NODE_SIZE = 64;
+
+    struct Node {
+        bool leaf;
+        int count;                 // Entries in a leaf, children in an internal node
+        Entry entries[NODE_SIZE];  // Leaf: the entries. Internal: entries[i] is the lowest bound of children[i], i >= 1
+        Node* children[NODE_SIZE]; // Internal nodes only
+        Node* next;                // Next leaf in order, leaves only
+
+        explicit Node(bool isLeaf) {
+            leaf = isLeaf;
+            count = 0;
+            next = nullptr;
+        }
+    };
+
+    // Private data members - ENCAPSULATION
+    Node* root;
+    int entryCount;     // Entries in the tree
+    int removedCount;   // Entries removed since the last rebuild
+
+public:
+    // Constructor
+    OrderIndex() {
+        root = new Node(true);
+        entryCount = 0;
+        removedCount = 0;
+    }
+
+    // Destructor to free memory
+    ~OrderIndex() {
+        freeNode(root);
+    }
+
+    // The index owns its nodes, so it cannot be copied
+    OrderIndex(const OrderIndex&) = delete;
+    OrderIndex& operator=(const OrderIndex&) = delete;
+
+    // Get the number of entries
+    int getCount() const {
+        return entryCount;
+    }
+
+    // Add a row under a key
+    void add(const char* key, int row) {
+        Entry entry = makeEntry(key, row);
+        Entry split;
+        Node* right = insertInto(root, entry, split);
+        if (right != nullptr) {
+            Node* newRoot = new Node(false);
+            newRoot->children[0] = root;
+            newRoot->children[1] = right;
+            newRoot->entries[1] = split;
+            newRoot->count = 2;
+            root = newRoot;
+        }
+        entryCount++;
+    }
+
+    // Remove a row stored under a key; returns false if the pair is not indexed
+    bool remove(const char* key, int row) {
+        Entry entry = makeEntry(key, row);
+        Node* node = root;
+        while (!node->leaf) {
+            node = node->children[childFor(node, entry)];
+        }
+        int pos = lowerBound(node, entry);
+        if (pos == node->count || node->entries[pos].row != row) {
+            return false;
+        }
+        memmove(node->entries + pos, node->entries + pos + 1, (node->count - pos - 1) * sizeof(Entry));
+        node->count--;
+        entryCount--;
+        removedCount++;
+        if (removedCount > entryCount && removedCount > NODE_SIZE) {
+            rebuild();
+        }
+        return true;
+    }
+
+    // Walk entries in order from the first one not less than (key, row) until the visitor returns false
+    void walk(const char* key, int row, EntryVisitor visit, void* context) const {
+        Entry start = makeEntry(key, row);
+        const Node* node = root;
+        while (!node->leaf) {
+            node = node->children[childFor(node, start)];
+        }
+        for (int pos = lowerBound(node, start); node != nullptr; node = node->next, pos = 0) {
+            for (; pos < node->count; pos++) {
+                if (!visit(node->entries[pos], context)) {
+                    return;
+                }
+            }
+        }
+    }
+
+    // Give every entry a new row; newRows maps each old row to its new one
+    // The mapping must keep rows in order, so ties stay sorted. The tree is rebuilt packed.
+    void renumberRows(const int* newRows) {
+        rebuild(newRows);
+    }
+
+    // Replace every entry with one per row, keys[row] being the key of that row
+    // One sort and a bottom-up pack, instead of a descent and a shifting insert per row.
+    void build(const char* const* keys, int rowCount) {
+        Entry* all = new Entry[rowCount > 0 ? rowCount : 1];
+        for (int row = 0; row < rowCount; row++) {
+            all[row] = makeEntry(keys[row], row);
+        }
+        sort(all, all + rowCount, [](const Entry& a, const Entry& b) { return compareEntries(a, b) < 0; });
+        freeNode(root);
+        pack(all, rowCount);
+        delete[] all;
+    }
+
+    // Remove every entry
+    void clear() {
+        freeNode(root);
+        root = new Node(true);
+        entryCount = 0;
+        removedCount = 0;
+    }
+
+private:
+    // Helper method to build an entry with its key prefix - ENCAPSULATION
+    static Entry makeEntry(const char* key, int row) {
+        Entry entry;
+        entry.prefix = 0;
+        entry.key = key;
+        entry.row = row;
+        bool ended = false;
+        for (int i = 0; i < 8; i++) {
+            unsigned char c = ended ? 0 : static_cast<unsigned char>(key[i]);
+            ended = c == 0;
+            entry.prefix = (entry.prefix << 8) | ((c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c);
+        }
+        return entry;
+    }
+
+    // Helper method to order two entries by key ignoring case, then by row - ENCAPSULATION
+    static int compareEntries(const Entry& a, const Entry& b) {
+        if (a.prefix != b.prefix) {
+            return a.prefix < b.prefix ? -1 : 1;
+        }
+        // Equal prefixes with a zero byte are equal keys; otherwise both keys go past 8 bytes
+        if ((a.prefix & 0xFF) != 0) {
+            int byKey = compareFolded(a.key + 8, b.key + 8);
+            if (byKey != 0) {
+                return byKey;
+            }
+        }
+        return a.row < b.row ? -1 : (a.row > b.row ? 1 : 0);
+    }
+
+    // Helper method to find the first entry of a leaf not less than an entry - ENCAPSULATION
+    static int lowerBound(const Node* leaf, const Entry& entry) {
+        int low = 0;
+        int high = leaf->count;
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (compareEntries(leaf->entries[mid], entry) < 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    // Helper method to pick the child of an internal node whose range holds an entry - ENCAPSULATION
+    static int childFor(const Node* node, const Entry& entry) {
+        int low = 1;
+        int high = node->count;
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (compareEntries(node->entries[mid], entry) <= 0) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low - 1;
+    }
+
+    // Helper method to insert below a node - ENCAPSULATION
+    // Returns the new right sibling if the node split, with its lowest bound in split
+    Node* insertInto(Node* node, const Entry& entry, Entry& split) {
+        if (node->leaf) {
+            int pos = lowerBound(node, entry);
+            memmove(node->entries + pos + 1, node->entries + pos, (node->count - pos) * sizeof(Entry));
+            node->entries[pos] = entry;
+            node->count++;
+            if (node->count < NODE_SIZE) {
+                return nullptr;
+            }
+            Node* right = new Node(true);
+            right->count = NODE_SIZE / 2;
+            memcpy(right->entries, node->entries + NODE_SIZE / 2, right->count * sizeof(Entry));
+            node->count = NODE_SIZE / 2;
+            right->next = node->next;
+            node->next = right;
+            split = right->entries[0];
+            return right;
+        }
+
+        int child = childFor(node, entry);
+        Entry childSplit;
+        Node* childRight = insertInto(node->children[child], entry, childSplit);
+        if (childRight == nullptr) {
+            return nullptr;
+        }
+        memmove(node->children + child + 2, node->children + child + 1, (node->count - child - 1) * sizeof(Node*));
+        memmove(node->entries + child + 2, node->entries + child + 1, (node->count - child - 1) * sizeof(Entry));
+        node->children[child + 1] = childRight;
+        node->entries[child + 1] = childSplit;
+        node->count++;
+        if (node->count < NODE_SIZE) {
+            return nullptr;
+        }
+        Node* right = new Node(false);
+        right->count = NODE_SIZE / 2;
+        memcpy(right->children, node->children + NODE_SIZE / 2, right->count * sizeof(Node*));
+        memcpy(right->entries, node->entries + NODE_SIZE / 2, right->count * sizeof(Entry));
+        node->count = NODE_SIZE / 2;
+        split = right->entries[0];
+        return right;
+    }
+
+    // Helper method to rebuild the tree with full leaves after many removals - ENCAPSULATION
+    // newRows, if given, maps each entry's row to a new one on the way
+    void rebuild(const int* newRows = nullptr) {
+        Entry* all = new Entry[entryCount > 0 ? entryCount : 1];
+        int n = 0;
+        const Node* node = root;
+        while (!node->leaf) {
+            node = node->children[0];
+        }
+        for (; node != nullptr; node = node->next) {
+            memcpy(all + n, node->entries, node->count * sizeof(Entry));
+            n += node->count;
+        }
+        freeNode(root);
+        if (newRows != nullptr) {
+            for (int i = 0; i < n; i++) {
+                all[i].row = newRows[all[i].row];
+            }
+        }
+        pack(all, n);
+        delete[] all;
+    }
+
+    // Helper method to build the tree over sorted entries, replacing the freed root - ENCAPSULATION
+    void pack(const Entry* all, int n) {
+        // Pack leaves to three quarters so the next inserts do not split at once
+        const int fill = NODE_SIZE * 3 / 4;
+        int levelCount = n > 0 ? (n + fill - 1) / fill : 1;
+        Node** level = new Node*[levelCount];
+        for (int l = 0; l < levelCount; l++) {
+            level[l] = new Node(true);
+            int begin = l * fill;
+            level[l]->count = n - begin < fill ? (n - begin > 0 ? n - begin : 0) : fill;
+            memcpy(level[l]->entries, all + begin, level[l]->count * sizeof(Entry));
+            if (l > 0) {
+                level[l - 1]->next = level[l];
+            }
+        }
+        while (levelCount > 1) {
+            int parentCount = (levelCount + fill - 1) / fill;
+            Node** parents = new Node*[parentCount];
+            for (int p = 0; p < parentCount; p++) {
+                parents[p] = new Node(false);
+                int begin = p * fill;
+                int children = levelCount - begin < fill ? levelCount - begin : fill;
+                for (int c = 0; c < children; c++) {
+                    parents[p]->children[c] = level[begin + c];
+                    parents[p]->entries[c] = lowestEntry(level[begin + c]);
+                }
+                parents[p]->count = children;
+            }
+            delete[] level;
+            level = parents;
+            levelCount = parentCount;
+        }
+        root = level[0];
+        delete[] level;
+        entryCount = n;
+        removedCount = 0;
+    }
+
+    // Helper method to get the lowest entry below a freshly built node - ENCAPSULATION
+    static Entry lowestEntry(const Node* node) {
+        while (!node->leaf) {
+            node = node->children[0];
+        }
+        return node->entries[0];
+    }
+
+    // Helper method to free a node and everything below it - ENCAPSULATION
+    static void freeNode(Node* node) {
+        if (!node->leaf) {
+            for (int c = 0; c < node->count; c++) {
+                freeNode(node->children[c]);
+            }
+        }
+        delete node;
+    }
+};
+
+/**
+ * JournalHeader struct - header at the start of a journal file
+ */
+struct JournalHeader {
+    char magic[8];       // JOURNAL_MAGIC
+    uint32_t version;    // JOURNAL_VERSION
+    uint32_t checkpoint; // Snapshot generation the records apply on top of
+};
+
+/**
+ * JournalEntry struct - one decoded journal record
+ */
+struct JournalEntry {
+    int operation;           // One of CatalogJournal::Operation
+    char id[MAX_ID_LENGTH];  // ID of the affected book
+    Book book;               // Full book for add and edit records, in the pool it was bound to
+};
+
+/**
+ * CatalogJournal class - write-ahead log of Library mutations
+ * Each add, edit and delete is appended as a compact record:
+ *   [uint32 payload length][uint32 checksum][uint8 operation][payload]
+ * where the payload is the book ID (delete) or every field of the book (add, edit),
+ * each field stored as a one-byte length followed by its characters.
+ *
+ * Records are buffered in memory and made durable by commit(), which writes the
+ * buffer and issues a single fsync. With a group size above one, several mutations
+ * share one fsync (group commit); a mutation is durable once commit() has returned.
+ * Records stay in the buffer until the fsync that covers them succeeds. A failed write
+ * or fsync cuts the file back to its last synced length, so the file never holds a
+ * record the library has not applied, and the buffered records are retried by the next
+ * commit. A record whose own commit fails is dropped, since its mutation is rejected.
+ */
+class CatalogJournal {
+public:
+    enum Operation {
+        OP_ADD = 1,
+        OP_EDIT = 2,
+        OP_DELETE = 3
+    };
+
+private:
+    static const size_t RECORD_PREFIX_SIZE = 9;          // Length, checksum and operation byte
+    static const size_t FLUSH_THRESHOLD = 1024 * 1024;   // Buffered bytes written out without waiting for commit
+
+    // Private data members - ENCAPSULATION
+    FILE* file;              // Open journal, nullptr when closed
+    char* buffer;            // Records not yet synced to the file
+    size_t bufferUsed;       // Bytes used in buffer
+    size_t bufferWritten;    // Leading bytes of buffer already written to the file, not yet synced
+    size_t syncedLength;     // Length of the file up to the last successful fsync
+    size_t bufferCapacity;   // Bytes allocated for buffer
+    int pendingRecords;      // Records appended since the last commit
+    int groupSize;           // Records per automatic commit
+    int groupDepth;          // Open beginGroup calls; automatic commits wait until it is zero
+    uint32_t checkpoint;     // Generation written in the journal header
+
+public:
+    // Constructor
+    CatalogJournal() {
+        file = nullptr;
+        buffer = nullptr;
+        bufferUsed = 0;
+        bufferWritten = 0;
+        syncedLength = 0;
+        bufferCapacity = 0;
+        pendingRecords = 0;
+        groupSize = 1;
+        groupDepth = 0;
+        checkpoint = 0;
+    }
+
+    // Destructor - commits anything still buffered
+    ~CatalogJournal() {
+        close();
+        delete[] buffer;
+    }
+
+    // A journal owns its file handle, so it cannot be copied
+    CatalogJournal(const CatalogJournal&) = delete;
+    CatalogJournal& operator=(const CatalogJournal&) = delete;
+
+    // Open a journal for appending at the given generation
+    // validLength is the number of bytes known to hold intact records (from replay);
+    // anything after it is a torn tail and is cut off. Zero starts a fresh journal.
+    bool open(const char* path, uint32_t generation, size_t validLength) {
+        close();
+        if (path == nullptr || path[0] == '\0') {
+            return false;
+        }
+
+        file = fopen(path, "r+b");
+        if (file == nullptr) {
+            file = fopen(path, "w+b");
+            if (file == nullptr) {
+                return false;
+            }
+        }
+        // Records are buffered here, so stdio keeps nothing that a failed write could leave behind
+        setvbuf(file, nullptr, _IONBF, 0);
+
+        checkpoint = generation;
+        if (validLength < sizeof(JournalHeader)) {
+            return reset(generation);
+        }
+        if (!truncateFile(validLength) || fseek(file, 0, SEEK_END) != 0) {
+            close();
+            return false;
+        }
+        bufferUsed = 0;
+        bufferWritten = 0;
+        syncedLength = validLength;
+        return true;
+    }
+
+    // Commit buffered records and close the file
+    bool close() {
+        if (file == nullptr) {
+            return true;
+        }
+        bool ok = commit();
+        ok = fclose(file) == 0 && ok;
+        file = nullptr;
+        return ok;
+    }
+
+    // Check whether the journal is open
+    bool isOpen() const {
+        return file != nullptr;
+    }
+
+    // Set how many records may be buffered before an automatic commit
+    // 1 makes every mutation durable before it returns; larger values batch fsync calls
+    void setGroupSize(int records) {
+        groupSize = records > 0 ? records : 1;
+    }
+
+    // Hold automatic commits until the matching endGroup, e.g. for the books of one batch
+    void beginGroup() {
+        groupDepth++;
+    }
+
+    // Close a group; the outermost endGroup commits everything appended inside it
+    bool endGroup() {
+        if (groupDepth > 0) {
+            groupDepth--;
+        }
+        return groupDepth > 0 || commit();
+    }
+
+    // Get the generation the journal applies on top of
+    uint32_t getCheckpoint() const {
+        return checkpoint;
+    }
+
+    // Append records for Library mutations
+    bool logAdd(const Book& book) {
+        return appendRecord(OP_ADD, book.getId(), &book);
+    }
+
+    bool logEdit(const char* id, const Book& book) {
+        return appendRecord(OP_EDIT, id, &book);
+    }
+
+    // A patch is logged as an edit holding the book as it will be once patched
+    bool logPatch(const char* id, const Book& book, const BookPatch& patch) {
+        return appendRecord(OP_EDIT, id, &book, &patch);
+    }
+
+    bool logDelete(const char* id) {
+        return appendRecord(OP_DELETE, id, nullptr);
+    }
+
+    // Write all buffered records and fsync once - group commit
+    // On failure the records stay buffered and the file is cut back to its synced length
+    bool commit() {
+        if (file == nullptr) {
+            return false;
+        }
+        if (bufferUsed == 0) {
+            return true;
+        }
+        if (!writeBuffer() || !syncFile(file)) {
+            rollBack();
+            return false;
+        }
+        syncedLength += bufferUsed;
+        bufferUsed = 0;
+        bufferWritten = 0;
+        pendingRecords = 0;
+        return true;
+    }
+
+    // Discard every record and start a new generation, e.g. after a checkpoint
+    bool reset(uint32_t generation) {
+        if (file == nullptr) {
+            return false;
+        }
+        bufferUsed = 0;
+        bufferWritten = 0;
+        pendingRecords = 0;
+        checkpoint = generation;
+
+        JournalHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+        header.version = JOURNAL_VERSION;
+        header.checkpoint = generation;
+
+        if (!truncateFile(0) || fseek(file, 0, SEEK_SET) != 0 ||
+            fwrite(&header, sizeof(header), 1, file) != 1 || !syncFile(file)) {
+            return false;
+        }
+        syncedLength = sizeof(header);
+        return true;
+    }
+
+    // Read the header of a mapped journal; returns false if it is not a journal
+    static bool readHeader(const char* data, size_t size, JournalHeader& header) {
+        if (data == nullptr || size < sizeof(JournalHeader)) {
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+        return memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) == 0 &&
+               header.version == JOURNAL_VERSION;
+    }
+
+    // Decode the record starting at offset and advance offset past it
+    // Returns false at the end of the data or at a torn or corrupted record
+    static bool readRecord(const char* data, size_t size, size_t& offset, JournalEntry& entry) {
+        if (size - offset < RECORD_PREFIX_SIZE) {
+            return false;
+        }
+
+        uint32_t payloadLength;
+        uint32_t checksum;
+        memcpy(&payloadLength, data + offset, sizeof(payloadLength));
+        memcpy(&checksum, data + offset + 4, sizeof(checksum));
+        if (payloadLength > size - offset - RECORD_PREFIX_SIZE) {
+            return false;
+        }
+
+        const char* body = data + offset + 8; // Operation byte followed by the payload
+        if (checksumBytes(body, payloadLength + 1) != checksum) {
+            return false;
+        }
+
+        const char* cursor = body + 1;
+        const char* end = cursor + payloadLength;
+        entry.operation = static_cast<unsigned char>(body[0]);
+        entry.book = Book(entry.book.getTextPool()); // Keep the caller's choice of pool
+        if (!readField(cursor, end, entry.id, MAX_ID_LENGTH)) {
+            return false;
+        }
+
+        if (entry.operation == OP_ADD || entry.operation == OP_EDIT) {
+            char isbn[MAX_ISBN_LENGTH];
+            char title[MAX_TITLE_LENGTH];
+            char author[MAX_AUTHOR_LENGTH];
+            char edition[MAX_EDITION_LENGTH];
+            char publication[MAX_PUBLICATION_LENGTH];
+            char category[MAX_CATEGORY_LENGTH];
+            if (!readField(cursor, end, isbn, MAX_ISBN_LENGTH) ||
+                !readField(cursor, end, title, MAX_TITLE_LENGTH) ||
+                !readField(cursor, end, author, MAX_AUTHOR_LENGTH) ||
+                !readField(cursor, end, edition, MAX_EDITION_LENGTH) ||
+                !readField(cursor, end, publication, MAX_PUBLICATION_LENGTH) ||
+                !readField(cursor, end, category, MAX_CATEGORY_LENGTH)) {
+                return false;
+            }
+            // Empty fields are rejected by the setters and simply stay empty
+            entry.book.setId(entry.id);
+            entry.book.setIsbn(isbn);
+            entry.book.setTitle(title);
+            entry.book.setAuthor(author);
+            entry.book.setEdition(edition);
+            entry.book.setPublication(publication);
+            entry.book.setCategory(category);
+        } else if (entry.operation != OP_DELETE) {
+            return false;
+        }
+
+        offset += RECORD_PREFIX_SIZE + payloadLength;
+        return true;
+    }
+
+private:
+    // Helper method to encode one record into the buffer - ENCAPSULATION
+    // Fields set in patch, if not nullptr, are written in place of the book's
+    bool appendRecord(Operation operation, const char* id, const Book* book, const BookPatch* patch = nullptr) {
+        if (file == nullptr || id == nullptr) {
+            return false;
+        }
+
+        // Largest possible record: prefix plus every field at maximum length
+        const size_t maxRecord = RECORD_PREFIX_SIZE + MAX_ID_LENGTH + MAX_ISBN_LENGTH + MAX_TITLE_LENGTH +
+                                 MAX_AUTHOR_LENGTH + MAX_EDITION_LENGTH + MAX_PUBLICATION_LENGTH +
+                                 MAX_CATEGORY_LENGTH;
+        ensureBuffer(bufferUsed + maxRecord);
+
+        size_t recordStart = bufferUsed;
+        char* record = buffer + bufferUsed;
+        char* cursor = record + RECORD_PREFIX_SIZE;
+        record[8] = static_cast<char>(operation);
+        writeField(cursor, id, MAX_ID_LENGTH);
+        if (book != nullptr) {
+            BookPatch none;
+            const BookPatch& changes = patch != nullptr ? *patch : none;
+            char isbnText[MAX_ISBN_LENGTH];
+            formatIsbn(changes.has(BookPatch::FIELD_ISBN) ? changes.isbn : book->getIsbn(), isbnText);
+            writeField(cursor, isbnText, MAX_ISBN_LENGTH);
+            writeField(cursor, changes.has(BookPatch::FIELD_TITLE) ? changes.getTitle() : book->getTitle(), MAX_TITLE_LENGTH);
+            writeField(cursor, changes.has(BookPatch::FIELD_AUTHOR) ? changes.getAuthor() : book->getAuthor(), MAX_AUTHOR_LENGTH);
+            writeField(cursor, changes.has(BookPatch::FIELD_EDITION) ? changes.getEdition() : book->getEdition(), MAX_EDITION_LENGTH);
+            writeField(cursor, changes.has(BookPatch::FIELD_PUBLICATION) ? changes.getPublication() : book->getPublication(),
+                       MAX_PUBLICATION_LENGTH);
+            writeField(cursor, changes.has(BookPatch::FIELD_CATEGORY) ? categoryName(changes.category) : book->getCategory(),
+                       MAX_CATEGORY_LENGTH);
+        }
+
+        uint32_t payloadLength = static_cast<uint32_t>(cursor - record - RECORD_PREFIX_SIZE);
+        uint32_t checksum = checksumBytes(record + 8, payloadLength + 1);
+        memcpy(record, &payloadLength, sizeof(payloadLength));
+        memcpy(record + 4, &checksum, sizeof(checksum));
+        bufferUsed += RECORD_PREFIX_SIZE + payloadLength;
+        pendingRecords++;
+
+        bool ok = true;
+        if (groupDepth == 0 && pendingRecords >= groupSize) {
+            ok = commit();
+        } else if (bufferUsed - bufferWritten >= FLUSH_THRESHOLD && !writeBuffer()) {
+            rollBack();
+            ok = false;
+        }
+        if (!ok) {
+            // The caller rejects this mutation, so its record must not be written later
+            bufferUsed = recordStart;
+            pendingRecords--;
+        }
+        return ok;
+    }
+
+    // Helper method to write a length-prefixed field - ENCAPSULATION
+    static void writeField(char*& cursor, const char* value, int maxLength) {
+        size_t length = strnlen(value, maxLength - 1);
+        *cursor++ = static_cast<char>(length);
+        memcpy(cursor, value, length);
+        cursor += length;
+    }
+
+    // Helper method to read a length-prefixed field into a null-terminated buffer - ENCAPSULATION
+    static bool readField(const char*& cursor, const char* end, char* out, int maxLength) {
+        if (cursor >= end) {
+            return false;
+        }
+        size_t length = static_cast<unsigned char>(*cursor++);
+        if (length > static_cast<size_t>(maxLength - 1) || length > static_cast<size_t>(end - cursor)) {
+            return false;
+        }
+        memcpy(out, cursor, length);
+        out[length] = '\0';
+        cursor += length;
+        return true;
+    }
+
+    // Helper method to grow the record buffer - ENCAPSULATION
+    void ensureBuffer(size_t needed) {
+        if (needed <= bufferCapacity) {
+            return;
+        }
+        size_t newCapacity = bufferCapacity > 0 ? bufferCapacity * 2 : 64 * 1024;
+        while (newCapacity < needed) {
+            newCapacity *= 2;
+        }
+        char* grown = new char[newCapacity];
+        if (bufferUsed > 0) {
+            memcpy(grown, buffer, bufferUsed);
+        }
+        delete[] buffer;
+        buffer = grown;
+        bufferCapacity = newCapacity;
+    }
+
+    // Helper method to hand the unwritten part of the buffer to the OS without syncing - ENCAPSULATION
+    // The records stay in the buffer until commit() has synced them
+    bool writeBuffer() {
+        size_t unwritten = bufferUsed - bufferWritten;
+        if (unwritten == 0) {
+            return true;
+        }
+        if (fwrite(buffer + bufferWritten, 1, unwritten, file) != unwritten || fflush(file) != 0) {
+            return false;
+        }
+        bufferWritten = bufferUsed;
+        return true;
+    }
+
+    // Helper method to cut the file back to its synced length after a failed write or fsync - ENCAPSULATION
+    // Every unsynced record is still in the buffer, so the next commit writes them again
+    void rollBack() {
+        clearerr(file);
+        truncateFile(syncedLength);
+        fseek(file, 0, SEEK_END);
+        bufferWritten = 0;
+    }
+
+    // Helper method to cut the journal file to a given length - ENCAPSULATION
+    bool truncateFile(size_t length) {
+        if (fflush(file) != 0) {
+            return false;
+        }
+        #ifdef _WIN32
+            return _chsize(_fileno(file), static_cast<long>(length)) == 0;
+        #else
+            return ftruncate(fileno(file), static_cast<off_t>(length)) == 0;
+        #endif
+    }
+};
+
+/**
+ * CatalogSnapshot class - an immutable version of a Library's books and ID index
+ * Books are kept by row in fixed-size pages, each with its serial, and rows are hashed
+ * by ID into buckets. Rows and serials rise together, so a page can be found by serial. Versions share pages and buckets through shared_ptr: a
+ * change copies only the page and the bucket it touches, and whatever a version alone
+ * holds is freed when the last reader releases it. Once a reader holds a snapshot it
+ * needs no lock, and writers never wait for it. A version also holds the text pool of
+ * its books, so they stay readable after the library has compacted or cleared its text.
+ *
+ * Library keeps one working version that only it modifies and hands out copies of it
+ * through publish(). Each page and bucket is stamped with the epoch of the working
+ * version that created it, and publish() starts a new epoch, so the working version
+ * changes in place only what it has created since the last publish and copies the rest.
+ *
+ * The page and bucket slots are grouped into chunks of CHUNK_SIZE under a table, both
+ * stamped and shared the same way, so publish() shares just the two tables and is O(1)
+ * however large the catalogue. The first change after a publish pays instead: it copies
+ * the table (one pointer per CHUNK_SIZE pages or buckets), the chunk and the page or
+ * bucket it touches.
+ */
+class CatalogSnapshot {
+private:
+    static const int PAGE_BITS = 8;
+    static const int PAGE_SIZE = 1 << PAGE_BITS;
+    static const int MIN_BUCKETS = 64;
+    static const int BUCKET_LOAD = 32; // Average rows per bucket before the buckets double
+    static const int CHUNK_BITS = 6;
+    static const int CHUNK_SIZE = 1 << CHUNK_BITS; // Page or bucket slots per chunk
+
+    struct Page {
+        Book books[PAGE_SIZE];
+        int64_t serials[PAGE_SIZE]; // Kept after a book is erased, so serials stay searchable
+        bool live[PAGE_SIZE];
+        int liveCount;
+        unsigned long epoch; // Epoch of the working version that created the page
+
+        Page(unsigned long createdIn) {
+            memset(live, 0, sizeof(live));
+            liveCount = 0;
+            epoch = createdIn;
+        }
+    };
+
+    struct Bucket {
+        int* rows;
+        int count;
+        int capacity;
+        unsigned long epoch; // Epoch of the working version that created the bucket
+
+        Bucket(unsigned long createdIn) {
+            capacity = 4;
+            count = 0;
+            rows = new int[capacity];
+            epoch = createdIn;
+        }
+
+        Bucket(const Bucket& other, unsigned long createdIn) {
+            epoch = createdIn;
+            capacity = other.capacity;
+            count = other.count;
+            rows = new int[capacity];
+            memcpy(rows, other.rows, count * sizeof(int));
+        }
+
+        ~Bucket() {
+            delete[] rows;
+        }
+
+        Bucket(const Bucket&) = delete;
+        Bucket& operator=(const Bucket&) = delete;
+    };
+
+    // CHUNK_SIZE consecutive page or bucket slots
+    template <typename Entry>
+    struct Chunk {
+        shared_ptr<Entry> entries[CHUNK_SIZE];
+        unsigned long epoch; // Epoch of the working version that created the chunk
+
+        Chunk(unsigned long createdIn) {
+            epoch = createdIn;
+        }
+    };
+
+    // The chunks holding every page or bucket slot of a version
+    template <typename Entry>
+    struct Table {
+        shared_ptr<Chunk<Entry>>* chunks;
+        int chunkCount;
+        unsigned long epoch; // Epoch of the working version that created the table
+
+        Table(int initialChunks, unsigned long createdIn) {
+            chunkCount = initialChunks;
+            chunks = new shared_ptr<Chunk<Entry>>[chunkCount];
+            epoch = createdIn;
+        }
+
+        // A copy shares every chunk of the original, in a table of at least as many chunks
+        Table(const Table& other, int initialChunks, unsigned long createdIn) : Table(initialChunks, createdIn) {
+            for (int c = 0; c < other.chunkCount; c++) {
+                chunks[c] = other.chunks[c];
+            }
+        }
+
+        ~Table() {
+            delete[] chunks;
+        }
+
+        Table(const Table&) = delete;
+        Table& operator=(const Table&) = delete;
+
+        // Get the entry in a slot, nullptr if it is empty
+        Entry* get(int slot) const {
+            const Chunk<Entry>* chunk = chunks[slot >> CHUNK_BITS].get();
+            return chunk != nullptr ? chunk->entries[slot & (CHUNK_SIZE - 1)].get() : nullptr;
+        }
+    };
+
+    // Private data members - ENCAPSULATION
+    shared_ptr<const StringPool> text; // Pool the books' text lives in, kept alive for readers
+    shared_ptr<Table<Page>> pages;     // Page of each block of PAGE_SIZE rows, kept once all its books are gone
+    int pageCount;                     // Page slots in use
+    shared_ptr<Table<Bucket>> buckets; // Rows of the books whose ID hashes to each bucket
+    int bucketCount;                   // Always a power of two, and a multiple of CHUNK_SIZE
+    int bookCount;               // Live books
+    int rowCount;                // One past the highest row ever stored
+    unsigned long epoch;         // Stamp of the pages and buckets this version may change in place
+
+public:
+    // Constructor - an empty catalogue whose books keep their text in the given pool
+    explicit CatalogSnapshot(const shared_ptr<const StringPool>& pool) : text(pool) {
+        epoch = 1;
+        pageCount = 0;
+        pages = make_shared<Table<Page>>(1, epoch);
+        bucketCount = MIN_BUCKETS;
+        buckets = make_shared<Table<Bucket>>(bucketCount >> CHUNK_BITS, epoch);
+        bookCount = 0;
+        rowCount = 0;
+    }
+
+    CatalogSnapshot& operator=(const CatalogSnapshot&) = delete;
+
+    // Hand out an immutable copy of this version - used by Library
+    // Everything in it is shared with this version, which starts a new epoch so that its
+    // next change to a shared table, chunk, page or bucket copies it first. O(1)
+    shared_ptr<const CatalogSnapshot> publish() {
+        shared_ptr<const CatalogSnapshot> published(new CatalogSnapshot(*this));
+        epoch++;
+        return published;
+    }
+
+    // Get the number of books in this version
+    int getCount() const {
+        return bookCount;
+    }
+
+    // Find a book by ID; the pointer stays valid while the snapshot is held
+    const Book* findBookById(const char* id) const {
+        if (id == nullptr || id[0] == '\0') {
+            return nullptr;
+        }
+        const Bucket* bucket = buckets->get(IdIndex::hashId(id) & (bucketCount - 1));
+        for (int i = 0; bucket != nullptr && i < bucket->count; i++) {
+            const Book& book = bookAt(bucket->rows[i]);
+            if (strcmp(book.getId(), id) == 0) {
+                return &book;
+            }
+        }
+        return nullptr;
+    }
+
+    // Get a copy of a book by ID, its text copied into bookOut's pool (see Book::copyFrom)
+    // The copy stays readable after the snapshot is released
+    bool getBookById(const char* id, Book& bookOut) const {
+        const Book* book = findBookById(id);
+        return book != nullptr && bookOut.copyFrom(*book);
+    }
+
+    // Visit every book in insertion (row) order until the visitor returns false
+    void forEachBook(BookVisitor visit, void* context) const {
+        for (int p = 0; p < pageCount; p++) {
+            const Page* page = pages->get(p);
+            for (int i = 0; page != nullptr && i < PAGE_SIZE; i++) {
+                if (page->live[i] && !visit(page->books[i], context)) {
+                    return;
+                }
+            }
+        }
+    }
+
+    // Visit the books in a category in row order until the visitor returns false
+    void forEachBookInCategory(BookCategory category, BookVisitor visit, void* context) const {
+        for (int p = 0; p < pageCount; p++) {
+            const Page* page = pages->get(p);
+            for (int i = 0; page != nullptr && i < PAGE_SIZE; i++) {
+                if (page->live[i] && page->books[i].getCategoryCode() == category &&
+                    !visit(page->books[i], context)) {
+                    return;
+                }
+            }
+        }
+    }
+
+    // Copy the next page of books after a cursor into pageOut, in serial order, and advance it
+    // Each book is copied into its own pool as with getBookById; a full pool ends the page
+    // early. Returns the number of books copied, 0 once the listing is done
+    int fetchPage(BookCursor& cursor, Book* pageOut, int pageSize) const {
+        int found = 0;
+        int row = firstRowFrom(cursor.nextSerial);
+        while (row < rowCount && found < pageSize) {
+            const Page* page = pages->get(row >> PAGE_BITS);
+            int i = row & (PAGE_SIZE - 1);
+            if (page->live[i] && (cursor.category == CATEGORY_NONE || page->books[i].getCategoryCode() == cursor.category)) {
+                if (!pageOut[found].copyFrom(page->books[i])) {
+                    break;
+                }
+                found++;
+            }
+            row++;
+        }
+        if (row < rowCount) {
+            cursor.nextSerial = serialAt(row);
+        } else if (rowCount > 0 && cursor.nextSerial <= serialAt(rowCount - 1)) {
+            cursor.nextSerial = serialAt(rowCount - 1) + 1;
+        }
+        return found;
+    }
+
+    // Store a book at a row, adding it or replacing the book already there - used by Library
+    // Rows must be stored in order of serial, and every row below rowCount must have been stored
+    void putBook(int row, int64_t serial, const Book& book) {
+        Page& page = writablePage(row);
+        int i = row & (PAGE_SIZE - 1);
+        page.books[i] = book;
+        page.serials[i] = serial;
+        if (!page.live[i]) {
+            page.live[i] = true;
+            page.liveCount++;
+            bookCount++;
+            if (row >= rowCount) {
+                rowCount = row + 1;
+            }
+            if (bookCount > bucketCount * BUCKET_LOAD) {
+                rebuildBuckets(bucketCount * 2);
+            } else {
+                addToBucket(book.getId(), row);
+            }
+        }
+    }
+
+    // Remove the book at a row - used by Library
+    void eraseBook(int row) {
+        int p = row >> PAGE_BITS;
+        int i = row & (PAGE_SIZE - 1);
+        const Page* current = p < pageCount ? pages->get(p) : nullptr;
+        if (current == nullptr || !current->live[i]) {
+            return;
+        }
+        removeFromBucket(current->books[i].getId(), row);
+        bookCount--;
+        // The page stays even once it has no books, to keep the serials of its rows;
+        // Library starts a fresh version when most of its rows are gone
+        Page& page = writablePage(row);
+        page.live[i] = false;
+        page.liveCount--;
+    }
+
+private:
+    // Copy constructor - the copy shares both tables, and the pool, with the original
+    // Private: a copy is only made by publish(), which moves the original to a new epoch
+    CatalogSnapshot(const CatalogSnapshot& other) : text(other.text), pages(other.pages), buckets(other.buckets) {
+        pageCount = other.pageCount;
+        bucketCount = other.bucketCount;
+        bookCount = other.bookCount;
+        rowCount = other.rowCount;
+        epoch = other.epoch;
+    }
+
+    // Helper method to get the book at a live row - ENCAPSULATION
+    const Book& bookAt(int row) const {
+        return pages->get(row >> PAGE_BITS)->books[row & (PAGE_SIZE - 1)];
+    }
+
+    // Helper method to get the serial stored at a row below rowCount - ENCAPSULATION
+    int64_t serialAt(int row) const {
+        return pages->get(row >> PAGE_BITS)->serials[row & (PAGE_SIZE - 1)];
+    }
+
+    // Helper method to find the first row whose serial is not less than a serial - ENCAPSULATION
+    int firstRowFrom(int64_t serial) const {
+        int low = 0;
+        int high = rowCount;
+        while (low < high) {
+            int mid = low + (high - low) / 2;
+            if (serialAt(mid) < serial) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    // Helper method to get a slot of a table this version alone owns - ENCAPSULATION
+    // Copies the table if it is shared or too small, and the slot's chunk if it is shared
+    template <typename Entry>
+    shared_ptr<Entry>& writableSlot(shared_ptr<Table<Entry>>& table, int slot) {
+        int c = slot >> CHUNK_BITS;
+        if (table->epoch != epoch || c >= table->chunkCount) {
+            int chunkCount = table->chunkCount;
+            while (chunkCount <= c) {
+                chunkCount *= 2;
+            }
+            table = make_shared<Table<Entry>>(*table, chunkCount, epoch);
+        }
+        shared_ptr<Chunk<Entry>>& chunk = table->chunks[c];
+        if (!chunk) {
+            chunk = make_shared<Chunk<Entry>>(epoch);
+        } else if (chunk->epoch != epoch) {
+            shared_ptr<Chunk<Entry>> copy = make_shared<Chunk<Entry>>(*chunk);
+            copy->epoch = epoch;
+            chunk = copy;
+        }
+        return chunk->entries[slot & (CHUNK_SIZE - 1)];
+    }
+
+    // Helper method to get a page this version alone owns, copying a shared one first - ENCAPSULATION
+    // A page created in the current epoch has not been published, so no reader holds it
+    Page& writablePage(int row) {
+        int p = row >> PAGE_BITS;
+        if (p >= pageCount) {
+            pageCount = p + 1;
+        }
+        shared_ptr<Page>& page = writableSlot(pages, p);
+        if (!page) {
+            page = make_shared<Page>(epoch);
+        } else if (page->epoch != epoch) {
+            shared_ptr<Page> copy = make_shared<Page>(*page);
+            copy->epoch = epoch;
+            page = copy;
+        }
+        return *page;
+    }
+
+    // Helper method to get a bucket this version alone owns, copying a shared one first - ENCAPSULATION
+    Bucket& writableBucket(const char* id) {
+        shared_ptr<Bucket>& bucket = writableSlot(buckets, IdIndex::hashId(id) & (bucketCount - 1));
+        if (!bucket) {
+            bucket = make_shared<Bucket>(epoch);
+        } else if (bucket->epoch != epoch) {
+            bucket = make_shared<Bucket>(*bucket, epoch);
+        }
+        return *bucket;
+    }
+
+    // Helper method to add a row to the bucket of its ID - ENCAPSULATION
+    void addToBucket(const char* id, int row) {
+        Bucket& bucket = writableBucket(id);
+        if (bucket.count == bucket.capacity) {
+            int* grown = new int[bucket.capacity * 2];
+            memcpy(grown, bucket.rows, bucket.count * sizeof(int));
+            delete[] bucket.rows;
+            bucket.rows = grown;
+            bucket.capacity *= 2;
+        }
+        bucket.rows[bucket.count++] = row;
+    }
+
+    // Helper method to drop a row from the bucket of its ID - ENCAPSULATION
+    void removeFromBucket(const char* id, int row) {
+        Bucket& bucket = writableBucket(id);
+        for (int i = 0; i < bucket.count; i++) {
+            if (bucket.rows[i] == row) {
+                bucket.rows[i] = bucket.rows[--bucket.count];
+                return;
+            }
+        }
+    }
+
+    // Helper method to rehash every live row into a new set of buckets - ENCAPSULATION
+    void rebuildBuckets(int newBucketCount) {
+        bucketCount = newBucketCount;
+        buckets = make_shared<Table<Bucket>>(bucketCount >> CHUNK_BITS, epoch);
+        for (int p = 0; p < pageCount; p++) {
+            const Page* page = pages->get(p);
+            for (int i = 0; page != nullptr && i < PAGE_SIZE; i++) {
+                if (page->live[i]) {
+                    addToBucket(page->books[i].getId(), (p << PAGE_BITS) | i);
+                }
+            }
+        }
+    }
+};
+
+/**
+ * ScanPool class - a work-stealing thread pool for splitting a scan into tasks
+ * run() numbers the tasks 0..taskCount-1 and hands each participant (the workers plus
+ * the calling thread) an equal contiguous share. A participant works through its share
+ * from the front; once it runs dry it steals the back half of the largest share left,
+ * so uneven tasks still keep every core busy. run() returns when every task is done.
+ *
+ * One job runs at a time. A call that finds the pool busy (another thread's scan, or a
+ * task calling run() again) runs its tasks on the calling thread instead of waiting. A
+ * task's nested call is recognised by a per-thread marker before the job lock is touched,
+ * since the thread that started the job already holds that lock.
+ */
+class ScanPool {
+public:
+    // A task: body(task, context) is called once for each task number
+    typedef void (*TaskBody)(int task, void* context);
+
+private:
+    struct Share {
+        mutex lock;
+        int next; // Next task to run
+        int end;  // One past the last task in the share
+    };
+
+    // Private data members - ENCAPSULATION
+    thread* workers;
+    int workerCount;
+    Share* shares;             // Share of each participant; the caller uses the last one
+    mutex jobLock;             // Held by the thread whose job is running
+    mutex stateLock;           // Guards the fields below
+    condition_variable wake;   // Signals workers that a job started or the pool is stopping
+    condition_variable done;   // Signals the caller that a worker finished
+    unsigned long generation;  // Incremented for each job
+    int working;               // Workers still busy with the current job
+    bool stopping;
+    TaskBody body;
+    void* context;
+
+public:
+    // Constructor - starts the given number of worker threads
+    explicit ScanPool(int threads) {
+        workerCount = threads > 0 ? threads : 0;
+        shares = new Share[workerCount + 1];
+        generation = 0;
+        working = 0;
+        stopping = false;
+        body = nullptr;
+        context = nullptr;
+        workers = new thread[workerCount];
+        for (int w = 0; w < workerCount; w++) {
+            workers[w] = thread(&ScanPool::workerLoop, this, w);
+        }
+    }
+
+    // Destructor - stops and joins the workers
+    ~ScanPool() {
+        {
+            lock_guard<mutex> guard(stateLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (int w = 0; w < workerCount; w++) {
+            workers[w].join();
+        }
+        delete[] workers;
+        delete[] shares;
+    }
+
+    // The pool owns its threads, so it cannot be copied
+    ScanPool(const ScanPool&) = delete;
+    ScanPool& operator=(const ScanPool&) = delete;
+
+    // Get the pool shared by the whole program, with one thread per core including the caller
+    static ScanPool& shared() {
+        static ScanPool pool(static_cast<int>(thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+    // Get the number of threads that take part in a job, including the caller
+    int getThreadCount() const {
+        return workerCount + 1;
+    }
+
+    // Run tasks 0..taskCount-1 across the pool and wait for all of them
+    void run(int taskCount, TaskBody taskBody, void* taskContext) {
+        if (taskCount <= 0) {
+            return;
+        }
+        unique_lock<mutex> job;
+        if (runningPool() != this) {
+            job = unique_lock<mutex>(jobLock, try_to_lock);
+        }
+        if (!job.owns_lock() || workerCount == 0 || taskCount == 1) {
+            for (int task = 0; task < taskCount; task++) {
+                taskBody(task, taskContext);
+            }
+            return;
+        }
+
+        // Deal out equal contiguous shares; workers are parked, so no share locks are needed yet
+        int participants = workerCount + 1;
+        for (int p = 0; p < participants; p++) {
+            shares[p].next = static_cast<int>(static_cast<long long>(taskCount) * p / participants);
+            shares[p].end = static_cast<int>(static_cast<long long>(taskCount) * (p + 1) / participants);
+        }
+        {
+            lock_guard<mutex> guard(stateLock);
+            body = taskBody;
+            context = taskContext;
+            working = workerCount;
+            generation++;
+        }
+        wake.notify_all();
+
+        runSharesMarked(workerCount);
+
+        unique_lock<mutex> guard(stateLock);
+        done.wait(guard, [this] { return working == 0; });
+    }
+
+private:
+    // Helper method run by each worker thread - ENCAPSULATION
+    void workerLoop(int self) {
+        unsigned long seen = 0;
+        while (true) {
+            {
+                unique_lock<mutex> guard(stateLock);
+                wake.wait(guard, [this, seen] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+            }
+
+            runSharesMarked(self);
+
+            {
+                lock_guard<mutex> guard(stateLock);
+                working--;
+            }
+            done.notify_one();
+        }
+    }
+
+    // Helper method to get the pool whose tasks the calling thread is running, nullptr if none - ENCAPSULATION
+    static const ScanPool*& runningPool() {
+        static thread_local const ScanPool* pool = nullptr;
+        return pool;
+    }
+
+    // Helper method to run a participant's tasks with the thread marked as inside this pool - ENCAPSULATION
+    void runSharesMarked(int self) {
+        const ScanPool* outer = runningPool();
+        runningPool() = this;
+        runShares(self);
+        runningPool() = outer;
+    }
+
+    // Helper method to run tasks from a participant's own share, then stolen ones, until none are left - ENCAPSULATION
+    void runShares(int self) {
+        int task;
+        while (takeTask(self, task) || (stealTasks(self) && takeTask(self, task))) {
+            body(task, context);
+        }
+    }
+
+    // Helper method to take the next task from a participant's own share - ENCAPSULATION
+    bool takeTask(int self, int& task) {
+        lock_guard<mutex> guard(shares[self].lock);
+        if (shares[self].next >= shares[self].end) {
+            return false;
+        }
+        task = shares[self].next++;
+        return true;
+    }
+
+    // Helper method to move the back half of the largest other share into a participant's own - ENCAPSULATION
+    bool stealTasks(int self) {
+        int participants = workerCount + 1;
+        while (true) {
+            int victim = -1;
+            int most = 0;
+            for (int p = 0; p < participants; p++) {
+                if (p != self) {
+                    lock_guard<mutex> guard(shares[p].lock);
+                    if (shares[p].end - shares[p].next > most) {
+                        most = shares[p].end - shares[p].next;
+                        victim = p;
+                    }
+                }
+            }
+            if (victim == -1) {
+                return false; // Nothing left anywhere
+            }
+
+            int begin;
+            int end;
+            {
+                lock_guard<mutex> guard(shares[victim].lock);
+                int left = shares[victim].end - shares[victim].next;
+                if (left <= 0) {
+                    continue; // Emptied meanwhile; look again
+                }
+                end = shares[victim].end;
+                begin = end - (left + 1) / 2;
+                shares[victim].end = begin;
+            }
+            lock_guard<mutex> guard(shares[self].lock);
+            shares[self].next = begin;
+            shares[self].end = end;
+            return true;
+        }
+    }
+};
+
+/**
+ * Library class - implements ItemManager
+ * Manages a collection of books
+ */
+class Library : public ItemManager {
+public:
+    /**
+     * How deleteBook fills the slot of a deleted book
+     * PRESERVE_ORDER: later books shift down by one, so listings keep insertion order (O(n))
+     * SWAP_WITH_LAST: the last book moves into the hole, so nothing shifts (O(1)); the moved
+     *                 book changes position and listings are no longer in insertion order
+     */
+    enum DeleteOrder {
+        PRESERVE_ORDER,
+        SWAP_WITH_LAST
+    };
+
+private:
+    // Private data members - ENCAPSULATION
+    Book* books;             // Dynamic array of books, grown on demand
+    shared_ptr<StringPool> text; // Text of every book; shared with the snapshots taken from it
+    size_t droppedText;      // Bytes of text in the pool that no book uses any more, roughly (see dropText)
+    int capacity;            // Allocated slots in books
+    int count;               // Current number of books
+    IdIndex idIndex;         // Hash index from book ID to its slot in books
+    DeleteOrder deleteOrder; // Slot-filling policy used by deleteBook
+    CatalogJournal* journal; // Write-ahead log for mutations, nullptr if not journaling
+    uint32_t checkpointId;   // Generation of the last snapshot loaded or checkpointed
+    int* bookRows;           // Row number of the book in each slot, parallel to books
+    int* rowSlots;           // Slot of each row, -1 once the book is deleted
+    int64_t* rowSerials;     // Serial of the book given each row, ascending; kept after a delete
+    int rowCapacity;         // Allocated entries in rowSlots and rowSerials
+    int nextRow;             // Row number for the next book added; reset by renumberRows and clear
+    int64_t nextSerial;      // Serial for the next book added; never reused, even after clear
+    IsbnIndex isbnIndex;     // Hash index from ISBN to the rows of every copy
+    TextIndex textIndex;     // Inverted index over titles and authors, keyed by row
+    PrefixIndex titlePrefixes;  // Type-ahead over whole titles
+    PrefixIndex authorPrefixes; // Type-ahead over whole authors
+    CategoryIndex categoryIndex; // Slot bitmap of each category
+    CategoryIndex categoryRows;  // Row bitmap of each category, which cursors walk in row order
+    CatalogSnapshot* snapshotWorking; // Copy-on-write version kept in step with books, nullptr if snapshots are off
+    mutable shared_ptr<const CatalogSnapshot> snapshotPublished; // Last version handed to readers
+    mutable bool snapshotStale;       // The working version has changed since it was published
+    mutable mutex snapshotLock;       // Serializes readers publishing a version
+    OrderIndex* orderIndexes[SORT_FIELD_COUNT]; // Sorted order of rows by each field, nullptr until enabled
+    ItemArray<Journal> journals; // Journals, in a contiguous array of their own beside books
+
+public:
+    // Constructor
+    Library(int initialCapacity = DEFAULT_LIBRARY_CAPACITY) : idIndex(this, &Library::idAtSlot) {
+        capacity = initialCapacity > 0 ? initialCapacity : DEFAULT_LIBRARY_CAPACITY;
+        count = 0;
+        deleteOrder = PRESERVE_ORDER;
+        journal = nullptr;
+        checkpointId = 0;
+        books = new Book[capacity];
+        text = make_shared<StringPool>();
+        droppedText = 0;
+        bookRows = new int[capacity];
+        rowCapacity = capacity;
+        rowSlots = new int[rowCapacity];
+        rowSerials = new int64_t[rowCapacity];
+        nextRow = 0;
+        nextSerial = 0;
+        idIndex.reserve(capacity);
+        categoryIndex.resize(capacity);
+        categoryRows.resize(rowCapacity);
+        snapshotWorking = nullptr;
+        snapshotStale = false;
+        for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+            orderIndexes[f] = nullptr;
+        }
+    }
+
+    // Destructor to free memory
+    virtual ~Library() override {
+        delete[] books;
+        delete[] bookRows;
+        delete[] rowSlots;
+        delete[] rowSerials;
+        delete snapshotWorking;
+        for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+            delete orderIndexes[f];
+        }
+    }
+
+    // The library owns its book array and index, so it cannot be copied
+    Library(const Library&) = delete;
+    Library& operator=(const Library&) = delete;
+
+    // Check if an ID is already taken by a book or a journal - ENCAPSULATION
+    bool isIdDuplicate(const char* id) const {
+        return findBookById(id) != -1 || journals.find(id) != nullptr;
+    }
+
+    // Implementation of virtual function - ABSTRACTION
+    // Dispatches on the kind tag to the typed array that holds that kind
+    virtual bool addItem(const LibraryItem& item) override {
+        switch (item.getKind()) {
+            case ITEM_KIND_BOOK:
+                return addBook(static_cast<const Book&>(item));
+            case ITEM_KIND_JOURNAL:
+                return addJournal(static_cast<const Journal&>(item));
+            default:
+                return false;
+        }
+    }
+    
+    // Add a new book - specific implementation
+    bool addBook(const Book& book) {
+        // Grow the array geometrically so appends stay amortized O(1)
+        if (count >= capacity && !reallocate(growCapacity(count + 1))) {
+            return false;
+        }
+
+        return appendBook(book) == ITEM_ADDED;
+    }
+
+    // Implementation of virtual functions - ABSTRACTION
+    // Each item's kind is checked once: runs of books take the bulk path below, journals their own array
+    virtual int addItems(const LibraryItem* const* items, int itemCount, ItemOutcome* outcomes) override {
+        return putItems(items, itemCount, outcomes, false);
+    }
+
+    virtual int upsertItems(const LibraryItem* const* items, int itemCount, ItemOutcome* outcomes) override {
+        return putItems(items, itemCount, outcomes, true);
+    }
+
+    // IDs that are not books are then tried as journals
+    virtual int deleteItems(const char* const* ids, int idCount, ItemOutcome* outcomes) override {
+        if (journals.getCount() == 0 || ids == nullptr || idCount <= 0) {
+            return deleteBooks(ids, idCount, outcomes);
+        }
+        ItemOutcome* bookOutcomes = outcomes != nullptr ? outcomes : new ItemOutcome[idCount];
+        int deleted = deleteBooks(ids, idCount, bookOutcomes);
+        for (int i = 0; i < idCount; i++) {
+            if (bookOutcomes[i] == ITEM_NOT_FOUND) {
+                bookOutcomes[i] = dropJournal(ids[i]);
+                deleted += bookOutcomes[i] == ITEM_DELETED ? 1 : 0;
+            }
+        }
+        if (bookOutcomes != outcomes) {
+            delete[] bookOutcomes;
+        }
+        return deleted;
+    }
+
+    // Add a batch of books in one pass - used by bulk loaders
+    // Storage and the ID index grow at most once, duplicate IDs are caught by the same index
+    // probe that inserts each book (so duplicates within the batch are rejected too), and with
+    // a journal attached the whole batch shares a single commit. outcomes, if not nullptr,
+    // receives the outcome of each book. Returns the number of books added.
+    int addBooks(const Book* batch, int batchCount, ItemOutcome* outcomes) {
+        return putBatch(batch, nullptr, batchCount, outcomes, false);
+    }
+
+    // Same as above for a batch of pointers; a nullptr entry is ITEM_INVALID
+    int addBooks(const Book* const* batch, int batchCount, ItemOutcome* outcomes) {
+        return putBatch(nullptr, batch, batchCount, outcomes, false);
+    }
+
+    // Add or replace a batch of books in one pass - a book whose ID is present replaces
+    // every other field of the stored book (ITEM_UPDATED), any other is added. Returns the
+    // number of books added or updated.
+    int upsertBooks(const Book* batch, int batchCount, ItemOutcome* outcomes) {
+        return putBatch(batch, nullptr, batchCount, outcomes, true);
+    }
+
+    int upsertBooks(const Book* const* batch, int batchCount, ItemOutcome* outcomes) {
+        return putBatch(nullptr, batch, batchCount, outcomes, true);
+    }
+
+    // Delete a batch of books in one pass. Returns the number of books deleted
+    // With PRESERVE_ORDER the holes are closed by one compaction after the batch, so the
+    // batch costs O(n) in total instead of O(n) per book; with SWAP_WITH_LAST each delete
+    // fills its hole at once as deleteBook does. The journal commits once for the batch.
+    int deleteBooks(const char* const* ids, int idCount, ItemOutcome* outcomes) {
+        if (ids == nullptr || idCount <= 0) {
+            setOutcomes(outcomes, idCount, ITEM_INVALID);
+            return 0;
+        }
+        if (journal != nullptr) {
+            journal->beginGroup();
+        }
+
+        int deleted = 0;
+        int firstHole = count;
+        for (int i = 0; i < idCount; i++) {
+            ItemOutcome outcome = ITEM_NOT_FOUND;
+            int index = findBookById(ids[i]);
+            if (index != -1) {
+                if (journal != nullptr && !journal->logDelete(books[index].getId())) {
+                    outcome = ITEM_FAILED;
+                } else {
+                    idIndex.erase(books[index].getId());
+                    unregisterBook(index);
+                    if (deleteOrder == SWAP_WITH_LAST) {
+                        if (index != count - 1) {
+                            moveBook(count - 1, index);
+                        }
+                        count--;
+                    } else {
+                        // Leave a hole for the compaction below; the ID index still finds the other books
+                        bookRows[index] = -1;
+                        firstHole = index < firstHole ? index : firstHole;
+                    }
+                    outcome = ITEM_DELETED;
+                    deleted++;
+                }
+            }
+            if (outcomes != nullptr) {
+                outcomes[i] = outcome;
+            }
+        }
+
+        if (deleteOrder == PRESERVE_ORDER && firstHole < count) {
+            int write = firstHole;
+            for (int read = firstHole; read < count; read++) {
+                if (bookRows[read] != -1) {
+                    if (read != write) {
+                        moveBook(read, write);
+                    }
+                    write++;
+                }
+            }
+            count = write;
+        }
+
+        return endBatchGroup(outcomes, idCount, deleted);
+    }
+
+    // Find a copy of a book by its normalized ISBN, or -1 if no book has it
+    int findBookByIsbn(uint64_t isbn) const {
+        int row = isbnIndex.first(isbn);
+        return row != -1 ? rowSlots[row] : -1;
+    }
+
+    // Find the slots of every copy with an ISBN
+    // Writes at most maxResults slots and returns how many were written
+    int findBooksByIsbn(uint64_t isbn, int* slotsOut, int maxResults) const {
+        int found = 0;
+        for (int row = isbnIndex.first(isbn); row != -1 && found < maxResults; row = isbnIndex.next(row)) {
+            slotsOut[found++] = rowSlots[row];
+        }
+        return found;
+    }
+
+    // Find a book by ID - ENCAPSULATION (internal helper method)
+    int findBookById(const char* id) const {
+        // Validate ID is not null or empty
+        if (id == nullptr || id[0] == '\0') {
+            return -1;
+        }
+
+        return idIndex.find(id); // -1 if the book is not found
+    }
+
+    // Edit a book
+    // Every field but the ID is replaced; indexes are touched only for fields whose value changes
+    bool editBook(const char* id, const Book& updatedBook) {
+        BookPatch patch;
+        updatedBook.toPatch(patch);
+        return patchBook(id, patch);
+    }
+
+    // Change only the fields set in a patch, in place
+    // The book is not copied, and each secondary index is updated only if a field it covers
+    // actually changes value. Returns false if the book is not found or the change cannot be logged.
+    bool patchBook(const char* id, const BookPatch& patch) {
+        int index = findBookById(id);
+        if (index == -1) {
+            return false; // Book not found
+        }
+        Book& book = books[index];
+        int row = bookRows[index];
+
+        // Narrow the patch to the fields whose value differs; the patch may hold its text in
+        // another pool, so text is compared by value
+        bool categoryChanged = patch.has(BookPatch::FIELD_CATEGORY) && patch.category != book.getCategoryCode();
+        bool isbnChanged = patch.has(BookPatch::FIELD_ISBN) && patch.isbn != book.getIsbn();
+        bool titleChanged = patch.has(BookPatch::FIELD_TITLE) && strcmp(patch.getTitle(), book.getTitle()) != 0;
+        bool authorChanged = patch.has(BookPatch::FIELD_AUTHOR) && strcmp(patch.getAuthor(), book.getAuthor()) != 0;
+        bool editionChanged = patch.has(BookPatch::FIELD_EDITION) && strcmp(patch.getEdition(), book.getEdition()) != 0;
+        bool publicationChanged = patch.has(BookPatch::FIELD_PUBLICATION) &&
+                                  strcmp(patch.getPublication(), book.getPublication()) != 0;
+        bool textChanged = titleChanged || authorChanged;
+        bool sortChanged[SORT_FIELD_COUNT];
+        sortChanged[SORT_BY_TITLE] = titleChanged;
+        sortChanged[SORT_BY_AUTHOR] = authorChanged;
+        sortChanged[SORT_BY_PUBLICATION] = publicationChanged;
+        if (!categoryChanged && !isbnChanged && !textChanged && !editionChanged && !publicationChanged) {
+            return true; // Nothing to log or apply
+        }
+        BookPatch changes = patch;
+        changes.fields &= (categoryChanged ? ~0u : ~unsigned(BookPatch::FIELD_CATEGORY)) &
+                          (isbnChanged ? ~0u : ~unsigned(BookPatch::FIELD_ISBN)) &
+                          (titleChanged ? ~0u : ~unsigned(BookPatch::FIELD_TITLE)) &
+                          (authorChanged ? ~0u : ~unsigned(BookPatch::FIELD_AUTHOR)) &
+                          (editionChanged ? ~0u : ~unsigned(BookPatch::FIELD_EDITION)) &
+                          (publicationChanged ? ~0u : ~unsigned(BookPatch::FIELD_PUBLICATION));
+
+        // Bring the new text into the library's pool first, so a full pool rejects the change
+        if (!changes.moveTextTo(*text)) {
+            return false;
+        }
+
+        // Write-ahead: a change that cannot be logged is not applied
+        if (journal != nullptr && !journal->logPatch(book.getId(), book, changes)) {
+            return false;
+        }
+
+        // Pull the book out of the indexes over the changing fields
+        if (isbnChanged) {
+            isbnIndex.remove(book.getIsbn(), row);
+        }
+        if (textChanged) {
+            textIndex.removeDocument(row, book.getTitle(), book.getAuthor());
+        }
+        if (titleChanged) {
+            titlePrefixes.remove(book.getTitle());
+        }
+        if (authorChanged) {
+            authorPrefixes.remove(book.getAuthor());
+        }
+        if (categoryChanged) {
+            categoryIndex.clear(index, book.getCategoryCode());
+            categoryRows.clear(row, book.getCategoryCode());
+        }
+        for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+            if (orderIndexes[f] != nullptr && sortChanged[f]) {
+                orderIndexes[f]->remove(sortKey(book, static_cast<SortField>(f)), row);
+            }
+        }
+
+        // Titles are stored once per book; the interned fields count only once their last user changes
+        droppedText += titleChanged ? strlen(book.getTitle()) + 1 : 0;
+        droppedText += authorChanged ? text->release(book.getAuthor()) : 0;
+        droppedText += editionChanged ? text->release(book.getEdition()) : 0;
+        droppedText += publicationChanged ? text->release(book.getPublication()) : 0;
+        book.applyPatch(changes);
+
+        // Put it back under the new values
+        if (isbnChanged) {
+            isbnIndex.add(book.getIsbn(), row);
+        }
+        if (textChanged) {
+            textIndex.addDocument(row, book.getTitle(), book.getAuthor());
+        }
+        if (titleChanged) {
+            titlePrefixes.add(book.getTitle());
+        }
+        if (authorChanged) {
+            authorPrefixes.add(book.getAuthor());
+        }
+        if (categoryChanged) {
+            categoryIndex.set(index, book.getCategoryCode());
+            categoryRows.set(row, book.getCategoryCode());
+        }
+        for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+            if (orderIndexes[f] != nullptr && sortChanged[f]) {
+                orderIndexes[f]->add(sortKey(book, static_cast<SortField>(f)), row);
+            }
+        }
+        snapshotPut(index);
+        return true;
+    }
+
+    // Implementation of virtual function - ABSTRACTION
+    virtual bool deleteItem(const char* id) override {
+        return deleteBook(id) || deleteJournal(id);
+    }
+    
+    // Delete a book - specific implementation
+    // Ordering depends on the delete order policy, see DeleteOrder
+    bool deleteBook(const char* id) {
+        int index = findBookById(id);
+        if (index != -1) {
+            // Write-ahead: a change that cannot be logged is not applied
+            if (journal != nullptr && !journal->logDelete(books[index].getId())) {
+                return false;
+            }
+
+            idIndex.erase(books[index].getId());
+            unregisterBook(index);
+
+            if (deleteOrder == SWAP_WITH_LAST) {
+                // Move the last book into the hole - O(1)
+                if (index != count - 1) {
+                    moveBook(count - 1, index);
+                }
+            } else {
+                // Shift all books after the deleted one - O(n)
+                for (int i = index; i < count - 1; i++) {
+                    moveBook(i + 1, i);
+                }
+            }
+            count--;
+            return true;
+        }
+        return false; // Book not found
+    }
+
+    // Choose how deleteBook fills the slot of a deleted book
+    void setDeleteOrder(DeleteOrder order) {
+        deleteOrder = order;
+    }
+
+    // Get the current delete order policy
+    DeleteOrder getDeleteOrder() const {
+        return deleteOrder;
+    }
+
+    // Find the books whose title or author contain every word of the query
+    // Writes at most maxResults slots, in the order the books were added, and returns how many were written,
+    // or -1 if the query has more than TextIndex::MAX_QUERY_TERMS distinct words
+    int searchBooks(const char* query, int* slotsOut, int maxResults) const {
+        if (query == nullptr || slotsOut == nullptr) {
+            return 0;
+        }
+        int found = textIndex.search(query, slotsOut, maxResults);
+        for (int i = 0; i < found; i++) {
+            slotsOut[i] = rowSlots[slotsOut[i]];
+        }
+        return found;
+    }
+
+    // Type-ahead: the titles starting with prefix (ignoring case) held by the most books
+    // Writes at most maxResults suggestions and returns how many were written
+    int suggestTitles(const char* prefix, Suggestion* out, int maxResults) const {
+        return titlePrefixes.suggest(prefix, out, maxResults);
+    }
+
+    // Type-ahead: the authors starting with prefix (ignoring case) with the most books
+    int suggestAuthors(const char* prefix, Suggestion* out, int maxResults) const {
+        return authorPrefixes.suggest(prefix, out, maxResults);
+    }
+
+    // Get a copy of a book by ID
+    // The copy's text goes into bookOut's own pool (see Book::copyFrom), so it outlives
+    // clear(), compactText() and checkpoint(). Returns false if the book is not found or
+    // that pool is full.
+    bool getBookById(const char* id, Book& bookOut) const {
+        const Book* book = viewBookById(id);
+        return book != nullptr && bookOut.copyFrom(*book);
+    }
+
+    // Get a copy of a book by its normalized ISBN, owned by the caller as with getBookById
+    bool getBookByIsbn(uint64_t isbn, Book& bookOut) const {
+        const Book* book = viewBookByIsbn(isbn);
+        return book != nullptr && bookOut.copyFrom(*book);
+    }
+
+    // Borrow a book by ID without copying it, or nullptr if not found
+    // The pointer is valid until the next change to the library (add, edit, delete, clear
+    // or load); hold a BookHandle to refer to the book across changes.
+    const Book* viewBookById(const char* id) const {
+        int index = findBookById(id);
+        return index != -1 ? &books[index] : nullptr;
+    }
+
+    // Borrow a book by its normalized ISBN without copying it, or nullptr if no book has it
+    // When several copies share the ISBN the view is of one of them. Valid for the same
+    // scope as viewBookById.
+    const Book* viewBookByIsbn(uint64_t isbn) const {
+        int index = findBookByIsbn(isbn);
+        return index != -1 ? &books[index] : nullptr;
+    }
+
+    // Get a handle to a book by ID; resolves to nothing if the book is not found
+    BookHandle getBookHandle(const char* id) const {
+        BookHandle handle;
+        int index = findBookById(id);
+        if (index != -1) {
+            handle.row = bookRows[index];
+            handle.serial = rowSerials[handle.row];
+        }
+        return handle;
+    }
+
+    // Borrow the book a handle refers to, or nullptr once it has been deleted or the library cleared
+    // Edits show through the handle, and the pointer is valid until the next change. O(1)
+    // while the handle's row is current, O(log n) once the rows have been renumbered.
+    const Book* resolveBook(const BookHandle& handle) const {
+        if (handle.row < 0 || handle.serial < 0) {
+            return nullptr;
+        }
+        int row = handle.row;
+        if (row >= nextRow || rowSerials[row] != handle.serial) {
+            // Renumbering only moves rows down, so the book is below its old row if anywhere
+            row = firstRowFrom(handle.serial, row < nextRow ? row : nextRow);
+            if (row == nextRow || rowSerials[row] != handle.serial) {
+                return nullptr;
+            }
+        }
+        int slot = rowSlots[row];
+        return slot != -1 ? &books[slot] : nullptr;
+    }
+
+    // Visit every book in slot order until the visitor returns false
+    void forEachBook(BookVisitor visit, void* context) const {
+        for (int i = 0; i < count; i++) {
+            if (!visit(books[i], context)) {
+                return;
+            }
+        }
+    }
+
+    // Find the slots of the books that satisfy a predicate, in slot order
+    // The array is split into chunks that are scanned in parallel on ScanPool::shared(), so
+    // the predicate must be safe to call from several threads. Writes at most maxResults
+    // slots and returns how many were written.
+    int findBooksWhere(BookPredicate matches, const void* context, int* slotsOut, int maxResults) const {
+        if (matches == nullptr || count == 0 || maxResults <= 0) {
+            return 0;
+        }
+
+        // Each chunk writes its matches at its own offset, so no chunk waits for another
+        ScanJob job;
+        job.library = this;
+        job.matches = matches;
+        job.context = context;
+        job.chunkCount = (count + SCAN_CHUNK_SIZE - 1) / SCAN_CHUNK_SIZE;
+        job.found = new int[count];
+        job.chunkFound = new int[job.chunkCount];
+        ScanPool::shared().run(job.chunkCount, &Library::scanChunk, &job);
+
+        // Merge the chunks in order
+        int written = 0;
+        for (int c = 0; c < job.chunkCount && written < maxResults; c++) {
+            int take = job.chunkFound[c] < maxResults - written ? job.chunkFound[c] : maxResults - written;
+            memcpy(slotsOut + written, job.found + c * SCAN_CHUNK_SIZE, take * sizeof(int));
+            written += take;
+        }
+        delete[] job.found;
+        delete[] job.chunkFound;
+        return written;
+    }
+
+    // Get the number of books that satisfy a predicate, scanning in parallel
+    int countBooksWhere(BookPredicate matches, const void* context) const {
+        int* slots = new int[count > 0 ? count : 1];
+        int found = findBooksWhere(matches, context, slots, count);
+        delete[] slots;
+        return found;
+    }
+
+    // Display the books that satisfy a predicate, scanning in parallel
+    void displayBooksWhere(BookPredicate matches, const void* context) const {
+        int* slots = new int[count > 0 ? count : 1];
+        int found = findBooksWhere(matches, context, slots, count);
+        displayBookSlots(slots, found);
+        delete[] slots;
+    }
+
+    // Copy the next page of books after a cursor into pageOut, in insertion order, and advance it
+    // The rows are found through the category row bitmaps, so deleted rows and, for a filtered
+    // cursor, books of other categories are skipped a word at a time. Only the page is copied,
+    // each book into its own pool as with getBookById; a full pool ends the page early.
+    // Returns the number of books copied, 0 once the listing is done.
+    int fetchPage(BookCursor& cursor, Book* pageOut, int pageSize) const {
+        int found = 0;
+        int row = nextLiveRow(cursor.category, firstRowFrom(cursor.nextSerial, nextRow));
+        for (; row != -1 && found < pageSize; row = nextLiveRow(cursor.category, row + 1)) {
+            if (!pageOut[found].copyFrom(books[rowSlots[row]])) {
+                break;
+            }
+            found++;
+        }
+        advanceCursor(cursor, row != -1 ? row : nextRow);
+        return found;
+    }
+
+    // Visit the books in a category in slot order until the visitor returns false
+    // Only the slots in the category's bitmap are touched
+    void forEachBookInCategory(BookCategory category, BookVisitor visit, void* context) const {
+        if (category == CATEGORY_NONE) {
+            return;
+        }
+        for (int i = categoryIndex.next(category, 0); i != -1; i = categoryIndex.next(category, i + 1)) {
+            if (!visit(books[i], context)) {
+                return;
+            }
+        }
+    }
+
+    // Start keeping the books sorted by a field, so sorted listings and range queries need no sort
+    // Costs one O(log n) tree insert per add, so it is off by default
+    void enableOrderIndex(SortField field) {
+        if (field < 0 || field >= SORT_FIELD_COUNT || orderIndexes[field] != nullptr) {
+            return;
+        }
+        orderIndexes[field] = new OrderIndex();
+        for (int i = 0; i < count; i++) {
+            orderIndexes[field]->add(sortKey(books[i], field), bookRows[i]);
+        }
+    }
+
+    // Check if the books are kept sorted by a field
+    bool hasOrderIndex(SortField field) const {
+        return field >= 0 && field < SORT_FIELD_COUNT && orderIndexes[field] != nullptr;
+    }
+
+    // Visit the books sorted by a field (ignoring case, ties in insertion order) until the
+    // visitor returns false. from and to bound the range as in SortedCursor, e.g. "A" to "C"
+    // for authors A-C. Returns false if the field has no order index.
+    bool forEachBookSorted(SortField field, const char* from, const char* to, BookVisitor visit, void* context) const {
+        if (!hasOrderIndex(field)) {
+            return false;
+        }
+        SortedWalk walk;
+        walk.library = this;
+        walk.to = to != nullptr ? to : "";
+        walk.visit = visit;
+        walk.context = context;
+        walk.cursor = nullptr;
+        orderIndexes[field]->walk(from != nullptr ? from : "", -1, &Library::sortedStep, &walk);
+        return true;
+    }
+
+    // Copy the next page of books after a sorted cursor into pageOut and advance it
+    // Returns the number of books copied, 0 once the range is done or if the cursor's field
+    // has no order index. Cursors taken before clear() must not be reused.
+    int fetchSortedPage(SortedCursor& cursor, Book* pageOut, int pageSize) const {
+        if (!hasOrderIndex(cursor.field) || pageSize <= 0) {
+            return 0;
+        }
+        SortedWalk walk;
+        walk.library = this;
+        walk.to = cursor.to;
+        walk.visit = nullptr;
+        walk.context = nullptr;
+        walk.cursor = &cursor;
+        walk.pageOut = pageOut;
+        walk.pageSize = pageSize;
+        walk.found = 0;
+        if (cursor.lastSerial == -1) {
+            orderIndexes[cursor.field]->walk(cursor.from, -1, &Library::sortedStep, &walk);
+        } else {
+            // Ties are ordered by row, and rows rise with serials
+            int row = firstRowFrom(cursor.lastSerial + 1, nextRow);
+            orderIndexes[cursor.field]->walk(cursor.lastKey, row, &Library::sortedStep, &walk);
+        }
+        return walk.found;
+    }
+
+    // Display the books sorted by a field, optionally within a range
+    void displayBooksSorted(SortField field, const char* from = "", const char* to = "") const {
+        if (!hasOrderIndex(field)) {
+            cout << "Sorted listing is not enabled for this field." << endl;
+            return;
+        }
+        TableWriter table;
+        table.writeHeader();
+        forEachBookSorted(field, from, to, &Library::writeRow, &table);
+        table.flush();
+
+        if (table.getRowCount() == 0) {
+            cout << "No books available in this range." << endl;
+        }
+    }
+
+    // Implementation of virtual function - ABSTRACTION
+    virtual void displayAllItems() const override {
+        displayAllBooks();
+        if (journals.getCount() > 0) {
+            displayAllJournals();
+        }
+    }
+    
+    // Display all books - specific implementation
+    void displayAllBooks() const {
+        if (count == 0) {
+            cout << "No books available in the library." << endl;
+            return;
+        }
+
+        TableWriter table;
+        table.writeHeader();
+        for (int i = 0; i < count; i++) {
+            table.writeBook(books[i]);
+        }
+    }
+
+    // Add a new journal; its ID must not be taken by a book or another journal
+    // Journals cannot be logged, so while a write-ahead log is attached they cannot change
+    bool addJournal(const Journal& periodical) {
+        return putJournal(periodical, false) == ITEM_ADDED;
+    }
+
+    // Delete a journal by ID; the last journal moves into its place
+    bool deleteJournal(const char* id) {
+        return dropJournal(id) == ITEM_DELETED;
+    }
+
+    // Get a view of a journal by ID, or nullptr; valid until the next change to the journals
+    const Journal* viewJournalById(const char* id) const {
+        return journals.find(id);
+    }
+
+    // Get the number of journals
+    int getJournalCount() const {
+        return journals.getCount();
+    }
+
+    // Display all journals as a table
+    void displayAllJournals() const {
+        if (journals.getCount() == 0) {
+            cout << "No journals available in the library." << endl;
+            return;
+        }
+
+        TableWriter table;
+        table.writeJournalHeader();
+        JournalRows rows = { &table };
+        journals.forEach(rows);
+    }
+
+    // Visit every item, books first and then journals, until the visitor returns false
+    // The visitor is called with const Book& or const Journal&: each typed array is walked
+    // in its own loop and the overload is picked at compile time, with no per-item dispatch.
+    template <typename Visitor>
+    void forEachItem(Visitor& visit) const {
+        for (int i = 0; i < count; i++) {
+            if (!visit(books[i])) {
+                return;
+            }
+        }
+        journals.forEach(visit);
+    }
+
+    // Display books by category
+    void displayBooksByCategory(const char* category) const {
+        // Validate category is not null or empty
+        if (category == nullptr || strlen(category) == 0) {
+            cout << "Invalid category." << endl;
+            return;
+        }
+        
+        // Case-sensitive category comparison; only the slots in the category's bitmap are visited
+        BookCategory code = parseCategory(category);
+        TableWriter table;
+        table.writeHeader();
+        if (code != CATEGORY_NONE) {
+            for (int i = categoryIndex.next(code, 0); i != -1; i = categoryIndex.next(code, i + 1)) {
+                table.writeBook(books[i]);
+            }
+        }
+        table.flush();
+        
+        if (table.getRowCount() == 0) {
+            cout << "No books found in this category." << endl;
+        }
+    }
+
+    // Get the number of books in a category (case-sensitive name), 0 for an unknown category
+    int getCountByCategory(const char* category) const {
+        BookCategory code = parseCategory(category);
+        return code != CATEGORY_NONE ? categoryIndex.getCount(code) : 0;
+    }
+
+    // Display the books whose title or author contain every word of the query
+    void displayBooksMatching(const char* query) const {
+        // Validate query is not null or empty
+        if (query == nullptr || strlen(query) == 0) {
+            cout << "Invalid search." << endl;
+            return;
+        }
+
+        // A query that is a valid ISBN (e.g. a scanned barcode) lists the copies with that ISBN
+        int* slots = new int[count > 0 ? count : 1];
+        uint64_t isbn = 0;
+        int found = parseIsbn(query, isbn) ? findBooksByIsbn(isbn, slots, count) : searchBooks(query, slots, count);
+        if (found < 0) {
+            cout << "Search has too many words (at most " << TextIndex::MAX_QUERY_TERMS << ")." << endl;
+        } else {
+            displayBookSlots(slots, found);
+        }
+        delete[] slots;
+    }
+
+    // Implementation of virtual function - ABSTRACTION
+    virtual bool displayItemById(const char* id) const override {
+        if (displayBookById(id)) {
+            return true;
+        }
+        const Journal* periodical = journals.find(id);
+        if (periodical != nullptr) {
+            periodical->displayDetails();
+            return true;
+        }
+        return false;
+    }
+    
+    // Display a specific book by ID - specific implementation
+    bool displayBookById(const char* id) const {
+        int index = findBookById(id);
+        if (index != -1) {
+            books[index].displayDetails();
+            return true;
+        }
+        return false;
+    }
+
+    // Implementation of virtual function - ABSTRACTION
+    virtual int getItemCount() const override {
+        return getCount() + journals.getCount();
+    }
+    
+    // Get the number of books - specific implementation
+    int getCount() const {
+        return count;
+    }
+
+    // Get the number of books that fit before the array has to grow again
+    int getCapacity() const {
+        return capacity;
+    }
+
+    // Get the number of rows handed out since rows were last renumbered, deleted books' included
+    int getRowCount() const {
+        return nextRow;
+    }
+
+    // Make room for at least the given number of books, e.g. before a bulk load
+    void reserve(int newCapacity) {
+        if (newCapacity > capacity) {
+            reallocate(newCapacity);
+        }
+        idIndex.reserve(newCapacity);
+    }
+
+    // Remove every book and journal, keeping the allocated storage
+    // The text pool is replaced, so views from viewBookById and the visitors must not be read
+    // afterwards. Copies from getBookById and fetchPage hold their own text, and a snapshot
+    // taken earlier keeps the old pool alive, so both stay readable.
+    void clear() {
+        clearBooks();
+        journals.clear();
+    }
+
+    // Remove every book, keeping the journals and the allocated storage
+    // loadCatalogue and recover use this: journals are neither in the catalogue file nor
+    // in the write-ahead log, so what those restore must not wipe them
+    void clearBooks() {
+        count = 0;
+        nextRow = 0;
+        text = make_shared<StringPool>();
+        droppedText = 0;
+        idIndex.clear();
+        isbnIndex.clear();
+        textIndex.clear();
+        titlePrefixes.clear();
+        authorPrefixes.clear();
+        categoryIndex.clearAll();
+        categoryRows.clearAll();
+        for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+            if (orderIndexes[f] != nullptr) {
+                orderIndexes[f]->clear();
+            }
+        }
+        if (snapshotWorking != nullptr) {
+            delete snapshotWorking;
+            snapshotWorking = new CatalogSnapshot(text);
+            snapshotStale = true;
+        }
+    }
+
+    // Copy the text of every book into a fresh pool, reclaiming the text of replaced and
+    // deleted values, and renumber the rows so deleted books no longer hold any. O(n); the
+    // order indexes, the type-ahead tries and the working snapshot are rebuilt, since they
+    // point into the pool or keep values no book holds any more.
+    // Views of the library's books taken earlier must not be read afterwards; copies and
+    // earlier snapshots hold their own text and stay readable, and handles and cursors
+    // carry on. Returns false, with the library unchanged, if the text no longer fits one pool.
+    bool compactText() {
+        shared_ptr<StringPool> compacted = make_shared<StringPool>();
+        Book* moved = new Book[count > 0 ? count : 1];
+        for (int i = 0; i < count; i++) {
+            moved[i] = books[i];
+            if (!moved[i].moveTextTo(*compacted)) {
+                delete[] moved;
+                return false;
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            books[i] = moved[i];
+        }
+        delete[] moved;
+        text = compacted;
+        droppedText = 0;
+
+        // The order indexes are emptied before the rows are renumbered, since their keys
+        // point into the old pool, and bulk-built again under the new rows
+        for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+            if (orderIndexes[f] != nullptr) {
+                orderIndexes[f]->clear();
+            }
+        }
+        renumberRows();
+        buildOrderIndexes();
+
+        // The tries keep the nodes and text of every value ever added; start them over from
+        // the live books so the values no book holds any more are dropped too
+        titlePrefixes.clear();
+        authorPrefixes.clear();
+        for (int row = 0; row < nextRow; row++) {
+            titlePrefixes.add(books[rowSlots[row]].getTitle());
+            authorPrefixes.add(books[rowSlots[row]].getAuthor());
+        }
+        rebuildSnapshot();
+        return true;
+    }
+
+    // Get the number of bytes in the text pool, and roughly how many of them no book uses
+    size_t getTextBytes() const {
+        return text->getUsedBytes();
+    }
+
+    size_t getDroppedTextBytes() const {
+        return droppedText;
+    }
+
+    // Get the number of bytes of text in the title and author type-ahead tries
+    size_t getSuggestionTextBytes() const {
+        return titlePrefixes.getTextBytes() + authorPrefixes.getTextBytes();
+    }
+
+    // Start keeping a copy-on-write snapshot of the catalogue for lock-free readers
+    // Costs a second copy of every book and a page copy on the first change after each
+    // publish, so it is off by default
+    void enableSnapshots() {
+        if (snapshotWorking != nullptr) {
+            return;
+        }
+        // The snapshot finds books by serial through its rows, so it needs one row per book
+        if (nextRow != count) {
+            renumberRows();
+        }
+        snapshotWorking = new CatalogSnapshot(text);
+        for (int row = 0; row < nextRow; row++) {
+            snapshotWorking->putBook(row, rowSerials[row], books[rowSlots[row]]);
+        }
+        snapshotStale = true;
+    }
+
+    // Get an immutable version of the catalogue as of the last change, or nullptr if
+    // snapshots are not enabled. Reading the snapshot needs no lock and later changes do not
+    // affect it; the version is freed once every holder lets go. Like the other const
+    // methods this may run alongside readers, but not alongside a change.
+    shared_ptr<const CatalogSnapshot> snapshot() const {
+        if (snapshotWorking == nullptr) {
+            return nullptr;
+        }
+        lock_guard<mutex> guard(snapshotLock);
+        if (snapshotStale || !snapshotPublished) {
+            snapshotPublished = snapshotWorking->publish();
+            snapshotStale = false;
+        }
+        return snapshotPublished;
+    }
+
+    // Save every book to a binary catalogue file
+    // The file is written under a temporary name and renamed into place,
+    // so an interrupted save leaves the previous catalogue intact
+    bool saveCatalogue(const char* path) const {
+        if (path == nullptr || path[0] == '\0') {
+            return false;
+        }
+
+        string tempPath = string(path) + ".tmp";
+        FILE* file = fopen(tempPath.c_str(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+
+        CatalogHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CATALOGUE_MAGIC, sizeof(header.magic));
+        header.version = CATALOGUE_VERSION;
+        header.recordSize = sizeof(CatalogRecord);
+        header.byteOrder = CATALOGUE_BYTE_ORDER;
+        header.checkpoint = checkpointId;
+        header.recordCount = static_cast<uint64_t>(count);
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+        // Convert books in blocks so each fwrite moves a large contiguous buffer
+        const int BLOCK_RECORDS = 1024;
+        CatalogRecord* block = new CatalogRecord[BLOCK_RECORDS];
+        for (int start = 0; ok && start < count; start += BLOCK_RECORDS) {
+            int blockCount = count - start < BLOCK_RECORDS ? count - start : BLOCK_RECORDS;
+            for (int i = 0; i < blockCount; i++) {
+                books[start + i].toRecord(block[i]);
+            }
+            ok = fwrite(block, sizeof(CatalogRecord), blockCount, file) == static_cast<size_t>(blockCount);
+        }
+        delete[] block;
+
+        ok = syncFile(file) && ok;
+        ok = fclose(file) == 0 && ok;
+        if (!ok) {
+            remove(tempPath.c_str());
+            return false;
+        }
+
+        #ifdef _WIN32
+            remove(path); // rename does not replace an existing file on Windows
+        #endif
+        return rename(tempPath.c_str(), path) == 0;
+    }
+
+    // Replace the books of the library with a binary catalogue file; journals are kept
+    // The file is memory-mapped and its fixed-width records are copied straight into the
+    // book array and ID index, with no text parsing; the other indexes are then built in one
+    // pass over the loaded books. Returns false if the file cannot be read or has a bad
+    // header (library unchanged), or if a record is invalid (no books left).
+    bool loadCatalogue(const char* path) {
+        MappedFile file;
+        if (!file.open(path) || file.getSize() < sizeof(CatalogHeader)) {
+            return false;
+        }
+
+        CatalogHeader header;
+        memcpy(&header, file.getData(), sizeof(header));
+        if (memcmp(header.magic, CATALOGUE_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != CATALOGUE_VERSION ||
+            header.recordSize != sizeof(CatalogRecord) ||
+            header.byteOrder != CATALOGUE_BYTE_ORDER) {
+            return false;
+        }
+
+        // The header must not promise more records than the file holds
+        uint64_t available = (file.getSize() - sizeof(CatalogHeader)) / sizeof(CatalogRecord);
+        if (header.recordCount > available ||
+            header.recordCount > static_cast<uint64_t>(numeric_limits<int>::max())) {
+            return false;
+        }
+
+        int recordCount = static_cast<int>(header.recordCount);
+        const CatalogRecord* records = reinterpret_cast<const CatalogRecord*>(file.getData() + sizeof(CatalogHeader));
+
+        clearBooks();
+        checkpointId = header.checkpoint;
+        reserve(recordCount);
+        for (int i = 0; i < recordCount; i++) {
+            // Fill the next slot in place; a duplicate ID rejects the file
+            books[count] = Book(*text);
+            if (!books[count].fromRecord(records[i]) || !idIndex.insert(books[count].getId(), count)) {
+                clearBooks();
+                return false;
+            }
+            count++;
+        }
+        registerLoadedBooks();
+        return true;
+    }
+
+    // Log every later add, edit and delete to a journal; nullptr stops journaling
+    void attachJournal(CatalogJournal* newJournal) {
+        journal = newJournal;
+    }
+
+    // Rebuild the library after a restart and start journaling
+    // Loads the last snapshot (if any), replays the journal records written since that
+    // snapshot, cuts off a torn tail left by a crash, and attaches the journal for new
+    // records. Journals in memory are kept as they are. Replay cost is proportional to the journal length, not the catalogue size.
+    bool recover(const char* snapshotPath, CatalogJournal& recoveryJournal, const char* journalPath, int& replayed) {
+        replayed = 0;
+        attachJournal(nullptr);
+
+        if (fileExists(snapshotPath)) {
+            if (!loadCatalogue(snapshotPath)) {
+                return false;
+            }
+        } else {
+            clearBooks();
+            checkpointId = 0;
+        }
+
+        size_t validLength = 0;
+        MappedFile log;
+        JournalHeader header;
+        // A journal from another generation predates the snapshot and is discarded
+        if (log.open(journalPath) && CatalogJournal::readHeader(log.getData(), log.getSize(), header) &&
+            header.checkpoint == checkpointId) {
+            // Each record is decoded into a staging pool that is emptied once the library has
+            // copied what it keeps
+            size_t offset = sizeof(JournalHeader);
+            StringPool replayText;
+            JournalEntry entry;
+            entry.book = Book(replayText);
+            while (CatalogJournal::readRecord(log.getData(), log.getSize(), offset, entry)) {
+                applyJournalEntry(entry);
+                replayText.clear();
+                replayed++;
+            }
+            validLength = offset;
+        }
+        log.close();
+
+        if (!recoveryJournal.open(journalPath, checkpointId, validLength)) {
+            return false;
+        }
+        attachJournal(&recoveryJournal);
+        return true;
+    }
+
+    // Write a new snapshot and empty the journal
+    // The snapshot carries the next generation number, so a crash before the journal is
+    // reset leaves an old-generation journal that recover() ignores. Once at least half of
+    // the text pool is dropped text, the checkpoint also compacts it (see compactText).
+    bool checkpoint(const char* snapshotPath) {
+        if (journal != nullptr && !journal->commit()) {
+            return false;
+        }
+
+        checkpointId++;
+        if (!saveCatalogue(snapshotPath)) {
+            checkpointId--;
+            return false;
+        }
+        if (droppedText > 0 && droppedText * 2 >= text->getUsedBytes()) {
+            compactText();
+        } else if (rowsSparse()) {
+            renumberRows();
+            rebuildSnapshot();
+        }
+        return journal == nullptr || journal->reset(checkpointId);
+    }
+
+    // Release unused slots, e.g. after mass deletes
+    void shrinkToFit() {
+        int fitted = count > 0 ? count : 1;
+        if (fitted < capacity) {
+            reallocate(fitted);
+        }
+        idIndex.shrinkToFit();
+    }
+
+private:
+    // Helper method to pick the next capacity when the array is full - ENCAPSULATION
+    int growCapacity(int minCapacity) const {
+        const int maxCapacity = numeric_limits<int>::max();
+        if (capacity > maxCapacity / 2) {
+            return minCapacity > capacity ? maxCapacity : capacity;
+        }
+        int grown = capacity * 2;
+        return grown > minCapacity ? grown : minCapacity;
+    }
+
+    // Helper method to move the books into an array of a new size - ENCAPSULATION
+    // Slots keep their positions, so the ID index stays valid.
+    bool reallocate(int newCapacity) {
+        if (newCapacity < count || newCapacity <= 0) {
+            return false;
+        }
+
+        Book* resized = new Book[newCapacity];
+        int* resizedRows = new int[newCapacity];
+        for (int i = 0; i < count; i++) {
+            resized[i] = books[i];
+            resizedRows[i] = bookRows[i];
+        }
+        delete[] books;
+        delete[] bookRows;
+        books = resized;
+        bookRows = resizedRows;
+        capacity = newCapacity;
+        categoryIndex.resize(newCapacity);
+        return true;
+    }
+
+    // Helper method to append a book to a slot that is already allocated - ENCAPSULATION
+    ItemOutcome appendBook(const Book& book) {
+        // Validate book ID is not empty, nor taken by a journal
+        if (book.getId()[0] == '\0') {
+            return ITEM_INVALID;
+        }
+        if (journals.find(book.getId()) != nullptr) {
+            return ITEM_DUPLICATE;
+        }
+
+        // Stage the book in the next free slot; it only becomes part of the library once count moves
+        books[count] = book;
+
+        // The index rejects duplicate IDs in the same probe that reserves the entry
+        if (!idIndex.insert(books[count].getId(), count)) {
+            return ITEM_DUPLICATE;
+        }
+
+        // Copy the text into the library's pool, unless it is there already
+        if (!books[count].moveTextTo(*text)) {
+            idIndex.erase(books[count].getId());
+            return ITEM_FAILED;
+        }
+
+        // Write-ahead: a change that cannot be logged is not applied
+        if (journal != nullptr && !journal->logAdd(books[count])) {
+            idIndex.erase(books[count].getId());
+            dropText(books[count]);
+            return ITEM_FAILED;
+        }
+
+        registerBook(count);
+        count++;
+        return ITEM_ADDED;
+    }
+
+    // Helper method to add or upsert a batch held either contiguously or as pointers - ENCAPSULATION
+    int putBatch(const Book* contiguous, const Book* const* pointers, int batchCount, ItemOutcome* outcomes, bool replace) {
+        // Every outcome is set on every path, so callers can read the whole array
+        if ((contiguous == nullptr && pointers == nullptr) || batchCount <= 0) {
+            setOutcomes(outcomes, batchCount, ITEM_INVALID);
+            return 0;
+        }
+        // Grow once for the worst case of every book being new
+        if (count + batchCount > capacity && !reallocate(growCapacity(count + batchCount))) {
+            setOutcomes(outcomes, batchCount, ITEM_FAILED);
+            return 0;
+        }
+        idIndex.reserve(count + batchCount);
+
+        if (journal != nullptr) {
+            journal->beginGroup();
+        }
+        int applied = 0;
+        for (int i = 0; i < batchCount; i++) {
+            const Book* book = contiguous != nullptr ? &contiguous[i] : pointers[i];
+            ItemOutcome outcome = ITEM_INVALID;
+            if (book != nullptr) {
+                if (replace && findBookById(book->getId()) != -1) {
+                    outcome = editBook(book->getId(), *book) ? ITEM_UPDATED : ITEM_FAILED;
+                } else {
+                    outcome = appendBook(*book);
+                }
+            }
+            if (outcome == ITEM_ADDED || outcome == ITEM_UPDATED) {
+                applied++;
+            }
+            if (outcomes != nullptr) {
+                outcomes[i] = outcome;
+            }
+        }
+        return endBatchGroup(outcomes, batchCount, applied);
+    }
+
+    // Journal visitor that writes each journal as a table row
+    struct JournalRows {
+        TableWriter* table;
+        bool operator()(const Journal& periodical) const {
+            table->writeJournal(periodical);
+            return true;
+        }
+    };
+
+    // Helper method to close a batch's journal group and return the number of changes applied - ENCAPSULATION
+    // If the group cannot be committed, none of the batch is durable: its changes stay in
+    // memory and its records stay buffered for the next commit, as when an automatic commit
+    // fails, but every applied outcome becomes ITEM_FAILED and 0 is returned.
+    int endBatchGroup(ItemOutcome* outcomes, int outcomeCount, int applied) {
+        if (journal == nullptr || journal->endGroup()) {
+            return applied;
+        }
+        for (int i = 0; outcomes != nullptr && i < outcomeCount; i++) {
+            if (outcomes[i] == ITEM_ADDED || outcomes[i] == ITEM_UPDATED || outcomes[i] == ITEM_DELETED) {
+                outcomes[i] = ITEM_FAILED;
+            }
+        }
+        return 0;
+    }
+
+    // Helper method to give every entry of an outcome array the same value - ENCAPSULATION
+    static void setOutcomes(ItemOutcome* outcomes, int outcomeCount, ItemOutcome outcome) {
+        if (outcomes == nullptr) {
+            return;
+        }
+        for (int i = 0; i < outcomeCount; i++) {
+            outcomes[i] = outcome;
+        }
+    }
+
+    // Helper method to sort a batch of items by kind and put them - ENCAPSULATION
+    // Each run of items between journals takes the bulk book path, and each journal goes
+    // to its own array in between, so the batch is still applied in order.
+    int putItems(const LibraryItem* const* items, int itemCount, ItemOutcome* outcomes, bool replace) {
+        if (items == nullptr || itemCount <= 0) {
+            setOutcomes(outcomes, itemCount, ITEM_INVALID);
+            return 0;
+        }
+        const Book** batch = new const Book*[itemCount];
+        int applied = 0;
+        int runStart = 0;
+        for (int i = 0; i <= itemCount; i++) {
+            const Journal* periodical = i < itemCount ? asJournal(items[i]) : nullptr;
+            if (i < itemCount && periodical == nullptr) {
+                batch[i] = asBook(items[i]); // nullptr for an item of no known kind
+                continue;
+            }
+            if (i > runStart) {
+                applied += putBatch(nullptr, batch + runStart, i - runStart,
+                                    outcomes != nullptr ? outcomes + runStart : nullptr, replace);
+            }
+            if (periodical != nullptr) {
+                ItemOutcome outcome = putJournal(*periodical, replace);
+                applied += outcome == ITEM_ADDED || outcome == ITEM_UPDATED ? 1 : 0;
+                if (outcomes != nullptr) {
+                    outcomes[i] = outcome;
+                }
+            }
+            runStart = i + 1;
+        }
+        delete[] batch;
+        return applied;
+    }
+
+    // Helper method to add a journal, or replace the one stored under its ID - ENCAPSULATION
+    // A change that cannot be logged is not applied, and the log has no journal records
+    ItemOutcome putJournal(const Journal& periodical, bool replace) {
+        if (findBookById(periodical.getId()) != -1) {
+            return ITEM_DUPLICATE;
+        }
+        if (journal != nullptr) {
+            return ITEM_FAILED;
+        }
+        if (replace && journals.find(periodical.getId()) != nullptr) {
+            return journals.replace(periodical.getId(), periodical);
+        }
+        return journals.add(periodical);
+    }
+
+    // Helper method to delete a journal by ID, refused while a log is attached as above - ENCAPSULATION
+    ItemOutcome dropJournal(const char* id) {
+        if (journals.find(id) == nullptr) {
+            return ITEM_NOT_FOUND;
+        }
+        if (journal != nullptr) {
+            return ITEM_FAILED;
+        }
+        return journals.remove(id) ? ITEM_DELETED : ITEM_FAILED;
+    }
+
+    // Helper method to give the book in a new slot its row and add it to the secondary indexes - ENCAPSULATION
+    // Once the rows run out, they are renumbered if deleted books hold at least half of them
+    // (so each renumbering is paid for by as many deletes) and grown otherwise.
+    void registerBook(int slot) {
+        if (nextRow == rowCapacity) {
+            if (rowsSparse() || rowCapacity == numeric_limits<int>::max()) {
+                renumberRows();
+                rebuildSnapshot();
+            } else {
+                growRows(rowCapacity > numeric_limits<int>::max() / 2 ? numeric_limits<int>::max() : rowCapacity * 2);
+            }
+        }
+        int row = nextRow++;
+        rowSlots[row] = slot;
+        rowSerials[row] = nextSerial++;
+        bookRows[slot] = row;
+        isbnIndex.add(books[slot].getIsbn(), row);
+        textIndex.addDocument(row, books[slot].getTitle(), books[slot].getAuthor());
+        titlePrefixes.add(books[slot].getTitle());
+        authorPrefixes.add(books[slot].getAuthor());
+        categoryIndex.set(slot, books[slot].getCategoryCode());
+        categoryRows.set(row, books[slot].getCategoryCode());
+        for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+            if (orderIndexes[f] != nullptr) {
+                orderIndexes[f]->add(sortKey(books[slot], static_cast<SortField>(f)), row);
+            }
+        }
+        snapshotPut(slot);
+    }
+
+    // Helper method to give the rows arrays room for at least the given number of rows - ENCAPSULATION
+    void growRows(int newCapacity) {
+        if (newCapacity <= rowCapacity) {
+            return;
+        }
+        int* grownSlots = new int[newCapacity];
+        int64_t* grownSerials = new int64_t[newCapacity];
+        memcpy(grownSlots, rowSlots, rowCapacity * sizeof(int));
+        memcpy(grownSerials, rowSerials, rowCapacity * sizeof(int64_t));
+        delete[] rowSlots;
+        delete[] rowSerials;
+        rowSlots = grownSlots;
+        rowSerials = grownSerials;
+        rowCapacity = newCapacity;
+        categoryRows.resize(rowCapacity);
+    }
+
+    // Helper method to index the books just loaded into an empty library in one pass - ENCAPSULATION
+    // Slot i gets row i, so the ISBN and text postings are only ever appended to, each order
+    // index is built by one sort instead of a tree insert per book, and the snapshot is
+    // filled once at the end rather than page by page.
+    void registerLoadedBooks() {
+        growRows(count);
+        for (int slot = 0; slot < count; slot++) {
+            int row = nextRow++;
+            rowSlots[row] = slot;
+            rowSerials[row] = nextSerial++;
+            bookRows[slot] = row;
+            isbnIndex.add(books[slot].getIsbn(), row);
+            textIndex.addDocument(row, books[slot].getTitle(), books[slot].getAuthor());
+            titlePrefixes.add(books[slot].getTitle());
+            authorPrefixes.add(books[slot].getAuthor());
+            categoryIndex.set(slot, books[slot].getCategoryCode());
+            categoryRows.set(row, books[slot].getCategoryCode());
+        }
+        buildOrderIndexes();
+        rebuildSnapshot();
+    }
+
+    // Helper method to bulk-build every enabled order index from the rows in use - ENCAPSULATION
+    // Every row below nextRow must hold a book, as after registerLoadedBooks or renumberRows
+    void buildOrderIndexes() {
+        const char** keys = new const char*[nextRow > 0 ? nextRow : 1];
+        for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+            if (orderIndexes[f] != nullptr) {
+                for (int row = 0; row < nextRow; row++) {
+                    keys[row] = sortKey(books[rowSlots[row]], static_cast<SortField>(f));
+                }
+                orderIndexes[f]->build(keys, nextRow);
+            }
+        }
+        delete[] keys;
+    }
+
+    // Helper method to count the text of a book that leaves the library as dropped - ENCAPSULATION
+    // Its title always; each interned field only if no other book uses the value, since the
+    // pool counts a use per intern() (adds, loads, patches and compaction all intern)
+    void dropText(const Book& book) {
+        droppedText += strlen(book.getTitle()) + 1;
+        droppedText += text->release(book.getAuthor());
+        droppedText += text->release(book.getEdition());
+        droppedText += text->release(book.getPublication());
+    }
+
+    // Helper method to drop the book in a slot from the secondary indexes before it is removed - ENCAPSULATION
+    void unregisterBook(int slot) {
+        int row = bookRows[slot];
+        dropText(books[slot]);
+        isbnIndex.remove(books[slot].getIsbn(), row);
+        textIndex.removeDocument(row, books[slot].getTitle(), books[slot].getAuthor());
+        titlePrefixes.remove(books[slot].getTitle());
+        authorPrefixes.remove(books[slot].getAuthor());
+        categoryIndex.clear(slot, books[slot].getCategoryCode());
+        categoryRows.clear(row, books[slot].getCategoryCode());
+        for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+            if (orderIndexes[f] != nullptr) {
+                orderIndexes[f]->remove(sortKey(books[slot], static_cast<SortField>(f)), row);
+            }
+        }
+        rowSlots[row] = -1;
+        if (snapshotWorking != nullptr) {
+            snapshotWorking->eraseBook(row);
+            snapshotStale = true;
+        }
+    }
+
+    // Helper method to check whether deleted books hold at least half of the rows - ENCAPSULATION
+    bool rowsSparse() const {
+        return nextRow - count >= count && nextRow > count;
+    }
+
+    // Helper method to give the live books rows 0..count-1, keeping their order - ENCAPSULATION
+    // A deleted book's row is never given to another book, so without this the rows, and
+    // every structure and scan sized by them, would grow with every add ever made. Books
+    // keep their serials, which is how handles and cursors find them again. The caller
+    // rebuilds the working snapshot, whose rows change too.
+    void renumberRows() {
+        int* newRows = new int[nextRow > 0 ? nextRow : 1];
+        int live = 0;
+        for (int row = 0; row < nextRow; row++) {
+            int slot = rowSlots[row];
+            newRows[row] = slot != -1 ? live : -1;
+            if (slot != -1) {
+                rowSlots[live] = slot;
+                rowSerials[live] = rowSerials[row];
+                bookRows[slot] = live;
+                live++;
+            }
+        }
+        nextRow = live;
+
+        // Live rows keep their relative order, so the postings and trees are rewritten in place
+        isbnIndex.clear();
+        categoryRows.clearAll();
+        for (int row = 0; row < nextRow; row++) {
+            isbnIndex.add(books[rowSlots[row]].getIsbn(), row);
+            categoryRows.set(row, books[rowSlots[row]].getCategoryCode());
+        }
+        textIndex.renumberRows(newRows);
+        for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+            if (orderIndexes[f] != nullptr) {
+                orderIndexes[f]->renumberRows(newRows);
+            }
+        }
+        delete[] newRows;
+    }
+
+    // Helper method to start the working snapshot over from the current rows - ENCAPSULATION
+    void rebuildSnapshot() {
+        if (snapshotWorking != nullptr) {
+            delete snapshotWorking;
+            snapshotWorking = nullptr;
+            enableSnapshots();
+        }
+    }
+
+    // Helper method to find the first row below limit whose serial is not less than a serial - ENCAPSULATION
+    int firstRowFrom(int64_t serial, int limit) const {
+        int low = 0;
+        int high = limit;
+        while (low < high) {
+            int mid = low + (high - low) / 2;
+            if (rowSerials[mid] < serial) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    // Helper method to find the first live row at or after a row in a category, or any live row - ENCAPSULATION
+    // Returns -1 once no such row remains.
+    int nextLiveRow(BookCategory category, int fromRow) const {
+        if (fromRow >= nextRow) {
+            return -1;
+        }
+        return category == CATEGORY_NONE ? categoryRows.nextAny(fromRow) : categoryRows.next(category, fromRow);
+    }
+
+    // Helper method to move a cursor to the row a page stopped at, or past every row - ENCAPSULATION
+    void advanceCursor(BookCursor& cursor, int row) const {
+        if (row < nextRow) {
+            cursor.nextSerial = rowSerials[row];
+        } else if (nextRow > 0 && cursor.nextSerial <= rowSerials[nextRow - 1]) {
+            cursor.nextSerial = rowSerials[nextRow - 1] + 1;
+        }
+    }
+
+    // Books per task of a parallel scan - large enough that scheduling is noise
+    static const int SCAN_CHUNK_SIZE = 16384;
+
+    // State shared by the tasks of findBooksWhere
+    struct ScanJob {
+        const Library* library;
+        BookPredicate matches;
+        const void* context;
+        int chunkCount;
+        int* found;      // Matching slots, each chunk's at its own offset
+        int* chunkFound; // Matches in each chunk
+    };
+
+    // Task run by ScanPool - scans one chunk of slots
+    static void scanChunk(int chunk, void* state) {
+        ScanJob* job = static_cast<ScanJob*>(state);
+        int begin = chunk * SCAN_CHUNK_SIZE;
+        int end = begin + SCAN_CHUNK_SIZE < job->library->count ? begin + SCAN_CHUNK_SIZE : job->library->count;
+        int* out = job->found + begin;
+        int found = 0;
+        for (int i = begin; i < end; i++) {
+            if (job->matches(job->library->books[i], job->context)) {
+                out[found++] = i;
+            }
+        }
+        job->chunkFound[chunk] = found;
+    }
+
+    // Helper method to get the text a book is sorted by - ENCAPSULATION
+    // The text lives in the library's pool, so the order indexes can keep the pointer until
+    // compactText rebuilds them.
+    static const char* sortKey(const Book& book, SortField field) {
+        switch (field) {
+            case SORT_BY_AUTHOR:
+                return book.getAuthor();
+            case SORT_BY_PUBLICATION:
+                return book.getPublication();
+            default:
+                return book.getTitle();
+        }
+    }
+
+    // State of a walk along an order index, for forEachBookSorted and fetchSortedPage
+    struct SortedWalk {
+        const Library* library;
+        const char* to;          // Upper bound as a prefix, "" for none
+        BookVisitor visit;       // Visitor for forEachBookSorted
+        void* context;
+        SortedCursor* cursor;    // Cursor for fetchSortedPage, nullptr when visiting
+        Book* pageOut;
+        int pageSize;
+        int found;
+    };
+
+    // Entry visitor handed to OrderIndex::walk - stops past the range or once the page is full
+    static bool sortedStep(const OrderIndex::Entry& entry, void* state) {
+        SortedWalk* walk = static_cast<SortedWalk*>(state);
+        if (walk->to[0] != '\0' && compareFoldedPrefix(entry.key, walk->to) > 0) {
+            return false;
+        }
+        const Book& book = walk->library->books[walk->library->rowSlots[entry.row]];
+        if (walk->cursor == nullptr) {
+            return walk->visit(book, walk->context);
+        }
+        if (walk->found == walk->pageSize || !walk->pageOut[walk->found].copyFrom(book)) {
+            return false;
+        }
+        walk->found++;
+        strncpy(walk->cursor->lastKey, entry.key, MAX_TITLE_LENGTH - 1);
+        walk->cursor->lastKey[MAX_TITLE_LENGTH - 1] = '\0';
+        walk->cursor->lastSerial = walk->library->rowSerials[entry.row];
+        return true;
+    }
+
+    // Book visitor that writes each book to a TableWriter
+    static bool writeRow(const Book& book, void* table) {
+        static_cast<TableWriter*>(table)->writeBook(book);
+        return true;
+    }
+
+    // Helper method to copy the book in a slot into the working snapshot - ENCAPSULATION
+    void snapshotPut(int slot) {
+        if (snapshotWorking != nullptr) {
+            snapshotWorking->putBook(bookRows[slot], rowSerials[bookRows[slot]], books[slot]);
+            snapshotStale = true;
+        }
+    }
+
+    // Helper method to apply a replayed journal record - ENCAPSULATION
+    // Records that no longer apply (e.g. deleting a missing book) are skipped.
+    void applyJournalEntry(const JournalEntry& entry) {
+        switch (entry.operation) {
+            case CatalogJournal::OP_ADD:
+                addBook(entry.book);
+                break;
+            case CatalogJournal::OP_EDIT:
+                editBook(entry.id, entry.book);
+                break;
+            case CatalogJournal::OP_DELETE:
+                deleteBook(entry.id);
+                break;
+        }
+    }
+
+    // Helper method to move a book to another slot and repoint its index entry - ENCAPSULATION
+    // The source slot still holds a copy until it is overwritten or dropped by the caller.
+    void moveBook(int from, int to) {
+        books[to] = books[from];
+        bookRows[to] = bookRows[from];
+        rowSlots[bookRows[to]] = to;
+        idIndex.updateSlot(books[to].getId(), to);
+        categoryIndex.clear(from, books[to].getCategoryCode());
+        categoryIndex.set(to, books[to].getCategoryCode());
+    }
+
+    // Key accessor handed to idIndex - resolves a slot to the ID of the book stored there
+    static const char* idAtSlot(const void* owner, int slot) {
+        return static_cast<const Library*>(owner)->books[slot].getId();
+    }
+
+    // Helper method to display the books in a list of slots as a table - ENCAPSULATION
+    void displayBookSlots(const int* slots, int found) const {
+        if (found == 0) {
+            cout << "No books match your search." << endl;
+            return;
+        }
+        TableWriter table;
+        table.writeHeader();
+        for (int i = 0; i < found; i++) {
+            table.writeBook(books[slots[i]]);
+        }
+    }
+};
+
+/**
+ * ColumnarLibrary class - implements ItemManager with column-oriented storage
+ * A standalone alternative to Library for scan-heavy workloads, not a backing store for
+ * it: Library keeps its own array of Book records. Each field lives in its own
+ * contiguous column: IDs in a fixed-width column (the key of the hash index), categories
+ * in a one-byte column, and the other text fields as 32-bit handles into the library's
+ * own StringPool. A category filter reads one byte per book and an ID lookup touches only
+ * the ID column, instead of pulling whole Book records through the cache.
+ *
+ * Books read back are views bound to that pool: assembling one copies handles, not text.
+ * A view stays readable until compact() is called. Text of edited and deleted books
+ * stays in the pool until then too.
+ *
+ * Deletes move the last book into the hole (O(1)), so listing order is insertion order
+ * only until the first delete. There is no journal and no search, ISBN or sort index;
+ * use Library where those are needed.
+ */
+class ColumnarLibrary : public ItemManager {
+private:
+    // Private data members - ENCAPSULATION
+    char* ids;                 // ID column, MAX_ID_LENGTH bytes per book
+    uint64_t* isbns;           // ISBN column, normalized ISBN-13s
+    uint32_t* titles;          // Text columns, handles into text
+    uint32_t* authors;
+    uint32_t* editions;
+    uint32_t* publications;
+    BookCategory* categories;  // Category column, one byte per book
+    StringPool* text;          // Characters of every text field; authors and the like interned
+    int capacity;              // Allocated rows per column
+    int count;                 // Current number of books
+    int categoryCounts[CATEGORY_COUNT]; // Books in each category
+    IdIndex idIndex;           // Hash index from ID to row
+
+public:
+    // Constructor
+    ColumnarLibrary(int initialCapacity = DEFAULT_LIBRARY_CAPACITY) : idIndex(this, &ColumnarLibrary::idAtRow) {
+        capacity = 0;
+        count = 0;
+        ids = nullptr;
+        isbns = nullptr;
+        titles = nullptr;
+        authors = nullptr;
+        editions = nullptr;
+        publications = nullptr;
+        categories = nullptr;
+        text = new StringPool();
+        memset(categoryCounts, 0, sizeof(categoryCounts));
+        resizeColumns(initialCapacity > 0 ? initialCapacity : DEFAULT_LIBRARY_CAPACITY);
+    }
+
+    // Destructor to free memory
+    virtual ~ColumnarLibrary() override {
+        delete[] ids;
+        delete[] isbns;
+        delete[] titles;
+        delete[] authors;
+        delete[] editions;
+        delete[] publications;
+        delete[] categories;
+        delete text;
+    }
+
+    // The library owns its columns and index, so it cannot be copied
+    ColumnarLibrary(const ColumnarLibrary&) = delete;
+    ColumnarLibrary& operator=(const ColumnarLibrary&) = delete;
+
+    // Implementation of virtual function - ABSTRACTION
+    virtual bool addItem(const LibraryItem& item) override {
+        // Check if item is a Book
+        const Book* bookItem = asBook(&item);
+        if (!bookItem) {
+            return false; // Not a Book
+        }
+
+        return addBook(*bookItem);
+    }
+
+    // Add a new book - specific implementation
+    // Returns false if the ID is empty or taken, or the text pool is full
+    bool addBook(const Book& book) {
+        // Validate book ID is not empty
+        if (book.getId()[0] == '\0') {
+            return false;
+        }
+        if (count >= capacity) {
+            resizeColumns(capacity * 2);
+        }
+
+        // Stage the ID in the next row; the index rejects duplicates in the probe that inserts it
+        char* idCell = ids + static_cast<size_t>(count) * MAX_ID_LENGTH;
+        strncpy(idCell, book.getId(), MAX_ID_LENGTH);
+        if (!idIndex.insert(idCell, count)) {
+            return false;
+        }
+
+        if (!storeFields(count, book)) {
+            idIndex.erase(idCell);
+            return false;
+        }
+        categoryCounts[categories[count]]++;
+        count++;
+        return true;
+    }
+
+    // Implementation of virtual functions - ABSTRACTION
+    // The columns grow at most once per batch
+    virtual int addItems(const LibraryItem* const* items, int itemCount, ItemOutcome* outcomes) override {
+        return putItems(items, itemCount, outcomes, false);
+    }
+
+    virtual int upsertItems(const LibraryItem* const* items, int itemCount, ItemOutcome* outcomes) override {
+        return putItems(items, itemCount, outcomes, true);
+    }
+
+    // The parameter is not named ids, which is the ID column
+    virtual int deleteItems(const char* const* deleteIds, int idCount, ItemOutcome* outcomes) override {
+        if (deleteIds == nullptr || idCount <= 0) {
+            for (int i = 0; outcomes != nullptr && i < idCount; i++) {
+                outcomes[i] = ITEM_INVALID;
+            }
+            return 0;
+        }
+        int deleted = 0;
+        for (int i = 0; i < idCount; i++) {
+            bool ok = deleteBook(deleteIds[i]);
+            if (ok) {
+                deleted++;
+            }
+            if (outcomes != nullptr) {
+                outcomes[i] = ok ? ITEM_DELETED : ITEM_NOT_FOUND;
+            }
+        }
+        return deleted;
+    }
+
+    // Find a book by ID - ENCAPSULATION (internal helper method)
+    int findBookById(const char* id) const {
+        // Validate ID is not null or empty
+        if (id == nullptr || id[0] == '\0') {
+            return -1;
+        }
+
+        return idIndex.find(id); // -1 if the book is not found
+    }
+
+    // Check if a book ID already exists
+    bool isIdDuplicate(const char* id) const {
+        return findBookById(id) != -1;
+    }
+
+    // Edit a book, keeping its ID
+    // Returns false if the book is not found or the text pool is full (book unchanged)
+    bool editBook(const char* id, const Book& updatedBook) {
+        int row = findBookById(id);
+        if (row == -1) {
+            return false; // Book not found
+        }
+        BookCategory oldCategory = categories[row];
+        if (!storeFields(row, updatedBook)) {
+            return false;
+        }
+        categoryCounts[oldCategory]--;
+        categoryCounts[categories[row]]++;
+        return true;
+    }
+
+    // Implementation of virtual function - ABSTRACTION
+    virtual bool deleteItem(const char* id) override {
+        return deleteBook(id);
+    }
+
+    // Delete a book - O(1), the last book takes the deleted row
+    bool deleteBook(const char* id) {
+        int row = findBookById(id);
+        if (row == -1) {
+            return false; // Book not found
+        }
+
+        idIndex.erase(ids + static_cast<size_t>(row) * MAX_ID_LENGTH);
+        categoryCounts[categories[row]]--;
+        int last = count - 1;
+        if (row != last) {
+            memcpy(ids + static_cast<size_t>(row) * MAX_ID_LENGTH, ids + static_cast<size_t>(last) * MAX_ID_LENGTH, MAX_ID_LENGTH);
+            isbns[row] = isbns[last];
+            titles[row] = titles[last];
+            authors[row] = authors[last];
+            editions[row] = editions[last];
+            publications[row] = publications[last];
+            categories[row] = categories[last];
+            idIndex.updateSlot(ids + static_cast<size_t>(row) * MAX_ID_LENGTH, row);
+        }
+        count--;
+        return true;
+    }
+
+    // Get a copy of a book by ID, assembled from the columns
+    // The text is copied into bookOut's pool (see Book::copyFrom), so the copy outlives
+    // compact(). Returns false if the book is not found or that pool is full.
+    bool getBookById(const char* id, Book& bookOut) const {
+        int row = findBookById(id);
+        if (row == -1) {
+            return false; // Book not found
+        }
+        Book view;
+        assembleBook(row, view);
+        return bookOut.copyFrom(view);
+    }
+
+    // Find the rows of the books in a category by scanning only the category column
+    // Writes at most maxResults rows and returns how many were written
+    int findBooksByCategory(BookCategory category, int* rowsOut, int maxResults) const {
+        int found = 0;
+        for (int row = 0; row < count && found < maxResults; row++) {
+            if (categories[row] == category) {
+                rowsOut[found++] = row;
+            }
+        }
+        return found;
+    }
+
+    // Get the number of books in a category (case-sensitive name), 0 for an unknown category
+    int getCountByCategory(const char* category) const {
+        BookCategory code = parseCategory(category);
+        return code != CATEGORY_NONE ? categoryCounts[code] : 0;
+    }
+
+    // Implementation of virtual function - ABSTRACTION
+    virtual void displayAllItems() const override {
+        displayAllBooks();
+    }
+
+    // Display all books - specific implementation
+    void displayAllBooks() const {
+        if (count == 0) {
+            cout << "No books available in the library." << endl;
+            return;
+        }
+
+        TableWriter table;
+        table.writeHeader();
+        Book book;
+        for (int row = 0; row < count; row++) {
+            assembleBook(row, book);
+            table.writeBook(book);
+        }
+    }
+
+    // Display books by category
+    void displayBooksByCategory(const char* category) const {
+        // Validate category is not null or empty
+        if (category == nullptr || strlen(category) == 0) {
+            cout << "Invalid category." << endl;
+            return;
+        }
+
+        BookCategory code = parseCategory(category);
+        TableWriter table;
+        table.writeHeader();
+        Book book;
+        for (int row = 0; row < count && code != CATEGORY_NONE; row++) {
+            if (categories[row] == code) {
+                assembleBook(row, book);
+                table.writeBook(book);
+            }
+        }
+        table.flush();
+        bool found = table.getRowCount() > 0;
+
+        if (!found) {
+            cout << "No books found in this category." << endl;
+        }
+    }
+
+    // Implementation of virtual function - ABSTRACTION
+    virtual bool displayItemById(const char* id) const override {
+        return displayBookById(id);
+    }
+
+    // Display a specific book by ID - specific implementation
+    bool displayBookById(const char* id) const {
+        int row = findBookById(id);
+        if (row == -1) {
+            return false;
+        }
+        Book view;
+        assembleBook(row, view);
+        view.displayDetails();
+        return true;
+    }
+
+    // Implementation of virtual function - ABSTRACTION
+    virtual int getItemCount() const override {
+        return getCount();
+    }
+
+    // Get the number of books - specific implementation
+    int getCount() const {
+        return count;
+    }
+
+    // Make room for at least the given number of books, e.g. before a bulk load
+    void reserve(int newCapacity) {
+        if (newCapacity > capacity) {
+            resizeColumns(newCapacity);
+        }
+        idIndex.reserve(newCapacity);
+    }
+
+    // Rebuild the text pool with only the text of current books
+    // Views of books taken earlier must not be read afterwards. Returns false, with the
+    // library unchanged, if the text no longer fits one pool.
+    bool compact() {
+        StringPool* compacted = new StringPool();
+        uint32_t* moved = new uint32_t[static_cast<size_t>(count > 0 ? count : 1) * 4];
+        bool ok = true;
+        for (int row = 0; ok && row < count; row++) {
+            uint32_t* cell = moved + static_cast<size_t>(row) * 4;
+            ok = compacted->copyFrom(*text, titles[row], false, cell[0]) &&
+                 compacted->copyFrom(*text, authors[row], true, cell[1]) &&
+                 compacted->copyFrom(*text, editions[row], true, cell[2]) &&
+                 compacted->copyFrom(*text, publications[row], true, cell[3]);
+        }
+        if (ok) {
+            for (int row = 0; row < count; row++) {
+                const uint32_t* cell = moved + static_cast<size_t>(row) * 4;
+                titles[row] = cell[0];
+                authors[row] = cell[1];
+                editions[row] = cell[2];
+                publications[row] = cell[3];
+            }
+            delete text;
+            text = compacted;
+        } else {
+            delete compacted;
+        }
+        delete[] moved;
+        return ok;
+    }
+
+private:
+    // Helper method to add or upsert a batch of items - ENCAPSULATION
+    int putItems(const LibraryItem* const* items, int itemCount, ItemOutcome* outcomes, bool replace) {
+        if (items == nullptr || itemCount <= 0) {
+            for (int i = 0; outcomes != nullptr && i < itemCount; i++) {
+                outcomes[i] = ITEM_INVALID;
+            }
+            return 0;
+        }
+        if (count + itemCount > capacity) {
+            resizeColumns(count + itemCount > capacity * 2 ? count + itemCount : capacity * 2);
+        }
+        int applied = 0;
+        for (int i = 0; i < itemCount; i++) {
+            const Book* book = asBook(items[i]);
+            ItemOutcome outcome = ITEM_INVALID;
+            if (book != nullptr && book->getId()[0] != '\0') {
+                if (replace && findBookById(book->getId()) != -1) {
+                    outcome = editBook(book->getId(), *book) ? ITEM_UPDATED : ITEM_FAILED;
+                } else if (addBook(*book)) {
+                    outcome = ITEM_ADDED;
+                } else {
+                    // A rejected add leaves the ID unindexed unless another book holds it
+                    outcome = findBookById(book->getId()) != -1 ? ITEM_DUPLICATE : ITEM_FAILED;
+                }
+            }
+            if (outcome == ITEM_ADDED || outcome == ITEM_UPDATED) {
+                applied++;
+            }
+            if (outcomes != nullptr) {
+                outcomes[i] = outcome;
+            }
+        }
+        return applied;
+    }
+
+    // Helper method to write every field except the ID into a row - ENCAPSULATION
+    // The text is copied into the pool first, so a full pool leaves the row unchanged
+    bool storeFields(int row, const Book& book) {
+        BookPatch fields;
+        book.toPatch(fields);
+        if (!fields.moveTextTo(*text)) {
+            return false;
+        }
+        isbns[row] = fields.isbn;
+        titles[row] = fields.title;
+        authors[row] = fields.author;
+        editions[row] = fields.edition;
+        publications[row] = fields.publication;
+        categories[row] = fields.category;
+        return true;
+    }
+
+    // Helper method to assemble a view of a row - ENCAPSULATION
+    // The view is bound to the pool and takes its handles as they are, so no text is copied
+    void assembleBook(int row, Book& book) const {
+        BookPatch fields(*text);
+        fields.fields = BookPatch::ALL_FIELDS;
+        fields.category = categories[row];
+        fields.isbn = isbns[row];
+        fields.title = titles[row];
+        fields.author = authors[row];
+        fields.edition = editions[row];
+        fields.publication = publications[row];
+        book = Book(*text);
+        book.setId(ids + static_cast<size_t>(row) * MAX_ID_LENGTH);
+        book.applyPatch(fields);
+    }
+
+    // Helper method to reallocate every column to a new capacity - ENCAPSULATION
+    void resizeColumns(int newCapacity) {
+        resizeColumn(ids, static_cast<size_t>(count) * MAX_ID_LENGTH, static_cast<size_t>(newCapacity) * MAX_ID_LENGTH);
+        resizeColumn(isbns, count, newCapacity);
+        resizeColumn(titles, count, newCapacity);
+        resizeColumn(authors, count, newCapacity);
+        resizeColumn(editions, count, newCapacity);
+        resizeColumn(publications, count, newCapacity);
+        resizeColumn(categories, count, newCapacity);
+        capacity = newCapacity;
+    }
+
+    template <typename T>
+    static void resizeColumn(T*& column, size_t used, size_t newSize) {
+        T* resized = new T[newSize];
+        if (used > 0) {
+            memcpy(resized, column, used * sizeof(T));
+        }
+        delete[] column;
+        column = resized;
+    }
+
+    // Key accessor handed to idIndex - resolves a row to its ID cell
+    static const char* idAtRow(const void* owner, int row) {
+        return static_cast<const ColumnarLibrary*>(owner)->ids + static_cast<size_t>(row) * MAX_ID_LENGTH;
+    }
+};
+
+/**
+ * ConcurrentLibrary class - implements ItemManager for use from many threads at once
+ * Books are spread over SHARD_COUNT Library shards by a hash of their ID, and each shard
+ * has its own reader-writer lock. Lookups and displays take the lock shared, so any number
+ * of them run in parallel; adds, edits and deletes take it exclusively, so a writer only
+ * waits for work on its own shard. At most one shard lock is held at a time.
+ * Readers look a book up in place with visitBookById; getBookById copies it out, and never
+ * touches the shared bookFieldPool() while holding a shard lock.
+ *
+ * Whole-catalogue operations (counts, listings) visit the shards one after another, so they
+ * see each shard at a consistent point but not the whole catalogue at a single instant.
+ * Listings walk a CatalogSnapshot of each shard and hold no lock while they print.
+ * They are grouped by shard rather than in insertion order. Shards do not journal.
+ */
+class ConcurrentLibrary : public ItemManager {
+public:
+    static const int SHARD_BITS = 4;
+    static const int SHARD_COUNT = 1 << SHARD_BITS;
+
+private:
+    struct Shard {
+        Library library;
+        mutable shared_mutex lock;
+    };
+
+    // Private data members - ENCAPSULATION
+    Shard shards[SHARD_COUNT];
+
+public:
+    // Constructor
+    ConcurrentLibrary(int initialCapacity = DEFAULT_LIBRARY_CAPACITY) {
+        if (initialCapacity > DEFAULT_LIBRARY_CAPACITY * SHARD_COUNT) {
+            reserve(initialCapacity);
+        }
+        for (int s = 0; s < SHARD_COUNT; s++) {
+            shards[s].library.enableSnapshots();
+        }
+    }
+
+    // The shards own their books and locks, so the library cannot be copied
+    ConcurrentLibrary(const ConcurrentLibrary&) = delete;
+    ConcurrentLibrary& operator=(const ConcurrentLibrary&) = delete;
+
+    // Implementation of virtual function - ABSTRACTION
+    virtual bool addItem(const LibraryItem& item) override {
+        // Check if item is a Book
+        const Book* bookItem = asBook(&item);
+        if (!bookItem) {
+            return false; // Not a Book
+        }
+
+        return addBook(*bookItem);
+    }
+
+    // Add a new book - specific implementation
+    bool addBook(const Book& book) {
+        Shard& shard = shardFor(book.getId());
+        unique_lock<shared_mutex> guard(shard.lock);
+        return shard.library.addBook(book);
+    }
+
+    // Implementation of virtual functions - ABSTRACTION
+    // The batch is split by shard and each shard takes its share in one locked bulk call,
+    // so a shard's lock is taken once per batch rather than once per item
+    virtual int addItems(const LibraryItem* const* items, int itemCount, ItemOutcome* outcomes) override {
+        return putItems(items, itemCount, outcomes, false);
+    }
+
+    virtual int upsertItems(const LibraryItem* const* items, int itemCount, ItemOutcome* outcomes) override {
+        return putItems(items, itemCount, outcomes, true);
+    }
+
+    virtual int deleteItems(const char* const* ids, int idCount, ItemOutcome* outcomes) override {
+        if (ids == nullptr || idCount <= 0) {
+            for (int i = 0; outcomes != nullptr && i < idCount; i++) {
+                outcomes[i] = ITEM_INVALID;
+            }
+            return 0;
+        }
+        int* shardOf = new int[idCount];
+        for (int i = 0; i < idCount; i++) {
+            shardOf[i] = ids[i] != nullptr ? shardIndex(ids[i]) : -1;
+            if (shardOf[i] == -1 && outcomes != nullptr) {
+                outcomes[i] = ITEM_NOT_FOUND;
+            }
+        }
+
+        const char** routed = new const char*[idCount];
+        int* positions = new int[idCount];
+        ItemOutcome* routedOutcomes = new ItemOutcome[idCount];
+        int deleted = 0;
+        for (int s = 0; s < SHARD_COUNT; s++) {
+            int routedCount = gatherShard(s, shardOf, idCount, positions);
+            if (routedCount == 0) {
+                continue;
+            }
+            for (int k = 0; k < routedCount; k++) {
+                routed[k] = ids[positions[k]];
+            }
+            {
+                unique_lock<shared_mutex> guard(shards[s].lock);
+                deleted += shards[s].library.deleteBooks(routed, routedCount, routedOutcomes);
+            }
+            scatterOutcomes(routedOutcomes, positions, routedCount, outcomes);
+        }
+        delete[] routed;
+        delete[] positions;
+        delete[] routedOutcomes;
+        delete[] shardOf;
+        return deleted;
+    }
+
+    // Edit a book, keeping its ID
+    bool editBook(const char* id, const Book& updatedBook) {
+        if (id == nullptr) {
+            return false;
+        }
+        Shard& shard = shardFor(id);
+        unique_lock<shared_mutex> guard(shard.lock);
+        return shard.library.editBook(id, updatedBook);
+    }
+
+    // Change only the fields set in a patch, see Library::patchBook
+    bool patchBook(const char* id, const BookPatch& patch) {
+        if (id == nullptr) {
+            return false;
+        }
+        Shard& shard = shardFor(id);
+        unique_lock<shared_mutex> guard(shard.lock);
+        return shard.library.patchBook(id, patch);
+    }
+
+    // Implementation of virtual function - ABSTRACTION
+    virtual bool deleteItem(const char* id) override {
+        return deleteBook(id);
+    }
+
+    // Delete a book - specific implementation
+    bool deleteBook(const char* id) {
+        if (id == nullptr) {
+            return false;
+        }
+        Shard& shard = shardFor(id);
+        unique_lock<shared_mutex> guard(shard.lock);
+        return shard.library.deleteBook(id);
+    }
+
+    // Check if a book ID already exists
+    bool isIdDuplicate(const char* id) const {
+        if (id == nullptr) {
+            return false;
+        }
+        const Shard& shard = shardFor(id);
+        shared_lock<shared_mutex> guard(shard.lock);
+        return shard.library.isIdDuplicate(id);
+    }
+
+    // Visit a book by ID in place, under the shard's read lock, without copying it
+    // The visitor must not keep the reference or call back into this library. Readers
+    // on many threads should look books up this way: nothing is copied, and the only
+    // lock taken is the shared lock of one shard. Returns false if there is no such book.
+    bool visitBookById(const char* id, BookVisitor visit, void* context) const {
+        if (id == nullptr || visit == nullptr) {
+            return false;
+        }
+        const Shard& shard = shardFor(id);
+        shared_lock<shared_mutex> guard(shard.lock);
+        const Book* book = shard.library.viewBookById(id);
+        if (book == nullptr) {
+            return false;
+        }
+        visit(*book, context);
+        return true;
+    }
+
+    // Get a copy of a book by ID, its text copied into bookOut's pool
+    // Readers on many threads should bind bookOut to a pool of their own (Book(StringPool&)):
+    // a book on bookFieldPool() is still filled, through a staging pool (see
+    // fetchThroughStaging), but every such copy waits on that pool's one lock. Returns false
+    // if the book is not found or the pool is full, as Library::getBookById does.
+    bool getBookById(const char* id, Book& bookOut) const {
+        if (id == nullptr) {
+            return false;
+        }
+        if (onSharedPool(bookOut)) {
+            return fetchThroughStaging(bookOut, [this, id](Book& staged) { return getBookById(id, staged); });
+        }
+        const Shard& shard = shardFor(id);
+        shared_lock<shared_mutex> guard(shard.lock);
+        return shard.library.getBookById(id, bookOut);
+    }
+
+    // Get a copy of a book by its normalized ISBN, into a pool of the caller's as with getBookById
+    // Copies of a title may sit in any shard, so the shards are asked in turn
+    bool getBookByIsbn(uint64_t isbn, Book& bookOut) const {
+        if (onSharedPool(bookOut)) {
+            return fetchThroughStaging(bookOut, [this, isbn](Book& staged) { return getBookByIsbn(isbn, staged); });
+        }
+        for (int s = 0; s < SHARD_COUNT; s++) {
+            shared_lock<shared_mutex> guard(shards[s].lock);
+            if (shards[s].library.getBookByIsbn(isbn, bookOut)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Implementation of virtual function - ABSTRACTION
+    virtual bool displayItemById(const char* id) const override {
+        return displayBookById(id);
+    }
+
+    // Display a specific book by ID - specific implementation
+    // The book is displayed in place under the shard's read lock, without copying it out
+    bool displayBookById(const char* id) const {
+        if (id == nullptr) {
+            return false;
+        }
+        const Shard& shard = shardFor(id);
+        shared_lock<shared_mutex> guard(shard.lock);
+        const Book* book = shard.library.viewBookById(id);
+        if (book != nullptr) {
+            book->displayDetails();
+            return true;
+        }
+        return false;
+    }
+
+    // Implementation of virtual function - ABSTRACTION
+    virtual void displayAllItems() const override {
+        displayAllBooks();
+    }
+
+    // Display all books - specific implementation
+    void displayAllBooks() const {
+        if (getCount() == 0) {
+            cout << "No books available in the library." << endl;
+            return;
+        }
+
+        TableWriter table;
+        table.writeHeader();
+        forEachBook(&ConcurrentLibrary::displayRow, &table);
+    }
+
+    // Display books by category
+    void displayBooksByCategory(const char* category) const {
+        // Validate category is not null or empty
+        if (category == nullptr || strlen(category) == 0) {
+            cout << "Invalid category." << endl;
+            return;
+        }
+
+        BookCategory code = parseCategory(category);
+        TableWriter table;
+        table.writeHeader();
+        if (code != CATEGORY_NONE) {
+            shared_ptr<const CatalogSnapshot> versions[SHARD_COUNT];
+            takeSnapshots(versions);
+            for (int s = 0; s < SHARD_COUNT; s++) {
+                versions[s]->forEachBookInCategory(code, &ConcurrentLibrary::displayRow, &table);
+            }
+        }
+        table.flush();
+        bool found = table.getRowCount() > 0;
+
+        if (!found) {
+            cout << "No books found in this category." << endl;
+        }
+    }
+
+    // Visit every book, shard by shard, until the visitor returns false
+    // Walks snapshots taken up front, so no lock is held while visiting and writers are
+    // never blocked, however long the visitor takes
+    void forEachBook(BookVisitor visit, void* context) const {
+        shared_ptr<const CatalogSnapshot> versions[SHARD_COUNT];
+        takeSnapshots(versions);
+        bool keepGoing = true;
+        for (int s = 0; s < SHARD_COUNT && keepGoing; s++) {
+            VisitState state = {visit, context, true};
+            versions[s]->forEachBook(&ConcurrentLibrary::forwardVisit, &state);
+            keepGoing = state.keepGoing;
+        }
+    }
+
+    // Get the number of books in a category (case-sensitive name), 0 for an unknown category
+    int getCountByCategory(const char* category) const {
+        int total = 0;
+        for (int s = 0; s < SHARD_COUNT; s++) {
+            shared_lock<shared_mutex> guard(shards[s].lock);
+            total += shards[s].library.getCountByCategory(category);
+        }
+        return total;
+    }
+
+    // Implementation of virtual function - ABSTRACTION
+    virtual int getItemCount() const override {
+        return getCount();
+    }
+
+    // Get the number of books - specific implementation
+    int getCount() const {
+        int total = 0;
+        for (int s = 0; s < SHARD_COUNT; s++) {
+            shared_lock<shared_mutex> guard(shards[s].lock);
+            total += shards[s].library.getCount();
+        }
+        return total;
+    }
+
+    // Make room for at least the given number of books across all shards
+    void reserve(int newCapacity) {
+        int perShard = newCapacity / SHARD_COUNT + 1;
+        for (int s = 0; s < SHARD_COUNT; s++) {
+            unique_lock<shared_mutex> guard(shards[s].lock);
+            shards[s].library.reserve(perShard);
+        }
+    }
+
+    // Set how every shard fills the slot of a deleted book
+    void setDeleteOrder(Library::DeleteOrder order) {
+        for (int s = 0; s < SHARD_COUNT; s++) {
+            unique_lock<shared_mutex> guard(shards[s].lock);
+            shards[s].library.setDeleteOrder(order);
+        }
+    }
+
+private:
+    // Helper method to pick the shard that owns an ID - ENCAPSULATION
+    // Uses the top bits of the hash: each shard's IdIndex buckets on the low bits, which
+    // would otherwise be the same for every ID in a shard
+    static int shardIndex(const char* id) {
+        return static_cast<int>(IdIndex::hashId(id) >> (32 - SHARD_BITS));
+    }
+
+    Shard& shardFor(const char* id) {
+        return shards[shardIndex(id)];
+    }
+
+    const Shard& shardFor(const char* id) const {
+        return shards[shardIndex(id)];
+    }
+
+    // Helper method to check whether a copy-out target is bound to the shared bookFieldPool() - ENCAPSULATION
+    static bool onSharedPool(const Book& bookOut) {
+        return &bookOut.getTextPool() == &bookFieldPool();
+    }
+
+    // Helper method to fetch a book into bookOut on the shared pool - ENCAPSULATION
+    // fetch copies the book, under the shard locks, into a pool of the calling thread's;
+    // only then, with no shard lock held, is it copied on into the shared pool, so a reader
+    // waiting for that pool's lock never holds up a writer of the shard.
+    template <typename Fetch>
+    static bool fetchThroughStaging(Book& bookOut, Fetch fetch) {
+        static thread_local StringPool staging;
+        Book staged(staging);
+        bool copied = fetch(staged) && bookOut.copyFrom(staged);
+        staging.clear();
+        return copied;
+    }
+
+    // Helper method to list, in batch order, the positions of the items routed to a shard - ENCAPSULATION
+    static int gatherShard(int shard, const int* shardOf, int itemCount, int* positions) {
+        int routedCount = 0;
+        for (int i = 0; i < itemCount; i++) {
+            if (shardOf[i] == shard) {
+                positions[routedCount++] = i;
+            }
+        }
+        return routedCount;
+    }
+
+    // Helper method to copy a shard's outcomes back to the batch positions they came from - ENCAPSULATION
+    static void scatterOutcomes(const ItemOutcome* routedOutcomes, const int* positions, int routedCount, ItemOutcome* outcomes) {
+        if (outcomes == nullptr) {
+            return;
+        }
+        for (int k = 0; k < routedCount; k++) {
+            outcomes[positions[k]] = routedOutcomes[k];
+        }
+    }
+
+    // Helper method to add or upsert a batch of items shard by shard - ENCAPSULATION
+    int putItems(const LibraryItem* const* items, int itemCount, ItemOutcome* outcomes, bool replace) {
+        if (items == nullptr || itemCount <= 0) {
+            for (int i = 0; outcomes != nullptr && i < itemCount; i++) {
+                outcomes[i] = ITEM_INVALID;
+            }
+            return 0;
+        }
+        // Check each item is a Book once, up front
+        const Book** booksIn = new const Book*[itemCount];
+        int* shardOf = new int[itemCount];
+        for (int i = 0; i < itemCount; i++) {
+            booksIn[i] = asBook(items[i]);
+            shardOf[i] = booksIn[i] != nullptr ? shardIndex(booksIn[i]->getId()) : -1;
+            if (shardOf[i] == -1 && outcomes != nullptr) {
+                outcomes[i] = ITEM_INVALID;
+            }
+        }
+
+        const Book** routed = new const Book*[itemCount];
+        int* positions = new int[itemCount];
+        ItemOutcome* routedOutcomes = new ItemOutcome[itemCount];
+        int applied = 0;
+        for (int s = 0; s < SHARD_COUNT; s++) {
+            int routedCount = gatherShard(s, shardOf, itemCount, positions);
+            if (routedCount == 0) {
+                continue;
+            }
+            for (int k = 0; k < routedCount; k++) {
+                routed[k] = booksIn[positions[k]];
+            }
+            {
+                unique_lock<shared_mutex> guard(shards[s].lock);
+                applied += replace ? shards[s].library.upsertBooks(routed, routedCount, routedOutcomes)
+                                   : shards[s].library.addBooks(routed, routedCount, routedOutcomes);
+            }
+            scatterOutcomes(routedOutcomes, positions, routedCount, outcomes);
+        }
+        delete[] booksIn;
+        delete[] shardOf;
+        delete[] routed;
+        delete[] positions;
+        delete[] routedOutcomes;
+        return applied;
+    }
+
+    // Context for forwardVisit - the caller's visitor and whether it asked to stop
+    struct VisitState {
+        BookVisitor visit;
+        void* context;
+        bool keepGoing;
+    };
+
+    // Helper method to pin the current version of every shard - ENCAPSULATION
+    // Each shard lock is held only while its version is published, which is O(1) per shard
+    void takeSnapshots(shared_ptr<const CatalogSnapshot>* versions) const {
+        for (int s = 0; s < SHARD_COUNT; s++) {
+            shared_lock<shared_mutex> guard(shards[s].lock);
+            versions[s] = shards[s].library.snapshot();
+        }
+    }
+
+    // Visitor that passes each book on and remembers when the caller's visitor stops
+    static bool forwardVisit(const Book& book, void* state) {
+        VisitState* visitState = static_cast<VisitState*>(state);
+        visitState->keepGoing = visitState->visit(book, visitState->context);
+        return visitState->keepGoing;
+    }
+
+    // Visitor used by the display methods - adds one book to a TableWriter
+    static bool displayRow(const Book& book, void* table) {
+        static_cast<TableWriter*>(table)->writeBook(book);
+        return true;
+    }
+};
+
+/**
+ * CirculationResult enum - outcome of a checkout, return or hold
+ */
+enum CirculationResult : unsigned char {
+    CIRC_OK,
+    CIRC_NO_SUCH_COPY, // No book has the ID (or, for a hold, the ISBN)
+    CIRC_BAD_PATRON,   // Patron number is negative or not below the patron limit
+    CIRC_BAD_DUE_DAY,  // Due day 0 is reserved
+    CIRC_ON_LOAN,      // The copy is lent out already
+    CIRC_ON_HOLD,      // The copy is held for another patron
+    CIRC_NOT_ON_LOAN,  // The returned copy was not lent out
+    CIRC_LOAN_LIMIT,   // The patron has as many loans as allowed
+    CIRC_NO_HOLD,      // The patron has no hold on the title to cancel
+    CIRC_DUPLICATE_HOLD // The patron already has a hold on the title, queued or on the shelf
+};
+
+/**
+ * Circulation class - loans and holds for the copies in a Library
+ * Only copies off the shelf have state: a record per lent or held copy, keyed by book ID
+ * in an IdIndex, with the borrower (or the patron a returned copy is held for), the due
+ * day and the copy's ISBN. Records are recycled through a free list, and because they are
+ * keyed by ID, loans survive the library being cleared or reloaded, and a copy can be
+ * returned after its book has been deleted. Patrons are dense numbers 0, 1, 2, ... (the
+ * PatronRegistry numbers) below a patron limit, each with the head and length of its loan
+ * list and a count of its holds; the state array grows to the highest number seen, so the
+ * limit keeps a mistyped number from allocating state for patrons that do not exist.
+ * Holds queue FIFO per ISBN: a hash table maps the ISBN to the two ends of a doubly linked
+ * list of hold records, which are recycled through a free list. A patron has at most one
+ * hold per title, and a second hash table maps each (ISBN, patron) pair to that hold, or
+ * to the copy held for the patron once one comes back. Checkout, return, placing a hold
+ * and cancelling one are each a few lookups and link changes, so each is O(1).
+ *
+ * Days are whole day numbers chosen by the caller (e.g. days since 1970-01-01). A hold
+ * waits for the next copy of its title to be returned; a copy already on the shelf is
+ * simply checked out. A returned copy is held for its patron until a pickup deadline a
+ * fixed number of days after the current day. Held copies sit on a hold shelf list in
+ * deadline order, so when setCurrentDay moves past deadlines it takes expired copies off
+ * the front and passes each to the next patron waiting for its title, or back to the shelf.
+ */
+class Circulation {
+public:
+    // Callback for forEachLoan; returning false stops the walk
+    typedef bool (*LoanVisitor)(const char* bookId, uint32_t dueDay, void* context);
+
+private:
+    struct CopyState {
+        char bookId[MAX_ID_LENGTH]; // Key in idIndex
+        uint64_t isbn;      // ISBN of the copy when it left the shelf, 0 if it had none
+        int patron;         // Borrower, or the patron a held copy waits for
+        uint32_t dueDay;    // Day the loan is due; 0 while the copy is held rather than lent
+        uint32_t holdUntil; // Last day a held copy waits for its patron
+        int next;           // Neighbouring records in the borrower's loan list, or on the hold
+        int prev;           // shelf while held, -1 at the ends; next also chains free records
+    };
+
+    struct PatronState {
+        int firstLoan;   // Record of the newest loan, -1 with no loans
+        int loanCount;
+        int holdCount;   // Holds queued plus copies held for the patron
+    };
+
+    struct HoldQueue {
+        uint64_t isbn;   // 0 marks a free bucket
+        int first;       // Oldest hold, -1 when nobody is waiting
+        int last;        // Newest hold
+        int waiting;     // Holds in the queue
+    };
+
+    struct Hold {
+        int patron;
+        int next;        // Next hold in the queue or the free list, -1 at the end
+        int prev;        // Previous hold in the queue, -1 at the front
+    };
+
+    struct HoldEntry {
+        uint64_t isbn;   // 0 marks a free bucket
+        int patron;
+        int record;      // Hold record while queued, copy record once a copy is held for the patron
+        bool onShelf;    // record is a copy on the hold shelf
+    };
+
+    static const int MIN_CAPACITY = 16;
+
+    // Private data members - ENCAPSULATION
+    const Library& library;
+    int loanLimit;              // Most loans one patron may have at a time
+    int patronLimit;            // Patron numbers must be below this
+    uint32_t pickupDays;        // Days a held copy waits for its patron
+    uint32_t today;             // Current day, from setCurrentDay
+    CopyState* copies;          // Records of the copies off the shelf, and free records
+    int copyCapacity;
+    int copyUsed;               // Records ever handed out; those above are untouched
+    int freeCopy;               // First free record below copyUsed, -1 if none
+    IdIndex idIndex;            // Hash index from book ID to its record
+    int heldFirst;              // Hold shelf, earliest deadline first; -1 when empty
+    int heldLast;
+    PatronState* patrons;       // Loans and holds of each patron number
+    int patronCapacity;
+    HoldQueue* queues;          // Hold queue of each ISBN, size is always a power of two
+    int queueBuckets;
+    int queueCount;             // ISBNs that have had a hold
+    Hold* holds;                // Hold records, queued or free
+    int holdCapacity;
+    int freeHold;               // First free hold record, -1 when all are in use
+    HoldEntry* holdEntries;     // Each patron's hold on each title, size is always a power of two
+    int entryBuckets;
+    int entryCount;
+
+public:
+    // Constructor
+    Circulation(const Library& catalogue, int maxLoans = DEFAULT_LOAN_LIMIT, int holdDays = DEFAULT_PICKUP_DAYS,
+                int maxPatrons = DEFAULT_PATRON_LIMIT)
+        : library(catalogue), idIndex(this, &Circulation::idAtCopy) {
+        loanLimit = maxLoans > 0 ? maxLoans : DEFAULT_LOAN_LIMIT;
+        patronLimit = DEFAULT_PATRON_LIMIT;
+        setPatronLimit(maxPatrons);
+        pickupDays = static_cast<uint32_t>(holdDays > 0 ? holdDays : DEFAULT_PICKUP_DAYS);
+        today = 0;
+        copyCapacity = MIN_CAPACITY;
+        copies = new CopyState[copyCapacity];
+        copyUsed = 0;
+        freeCopy = -1;
+        heldFirst = -1;
+        heldLast = -1;
+        patronCapacity = MIN_CAPACITY;
+        patrons = new PatronState[patronCapacity];
+        resetPatrons(0);
+        queueBuckets = MIN_CAPACITY;
+        queueCount = 0;
+        queues = new HoldQueue[queueBuckets]();
+        holdCapacity = 0;
+        holds = nullptr;
+        freeHold = -1;
+        entryBuckets = MIN_CAPACITY;
+        entryCount = 0;
+        holdEntries = new HoldEntry[entryBuckets]();
+    }
+
+    // Destructor to free memory
+    ~Circulation() {
+        delete[] copies;
+        delete[] patrons;
+        delete[] queues;
+        delete[] holds;
+        delete[] holdEntries;
+    }
+
+    // The circulation state owns its arrays, so it cannot be copied
+    Circulation(const Circulation&) = delete;
+    Circulation& operator=(const Circulation&) = delete;
+
+    // Lend a copy to a patron until a due day
+    // A copy held for a patron can only be checked out by that patron, which ends the hold
+    CirculationResult checkout(const char* bookId, int patron, uint32_t dueDay) {
+        if (patron < 0 || patron >= patronLimit) {
+            return CIRC_BAD_PATRON;
+        }
+        if (dueDay == 0) {
+            return CIRC_BAD_DUE_DAY;
+        }
+        const Book* book = library.viewBookById(bookId);
+        if (book == nullptr) {
+            return CIRC_NO_SUCH_COPY;
+        }
+        ensurePatrons(patron + 1);
+        PatronState& borrower = patrons[patron];
+
+        int record = idIndex.find(bookId);
+        if (record != -1) {
+            CopyState& held = copies[record];
+            if (held.dueDay != 0) {
+                return CIRC_ON_LOAN;
+            }
+            if (held.patron != patron) {
+                return CIRC_ON_HOLD;
+            }
+            if (borrower.loanCount >= loanLimit) {
+                return CIRC_LOAN_LIMIT;
+            }
+            // The patron collects the copy held for them
+            unlinkHeld(record);
+            eraseEntry(findEntry(held.isbn, patron));
+            borrower.holdCount--;
+        } else {
+            if (borrower.loanCount >= loanLimit) {
+                return CIRC_LOAN_LIMIT;
+            }
+            record = allocateCopy();
+            CopyState& taken = copies[record];
+            memcpy(taken.bookId, book->getId(), MAX_ID_LENGTH);
+            taken.isbn = book->getIsbn();
+            idIndex.insert(taken.bookId, record);
+        }
+
+        // Push the copy onto the front of the borrower's loan list
+        CopyState& copy = copies[record];
+        copy.patron = patron;
+        copy.dueDay = dueDay;
+        copy.holdUntil = 0;
+        copy.prev = -1;
+        copy.next = borrower.firstLoan;
+        if (borrower.firstLoan != -1) {
+            copies[borrower.firstLoan].prev = record;
+        }
+        borrower.firstLoan = record;
+        borrower.loanCount++;
+        return CIRC_OK;
+    }
+
+    // Take back a lent copy by its book ID; works after the book has been deleted from the library
+    // If a patron is waiting for the title, the copy is held for the first of them and
+    // holdPatronOut is set to that patron; otherwise it goes back on the shelf and holdPatronOut is -1
+    CirculationResult returnCopy(const char* bookId, int& holdPatronOut) {
+        holdPatronOut = -1;
+        int record = bookId != nullptr && bookId[0] != '\0' ? idIndex.find(bookId) : -1;
+        if (record == -1) {
+            return library.viewBookById(bookId) != nullptr ? CIRC_NOT_ON_LOAN : CIRC_NO_SUCH_COPY;
+        }
+        if (copies[record].dueDay == 0) {
+            return CIRC_NOT_ON_LOAN;
+        }
+
+        // Unlink the copy from the borrower's loan list
+        CopyState& copy = copies[record];
+        PatronState& borrower = patrons[copy.patron];
+        if (copy.prev != -1) {
+            copies[copy.prev].next = copy.next;
+        } else {
+            borrower.firstLoan = copy.next;
+        }
+        if (copy.next != -1) {
+            copies[copy.next].prev = copy.prev;
+        }
+        borrower.loanCount--;
+        copy.dueDay = 0;
+
+        holdPatronOut = passToNextHold(record);
+        return CIRC_OK;
+    }
+
+    // Queue a patron for the next returned copy of a title
+    // A patron may hold a title once: a second hold while the first is queued, or while a
+    // copy is held for them, is CIRC_DUPLICATE_HOLD
+    CirculationResult placeHold(uint64_t isbn, int patron) {
+        if (patron < 0 || patron >= patronLimit) {
+            return CIRC_BAD_PATRON;
+        }
+        if (isbn == 0 || library.viewBookByIsbn(isbn) == nullptr) {
+            return CIRC_NO_SUCH_COPY;
+        }
+        if ((entryCount + 1) * 10 > entryBuckets * 7) {
+            rehashEntries(entryBuckets * 2);
+        }
+        int entry = findEntry(isbn, patron);
+        if (holdEntries[entry].isbn != 0) {
+            return CIRC_DUPLICATE_HOLD;
+        }
+
+        if ((queueCount + 1) * 10 > queueBuckets * 7) {
+            rehashQueues(queueBuckets * 2);
+        }
+        int hold = allocateHold();
+        holds[hold].patron = patron;
+        holds[hold].next = -1;
+
+        HoldQueue& queue = queues[findQueue(isbn)];
+        if (queue.isbn == 0) {
+            queue.isbn = isbn;
+            queue.first = -1;
+            queue.waiting = 0;
+            queueCount++;
+        }
+        holds[hold].prev = queue.first == -1 ? -1 : queue.last;
+        if (queue.first == -1) {
+            queue.first = hold;
+        } else {
+            holds[queue.last].next = hold;
+        }
+        queue.last = hold;
+        queue.waiting++;
+        holdEntries[entry].isbn = isbn;
+        holdEntries[entry].patron = patron;
+        holdEntries[entry].record = hold;
+        holdEntries[entry].onShelf = false;
+        entryCount++;
+        ensurePatrons(patron + 1);
+        patrons[patron].holdCount++;
+        return CIRC_OK;
+    }
+
+    // Withdraw a patron's hold on a title
+    // A queued hold leaves the queue; a copy already held for the patron is released to the
+    // next patron waiting or back to the shelf
+    CirculationResult cancelHold(uint64_t isbn, int patron) {
+        if (patron < 0) {
+            return CIRC_BAD_PATRON;
+        }
+        int entry = isbn != 0 ? findEntry(isbn, patron) : -1;
+        if (entry == -1 || holdEntries[entry].isbn == 0) {
+            return CIRC_NO_HOLD;
+        }
+        int record = holdEntries[entry].record;
+        bool onShelf = holdEntries[entry].onShelf;
+        eraseEntry(entry);
+        patrons[patron].holdCount--;
+        if (onShelf) {
+            unlinkHeld(record);
+            passToNextHold(record);
+            return CIRC_OK;
+        }
+
+        // Unlink the hold from its queue
+        HoldQueue& queue = queues[findQueue(isbn)];
+        Hold& hold = holds[record];
+        if (hold.prev != -1) {
+            holds[hold.prev].next = hold.next;
+        } else {
+            queue.first = hold.next;
+        }
+        if (hold.next != -1) {
+            holds[hold.next].prev = hold.prev;
+        } else {
+            queue.last = hold.prev;
+        }
+        queue.waiting--;
+        hold.next = freeHold;
+        freeHold = record;
+        return CIRC_OK;
+    }
+
+    // Move the current day forward; held copies whose pickup deadline has passed go to the
+    // next patron waiting for their title, or back on the shelf
+    // Returns the number of held copies that expired. A day before the current one is ignored.
+    int setCurrentDay(uint32_t day) {
+        if (day <= today) {
+            return 0;
+        }
+        today = day;
+        int expired = 0;
+        while (heldFirst != -1 && copies[heldFirst].holdUntil < today) {
+            int record = heldFirst;
+            unlinkHeld(record);
+            eraseEntry(findEntry(copies[record].isbn, copies[record].patron));
+            patrons[copies[record].patron].holdCount--;
+            passToNextHold(record);
+            expired++;
+        }
+        return expired;
+    }
+
+    // Get the current day
+    uint32_t getCurrentDay() const {
+        return today;
+    }
+
+    // Set the bound on patron numbers: checkouts and holds for a number not below it are
+    // CIRC_BAD_PATRON. An owner with a PatronRegistry can keep it at getNextNumber().
+    // Clamped to 1..MAX_PATRON_LIMIT; patrons above a lowered limit keep their loans and holds.
+    void setPatronLimit(int limit) {
+        patronLimit = limit < 1 ? 1 : (limit > MAX_PATRON_LIMIT ? MAX_PATRON_LIMIT : limit);
+    }
+
+    // Get the bound on patron numbers
+    int getPatronLimit() const {
+        return patronLimit;
+    }
+
+    // Get who has a copy: the borrower (dueDayOut set) or the patron it is held for (dueDayOut 0)
+    // Returns false if the copy is on the shelf or no copy has the ID
+    bool getCopyStatus(const char* bookId, int& patronOut, uint32_t& dueDayOut) const {
+        int record = bookId != nullptr && bookId[0] != '\0' ? idIndex.find(bookId) : -1;
+        if (record == -1) {
+            return false;
+        }
+        patronOut = copies[record].patron;
+        dueDayOut = copies[record].dueDay;
+        return true;
+    }
+
+    // Get the number of copies a patron has on loan
+    int getLoanCount(int patron) const {
+        return patron >= 0 && patron < patronCapacity ? patrons[patron].loanCount : 0;
+    }
+
+    // Get the number of holds a patron has, queued or waiting on the hold shelf
+    int getHoldCount(int patron) const {
+        return patron >= 0 && patron < patronCapacity ? patrons[patron].holdCount : 0;
+    }
+
+    // Get the number of patrons waiting for a title
+    int getWaitingCount(uint64_t isbn) const {
+        if (isbn == 0) {
+            return 0;
+        }
+        const HoldQueue& queue = queues[findQueue(isbn)];
+        return queue.isbn == isbn ? queue.waiting : 0;
+    }
+
+    // Visit a patron's loans, newest first, until the visitor returns false
+    // The visitor must not check out or return copies
+    void forEachLoan(int patron, LoanVisitor visit, void* context) const {
+        if (getLoanCount(patron) == 0) {
+            return;
+        }
+        for (int record = patrons[patron].firstLoan; record != -1; record = copies[record].next) {
+            if (!visit(copies[record].bookId, copies[record].dueDay, context)) {
+                return;
+            }
+        }
+    }
+
+    // Drop every loan and hold, keeping the allocated storage
+    void clear() {
+        idIndex.clear();
+        copyUsed = 0;
+        freeCopy = -1;
+        heldFirst = -1;
+        heldLast = -1;
+        resetPatrons(0);
+        memset(queues, 0, queueBuckets * sizeof(HoldQueue));
+        queueCount = 0;
+        freeHold = -1;
+        for (int i = holdCapacity - 1; i >= 0; i--) {
+            holds[i].next = freeHold;
+            freeHold = i;
+        }
+        memset(holdEntries, 0, entryBuckets * sizeof(HoldEntry));
+        entryCount = 0;
+    }
+
+private:
+    // Helper method to give a copy that has just come back to the first patron waiting for its title - ENCAPSULATION
+    // The copy goes on the hold shelf and that patron is returned; with nobody waiting its
+    // record is freed, putting it back on the shelf, and -1 is returned
+    int passToNextHold(int record) {
+        CopyState& copy = copies[record];
+        HoldQueue& queue = queues[findQueue(copy.isbn)];
+        if (copy.isbn == 0 || queue.isbn == 0 || queue.first == -1) {
+            idIndex.erase(copy.bookId);
+            copy.next = freeCopy;
+            freeCopy = record;
+            return -1;
+        }
+
+        int hold = queue.first;
+        queue.first = holds[hold].next;
+        if (queue.first == -1) {
+            queue.last = -1;
+        } else {
+            holds[queue.first].prev = -1;
+        }
+        queue.waiting--;
+        copy.patron = holds[hold].patron;
+        holds[hold].next = freeHold;
+        freeHold = hold;
+        HoldEntry& entry = holdEntries[findEntry(copy.isbn, copy.patron)];
+        entry.record = record;
+        entry.onShelf = true;
+
+        // The hold moves from the queue to the shelf, so the patron's hold count is unchanged;
+        // deadlines only grow, so appending keeps the shelf in deadline order
+        copy.dueDay = 0;
+        copy.holdUntil = today + pickupDays;
+        copy.next = -1;
+        copy.prev = heldLast;
+        if (heldLast != -1) {
+            copies[heldLast].next = record;
+        } else {
+            heldFirst = record;
+        }
+        heldLast = record;
+        return copy.patron;
+    }
+
+    // Helper method to take a held copy off the hold shelf list - ENCAPSULATION
+    void unlinkHeld(int record) {
+        CopyState& copy = copies[record];
+        if (copy.prev != -1) {
+            copies[copy.prev].next = copy.next;
+        } else {
+            heldFirst = copy.next;
+        }
+        if (copy.next != -1) {
+            copies[copy.next].prev = copy.prev;
+        } else {
+            heldLast = copy.prev;
+        }
+    }
+
+    // Helper method to take a copy record from the free list, growing the array when needed - ENCAPSULATION
+    int allocateCopy() {
+        if (freeCopy != -1) {
+            int record = freeCopy;
+            freeCopy = copies[record].next;
+            return record;
+        }
+        if (copyUsed == copyCapacity) {
+            CopyState* grown = new CopyState[copyCapacity * 2];
+            memcpy(grown, copies, copyCapacity * sizeof(CopyState));
+            delete[] copies;
+            copies = grown;
+            copyCapacity *= 2;
+        }
+        return copyUsed++;
+    }
+
+    // Helper method to grow the patron states to cover a patron count - ENCAPSULATION
+    void ensurePatrons(int count) {
+        if (count <= patronCapacity) {
+            return;
+        }
+        // Double until the count fits, stopping short of overflow
+        int oldCapacity = patronCapacity;
+        int newCapacity = patronCapacity;
+        while (newCapacity < count) {
+            newCapacity = newCapacity > numeric_limits<int>::max() / 2 ? count : newCapacity * 2;
+        }
+        PatronState* grown = new PatronState[newCapacity];
+        memcpy(grown, patrons, oldCapacity * sizeof(PatronState));
+        delete[] patrons;
+        patrons = grown;
+        patronCapacity = newCapacity;
+        resetPatrons(oldCapacity);
+    }
+
+    // Helper method to empty the states of the patrons from a number up - ENCAPSULATION
+    void resetPatrons(int from) {
+        for (int i = from; i < patronCapacity; i++) {
+            patrons[i].firstLoan = -1;
+            patrons[i].loanCount = 0;
+            patrons[i].holdCount = 0;
+        }
+    }
+
+    // Helper method to take a hold record from the free list, growing the pool when it is empty - ENCAPSULATION
+    int allocateHold() {
+        if (freeHold == -1) {
+            int newCapacity = holdCapacity > 0 ? holdCapacity * 2 : MIN_CAPACITY;
+            Hold* grown = new Hold[newCapacity];
+            if (holdCapacity > 0) {
+                memcpy(grown, holds, holdCapacity * sizeof(Hold));
+            }
+            for (int i = newCapacity - 1; i >= holdCapacity; i--) {
+                grown[i].next = freeHold;
+                freeHold = i;
+            }
+            delete[] holds;
+            holds = grown;
+            holdCapacity = newCapacity;
+        }
+        int hold = freeHold;
+        freeHold = holds[hold].next;
+        return hold;
+    }
+
+    // Helper method to find the bucket holding an ISBN's queue, or the free bucket where it would go - ENCAPSULATION
+    int findQueue(uint64_t isbn) const {
+        int mask = queueBuckets - 1;
+        int b = static_cast<int>(IsbnIndex::hashIsbn(isbn)) & mask;
+        while (queues[b].isbn != 0 && queues[b].isbn != isbn) {
+            b = (b + 1) & mask;
+        }
+        return b;
+    }
+
+    // Helper method to move every queue into a larger bucket array - ENCAPSULATION
+    void rehashQueues(int newBucketCount) {
+        HoldQueue* oldQueues = queues;
+        int oldCount = queueBuckets;
+
+        queueBuckets = newBucketCount;
+        queues = new HoldQueue[queueBuckets]();
+        for (int i = 0; i < oldCount; i++) {
+            if (oldQueues[i].isbn != 0) {
+                queues[findQueue(oldQueues[i].isbn)] = oldQueues[i];
+            }
+        }
+
+        delete[] oldQueues;
+    }
+
+    // Helper method to hash an (ISBN, patron) pair for holdEntries - ENCAPSULATION
+    static int hashEntry(uint64_t isbn, int patron) {
+        return static_cast<int>(IsbnIndex::hashIsbn(isbn ^ (static_cast<uint64_t>(patron) * 0x9e3779b97f4a7c15ULL)));
+    }
+
+    // Helper method to find the bucket holding a patron's hold on a title, or the free bucket where it would go - ENCAPSULATION
+    int findEntry(uint64_t isbn, int patron) const {
+        int mask = entryBuckets - 1;
+        int b = hashEntry(isbn, patron) & mask;
+        while (holdEntries[b].isbn != 0 && (holdEntries[b].isbn != isbn || holdEntries[b].patron != patron)) {
+            b = (b + 1) & mask;
+        }
+        return b;
+    }
+
+    // Helper method to remove the entry in a bucket, as IdIndex::erase does - ENCAPSULATION
+    void eraseEntry(int bucket) {
+        int mask = entryBuckets - 1;
+        int hole = bucket;
+        for (int next = (hole + 1) & mask; holdEntries[next].isbn != 0; next = (next + 1) & mask) {
+            int home = hashEntry(holdEntries[next].isbn, holdEntries[next].patron) & mask;
+            // Move the entry only if its home bucket is not inside (hole, next]
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                holdEntries[hole] = holdEntries[next];
+                hole = next;
+            }
+        }
+        holdEntries[hole].isbn = 0;
+        entryCount--;
+    }
+
+    // Helper method to move every hold entry into a larger bucket array - ENCAPSULATION
+    void rehashEntries(int newBucketCount) {
+        HoldEntry* oldEntries = holdEntries;
+        int oldCount = entryBuckets;
+
+        entryBuckets = newBucketCount;
+        holdEntries = new HoldEntry[entryBuckets]();
+        for (int i = 0; i < oldCount; i++) {
+            if (oldEntries[i].isbn != 0) {
+                holdEntries[findEntry(oldEntries[i].isbn, oldEntries[i].patron)] = oldEntries[i];
+            }
+        }
+
+        delete[] oldEntries;
+    }
+
+    // Key accessor handed to idIndex - resolves a record to the ID of its copy
+    static const char* idAtCopy(const void* owner, int record) {
+        return static_cast<const Circulation*>(owner)->copies[record].bookId;
+    }
+};
+
+/**
+ * PatronRecord struct - one patron, as held in memory and in a patron file
+ * Fixed width and null-padded like CatalogRecord, 64 bytes in all, so the registry's array
+ * is written and loaded as-is. A record with an empty ID is a removed patron.
+ */
+struct PatronRecord {
+    char id[MAX_ID_LENGTH];
+    char name[MAX_PATRON_NAME_LENGTH];
+};
+
+/**
+ * PatronHeader struct - header at the start of a patron file
+ * The records follow immediately after the header.
+ */
+struct PatronHeader {
+    char magic[8];        // PATRON_MAGIC
+    uint32_t version;     // PATRON_VERSION
+    uint32_t recordSize;  // sizeof(PatronRecord), rejects files written with another layout
+    uint32_t byteOrder;   // CATALOGUE_BYTE_ORDER in the byte order of the writing machine
+    uint32_t reserved;    // Zero; keeps recordCount 8-byte aligned
+    uint64_t recordCount; // Number of records after the header
+};
+
+/**
+ * PatronRegistry class - the library's borrowers, looked up by card ID
+ * Patrons live in one array of fixed records indexed by an IdIndex, so a card swipe is a
+ * hash probe and a single record comparison however many patrons there are. A patron's
+ * position in the array is its patron number, the dense number Circulation keys loans and
+ * holds by. A patron keeps its number while registered: removing a patron blanks its
+ * record rather than moving another patron into it, and the number goes on a free list
+ * for the next registration. Removal is refused while the patron has loans or holds, so a
+ * reused number never inherits another patron's circulation state.
+ */
+class PatronRegistry {
+private:
+    // Private data members - ENCAPSULATION
+    PatronRecord* patrons; // Dynamic array of patrons, grown on demand
+    int capacity;          // Allocated records in patrons
+    int count;             // Records in use, removed patrons included; the next new patron number
+    int active;            // Patrons not removed
+    int* freeNumbers;      // Numbers of removed patrons, reused newest first; capacity entries
+    int freeCount;         // Entries in freeNumbers
+    IdIndex idIndex;       // Hash index from patron ID to patron number
+
+public:
+    // Constructor
+    PatronRegistry(int initialCapacity = DEFAULT_PATRON_CAPACITY) : idIndex(this, &PatronRegistry::idAtSlot) {
+        capacity = initialCapacity > 0 ? initialCapacity : DEFAULT_PATRON_CAPACITY;
+        count = 0;
+        active = 0;
+        patrons = new PatronRecord[capacity];
+        freeNumbers = new int[capacity];
+        freeCount = 0;
+        idIndex.reserve(capacity);
+    }
+
+    // Destructor to free memory
+    ~PatronRegistry() {
+        delete[] patrons;
+        delete[] freeNumbers;
+    }
+
+    // The registry owns its array and index, so it cannot be copied
+    PatronRegistry(const PatronRegistry&) = delete;
+    PatronRegistry& operator=(const PatronRegistry&) = delete;
+
+    // Register a patron and return its patron number, reusing the number of a removed patron if any
+    // Returns -1 if the ID is not alphanumeric (the rule Book::setId applies), the name is
+    // empty or too long, another patron has the ID, or every patron number is taken
+    int addPatron(const char* id, const char* name) {
+        size_t idLength;
+        size_t nameLength;
+        if (!checkField(id, MAX_ID_LENGTH, CHAR_ALNUM, idLength) ||
+            !checkField(name, MAX_PATRON_NAME_LENGTH, CHAR_TEXT, nameLength)) {
+            return -1;
+        }
+        if (freeCount == 0 && count == capacity) {
+            int grown = growCapacity(count + 1);
+            if (grown <= capacity) {
+                return -1;
+            }
+            reallocate(grown);
+        }
+
+        // Fill a blank record, null-padded, then index it; a duplicate ID leaves it blank
+        int patron = freeCount > 0 ? freeNumbers[freeCount - 1] : count;
+        PatronRecord& record = patrons[patron];
+        memset(&record, 0, sizeof(record));
+        memcpy(record.id, id, idLength);
+        memcpy(record.name, name, nameLength);
+        if (!idIndex.insert(record.id, patron)) {
+            memset(&record, 0, sizeof(record));
+            return -1;
+        }
+        if (patron == count) {
+            count++;
+        } else {
+            freeCount--;
+        }
+        active++;
+        return patron;
+    }
+
+    // Find a patron's number by card ID, or -1 if no patron has it
+    int findPatron(const char* id) const {
+        if (id == nullptr || id[0] == '\0') {
+            return -1;
+        }
+        return idIndex.find(id);
+    }
+
+    // Borrow a patron's record by number, or nullptr if the number is unused or removed
+    // The pointer is valid until the next patron is added or the registry is loaded
+    const PatronRecord* viewPatron(int patron) const {
+        if (patron < 0 || patron >= count || patrons[patron].id[0] == '\0') {
+            return nullptr;
+        }
+        return &patrons[patron];
+    }
+
+    // Change a patron's name; returns false if the patron is not found or the name is invalid
+    bool renamePatron(int patron, const char* name) {
+        size_t length;
+        if (viewPatron(patron) == nullptr || !checkField(name, MAX_PATRON_NAME_LENGTH, CHAR_TEXT, length)) {
+            return false;
+        }
+        memset(patrons[patron].name, 0, MAX_PATRON_NAME_LENGTH);
+        memcpy(patrons[patron].name, name, length);
+        return true;
+    }
+
+    // Remove a patron by card ID and free its number for the next registration
+    // Returns false if the patron is not found, or still has loans or holds in circulation
+    bool removePatron(const char* id, const Circulation& circulation) {
+        int patron = findPatron(id);
+        if (patron == -1 || circulation.getLoanCount(patron) > 0 || circulation.getHoldCount(patron) > 0) {
+            return false;
+        }
+        idIndex.erase(id);
+        memset(&patrons[patron], 0, sizeof(PatronRecord));
+        freeNumbers[freeCount++] = patron;
+        active--;
+        return true;
+    }
+
+    // Get the number of registered patrons, removed ones excluded
+    int getCount() const {
+        return active;
+    }
+
+    // Get one past the highest patron number in use; every patron number is below it
+    int getNextNumber() const {
+        return count;
+    }
+
+    // Make room for at least the given number of patrons, e.g. before a bulk load
+    void reserve(int newCapacity) {
+        if (newCapacity > capacity) {
+            reallocate(newCapacity);
+        }
+        idIndex.reserve(newCapacity);
+    }
+
+    // Remove every patron, keeping the allocated storage
+    void clear() {
+        count = 0;
+        active = 0;
+        freeCount = 0;
+        idIndex.clear();
+    }
+
+    // Save every patron to a binary patron file
+    // The records are written as they are held, under a temporary name that is renamed
+    // into place, so an interrupted save leaves the previous file intact
+    bool savePatrons(const char* path) const {
+        if (path == nullptr || path[0] == '\0') {
+            return false;
+        }
+
+        string tempPath = string(path) + ".tmp";
+        FILE* file = fopen(tempPath.c_str(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+
+        PatronHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, PATRON_MAGIC, sizeof(header.magic));
+        header.version = PATRON_VERSION;
+        header.recordSize = sizeof(PatronRecord);
+        header.byteOrder = CATALOGUE_BYTE_ORDER;
+        header.recordCount = static_cast<uint64_t>(count);
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        ok = ok && fwrite(patrons, sizeof(PatronRecord), count, file) == static_cast<size_t>(count);
+
+        ok = syncFile(file) && ok;
+        ok = fclose(file) == 0 && ok;
+        if (!ok) {
+            remove(tempPath.c_str());
+            return false;
+        }
+
+        #ifdef _WIN32
+            remove(path); // rename does not replace an existing file on Windows
+        #endif
+        return rename(tempPath.c_str(), path) == 0;
+    }
+
+    // Replace the registry with a binary patron file
+    // The file is memory-mapped and its records are copied into the array in one block,
+    // then checked and indexed. Returns false if the file cannot be read or has a bad
+    // header (registry unchanged), or if a record is invalid (registry left empty).
+    bool loadPatrons(const char* path) {
+        MappedFile file;
+        if (!file.open(path) || file.getSize() < sizeof(PatronHeader)) {
+            return false;
+        }
+
+        PatronHeader header;
+        memcpy(&header, file.getData(), sizeof(header));
+        if (memcmp(header.magic, PATRON_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != PATRON_VERSION ||
+            header.recordSize != sizeof(PatronRecord) ||
+            header.byteOrder != CATALOGUE_BYTE_ORDER) {
+            return false;
+        }
+
+        // The header must not promise more records than the file holds
+        uint64_t available = (file.getSize() - sizeof(PatronHeader)) / sizeof(PatronRecord);
+        if (header.recordCount > available ||
+            header.recordCount > static_cast<uint64_t>(numeric_limits<int>::max())) {
+            return false;
+        }
+
+        int recordCount = static_cast<int>(header.recordCount);
+        clear();
+        reserve(recordCount);
+        if (recordCount > 0) {
+            memcpy(patrons, file.getData() + sizeof(PatronHeader), recordCount * sizeof(PatronRecord));
+        }
+        for (int i = 0; i < recordCount; i++) {
+            // Numbers of removed patrons are free again; a bad field or duplicate ID rejects the file
+            const PatronRecord& record = patrons[i];
+            if (record.id[0] == '\0') {
+                freeNumbers[freeCount++] = i;
+                continue;
+            }
+            size_t length;
+            if (memchr(record.id, '\0', MAX_ID_LENGTH) == nullptr ||
+                memchr(record.name, '\0', MAX_PATRON_NAME_LENGTH) == nullptr ||
+                !checkField(record.id, MAX_ID_LENGTH, CHAR_ALNUM, length) ||
+                !checkField(record.name, MAX_PATRON_NAME_LENGTH, CHAR_TEXT, length) ||
+                !idIndex.insert(record.id, i)) {
+                clear();
+                return false;
+            }
+            active++;
+        }
+        count = recordCount;
+        return true;
+    }
+
+private:
+    // Helper method to pick the next capacity when the array is full - ENCAPSULATION
+    int growCapacity(int minCapacity) const {
+        const int maxCapacity = numeric_limits<int>::max();
+        if (capacity > maxCapacity / 2) {
+            return minCapacity > capacity ? maxCapacity : capacity;
+        }
+        int grown = capacity * 2;
+        return grown > minCapacity ? grown : minCapacity;
+    }
+
+    // Helper method to move the patrons into an array of a new size - ENCAPSULATION
+    void reallocate(int newCapacity) {
+        PatronRecord* grown = new PatronRecord[newCapacity];
+        memcpy(grown, patrons, count * sizeof(PatronRecord));
+        delete[] patrons;
+        patrons = grown;
+        int* grownFree = new int[newCapacity];
+        memcpy(grownFree, freeNumbers, freeCount * sizeof(int));
+        delete[] freeNumbers;
+        freeNumbers = grownFree;
+        capacity = newCapacity;
+    }
+
+    // Key accessor handed to idIndex - resolves a slot to the ID of the patron stored there
+    static const char* idAtSlot(const void* owner, int slot) {
+        return static_cast<const PatronRegistry*>(owner)->patrons[slot].id;
     }
 };
 
 /**
- * ItemManager abstract base class - demonstrates ABSTRACTION through virtual functions
- * Defines the interface for managing collections of items
+ * ImportRejection struct - one row the importer could not add
  */
-class ItemManager {
-public:
-    virtual ~ItemManager() {}
-    
-    // Pure virtual functions - ABSTRACTION
-    virtual bool addItem(const LibraryItem& item) = 0;
-    virtual bool deleteItem(const char* id) = 0;
-    virtual bool displayItemById(const char* id) const = 0;
-    virtual void displayAllItems() const = 0;
-    virtual int getItemCount() const = 0;
+struct ImportRejection {
+    long line;          // 1-based line number in the input file
+    const char* reason; // Static description of the failed rule
 };
 
 /**
- * Library class - implements ItemManager
- * Manages a collection of books
+ * ImportReport struct - outcome of a bulk import
+ * Every rejected row is counted; the first MAX_REPORTED_REJECTIONS are kept with their reasons.
  */
-class Library : public ItemManager {
+struct ImportReport {
+    static const int MAX_REPORTED_REJECTIONS = 20;
+
+    long rowsRead;     // Data rows seen, excluding blank lines and the header row
+    long rowsImported; // Rows added to the library
+    long rowsRejected; // Rows that failed parsing, validation or the duplicate check
+    int reportedRejections;
+    ImportRejection rejections[MAX_REPORTED_REJECTIONS];
+};
+
+/**
+ * CatalogImporter class - bulk loader for CSV/TSV files of books
+ * Each row holds ID, ISBN, title, author, edition, publication and category in that order.
+ * The file is streamed in large chunks and rows are split in place inside the chunk, so
+ * parsing allocates nothing per row. Rows are validated by the Book setters and added to
+ * the library in batches through Library::addBooks.
+ *
+ * CSV fields may be wrapped in double quotes (with "" for a literal quote) but may not span
+ * lines; TSV fields are taken literally. A first row whose ID column reads "ID" is a header
+ * and is skipped.
+ */
+class CatalogImporter {
+public:
+    static const size_t CHUNK_SIZE = 1024 * 1024; // Bytes read at a time; no row may be this long
+
 private:
+    static const int FIELD_COUNT = 7;
+    static const int BATCH_SIZE = 4096;
+
     // Private data members - ENCAPSULATION
-    Book* books;  // Dynamic array of books
-    int capacity; // Maximum capacity
-    int count;    // Current number of books
+    Library& library;  // Destination of imported books
+    char* chunk;       // Read buffer, one byte larger than CHUNK_SIZE for a terminator
+    Book* batch;       // Validated books waiting for addBooks
+    long* batchLines;  // Source line of each book in batch
+    ItemOutcome* outcomes; // Per-book outcome filled by addBooks
+    int batchCount;    // Books currently in batch
+    StringPool staging; // Text of the books in batch, emptied after each flush
 
 public:
     // Constructor
-    Library(int initialCapacity = DEFAULT_LIBRARY_CAPACITY) {
-        capacity = initialCapacity > 0 ? initialCapacity : DEFAULT_LIBRARY_CAPACITY;
-        count = 0;
-        books = new Book[capacity];
+    CatalogImporter(Library& target) : library(target) {
+        chunk = new char[CHUNK_SIZE + 1];
+        batch = new Book[BATCH_SIZE];
+        batchLines = new long[BATCH_SIZE];
+        outcomes = new ItemOutcome[BATCH_SIZE];
+        batchCount = 0;
     }
 
     // Destructor to free memory
-    virtual ~Library() override {
-        delete[] books;
+    ~CatalogImporter() {
+        delete[] chunk;
+        delete[] batch;
+        delete[] batchLines;
+        delete[] outcomes;
     }
 
-    // Check if a book ID already exists - ENCAPSULATION
-    bool isIdDuplicate(const char* id) const {
-        // Validate ID is not null or empty
-        if (id == nullptr || strlen(id) == 0) {
+    // The importer owns its buffers, so it cannot be copied
+    CatalogImporter(const CatalogImporter&) = delete;
+    CatalogImporter& operator=(const CatalogImporter&) = delete;
+
+    // Import a CSV or TSV file; a delimiter of 0 picks tab or comma from the first line
+    // Returns false if the file cannot be opened or read; report is filled in either case
+    bool importFile(const char* path, char delimiter, ImportReport& report) {
+        memset(&report, 0, sizeof(report));
+        batchCount = 0;
+        staging.clear();
+
+        FILE* file = path != nullptr ? fopen(path, "rb") : nullptr;
+        if (file == nullptr) {
             return false;
         }
-        
-        for (int i = 0; i < count; i++) {
-            if (strcmp(books[i].getId(), id) == 0) {
-                return true;
-            }
+
+        // The file size lets the library be reserved once, after the first chunk shows the average row length
+        long fileSize = -1;
+        if (fseek(file, 0, SEEK_END) == 0) {
+            fileSize = ftell(file);
         }
-        return false;
-    }
+        fseek(file, 0, SEEK_SET);
+        bool reserved = false;
 
-    // Implementation of virtual function - ABSTRACTION
-    virtual bool addItem(const LibraryItem& item) override {
-        // Check if item is a Book
-        const Book* bookItem = dynamic_cast<const Book*>(&item);
-        if (!bookItem) {
-            return false; // Not a Book
+        long line = 0;
+        bool headerChecked = false;
+        bool skippingLongRow = false; // Discarding the rest of a row that overflowed the chunk
+        size_t carry = 0;             // Bytes of an incomplete row kept from the previous chunk
+        bool ok = true;
+
+        while (true) {
+            size_t got = fread(chunk + carry, 1, CHUNK_SIZE - carry, file);
+            if (got == 0 && ferror(file)) {
+                ok = false;
+                break;
+            }
+            char* cursor = chunk;
+            char* limit = chunk + carry + got;
+
+            if (delimiter == 0) {
+                char* firstBreak = static_cast<char*>(memchr(cursor, '\n', limit - cursor));
+                char* firstEnd = firstBreak != nullptr ? firstBreak : limit;
+                delimiter = memchr(cursor, '\t', firstEnd - cursor) != nullptr ? '\t' : ',';
+            }
+
+            // Process every complete row in the chunk
+            char* lineEnd;
+            while ((lineEnd = static_cast<char*>(memchr(cursor, '\n', limit - cursor))) != nullptr) {
+                line++;
+                if (skippingLongRow) {
+                    skippingLongRow = false;
+                } else {
+                    *lineEnd = '\0';
+                    processRow(cursor, lineEnd, line, delimiter, headerChecked, report);
+                }
+                cursor = lineEnd + 1;
+            }
+
+            carry = limit - cursor;
+            if (!reserved && line > 0 && fileSize > 0) {
+                reserved = true;
+                double bytesPerRow = static_cast<double>(cursor - chunk) / line;
+                double expectedRows = fileSize / bytesPerRow;
+                if (expectedRows < numeric_limits<int>::max() - library.getCount()) {
+                    library.reserve(library.getCount() + static_cast<int>(expectedRows));
+                }
+            }
+
+            if (got == 0) {
+                // End of file: the remaining bytes form a last row without a newline
+                if (carry > 0 && !skippingLongRow) {
+                    line++;
+                    *limit = '\0';
+                    processRow(cursor, limit, line, delimiter, headerChecked, report);
+                }
+                break;
+            }
+
+            if (carry == CHUNK_SIZE) {
+                // A single row filled the whole chunk - count and reject it, then skip to its end.
+                // It cannot be the header, so a later row is not checked for one.
+                if (!skippingLongRow) {
+                    headerChecked = true;
+                    report.rowsRead++;
+                    reject(line + 1, "row too long", report);
+                }
+                skippingLongRow = true;
+                carry = 0;
+            } else if (carry > 0) {
+                memmove(chunk, cursor, carry);
+            }
         }
-        
-        return addBook(*bookItem);
+
+        fclose(file);
+        flushBatch(report);
+        return ok;
     }
-    
-    // Add a new book - specific implementation
-    bool addBook(const Book& book) {
-        // Check if library is full
-        if (count >= capacity) {
-            return false;
+
+private:
+    // Helper method to split, validate and queue one row - ENCAPSULATION
+    void processRow(char* start, char* end, long line, char delimiter, bool& headerChecked, ImportReport& report) {
+        if (end > start && end[-1] == '\r') {
+            *--end = '\0';
         }
-        
-        // Validate book ID is not empty and not duplicate
-        if (strlen(book.getId()) == 0 || isIdDuplicate(book.getId())) {
-            return false;
+        if (end == start) {
+            return; // Blank line
         }
-        
-        // Add the book to the array
-        books[count++] = book;
-        return true;
-    }
 
-    // Find a book by ID - ENCAPSULATION (internal helper method)
-    int findBookById(const char* id) const {
-        // Validate ID is not null or empty
-        if (id == nullptr || strlen(id) == 0) {
-            return -1;
-        }
-        
-        for (int i = 0; i < count; i++) {
-            if (strcmp(books[i].getId(), id) == 0) {
-                return i;
+        char* fields[FIELD_COUNT];
+        int fieldCount = splitRow(start, end, delimiter, fields);
+
+        if (!headerChecked) {
+            headerChecked = true;
+            if (fieldCount >= 1 && (fields[0][0] == 'I' || fields[0][0] == 'i') &&
+                (fields[0][1] == 'D' || fields[0][1] == 'd') && fields[0][2] == '\0') {
+                return; // Header row
             }
         }
-        return -1; // Book not found
-    }
 
-    // Edit a book
-    bool editBook(const char* id, const Book& updatedBook) {
-        int index = findBookById(id);
-        if (index != -1) {
-            // Preserve the original ID
-            char originalId[MAX_ID_LENGTH];
-            strncpy(originalId, books[index].getId(), MAX_ID_LENGTH - 1);
-            originalId[MAX_ID_LENGTH - 1] = '\0';
-            
-            // Update the book
-            books[index] = updatedBook;
-            
-            // Restore the original ID
-            books[index].setId(originalId);
-            
-            return true;
+        report.rowsRead++;
+        if (fieldCount != FIELD_COUNT) {
+            reject(line, fieldCount < 0 ? "malformed quoted field" : "expected 7 fields", report);
+            return;
         }
-        return false; // Book not found
-    }
 
-    // Implementation of virtual function - ABSTRACTION
-    virtual bool deleteItem(const char* id) override {
-        return deleteBook(id);
-    }
-    
-    // Delete a book - specific implementation
-    bool deleteBook(const char* id) {
-        int index = findBookById(id);
-        if (index != -1) {
-            // Shift all books after the deleted one
-            for (int i = index; i < count - 1; i++) {
-                books[i] = books[i + 1];
-            }
-            count--;
-            return true;
+        // Same rules as interactive entry: the Book setters do the validation
+        Book& book = batch[batchCount];
+        book = Book(staging);
+        const char* reason = nullptr;
+        if (!book.setId(fields[0])) {
+            reason = "invalid ID";
+        } else if (!book.setIsbn(fields[1])) {
+            reason = "invalid ISBN";
+        } else if (!book.setTitle(fields[2])) {
+            reason = "invalid title";
+        } else if (!book.setAuthor(fields[3])) {
+            reason = "invalid author";
+        } else if (!book.setEdition(fields[4])) {
+            reason = "invalid edition";
+        } else if (!book.setPublication(fields[5])) {
+            reason = "invalid publication";
+        } else if (!book.setCategory(fields[6])) {
+            reason = "invalid category";
+        }
+        if (reason != nullptr) {
+            reject(line, reason, report);
+            return;
         }
-        return false; // Book not found
-    }
 
-    // Get a book by ID
-    bool getBookById(const char* id, Book& bookOut) const {
-        int index = findBookById(id);
-        if (index != -1) {
-            bookOut = books[index];
-            return true;
+        batchLines[batchCount++] = line;
+        if (batchCount == BATCH_SIZE) {
+            flushBatch(report);
         }
-        return false; // Book not found
     }
 
-    // Implementation of virtual function - ABSTRACTION
-    virtual void displayAllItems() const override {
-        displayAllBooks();
-    }
-    
-    // Display all books - specific implementation
-    void displayAllBooks() const {
-        if (count == 0) {
-            cout << "No books available in the library." << endl;
-            return;
-        }
+    // Helper method to split a null-terminated row into fields in place - ENCAPSULATION
+    // Returns the number of fields (stopping past FIELD_COUNT), or -1 for a malformed quote
+    static int splitRow(char* start, char* end, char delimiter, char** fields) {
+        int fieldCount = 0;
+        char* cursor = start;
+        while (true) {
+            if (fieldCount == FIELD_COUNT) {
+                return FIELD_COUNT + 1; // Too many fields
+            }
 
-        displayBookHeader();
-        for (int i = 0; i < count; i++) {
-            books[i].displayInTable();
-            displayTableSeparator();
+            if (delimiter == ',' && *cursor == '"') {
+                // Quoted field: unescape in place, writing behind the read position
+                char* out = cursor;
+                fields[fieldCount++] = out;
+                cursor++;
+                while (true) {
+                    if (cursor >= end) {
+                        return -1; // Unterminated quote
+                    }
+                    if (*cursor == '"') {
+                        if (cursor + 1 < end && cursor[1] == '"') {
+                            *out++ = '"';
+                            cursor += 2;
+                            continue;
+                        }
+                        cursor++;
+                        break;
+                    }
+                    *out++ = *cursor++;
+                }
+                if (cursor < end && *cursor != delimiter) {
+                    return -1; // Text after the closing quote
+                }
+                *out = '\0';
+            } else {
+                fields[fieldCount++] = cursor;
+                char* next = static_cast<char*>(memchr(cursor, delimiter, end - cursor));
+                cursor = next != nullptr ? next : end;
+            }
+
+            if (cursor >= end) {
+                *cursor = '\0';
+                return fieldCount;
+            }
+            *cursor++ = '\0'; // Terminate the field at its delimiter
         }
     }
 
-    // Display books by category
-    void displayBooksByCategory(const char* category) const {
-        // Validate category is not null or empty
-        if (category == nullptr || strlen(category) == 0) {
-            cout << "Invalid category." << endl;
+    // Helper method to add the queued books and record duplicates - ENCAPSULATION
+    void flushBatch(ImportReport& report) {
+        if (batchCount == 0) {
             return;
         }
-        
-        bool found = false;
-        
-        // Case-sensitive category comparison
-        displayBookHeader();
-        for (int i = 0; i < count; i++) {
-            if (strcmp(books[i].getCategory(), category) == 0) {
-                books[i].displayInTable();
-                displayTableSeparator();
-                found = true;
+        report.rowsImported += library.addBooks(batch, batchCount, outcomes);
+        for (int i = 0; i < batchCount; i++) {
+            if (outcomes[i] == ITEM_DUPLICATE) {
+                reject(batchLines[i], "duplicate ID", report);
+            } else if (outcomes[i] != ITEM_ADDED) {
+                reject(batchLines[i], "could not be stored", report);
             }
         }
-        
-        if (!found) {
-            cout << "No books found in this category." << endl;
-        }
+        batchCount = 0;
+        staging.clear(); // The library has copied the text of every book it kept
     }
 
-    // Implementation of virtual function - ABSTRACTION
-    virtual bool displayItemById(const char* id) const override {
-        return displayBookById(id);
-    }
-    
-    // Display a specific book by ID - specific implementation
-    bool displayBookById(const char* id) const {
-        int index = findBookById(id);
-        if (index != -1) {
-            books[index].displayDetails();
-            return true;
+    // Helper method to count a rejected row - ENCAPSULATION
+    static void reject(long line, const char* reason, ImportReport& report) {
+        report.rowsRejected++;
+        if (report.reportedRejections < ImportReport::MAX_REPORTED_REJECTIONS) {
+            report.rejections[report.reportedRejections].line = line;
+            report.rejections[report.reportedRejections].reason = reason;
+            report.reportedRejections++;
         }
-        return false;
-    }
-
-    // Implementation of virtual function - ABSTRACTION
-    virtual int getItemCount() const override {
-        return getCount();
-    }
-    
-    // Get the number of books - specific implementation
-    int getCount() const {
-        return count;
-    }
-
-private:
-    // Helper method to display table header - ENCAPSULATION
-    void displayBookHeader() const {
-        cout << "+--------+---------------+--------------------------------+----------------------+----------+----------------------+-------------+" << endl;
-        cout << "| ID     | ISBN          | Title                          | Author               | Edition  | Publication          | Category    |" << endl;
-        cout << "+--------+---------------+--------------------------------+----------------------+----------+----------------------+-------------+" << endl;
-    }
-
-    // Helper method to display table separator - ENCAPSULATION
-    void displayTableSeparator() const {
-        cout << "+--------+---------------+--------------------------------+----------------------+----------+----------------------+-------------+" << endl;
     }
 };
 
@@ -525,7 +8405,7 @@ bool getValidString(char* buffer, size_t bufferSize, const string& prompt, bool
         }
         
         // Check if input is empty
-        if (strlen(buffer) == 0 && !allowEmpty) {
+        if (buffer[0] == '\0' && !allowEmpty) {
             cout << "Input cannot be empty. Please try again." << endl;
             continue;
         }
@@ -553,7 +8433,7 @@ bool getValidCategory(char* buffer, size_t bufferSize, const string& prompt) {
         }
         
         // Case-sensitive validation
-        if (strcmp(buffer, "Fiction") == 0 || strcmp(buffer, "Non-fiction") == 0) {
+        if (parseCategory(buffer) != CATEGORY_NONE) {
             isValid = true;
         } else {
             cout << "Category must be exactly 'Fiction' or 'Non-fiction' (case-sensitive)." << endl;
@@ -579,16 +8459,9 @@ bool getValidId(char* buffer, size_t bufferSize, const string& prompt, const Lib
             return false;
         }
         
-        // Check if ID contains only alphanumeric characters
-        bool alphanumeric = true;
-        for (size_t i = 0; i < strlen(buffer); ++i) {
-            if (!isalnum(buffer[i])) {
-                alphanumeric = false;
-                break;
-            }
-        }
-        
-        if (!alphanumeric) {
+        // Check if ID contains only alphanumeric characters, with the same check as Book::setId
+        size_t length;
+        if (!checkField(buffer, bufferSize, CHAR_ALNUM, length)) {
             cout << "ID must contain only alphanumeric characters." << endl;
             continue;
         }
@@ -607,13 +8480,46 @@ bool getValidId(char* buffer, size_t bufferSize, const string& prompt, const Lib
 
 /**
  * Main function - entry point of the program
- * Implements the main menu and user interaction loop
+ * Implements the main menu and user interaction loop. Left out when
+ * LIBRARY_MANAGEMENT_NO_MAIN is defined, so the tests can include this file.
  */
+#ifndef LIBRARY_MANAGEMENT_NO_MAIN
 int main() {
-    // Create a library with capacity for 100 books
-    Library library(100);
+    // Create a library; storage grows as books are added
+    Library library;
     int choice = 0;
     bool exitProgram = false;
+    bool saveOnExit = true;
+
+    // Keep sorted orders for View All; enabled before loading so they fill as books arrive
+    library.enableOrderIndex(SORT_BY_TITLE);
+    library.enableOrderIndex(SORT_BY_AUTHOR);
+    library.enableOrderIndex(SORT_BY_PUBLICATION);
+
+    // Load the last snapshot and replay the journal; every change is then logged before it is applied
+    CatalogJournal journal;
+    int replayed = 0;
+    if (library.recover(CATALOGUE_FILE, journal, JOURNAL_FILE, replayed)) {
+        if (library.getCount() > 0 || replayed > 0) {
+            cout << "Loaded " << library.getCount() << " books (" << replayed << " journal entries replayed)." << endl;
+            pauseExecution();
+        }
+    } else {
+        // Do not overwrite a catalogue we could not read
+        cout << "Could not read " << CATALOGUE_FILE << " or " << JOURNAL_FILE
+             << ". Changes in this session will not be saved." << endl;
+        saveOnExit = false;
+        pauseExecution();
+    }
+
+    // Load the registered patrons; a patron file that cannot be read is not overwritten
+    PatronRegistry patrons;
+    bool savePatronsOnExit = true;
+    if (fileExists(PATRON_FILE) && !patrons.loadPatrons(PATRON_FILE)) {
+        cout << "Could not read " << PATRON_FILE << ". Patrons registered in this session will not be saved." << endl;
+        savePatronsOnExit = false;
+        pauseExecution();
+    }
     
     // Main program loop - continues until user chooses to exit
     while (!exitProgram) {
@@ -625,17 +8531,20 @@ int main() {
         cout << "4. Delete Book\n";
         cout << "5. View Books by Category\n";
         cout << "6. View All Books\n";
-        cout << "7. Exit\n";
-        cout << "Enter your choice (1-7): ";
+        cout << "7. Import Books from CSV/TSV\n";
+        cout << "8. Search Books by Title/Author/ISBN\n";
+        cout << "9. Register Patron\n";
+        cout << "10. Exit\n";
+        cout << "Enter your choice (1-10): ";
         
         // Get valid menu choice - loop until valid input is received
         bool validChoice = false;
         while (!validChoice) {
             if (cin >> choice) {
-                if (choice >= 1 && choice <= 7) {
+                if (choice >= 1 && choice <= 10) {
                     validChoice = true;
                 } else {
-                    cout << "Invalid choice. Please enter a number between 1 and 7: ";
+                    cout << "Invalid choice. Please enter a number between 1 and 10: ";
                 }
             } else {
                 cout << "Invalid input. Please enter a number: ";
@@ -693,7 +8602,11 @@ int main() {
                     pauseExecution();
                     break;
                 }
-                newBook.setIsbn(isbn);
+                if (!newBook.setIsbn(isbn)) {
+                    cout << "Invalid ISBN. Must be a valid ISBN-10 or ISBN-13. Returning to main menu." << endl;
+                    pauseExecution();
+                    break;
+                }
                 
                 if (!getValidString(title, MAX_TITLE_LENGTH, "Enter Title: ")) {
                     cout << "Failed to get valid title. Returning to main menu." << endl;
@@ -727,7 +8640,7 @@ int main() {
                 if (library.addBook(newBook)) {
                     cout << "Book added successfully!" << endl;
                 } else {
-                    cout << "Failed to add book. Library might be full." << endl;
+                    cout << "Failed to add book." << endl;
                 }
                 
                 pauseExecution();
@@ -745,108 +8658,95 @@ int main() {
                     break;
                 }
                 
-                Book bookToEdit;
-                if (library.getBookById(id, bookToEdit)) {
+                // Borrowed, not copied: nothing changes the library until patchBook below
+                const Book* bookToEdit = library.viewBookById(id);
+                if (bookToEdit != nullptr) {
                     cout << "\nCurrent Book Details:\n";
-                    bookToEdit.displayDetails();
+                    bookToEdit->displayDetails();
                     cout << "\nEnter new details (leave blank to keep current value):\n";
                     
-                    Book updatedBook;
-                    updatedBook.setId(id); // Keep the same ID
+                    // Only the fields given a new value go into the patch
+                    BookPatch patch;
+                    bookToEdit->startPatch(patch);
                     
                     char input[MAX_TITLE_LENGTH]; // Using the largest buffer size for all inputs
                     
                     // Category (case-sensitive)
-                    string categoryPrompt = "Enter Category (Fiction/Non-fiction) [" + string(bookToEdit.getCategory()) + "]: ";
+                    string categoryPrompt = "Enter Category (Fiction/Non-fiction) [" + string(bookToEdit->getCategory()) + "]: ";
                     cout << categoryPrompt;
                     cin.getline(input, MAX_CATEGORY_LENGTH);
                     
-                    if (strlen(input) == 0) {
-                        // Keep the current value
-                        updatedBook.setCategory(bookToEdit.getCategory());
-                    } else {
-                        // Case-sensitive validation
-                        if (strcmp(input, "Fiction") == 0 || strcmp(input, "Non-fiction") == 0) {
-                            updatedBook.setCategory(input);
-                        } else {
-                            cout << "Invalid category. Must be exactly 'Fiction' or 'Non-fiction'." << endl;
-                            cout << "Keeping current category: " << bookToEdit.getCategory() << endl;
-                            updatedBook.setCategory(bookToEdit.getCategory());
-                        }
+                    // Case-sensitive validation; blank keeps the current value
+                    if (strlen(input) != 0 && !patch.setCategory(input)) {
+                        cout << "Invalid category. Must be exactly 'Fiction' or 'Non-fiction'." << endl;
+                        cout << "Keeping current category: " << bookToEdit->getCategory() << endl;
                     }
                     
                     // ISBN
-                    string isbnPrompt = "Enter ISBN [" + string(bookToEdit.getIsbn()) + "]: ";
+                    char currentIsbn[MAX_ISBN_LENGTH];
+                    formatIsbn(bookToEdit->getIsbn(), currentIsbn);
+                    string isbnPrompt = "Enter ISBN [" + string(currentIsbn) + "]: ";
                     if (!getValidString(input, MAX_ISBN_LENGTH, isbnPrompt, true)) {
                         cout << "Failed to get valid ISBN. Returning to main menu." << endl;
                         pauseExecution();
                         break;
                     }
                     
-                    if (strlen(input) == 0) {
-                        updatedBook.setIsbn(bookToEdit.getIsbn());
-                    } else {
-                        updatedBook.setIsbn(input);
+                    if (strlen(input) != 0 && !patch.setIsbn(input)) {
+                        cout << "Invalid ISBN. Must be a valid ISBN-10 or ISBN-13." << endl;
+                        cout << "Keeping current ISBN: " << currentIsbn << endl;
                     }
                     
                     // Title
-                    string titlePrompt = "Enter Title [" + string(bookToEdit.getTitle()) + "]: ";
+                    string titlePrompt = "Enter Title [" + string(bookToEdit->getTitle()) + "]: ";
                     if (!getValidString(input, MAX_TITLE_LENGTH, titlePrompt, true)) {
                         cout << "Failed to get valid title. Returning to main menu." << endl;
                         pauseExecution();
                         break;
                     }
                     
-                    if (strlen(input) == 0) {
-                        updatedBook.setTitle(bookToEdit.getTitle());
-                    } else {
-                        updatedBook.setTitle(input);
+                    if (strlen(input) != 0) {
+                        patch.setTitle(input);
                     }
                     
                     // Author
-                    string authorPrompt = "Enter Author [" + string(bookToEdit.getAuthor()) + "]: ";
+                    string authorPrompt = "Enter Author [" + string(bookToEdit->getAuthor()) + "]: ";
                     if (!getValidString(input, MAX_AUTHOR_LENGTH, authorPrompt, true)) {
                         cout << "Failed to get valid author. Returning to main menu." << endl;
                         pauseExecution();
                         break;
                     }
                     
-                    if (strlen(input) == 0) {
-                        updatedBook.setAuthor(bookToEdit.getAuthor());
-                    } else {
-                        updatedBook.setAuthor(input);
+                    if (strlen(input) != 0) {
+                        patch.setAuthor(input);
                     }
                     
                     // Edition
-                    string editionPrompt = "Enter Edition [" + string(bookToEdit.getEdition()) + "]: ";
+                    string editionPrompt = "Enter Edition [" + string(bookToEdit->getEdition()) + "]: ";
                     if (!getValidString(input, MAX_EDITION_LENGTH, editionPrompt, true)) {
                         cout << "Failed to get valid edition. Returning to main menu." << endl;
                         pauseExecution();
                         break;
                     }
                     
-                    if (strlen(input) == 0) {
-                        updatedBook.setEdition(bookToEdit.getEdition());
-                    } else {
-                        updatedBook.setEdition(input);
+                    if (strlen(input) != 0) {
+                        patch.setEdition(input);
                     }
                     
                     // Publication
-                    string publicationPrompt = "Enter Publication [" + string(bookToEdit.getPublication()) + "]: ";
+                    string publicationPrompt = "Enter Publication [" + string(bookToEdit->getPublication()) + "]: ";
                     if (!getValidString(input, MAX_PUBLICATION_LENGTH, publicationPrompt, true)) {
                         cout << "Failed to get valid publication. Returning to main menu." << endl;
                         pauseExecution();
                         break;
                     }
                     
-                    if (strlen(input) == 0) {
-                        updatedBook.setPublication(bookToEdit.getPublication());
-                    } else {
-                        updatedBook.setPublication(input);
+                    if (strlen(input) != 0) {
+                        patch.setPublication(input);
                     }
                     
                     // Update the book
-                    if (library.editBook(id, updatedBook)) {
+                    if (library.patchBook(id, patch)) {
                         cout << "Book edited successfully!" << endl;
                     } else {
                         cout << "Failed to edit book." << endl;
@@ -890,10 +8790,10 @@ int main() {
                     break;
                 }
                 
-                Book bookToDelete;
-                if (library.getBookById(id, bookToDelete)) {
+                const Book* bookToDelete = library.viewBookById(id);
+                if (bookToDelete != nullptr) {
                     cout << "\nBook Details:\n";
-                    bookToDelete.displayDetails();
+                    bookToDelete->displayDetails();
                     
                     char confirm;
                     bool validConfirm = false;
@@ -946,7 +8846,7 @@ int main() {
                     break;
                 }
                 
-                cout << "\nBooks in category '" << category << "':\n";
+                cout << "\nBooks in category '" << category << "' (" << library.getCountByCategory(category) << "):\n";
                 library.displayBooksByCategory(category);
                 
                 pauseExecution();
@@ -959,8 +8859,28 @@ int main() {
                 
                 // Using the virtual function through the ItemManager interface - ABSTRACTION
                 if (library.getItemCount() > 0) {
-                    cout << "Total Books: " << library.getItemCount() << "\n\n";
-                    library.displayAllItems();
+                    char order[8];
+                    cout << "Sort by [T]itle, [A]uthor or [P]ublication (Enter for order added): ";
+                    if (!cin.getline(order, sizeof(order))) {
+                        clearInputBuffer();
+                        order[0] = '\0';
+                    }
+
+                    cout << "\nTotal Books: " << library.getItemCount() << "\n\n";
+                    switch (order[0]) {
+                        case 'T': case 't':
+                            library.displayBooksSorted(SORT_BY_TITLE);
+                            break;
+                        case 'A': case 'a':
+                            library.displayBooksSorted(SORT_BY_AUTHOR);
+                            break;
+                        case 'P': case 'p':
+                            library.displayBooksSorted(SORT_BY_PUBLICATION);
+                            break;
+                        default:
+                            library.displayAllItems();
+                            break;
+                    }
                 } else {
                     cout << "No books available in the library." << endl;
                 }
@@ -969,7 +8889,103 @@ int main() {
                 break;
             }
             
-            case 7: // Exit
+            case 7: { // Import Books from CSV/TSV
+                clearScreen();
+                cout << "\n===== IMPORT BOOKS =====\n";
+                cout << "Columns: ID, ISBN, Title, Author, Edition, Publication, Category\n";
+
+                char path[MAX_PATH_LENGTH];
+                if (!getValidString(path, MAX_PATH_LENGTH, "Enter file path: ")) {
+                    cout << "Failed to get valid path. Returning to main menu." << endl;
+                    pauseExecution();
+                    break;
+                }
+
+                CatalogImporter importer(library);
+                ImportReport report;
+                if (!importer.importFile(path, 0, report)) {
+                    cout << "Could not read " << path << "." << endl;
+                }
+
+                cout << "Rows read: " << report.rowsRead << ", imported: " << report.rowsImported
+                     << ", rejected: " << report.rowsRejected << endl;
+                for (int i = 0; i < report.reportedRejections; i++) {
+                    cout << "  Line " << report.rejections[i].line << ": " << report.rejections[i].reason << endl;
+                }
+                if (report.rowsRejected > report.reportedRejections) {
+                    cout << "  ... and " << report.rowsRejected - report.reportedRejections << " more" << endl;
+                }
+
+                // Fold the imported rows into a snapshot instead of keeping them in the journal
+                if (report.rowsImported > 0 && saveOnExit && !library.checkpoint(CATALOGUE_FILE)) {
+                    cout << "Failed to save catalogue to " << CATALOGUE_FILE << "." << endl;
+                }
+
+                pauseExecution();
+                break;
+            }
+
+            case 8: { // Search Books by Title/Author/ISBN
+                clearScreen();
+                cout << "\n===== SEARCH BY TITLE/AUTHOR/ISBN =====\n";
+
+                char query[MAX_TITLE_LENGTH];
+                if (!getValidString(query, MAX_TITLE_LENGTH, "Enter words from the title or author, or an ISBN: ")) {
+                    cout << "Failed to get valid search. Returning to main menu." << endl;
+                    pauseExecution();
+                    break;
+                }
+
+                cout << "\nBooks matching '" << query << "':\n";
+                library.displayBooksMatching(query);
+
+                pauseExecution();
+                break;
+            }
+
+            case 9: { // Register Patron
+                clearScreen();
+                cout << "\n===== REGISTER PATRON =====\n";
+
+                char patronId[MAX_ID_LENGTH];
+                char name[MAX_PATRON_NAME_LENGTH];
+                if (!getValidString(patronId, MAX_ID_LENGTH, "Enter card ID (alphanumeric only): ") ||
+                    !getValidString(name, MAX_PATRON_NAME_LENGTH, "Enter name: ")) {
+                    cout << "Failed to get valid input. Returning to main menu." << endl;
+                    pauseExecution();
+                    break;
+                }
+
+                if (patrons.findPatron(patronId) != -1) {
+                    cout << "Duplicate card ID! Patron not registered." << endl;
+                } else {
+                    int patron = patrons.addPatron(patronId, name);
+                    if (patron != -1) {
+                        cout << "Patron registered as number " << patron << "." << endl;
+                    } else {
+                        cout << "Invalid card ID or name. Patron not registered." << endl;
+                    }
+                }
+
+                pauseExecution();
+                break;
+            }
+
+            case 10: // Exit
+                if (saveOnExit) {
+                    if (library.checkpoint(CATALOGUE_FILE)) {
+                        cout << "Catalogue saved to " << CATALOGUE_FILE << "." << endl;
+                    } else {
+                        cout << "Failed to save catalogue to " << CATALOGUE_FILE << "." << endl;
+                    }
+                }
+                if (savePatronsOnExit && patrons.getNextNumber() > 0) {
+                    if (patrons.savePatrons(PATRON_FILE)) {
+                        cout << "Patrons saved to " << PATRON_FILE << "." << endl;
+                    } else {
+                        cout << "Failed to save patrons to " << PATRON_FILE << "." << endl;
+                    }
+                }
                 cout << "Exiting the Library Management System. Goodbye!" << endl;
                 exitProgram = true;
                 break;
@@ -977,4 +8993,5 @@ int main() {
     }
     
     return 0;
-}
\ No newline at end of file
+}
+#endif
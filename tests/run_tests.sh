@@ -0,0 +1,31 @@
+#!/bin/sh
+# Build and run every test in this directory; exits non-zero if any test fails.
+# Each test includes library_management.cpp with LIBRARY_MANAGEMENT_NO_MAIN defined.
+# Usage: tests/run_tests.sh [test_name ...]   (CXX and CXXFLAGS are honoured)
+
+cd "$(dirname "$0")" || exit 1
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--std=c++17 -Wall -Wextra -Wshadow -O2 -pthread}
+BUILD_DIR=${BUILD_DIR:-build}
+mkdir -p "$BUILD_DIR"
+
+if [ $# -gt 0 ]; then
+    tests="$*"
+else
+    tests=$(ls test_*.cpp | sed 's/\.cpp$//')
+fi
+
+failed=0
+for test in $tests; do
+    if ! $CXX $CXXFLAGS "$test.cpp" -o "$BUILD_DIR/$test"; then
+        echo "FAIL $test (build)"
+        failed=$((failed + 1))
+    elif ! "$BUILD_DIR/$test"; then
+        echo "FAIL $test"
+        failed=$((failed + 1))
+    else
+        echo "PASS $test"
+    fi
+done
+
+[ $failed -eq 0 ]
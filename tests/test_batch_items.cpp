@@ -0,0 +1,199 @@
+/**
+ * test_batch_items.cpp - addItems, upsertItems and deleteItems on every ItemManager
+ * Random batches, with IDs drawn from a small set so they repeat within a batch, are
+ * replayed against a simple reference; every outcome, count and stored book is compared.
+ */
+#include "test_util.h"
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+const char* const TEST_ISBNS[] = { "9780306406157", "9781402894626" };
+
+// Reference catalogue: the books present, as ID -> "title|ISBN", and their insertion order
+struct Model {
+    map<string, string> books;
+    vector<string> order;
+};
+
+/**
+ * Helper function to describe a stored book the way the model does
+ */
+static string describe(const Book& book) {
+    char isbnText[MAX_ISBN_LENGTH];
+    formatIsbn(book.getIsbn(), isbnText);
+    return string(book.getTitle()) + "|" + isbnText;
+}
+
+/**
+ * Helper function to check every ID in the set against the model
+ */
+template <typename Manager>
+static void checkAgainstModel(const Manager& manager, const Model& model, int idCount) {
+    CHECK(manager.getItemCount() == static_cast<int>(model.books.size()));
+    StringPool pool;
+    Book book(pool);
+    char id[MAX_ID_LENGTH];
+    for (int i = 0; i < idCount; i++) {
+        snprintf(id, sizeof(id), "B%d", i);
+        map<string, string>::const_iterator expected = model.books.find(id);
+        bool found = manager.getBookById(id, book);
+        CHECK(found == (expected != model.books.end()));
+        if (found && expected != model.books.end()) {
+            CHECK(describe(book) == expected->second);
+        }
+    }
+}
+
+/**
+ * Helper function to replay random batches against a manager and the model
+ * With keepsOrder the manager must list books in insertion order, as Library does with
+ * PRESERVE_ORDER; listOrder fills a vector with the IDs in listing order.
+ */
+template <typename Manager>
+static void replayBatches(Manager& manager, unsigned seed, bool keepsOrder,
+                          void (*listOrder)(const Manager&, vector<string>&)) {
+    const int IDS = 300;
+    const int BATCHES = 400;
+    mt19937 random(seed);
+    Model model;
+    int version = 0;
+    char id[MAX_ID_LENGTH];
+    char title[32];
+
+    for (int b = 0; b < BATCHES; b++) {
+        int batchCount = 1 + static_cast<int>(random() % 60);
+        int kind = static_cast<int>(random() % 3);
+        vector<ItemOutcome> outcomes(batchCount, ITEM_FAILED);
+        int expectedApplied = 0;
+        vector<ItemOutcome> expected(batchCount);
+
+        if (kind == 2) {
+            vector<string> ids(batchCount);
+            vector<const char*> idPointers(batchCount);
+            for (int i = 0; i < batchCount; i++) {
+                snprintf(id, sizeof(id), "B%d", static_cast<int>(random() % IDS));
+                ids[i] = id;
+                idPointers[i] = ids[i].c_str();
+                if (model.books.erase(ids[i]) > 0) {
+                    expected[i] = ITEM_DELETED;
+                    expectedApplied++;
+                    for (size_t o = 0; o < model.order.size(); o++) {
+                        if (model.order[o] == ids[i]) {
+                            model.order.erase(model.order.begin() + o);
+                            break;
+                        }
+                    }
+                } else {
+                    expected[i] = ITEM_NOT_FOUND;
+                }
+            }
+            CHECK(manager.deleteItems(idPointers.data(), batchCount, outcomes.data()) == expectedApplied);
+        } else {
+            bool upsert = kind == 1;
+            vector<Book> books(batchCount);
+            vector<const LibraryItem*> items(batchCount);
+            for (int i = 0; i < batchCount; i++) {
+                snprintf(id, sizeof(id), "B%d", static_cast<int>(random() % IDS));
+                snprintf(title, sizeof(title), "Title %d", version++);
+                const char* isbn = TEST_ISBNS[random() % 2];
+                CHECK(makeBook(books[i], id, isbn, title));
+                items[i] = &books[i];
+                string value = string(title) + "|" + isbn;
+                if (model.books.count(id) == 0) {
+                    model.books[id] = value;
+                    model.order.push_back(id);
+                    expected[i] = ITEM_ADDED;
+                    expectedApplied++;
+                } else if (upsert) {
+                    model.books[id] = value;
+                    expected[i] = ITEM_UPDATED;
+                    expectedApplied++;
+                } else {
+                    expected[i] = ITEM_DUPLICATE;
+                }
+            }
+            int applied = upsert ? manager.upsertItems(items.data(), batchCount, outcomes.data())
+                                 : manager.addItems(items.data(), batchCount, outcomes.data());
+            CHECK(applied == expectedApplied);
+        }
+        CHECK(outcomes == expected);
+
+        if (b % 20 == 0 || b == BATCHES - 1) {
+            checkAgainstModel(manager, model, IDS);
+            if (keepsOrder) {
+                vector<string> listed;
+                listOrder(manager, listed);
+                CHECK(listed == model.order);
+            }
+        }
+    }
+}
+
+static void listLibrary(const Library& library, vector<string>& ids) {
+    library.forEachBook(collectId, &ids);
+}
+
+static void testLibraryPreserveOrder() {
+    Library library(8);
+    library.setDeleteOrder(Library::PRESERVE_ORDER);
+    replayBatches<Library>(library, 1, true, listLibrary);
+
+    // Every remaining book is still reachable through the ID and ISBN indexes
+    int slots[1024];
+    int copies = library.findBooksByIsbn(9780306406157ULL, slots, 1024) +
+                 library.findBooksByIsbn(9781402894626ULL, slots, 1024);
+    CHECK(copies == library.getItemCount());
+}
+
+static void testLibrarySwapWithLast() {
+    Library library(8);
+    library.setDeleteOrder(Library::SWAP_WITH_LAST);
+    replayBatches<Library>(library, 2, false, listLibrary);
+}
+
+static void testColumnarLibrary() {
+    ColumnarLibrary library(8);
+    replayBatches<ColumnarLibrary>(library, 3, false, nullptr);
+}
+
+static void testConcurrentLibrary() {
+    ConcurrentLibrary library(8);
+    replayBatches<ConcurrentLibrary>(library, 4, false, nullptr);
+}
+
+static void testInvalidBatches() {
+    Library library;
+    ColumnarLibrary columnar;
+    ConcurrentLibrary concurrent;
+    ItemManager* managers[] = { &library, &columnar, &concurrent };
+    Book book;
+    CHECK(makeBook(book, "B1", TEST_ISBNS[0], "Title"));
+    const LibraryItem* items[] = { &book, nullptr, &book };
+
+    for (ItemManager* manager : managers) {
+        // A missing entry is invalid, and the repeat of B1 in the batch is a duplicate
+        ItemOutcome outcomes[3];
+        CHECK(manager->addItems(items, 3, outcomes) == 1);
+        CHECK(outcomes[0] == ITEM_ADDED && outcomes[1] == ITEM_INVALID && outcomes[2] == ITEM_DUPLICATE);
+
+        // A missing array fills every outcome
+        outcomes[0] = outcomes[1] = ITEM_ADDED;
+        CHECK(manager->addItems(nullptr, 2, outcomes) == 0);
+        CHECK(outcomes[0] == ITEM_INVALID && outcomes[1] == ITEM_INVALID);
+        outcomes[0] = outcomes[1] = ITEM_ADDED;
+        CHECK(manager->deleteItems(nullptr, 2, outcomes) == 0);
+        CHECK(outcomes[0] == ITEM_INVALID && outcomes[1] == ITEM_INVALID);
+        CHECK(manager->getItemCount() == 1);
+    }
+}
+
+int main() {
+    testLibraryPreserveOrder();
+    testLibrarySwapWithLast();
+    testColumnarLibrary();
+    testConcurrentLibrary();
+    testInvalidBatches();
+    return finishTest("test_batch_items");
+}
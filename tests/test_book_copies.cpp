@@ -0,0 +1,202 @@
+/**
+ * test_book_copies.cpp - books copied out of a library outlive changes to its text pool
+ * Each copy-out method is called, the pool the copy came from is replaced (clear,
+ * compactText, checkpoint, a released snapshot, ColumnarLibrary::compact), and the copy
+ * is read again. Run under -fsanitize=address to catch a copy that still borrows the pool.
+ * The pools themselves allocate no chunk until their first string, and keep one when cleared.
+ */
+#include "test_util.h"
+#include <string>
+
+/**
+ * Helper function to fill a library with books whose fields are derived from their number
+ */
+static void addBooks(Library& library, int bookCount) {
+    Book book;
+    char id[MAX_ID_LENGTH];
+    char title[32];
+    char author[32];
+    for (int i = 0; i < bookCount; i++) {
+        snprintf(id, sizeof(id), "A%d", i);
+        snprintf(title, sizeof(title), "Title %d", i);
+        snprintf(author, sizeof(author), "Author %d", i % 7);
+        CHECK(makeBook(book, id, "9780306406157", title, author));
+        CHECK(library.addBook(book));
+    }
+}
+
+/**
+ * Helper function to check a copy still holds the fields of book number i
+ */
+static void checkCopy(const Book& copy, int i) {
+    char expected[32];
+    snprintf(expected, sizeof(expected), "A%d", i);
+    CHECK(strcmp(copy.getId(), expected) == 0);
+    snprintf(expected, sizeof(expected), "Title %d", i);
+    CHECK(strcmp(copy.getTitle(), expected) == 0);
+    snprintf(expected, sizeof(expected), "Author %d", i % 7);
+    CHECK(strcmp(copy.getAuthor(), expected) == 0);
+    CHECK(strcmp(copy.getEdition(), "1st") == 0);
+    CHECK(strcmp(copy.getPublication(), "Publisher") == 0);
+}
+
+static void testCopiesOutliveClear() {
+    Library library;
+    library.enableOrderIndex(SORT_BY_TITLE);
+    addBooks(library, 20);
+
+    StringPool pool;
+    Book byId(pool);
+    Book byIsbn(pool);
+    CHECK(library.getBookById("A3", byId));
+    CHECK(library.getBookByIsbn(9780306406157ULL, byIsbn));
+    CHECK(&byId.getTextPool() == &pool);
+    Book page[8];
+    BookCursor cursor;
+    CHECK(library.fetchPage(cursor, page, 8) == 8);
+    Book sorted[4];
+    SortedCursor sortedCursor(SORT_BY_TITLE, "Title 1");
+    CHECK(library.fetchSortedPage(sortedCursor, sorted, 4) == 4);
+
+    library.clear();
+    CHECK(library.getCount() == 0);
+    checkCopy(byId, 3);
+    CHECK(strncmp(byIsbn.getTitle(), "Title ", 6) == 0);
+    for (int i = 0; i < 8; i++) {
+        checkCopy(page[i], i);
+    }
+    checkCopy(sorted[0], 1);
+    checkCopy(sorted[1], 10);
+}
+
+static void testCopiesOutliveCompaction() {
+    Library library;
+    addBooks(library, 20);
+    Book before;
+    CHECK(library.getBookById("A5", before));
+
+    // Replacing every title leaves the old ones as dropped text
+    Book book;
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i < 20; i++) {
+            char id[MAX_ID_LENGTH];
+            char title[48];
+            snprintf(id, sizeof(id), "A%d", i);
+            snprintf(title, sizeof(title), "Round %d title %d", round, i);
+            CHECK(library.getBookById(id, book));
+            CHECK(book.setTitle(title));
+            CHECK(library.editBook(id, book));
+        }
+    }
+    Book edited;
+    CHECK(library.getBookById("A5", edited));
+    CHECK(library.getDroppedTextBytes() > 0);
+    CHECK(library.compactText());
+    CHECK(library.getDroppedTextBytes() == 0);
+    checkCopy(before, 5);
+    CHECK(strcmp(edited.getTitle(), "Round 4 title 5") == 0);
+
+    // checkpoint() compacts on its own once half the pool is dropped text
+    const char* path = "test_book_copies.dat";
+    for (int i = 0; i < 40; i++) {
+        char id[MAX_ID_LENGTH];
+        char title[48];
+        snprintf(id, sizeof(id), "A%d", i % 20);
+        snprintf(title, sizeof(title), "%s title %d", i < 20 ? "Interim" : "Final", i % 20);
+        CHECK(library.getBookById(id, book));
+        CHECK(book.setTitle(title));
+        CHECK(library.editBook(id, book));
+    }
+    CHECK(library.getBookById("A7", edited));
+    size_t usedBefore = library.getTextBytes();
+    CHECK(library.checkpoint(path));
+    remove(path);
+    CHECK(library.getTextBytes() < usedBefore);
+    checkCopy(before, 5);
+    CHECK(strcmp(edited.getTitle(), "Final title 7") == 0);
+}
+
+static void testCopiesOutliveSnapshot() {
+    Library library;
+    library.enableSnapshots();
+    addBooks(library, 10);
+    Book fromSnapshot;
+    Book page[4];
+    {
+        shared_ptr<const CatalogSnapshot> snapshot = library.snapshot();
+        CHECK(snapshot->getBookById("A2", fromSnapshot));
+        BookCursor cursor;
+        CHECK(snapshot->fetchPage(cursor, page, 4) == 4);
+    }
+    // The last reference to the old pool goes with the snapshot
+    library.clear();
+    library.snapshot();
+    checkCopy(fromSnapshot, 2);
+    for (int i = 0; i < 4; i++) {
+        checkCopy(page[i], i);
+    }
+}
+
+static void testColumnarCopiesOutliveCompact() {
+    ColumnarLibrary library;
+    Book book;
+    CHECK(makeBook(book, "A1", "9780306406157", "Title 1", "Author 1"));
+    CHECK(library.addItem(book));
+    Book copy;
+    CHECK(library.getBookById("A1", copy));
+    CHECK(book.setTitle("Renamed"));
+    CHECK(library.editBook("A1", book));
+    CHECK(library.compact());
+    checkCopy(copy, 1);
+}
+
+static void testCopyingAgainAddsNothing() {
+    Library library;
+    addBooks(library, 5);
+    StringPool pool;
+    Book copy(pool);
+    CHECK(library.getBookById("A4", copy));
+    size_t used = pool.getUsedBytes();
+    for (int i = 0; i < 100; i++) {
+        CHECK(library.getBookById("A4", copy));
+    }
+    CHECK(pool.getUsedBytes() == used);
+    CHECK(!library.getBookById("missing", copy));
+    checkCopy(copy, 4); // A failed lookup leaves the copy alone
+}
+
+static void testArenaChunks() {
+    StringArena arena;
+    CHECK(arena.getAllocatedBytes() == 0 && arena.getUsedBytes() == 0);
+    CHECK(arena.get(StringArena::EMPTY_HANDLE)[0] == '\0');
+    uint32_t first = arena.add("first");
+    CHECK(first != StringArena::EMPTY_HANDLE && strcmp(arena.get(first), "first") == 0);
+    size_t chunkBytes = arena.getAllocatedBytes();
+    CHECK(chunkBytes > 0 && arena.getUsedBytes() == 6);
+
+    // A cleared arena keeps one chunk and hands out handles in it again
+    string longText(chunkBytes / 2, 'x');
+    for (int i = 0; i < 4; i++) {
+        CHECK(arena.add(longText.c_str()) != StringArena::EMPTY_HANDLE);
+    }
+    CHECK(arena.getAllocatedBytes() > chunkBytes);
+    arena.clear();
+    CHECK(arena.getAllocatedBytes() == chunkBytes && arena.getUsedBytes() == 0);
+    uint32_t again = arena.add("again");
+    CHECK(again != StringArena::EMPTY_HANDLE && strcmp(arena.get(again), "again") == 0);
+    CHECK(arena.get(StringArena::EMPTY_HANDLE)[0] == '\0');
+
+    // A library that holds nothing has no text
+    Library library;
+    CHECK(library.getTextBytes() == 0);
+}
+
+int main() {
+    testCopiesOutliveClear();
+    testCopiesOutliveCompaction();
+    testCopiesOutliveSnapshot();
+    testColumnarCopiesOutliveCompact();
+    testCopyingAgainAddsNothing();
+    testArenaChunks();
+    return finishTest("test_book_copies");
+}
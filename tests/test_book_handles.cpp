@@ -0,0 +1,185 @@
+/**
+ * test_book_handles.cpp - BookHandle resolution across moves, deletes and clear()
+ * Handles are taken for every book ever added and kept for the whole run. A reference map
+ * of live IDs and titles says what each must resolve to after swap-removes, shifting
+ * deletes, edits, storage resizes and re-adds of a deleted ID: the same book, or nullptr,
+ * never another book. After clear() every old handle is dead, even once the rows are reused.
+ */
+#include "test_util.h"
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Reference handle: the ID it was taken for and that book's current title, "" once deleted
+struct ModelHandle {
+    BookHandle handle;
+    string id;
+    string title;
+};
+
+/**
+ * Helper function to check every handle resolves to its book, or to nothing once it is gone
+ */
+static void checkHandles(const Library& library, const vector<ModelHandle>& handles) {
+    bool resolved = true;
+    for (const ModelHandle& entry : handles) {
+        const Book* book = library.resolveBook(entry.handle);
+        if (entry.title.empty()) {
+            resolved = resolved && book == nullptr;
+        } else {
+            resolved = resolved && book != nullptr && entry.id == book->getId() && entry.title == book->getTitle() &&
+                       book == library.viewBookById(entry.id.c_str());
+        }
+    }
+    CHECK(resolved);
+}
+
+/**
+ * Helper function to add a book and take a handle to it
+ */
+static void addWithHandle(Library& library, vector<ModelHandle>& handles, map<string, size_t>& liveHandle,
+                          const string& id, const string& title) {
+    Book book;
+    CHECK(makeBook(book, id.c_str(), "9780306406157", title.c_str()));
+    CHECK(library.addBook(book));
+    ModelHandle entry;
+    entry.handle = library.getBookHandle(id.c_str());
+    entry.id = id;
+    entry.title = title;
+    liveHandle[id] = handles.size();
+    handles.push_back(entry);
+}
+
+static void testRandomChanges(Library::DeleteOrder order, unsigned seed) {
+    Library library(4);
+    library.setDeleteOrder(order);
+    vector<ModelHandle> handles;
+    map<string, size_t> liveHandle;  // Live ID -> its entry in handles
+    mt19937 random(seed);
+    for (int op = 0; op < 8000; op++) {
+        string id = "H" + to_string(random() % 500);
+        map<string, size_t>::iterator live = liveHandle.find(id);
+        int kind = static_cast<int>(random() % 10);
+        if (live == liveHandle.end()) {
+            // A re-added ID gets a new row; handles from before the delete stay dead
+            addWithHandle(library, handles, liveHandle, id, "Title " + to_string(op));
+        } else if (kind < 4) {
+            CHECK(library.deleteBook(id.c_str()));
+            handles[live->second].title.clear();
+            liveHandle.erase(live);
+        } else if (kind < 7) {
+            // Edits show through the handle
+            string title = "Edited " + to_string(op);
+            BookPatch patch;
+            CHECK(patch.setTitle(title.c_str()));
+            CHECK(library.patchBook(id.c_str(), patch));
+            handles[live->second].title = title;
+        } else if (kind < 8) {
+            // A second handle to the same book is the same handle
+            BookHandle again = library.getBookHandle(id.c_str());
+            CHECK(again.serial == handles[live->second].handle.serial &&
+                  library.resolveBook(again) == library.resolveBook(handles[live->second].handle));
+        } else if (kind < 9) {
+            library.shrinkToFit();
+        } else {
+            library.reserve(library.getCapacity() + static_cast<int>(random() % 64));
+        }
+        if (op % 100 == 0) {
+            checkHandles(library, handles);
+        }
+    }
+    checkHandles(library, handles);
+
+    // A batch delete moves many books at once
+    vector<string> ids;
+    for (map<string, size_t>::iterator it = liveHandle.begin(); it != liveHandle.end(); ++it) {
+        if (random() % 2 == 0) {
+            ids.push_back(it->first);
+        }
+    }
+    vector<const char*> idPointers;
+    for (const string& batchId : ids) {
+        idPointers.push_back(batchId.c_str());
+        handles[liveHandle[batchId]].title.clear();
+        liveHandle.erase(batchId);
+    }
+    CHECK(library.deleteBooks(idPointers.data(), static_cast<int>(idPointers.size()), nullptr) ==
+          static_cast<int>(ids.size()));
+    checkHandles(library, handles);
+
+    // compactText moves the text and renumbers the rows; handles find their books by serial
+    CHECK(library.compactText());
+    checkHandles(library, handles);
+}
+
+static void testSwapRemove() {
+    // The last book moves into the deleted book's slot; its handle follows it there
+    Library library;
+    library.setDeleteOrder(Library::SWAP_WITH_LAST);
+    vector<ModelHandle> handles;
+    map<string, size_t> liveHandle;
+    for (int i = 0; i < 5; i++) {
+        addWithHandle(library, handles, liveHandle, "W" + to_string(i), "Title " + to_string(i));
+    }
+    CHECK(library.findBookById("W4") == 4);
+    CHECK(library.deleteBook("W1"));
+    handles[1].title.clear();
+    CHECK(library.findBookById("W4") == 1);
+    checkHandles(library, handles);
+    CHECK(library.resolveBook(handles[1].handle) == nullptr);
+    CHECK(strcmp(library.resolveBook(handles[4].handle)->getId(), "W4") == 0);
+
+    // Re-adding the deleted ID does not revive the old handle
+    addWithHandle(library, handles, liveHandle, "W1", "Again");
+    CHECK(library.resolveBook(handles[1].handle) == nullptr);
+    CHECK(handles[5].handle.row != handles[1].handle.row);
+    checkHandles(library, handles);
+}
+
+static void testClear() {
+    Library library(8);
+    vector<ModelHandle> handles;
+    map<string, size_t> liveHandle;
+    for (int generation = 0; generation < 4; generation++) {
+        // The same IDs in the same order reuse the same rows after each clear
+        for (int i = 0; i < 20; i++) {
+            addWithHandle(library, handles, liveHandle, "L" + to_string(i), "Gen " + to_string(generation));
+        }
+        checkHandles(library, handles);
+        library.clear();
+        liveHandle.clear();
+        for (ModelHandle& entry : handles) {
+            entry.title.clear();
+        }
+        checkHandles(library, handles);
+    }
+    addWithHandle(library, handles, liveHandle, "L0", "Last");
+    CHECK(handles.back().handle.row == handles[0].handle.row);
+    checkHandles(library, handles);
+
+    // Handles that never referred to a book resolve to nothing
+    BookHandle none;
+    CHECK(library.resolveBook(none) == nullptr);
+    CHECK(library.resolveBook(library.getBookHandle("Missing")) == nullptr);
+    BookHandle forged = handles.back().handle;
+    forged.serial += 1000;
+    CHECK(library.resolveBook(forged) == nullptr);
+    forged.row = -1;
+    CHECK(library.resolveBook(forged) == nullptr);
+
+    // The serial decides: a stale row hint still finds the book, never another one
+    BookHandle moved = handles.back().handle;
+    moved.row = 1000;
+    CHECK(library.resolveBook(moved) == library.viewBookById("L0"));
+    moved.serial = handles[0].handle.serial;
+    CHECK(library.resolveBook(moved) == nullptr);
+}
+
+int main() {
+    testRandomChanges(Library::SWAP_WITH_LAST, 19);
+    testRandomChanges(Library::PRESERVE_ORDER, 29);
+    testSwapRemove();
+    testClear();
+    return finishTest("test_book_handles");
+}
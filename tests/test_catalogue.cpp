@@ -0,0 +1,157 @@
+/**
+ * test_catalogue.cpp - saving and loading the binary catalogue
+ * A library built book by book is saved and loaded into another library whose order
+ * indexes and snapshots are on, so every secondary index is bulk-built by the load. The
+ * loaded library must answer sorted listings, searches, ISBN and category lookups,
+ * suggestions, cursors and snapshots exactly as the original does, and keep working
+ * through adds and deletes afterwards.
+ */
+#include "test_util.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+const char* const CATALOGUE_PATH = "test_catalogue.dat";
+const char* const TEST_ISBNS[] = { "9780306406157", "9781402894626", "9780131103627" };
+const char* const WORDS[] = { "amber", "Birch", "cedar", "delta", "Ember", "fern" };
+
+/**
+ * Helper function to add random books to a library
+ */
+static void addRandomBooks(Library& library, int books, int firstNumber, mt19937& random) {
+    for (int i = 0; i < books; i++) {
+        string id = "B" + to_string(firstNumber + i);
+        string title = string(WORDS[random() % 6]) + " " + WORDS[random() % 6];
+        string author = WORDS[random() % 6];
+        Book book;
+        CHECK(makeBook(book, id.c_str(), TEST_ISBNS[random() % 3], title.c_str(), author.c_str(),
+                       random() % 4 == 0 ? "Non-fiction" : "Fiction"));
+        CHECK(library.addBook(book));
+    }
+}
+
+/**
+ * Helper function to list a library's books in row order through a cursor
+ */
+static vector<string> listAll(const Library& library, BookCategory filter) {
+    vector<string> ids;
+    BookCursor cursor(filter);
+    Book page[16];
+    int found;
+    while ((found = library.fetchPage(cursor, page, 16)) > 0) {
+        for (int i = 0; i < found; i++) {
+            ids.push_back(page[i].getId());
+        }
+    }
+    return ids;
+}
+
+/**
+ * Helper function to check that two libraries answer every query the same way
+ * The books are saved in slot order and both libraries delete the same way afterwards,
+ * so matching slots are the same books.
+ */
+static void checkSame(const Library& expected, const Library& actual) {
+    CHECK(actual.getCount() == expected.getCount());
+    CHECK(listAll(actual, CATEGORY_NONE) == listAll(expected, CATEGORY_NONE));
+    CHECK(listAll(actual, CATEGORY_NON_FICTION) == listAll(expected, CATEGORY_NON_FICTION));
+    CHECK(actual.getCountByCategory("Fiction") == expected.getCountByCategory("Fiction"));
+
+    const SortField fields[] = { SORT_BY_TITLE, SORT_BY_AUTHOR };
+    for (SortField field : fields) {
+        vector<string> want;
+        vector<string> got;
+        CHECK(expected.forEachBookSorted(field, "", "", collectId, &want));
+        CHECK(actual.forEachBookSorted(field, "", "", collectId, &got));
+        CHECK(got == want);
+        want.clear();
+        got.clear();
+        CHECK(expected.forEachBookSorted(field, "birch", "delta", collectId, &want));
+        CHECK(actual.forEachBookSorted(field, "birch", "delta", collectId, &got));
+        CHECK(!got.empty() && got == want);
+    }
+
+    int size = expected.getCount() + 1;
+    vector<int> wantSlots(size);
+    vector<int> gotSlots(size);
+    for (const char* word : WORDS) {
+        int want = expected.searchBooks(word, wantSlots.data(), size);
+        int got = actual.searchBooks(word, gotSlots.data(), size);
+        CHECK(got == want && equal(gotSlots.begin(), gotSlots.begin() + got, wantSlots.begin()));
+    }
+    for (const char* text : TEST_ISBNS) {
+        uint64_t isbn = 0;
+        CHECK(parseIsbn(text, isbn));
+        CHECK(actual.findBooksByIsbn(isbn, gotSlots.data(), size) ==
+              expected.findBooksByIsbn(isbn, wantSlots.data(), size));
+    }
+
+    Suggestion want[4];
+    Suggestion got[4];
+    int wantCount = expected.suggestTitles("c", want, 4);
+    CHECK(actual.suggestTitles("c", got, 4) == wantCount);
+    for (int i = 0; i < wantCount; i++) {
+        CHECK(strcmp(got[i].text, want[i].text) == 0 && got[i].count == want[i].count);
+    }
+}
+
+static void testRoundTrip() {
+    mt19937 random(4);
+    Library original(16);
+    original.enableOrderIndex(SORT_BY_TITLE);
+    original.enableOrderIndex(SORT_BY_AUTHOR);
+    addRandomBooks(original, 3000, 0, random);
+    CHECK(original.saveCatalogue(CATALOGUE_PATH));
+
+    // The loaded library already holds books, which the load replaces
+    Library loaded(8);
+    loaded.enableOrderIndex(SORT_BY_TITLE);
+    loaded.enableOrderIndex(SORT_BY_AUTHOR);
+    loaded.enableSnapshots();
+    addRandomBooks(loaded, 50, 90000, random);
+    CHECK(loaded.loadCatalogue(CATALOGUE_PATH));
+    remove(CATALOGUE_PATH);
+    checkSame(original, loaded);
+    CHECK(loaded.getRowCount() == loaded.getCount());
+
+    shared_ptr<const CatalogSnapshot> snapshot = loaded.snapshot();
+    CHECK(snapshot != nullptr && snapshot->getCount() == 3000);
+    CHECK(snapshot->findBookById("B1234") != nullptr);
+    CHECK(snapshot->findBookById("B90000") == nullptr);
+
+    // Both keep working in step after the load
+    for (int i = 0; i < 3000; i += 7) {
+        string id = "B" + to_string(i);
+        CHECK(original.deleteBook(id.c_str()));
+        CHECK(loaded.deleteBook(id.c_str()));
+    }
+    mt19937 again(5);
+    addRandomBooks(original, 200, 5000, again);
+    again.seed(5);
+    addRandomBooks(loaded, 200, 5000, again);
+    checkSame(original, loaded);
+}
+
+static void testEmptyCatalogue() {
+    Library empty;
+    CHECK(empty.saveCatalogue(CATALOGUE_PATH));
+    Library loaded;
+    loaded.enableOrderIndex(SORT_BY_TITLE);
+    mt19937 random(6);
+    addRandomBooks(loaded, 10, 0, random);
+    CHECK(loaded.loadCatalogue(CATALOGUE_PATH));
+    remove(CATALOGUE_PATH);
+    CHECK(loaded.getCount() == 0 && loaded.getRowCount() == 0);
+    vector<string> listed;
+    CHECK(loaded.forEachBookSorted(SORT_BY_TITLE, "", "", collectId, &listed));
+    CHECK(listed.empty());
+    addRandomBooks(loaded, 10, 0, random);
+    CHECK(listAll(loaded, CATEGORY_NONE).size() == 10);
+}
+
+int main() {
+    testRoundTrip();
+    testEmptyCatalogue();
+    return finishTest("test_catalogue");
+}
@@ -0,0 +1,154 @@
+/**
+ * test_category_index.cpp - CategoryIndex bitmaps as books move between slots
+ * A reference array of (ID, category) by slot follows every add, category edit and delete
+ * under both delete orders, plus batch deletes, shrinkToFit and clear. The books listed
+ * for each category, and its count, must match the array exactly, in slot order.
+ */
+#include "test_util.h"
+#include <random>
+#include <string>
+#include <vector>
+
+const char* const CATEGORY_NAMES[] = { "Fiction", "Non-fiction" };
+
+// Reference slot: the book there and its category (index into CATEGORY_NAMES)
+struct ModelSlot {
+    string id;
+    int category;
+};
+
+/**
+ * Helper function to get the ID of a reference slot, for slotOf
+ */
+static const string& modelSlotId(const ModelSlot& slot) {
+    return slot.id;
+}
+
+/**
+ * Helper function to compare each category's listing and count with the reference slots
+ */
+static void checkCategories(const Library& library, const vector<ModelSlot>& slots) {
+    for (int c = 0; c < 2; c++) {
+        vector<string> expected;
+        for (const ModelSlot& slot : slots) {
+            if (slot.category == c) {
+                expected.push_back(slot.id);
+            }
+        }
+        vector<string> listed;
+        library.forEachBookInCategory(parseCategory(CATEGORY_NAMES[c]), collectId, &listed);
+        CHECK(listed == expected);
+        CHECK(library.getCountByCategory(CATEGORY_NAMES[c]) == static_cast<int>(expected.size()));
+    }
+    CHECK(library.getCountByCategory("Poetry") == 0);
+}
+
+static void testRandomMoves(Library::DeleteOrder order, unsigned seed) {
+    // A small starting capacity, so the bitmaps are resized many times on the way up
+    const int IDS = 700;
+    Library library(3);
+    library.setDeleteOrder(order);
+    vector<ModelSlot> slots;
+    mt19937 random(seed);
+    Book book;
+    char id[MAX_ID_LENGTH];
+    for (int op = 0; op < 6000; op++) {
+        snprintf(id, sizeof(id), "K%d", static_cast<int>(random() % IDS));
+        int index = slotOf(slots, id);
+        int kind = static_cast<int>(random() % 10);
+        int category = static_cast<int>(random() % 2);
+        if (index == -1) {
+            CHECK(makeBook(book, id, "9780306406157", "Title", "Author", CATEGORY_NAMES[category]));
+            CHECK(library.addBook(book));
+            ModelSlot slot = { id, category };
+            slots.push_back(slot);
+        } else if (kind < 4) {
+            CHECK(library.deleteBook(id));
+            modelDelete(slots, index, order);
+        } else if (kind < 7) {
+            // A patch that changes only the category moves the slot between bitmaps
+            BookPatch patch;
+            CHECK(patch.setCategory(CATEGORY_NAMES[category]));
+            CHECK(library.patchBook(id, patch));
+            slots[index].category = category;
+        } else {
+            CHECK(library.getBookById(id, book));
+            CHECK(book.setCategory(CATEGORY_NAMES[category]));
+            CHECK(book.setTitle("Edited"));
+            CHECK(library.editBook(id, book));
+            slots[index].category = category;
+        }
+        if (op % 100 == 0) {
+            checkCategories(library, slots);
+        }
+        if (op % 1500 == 1499) {
+            library.shrinkToFit();
+            checkCategories(library, slots);
+        }
+    }
+    checkCategories(library, slots);
+
+    // A batch delete closes its holes in one pass
+    vector<string> ids;
+    for (size_t s = 0; s < slots.size(); s += 3) {
+        ids.push_back(slots[s].id);
+    }
+    vector<const char*> idPointers;
+    for (const string& batchId : ids) {
+        idPointers.push_back(batchId.c_str());
+    }
+    CHECK(library.deleteBooks(idPointers.data(), static_cast<int>(idPointers.size()), nullptr) ==
+          static_cast<int>(ids.size()));
+    for (const string& batchId : ids) {
+        modelDelete(slots, slotOf(slots, batchId), order);
+    }
+    checkCategories(library, slots);
+
+    library.clear();
+    slots.clear();
+    checkCategories(library, slots);
+    CHECK(makeBook(book, "K1", "9780306406157", "Title", "Author", "Non-fiction"));
+    CHECK(library.addBook(book));
+    ModelSlot slot = { "K1", 1 };
+    slots.push_back(slot);
+    checkCategories(library, slots);
+}
+
+static void testNextAcrossWords() {
+    // Slots on both sides of 64-bit word boundaries, and sparse runs of empty words
+    CategoryIndex index;
+    index.resize(1000);
+    const int marked[] = { 0, 63, 64, 127, 128, 500, 639, 640, 999 };
+    for (int slot : marked) {
+        index.set(slot, CATEGORY_FICTION);
+    }
+    index.set(1, CATEGORY_NON_FICTION);
+    vector<int> seen;
+    for (int slot = index.next(CATEGORY_FICTION, 0); slot != -1; slot = index.next(CATEGORY_FICTION, slot + 1)) {
+        seen.push_back(slot);
+    }
+    CHECK(seen == vector<int>(marked, marked + 9));
+    CHECK(index.getCount(CATEGORY_FICTION) == 9);
+    CHECK(index.next(CATEGORY_FICTION, 129) == 500);
+    CHECK(index.next(CATEGORY_FICTION, 1000) == -1);
+    CHECK(index.next(CATEGORY_FICTION, -1) == -1);
+    CHECK(index.next(CATEGORY_NON_FICTION, 2) == -1);
+
+    // Growing keeps the bits; shrinking keeps those still covered
+    index.resize(5000);
+    CHECK(index.next(CATEGORY_FICTION, 641) == 999);
+    index.clear(999, CATEGORY_FICTION);
+    index.resize(700);
+    CHECK(index.next(CATEGORY_FICTION, 641) == -1);
+    CHECK(index.next(CATEGORY_FICTION, 600) == 639);
+    index.clearAll();
+    CHECK(index.next(CATEGORY_FICTION, 0) == -1);
+    CHECK(index.getCount(CATEGORY_FICTION) == 0);
+}
+
+int main() {
+    testRandomMoves(Library::SWAP_WITH_LAST, 9);
+    testRandomMoves(Library::PRESERVE_ORDER, 10);
+    testNextAcrossWords();
+    return finishTest("test_category_index");
+}
@@ -0,0 +1,385 @@
+/**
+ * test_circulation.cpp - checkouts, returns, holds and loan limits in Circulation
+ * The scenario tests cover one rule each; the model test replays random transactions
+ * against a simple reference and compares every count and loan list.
+ */
+#include "test_util.h"
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Helper function to turn 12 digits into a valid ISBN-13 by appending its check digit
+ */
+static uint64_t isbnFrom(uint64_t first12) {
+    uint64_t rest = first12;
+    int sum = 0;
+    for (int i = 0; i < 12; i++) {
+        int digit = static_cast<int>(rest % 10);
+        rest /= 10;
+        sum += digit * (i % 2 == 0 ? 3 : 1); // Rightmost of the 12 digits has weight 3
+    }
+    return first12 * 10 + (10 - sum % 10) % 10;
+}
+
+/**
+ * Helper function to add a book with an ISBN given as a number
+ */
+static void addCopy(Library& library, const char* id, uint64_t isbn) {
+    char isbnText[MAX_ISBN_LENGTH];
+    formatIsbn(isbn, isbnText);
+    Book book;
+    CHECK(makeBook(book, id, isbnText, "Title"));
+    CHECK(library.addBook(book));
+}
+
+static void testCheckoutAndReturn() {
+    Library library;
+    uint64_t isbn = isbnFrom(978030640615ULL);
+    addCopy(library, "C1", isbn);
+    Circulation circulation(library);
+
+    CHECK(circulation.checkout("C1", 0, 30) == CIRC_OK);
+    CHECK(circulation.checkout("C1", 1, 30) == CIRC_ON_LOAN);
+    int patron = -1;
+    uint32_t dueDay = 0;
+    CHECK(circulation.getCopyStatus("C1", patron, dueDay) && patron == 0 && dueDay == 30);
+    CHECK(circulation.getLoanCount(0) == 1);
+
+    int holdPatron = 0;
+    CHECK(circulation.returnCopy("C1", holdPatron) == CIRC_OK && holdPatron == -1);
+    CHECK(!circulation.getCopyStatus("C1", patron, dueDay));
+    CHECK(circulation.getLoanCount(0) == 0);
+    CHECK(circulation.returnCopy("C1", holdPatron) == CIRC_NOT_ON_LOAN);
+
+    CHECK(circulation.checkout("missing", 0, 30) == CIRC_NO_SUCH_COPY);
+    CHECK(circulation.returnCopy("missing", holdPatron) == CIRC_NO_SUCH_COPY);
+    CHECK(circulation.checkout("C1", -1, 30) == CIRC_BAD_PATRON);
+    CHECK(circulation.checkout("C1", 0, 0) == CIRC_BAD_DUE_DAY);
+}
+
+static void testLoanLimit() {
+    Library library;
+    uint64_t isbn = isbnFrom(978030640615ULL);
+    addCopy(library, "C1", isbn);
+    addCopy(library, "C2", isbn);
+    addCopy(library, "C3", isbn);
+    Circulation circulation(library, 2);
+
+    CHECK(circulation.checkout("C1", 4, 10) == CIRC_OK);
+    CHECK(circulation.checkout("C2", 4, 10) == CIRC_OK);
+    CHECK(circulation.checkout("C3", 4, 10) == CIRC_LOAN_LIMIT);
+    CHECK(circulation.checkout("C3", 5, 10) == CIRC_OK); // The limit is per patron
+
+    int holdPatron;
+    CHECK(circulation.returnCopy("C1", holdPatron) == CIRC_OK);
+    CHECK(circulation.returnCopy("C3", holdPatron) == CIRC_OK);
+    CHECK(circulation.checkout("C3", 4, 10) == CIRC_OK);
+    CHECK(circulation.getLoanCount(4) == 2);
+}
+
+static void testPatronLimit() {
+    Library library;
+    uint64_t isbn = isbnFrom(978030640615ULL);
+    addCopy(library, "C1", isbn);
+    Circulation circulation(library, DEFAULT_LOAN_LIMIT, DEFAULT_PICKUP_DAYS, 100);
+    CHECK(circulation.getPatronLimit() == 100);
+
+    // Numbers at or past the limit, INT_MAX included, are refused before any state is grown
+    CHECK(circulation.checkout("C1", 100, 10) == CIRC_BAD_PATRON);
+    CHECK(circulation.checkout("C1", numeric_limits<int>::max(), 10) == CIRC_BAD_PATRON);
+    CHECK(circulation.placeHold(isbn, numeric_limits<int>::max()) == CIRC_BAD_PATRON);
+    CHECK(circulation.getLoanCount(numeric_limits<int>::max()) == 0);
+    CHECK(circulation.checkout("C1", 99, 10) == CIRC_OK);
+
+    // Limits are clamped; lowering one leaves existing loans to be returned
+    circulation.setPatronLimit(numeric_limits<int>::max());
+    CHECK(circulation.getPatronLimit() == MAX_PATRON_LIMIT);
+    circulation.setPatronLimit(0);
+    CHECK(circulation.getPatronLimit() == 1);
+    CHECK(circulation.placeHold(isbn, 99) == CIRC_BAD_PATRON);
+    int holdPatron = -1;
+    CHECK(circulation.returnCopy("C1", holdPatron) == CIRC_OK && holdPatron == -1);
+    CHECK(circulation.getLoanCount(99) == 0);
+}
+
+static void testReturnToHold() {
+    Library library;
+    uint64_t isbn = isbnFrom(978030640615ULL);
+    addCopy(library, "C1", isbn);
+    Circulation circulation(library);
+
+    CHECK(circulation.checkout("C1", 0, 10) == CIRC_OK);
+    CHECK(circulation.placeHold(isbn, 1) == CIRC_OK);
+    CHECK(circulation.placeHold(isbn, 2) == CIRC_OK);
+    CHECK(circulation.getWaitingCount(isbn) == 2);
+    CHECK(circulation.getHoldCount(1) == 1);
+    CHECK(circulation.placeHold(isbnFrom(978000000000ULL), 1) == CIRC_NO_SUCH_COPY);
+
+    // The returned copy is held for the first patron in the queue
+    int holdPatron = -1;
+    CHECK(circulation.returnCopy("C1", holdPatron) == CIRC_OK && holdPatron == 1);
+    CHECK(circulation.getWaitingCount(isbn) == 1);
+    CHECK(circulation.getHoldCount(1) == 1);
+    int patron = -1;
+    uint32_t dueDay = 1;
+    CHECK(circulation.getCopyStatus("C1", patron, dueDay) && patron == 1 && dueDay == 0);
+    CHECK(circulation.checkout("C1", 2, 10) == CIRC_ON_HOLD);
+    CHECK(circulation.returnCopy("C1", holdPatron) == CIRC_NOT_ON_LOAN);
+
+    // Collecting it ends the hold; the next return goes to the second patron
+    CHECK(circulation.checkout("C1", 1, 20) == CIRC_OK);
+    CHECK(circulation.getHoldCount(1) == 0);
+    CHECK(circulation.returnCopy("C1", holdPatron) == CIRC_OK && holdPatron == 2);
+    CHECK(circulation.getWaitingCount(isbn) == 0);
+}
+
+static void testCancelHold() {
+    Library library;
+    uint64_t isbn = isbnFrom(978030640615ULL);
+    addCopy(library, "C1", isbn);
+    Circulation circulation(library);
+
+    CHECK(circulation.placeHold(isbn, 1) == CIRC_OK);
+    CHECK(circulation.placeHold(isbn, 2) == CIRC_OK);
+    CHECK(circulation.placeHold(isbn, 3) == CIRC_OK);
+    CHECK(circulation.cancelHold(isbn, 2) == CIRC_OK);
+    CHECK(circulation.cancelHold(isbn, 2) == CIRC_NO_HOLD);
+    CHECK(circulation.getWaitingCount(isbn) == 2);
+    CHECK(circulation.getHoldCount(2) == 0);
+
+    // Cancelling a copy already held passes it on to the next patron waiting
+    int holdPatron = -1;
+    CHECK(circulation.checkout("C1", 0, 10) == CIRC_OK);
+    CHECK(circulation.returnCopy("C1", holdPatron) == CIRC_OK && holdPatron == 1);
+    CHECK(circulation.cancelHold(isbn, 1) == CIRC_OK);
+    int patron = -1;
+    uint32_t dueDay = 1;
+    CHECK(circulation.getCopyStatus("C1", patron, dueDay) && patron == 3 && dueDay == 0);
+
+    // With nobody left waiting, cancelling puts the copy back on the shelf
+    CHECK(circulation.cancelHold(isbn, 3) == CIRC_OK);
+    CHECK(!circulation.getCopyStatus("C1", patron, dueDay));
+    CHECK(circulation.getHoldCount(3) == 0);
+    CHECK(circulation.checkout("C1", 4, 10) == CIRC_OK);
+}
+
+static void testDuplicateHold() {
+    Library library;
+    uint64_t isbn = isbnFrom(978030640615ULL);
+    addCopy(library, "C1", isbn);
+    addCopy(library, "C2", isbn);
+    Circulation circulation(library);
+
+    CHECK(circulation.placeHold(isbn, 1) == CIRC_OK);
+    CHECK(circulation.placeHold(isbn, 1) == CIRC_DUPLICATE_HOLD);
+    CHECK(circulation.getHoldCount(1) == 1);
+    CHECK(circulation.getWaitingCount(isbn) == 1);
+
+    // Still a duplicate once a copy is held for the patron, and free again after collecting it
+    int holdPatron = -1;
+    CHECK(circulation.checkout("C1", 0, 10) == CIRC_OK);
+    CHECK(circulation.returnCopy("C1", holdPatron) == CIRC_OK && holdPatron == 1);
+    CHECK(circulation.placeHold(isbn, 1) == CIRC_DUPLICATE_HOLD);
+    CHECK(circulation.checkout("C1", 1, 10) == CIRC_OK);
+    CHECK(circulation.getHoldCount(1) == 0);
+    CHECK(circulation.placeHold(isbn, 1) == CIRC_OK);
+    CHECK(circulation.cancelHold(isbn, 1) == CIRC_OK);
+    CHECK(circulation.placeHold(isbn, 1) == CIRC_OK);
+    CHECK(circulation.placeHold(0, 1) == CIRC_NO_SUCH_COPY);
+}
+
+static void testHoldExpiry() {
+    Library library;
+    uint64_t isbn = isbnFrom(978030640615ULL);
+    addCopy(library, "C1", isbn);
+    Circulation circulation(library, DEFAULT_LOAN_LIMIT, 7);
+    CHECK(circulation.setCurrentDay(100) == 0);
+
+    int holdPatron = -1;
+    CHECK(circulation.checkout("C1", 0, 110) == CIRC_OK);
+    CHECK(circulation.placeHold(isbn, 1) == CIRC_OK);
+    CHECK(circulation.placeHold(isbn, 2) == CIRC_OK);
+    CHECK(circulation.returnCopy("C1", holdPatron) == CIRC_OK && holdPatron == 1);
+
+    // Held through day 107; expires on day 108 and passes to patron 2 until day 115
+    CHECK(circulation.setCurrentDay(107) == 0);
+    CHECK(circulation.setCurrentDay(50) == 0); // Days only move forward
+    CHECK(circulation.setCurrentDay(108) == 1);
+    int patron = -1;
+    uint32_t dueDay = 1;
+    CHECK(circulation.getCopyStatus("C1", patron, dueDay) && patron == 2);
+    CHECK(circulation.getHoldCount(1) == 0);
+    CHECK(circulation.getHoldCount(2) == 1);
+    CHECK(circulation.setCurrentDay(116) == 1);
+    CHECK(!circulation.getCopyStatus("C1", patron, dueDay));
+    CHECK(circulation.getHoldCount(2) == 0);
+}
+
+static void testLoansSurviveReload() {
+    Library library;
+    uint64_t isbn = isbnFrom(978030640615ULL);
+    addCopy(library, "C1", isbn);
+    addCopy(library, "C2", isbn);
+    Circulation circulation(library);
+    CHECK(circulation.checkout("C1", 0, 10) == CIRC_OK);
+    CHECK(circulation.checkout("C2", 0, 10) == CIRC_OK);
+
+    const char* path = "test_circulation.dat";
+    CHECK(library.saveCatalogue(path));
+    CHECK(library.loadCatalogue(path));
+    remove(path);
+    CHECK(circulation.getLoanCount(0) == 2);
+
+    // A copy can come back after its book has left the catalogue
+    int holdPatron = -1;
+    CHECK(library.deleteBook("C2"));
+    CHECK(circulation.returnCopy("C2", holdPatron) == CIRC_OK);
+    library.clear();
+    CHECK(circulation.returnCopy("C1", holdPatron) == CIRC_OK);
+    CHECK(circulation.getLoanCount(0) == 0);
+}
+
+// Loan visitor that collects (book ID, due day) pairs
+static bool collectLoan(const char* bookId, uint32_t dueDay, void* context) {
+    static_cast<vector<pair<string, uint32_t>>*>(context)->push_back(make_pair(string(bookId), dueDay));
+    return true;
+}
+
+static void testRandomAgainstModel() {
+    const int COPIES = 500;
+    const int PATRONS = 80;
+    const int TITLES = 20;
+    const int LIMIT = 4;
+    Library library;
+    uint64_t isbns[TITLES];
+    for (int t = 0; t < TITLES; t++) {
+        isbns[t] = isbnFrom(978000000000ULL + t * 7919);
+    }
+    char id[MAX_ID_LENGTH];
+    for (int c = 0; c < COPIES; c++) {
+        snprintf(id, sizeof(id), "C%d", c);
+        addCopy(library, id, isbns[c % TITLES]);
+    }
+    Circulation circulation(library, LIMIT);
+
+    // Reference: who has each copy (due day 0 while held), the hold queues and the loan counts
+    // Each patron holds a title at most once, queued or as a copy held for them
+    vector<int> holder(COPIES, -1);
+    vector<uint32_t> due(COPIES, 0);
+    map<int, deque<int>> queues;
+    vector<int> loans(PATRONS, 0);
+    mt19937 random(7);
+    for (int step = 0; step < 100000; step++) {
+        int copy = static_cast<int>(random() % COPIES);
+        int patron = static_cast<int>(random() % PATRONS);
+        snprintf(id, sizeof(id), "C%d", copy);
+        int operation = static_cast<int>(random() % 8);
+        if (operation < 4) {
+            uint32_t dueDay = 1 + random() % 100;
+            CirculationResult expected = CIRC_OK;
+            if (holder[copy] != -1 && due[copy] != 0) {
+                expected = CIRC_ON_LOAN;
+            } else if (holder[copy] != -1 && holder[copy] != patron) {
+                expected = CIRC_ON_HOLD;
+            } else if (loans[patron] >= LIMIT) {
+                expected = CIRC_LOAN_LIMIT;
+            }
+            CHECK(circulation.checkout(id, patron, dueDay) == expected);
+            if (expected == CIRC_OK) {
+                holder[copy] = patron;
+                due[copy] = dueDay;
+                loans[patron]++;
+            }
+        } else if (operation < 7) {
+            int holdPatron = -2;
+            CirculationResult result = circulation.returnCopy(id, holdPatron);
+            if (holder[copy] == -1 || due[copy] == 0) {
+                CHECK(result == CIRC_NOT_ON_LOAN);
+            } else {
+                CHECK(result == CIRC_OK);
+                loans[holder[copy]]--;
+                deque<int>& waiting = queues[copy % TITLES];
+                holder[copy] = waiting.empty() ? -1 : waiting.front();
+                due[copy] = 0;
+                if (!waiting.empty()) {
+                    waiting.pop_front();
+                }
+                CHECK(holdPatron == holder[copy]);
+            }
+        } else {
+            int title = static_cast<int>(random() % TITLES);
+            deque<int>& waiting = queues[title];
+            deque<int>::iterator queued = find(waiting.begin(), waiting.end(), patron);
+            int heldCopy = -1;
+            for (int c = title; c < COPIES; c += TITLES) {
+                if (holder[c] == patron && due[c] == 0) {
+                    heldCopy = c;
+                }
+            }
+            if (random() % 2 == 0) {
+                CirculationResult expected = queued != waiting.end() || heldCopy != -1 ? CIRC_DUPLICATE_HOLD : CIRC_OK;
+                CHECK(circulation.placeHold(isbns[title], patron) == expected);
+                if (expected == CIRC_OK) {
+                    waiting.push_back(patron);
+                }
+            } else if (queued != waiting.end()) {
+                CHECK(circulation.cancelHold(isbns[title], patron) == CIRC_OK);
+                waiting.erase(queued);
+            } else if (heldCopy != -1) {
+                // The held copy passes to the next patron waiting, or back to the shelf
+                CHECK(circulation.cancelHold(isbns[title], patron) == CIRC_OK);
+                holder[heldCopy] = waiting.empty() ? -1 : waiting.front();
+                if (!waiting.empty()) {
+                    waiting.pop_front();
+                }
+            } else {
+                CHECK(circulation.cancelHold(isbns[title], patron) == CIRC_NO_HOLD);
+            }
+        }
+
+        if (step % 5000 == 0) {
+            for (int p = 0; p < PATRONS; p++) {
+                vector<pair<string, uint32_t>> listed;
+                circulation.forEachLoan(p, collectLoan, &listed);
+                CHECK(circulation.getLoanCount(p) == loans[p]);
+                CHECK(static_cast<int>(listed.size()) == loans[p]);
+                for (size_t i = 0; i < listed.size(); i++) {
+                    int c = atoi(listed[i].first.c_str() + 1);
+                    CHECK(holder[c] == p && due[c] == listed[i].second);
+                }
+            }
+            vector<int> holdCounts(PATRONS, 0);
+            for (int t = 0; t < TITLES; t++) {
+                CHECK(circulation.getWaitingCount(isbns[t]) == static_cast<int>(queues[t].size()));
+                for (int p : queues[t]) {
+                    holdCounts[p]++;
+                }
+            }
+            for (int c = 0; c < COPIES; c++) {
+                if (holder[c] != -1 && due[c] == 0) {
+                    holdCounts[holder[c]]++;
+                }
+            }
+            for (int p = 0; p < PATRONS; p++) {
+                CHECK(circulation.getHoldCount(p) == holdCounts[p]);
+            }
+        }
+    }
+}
+
+int main() {
+    testCheckoutAndReturn();
+    testLoanLimit();
+    testPatronLimit();
+    testReturnToHold();
+    testCancelHold();
+    testDuplicateHold();
+    testHoldExpiry();
+    testLoansSurviveReload();
+    testRandomAgainstModel();
+    return finishTest("test_circulation");
+}
@@ -0,0 +1,133 @@
+/**
+ * test_columnar.cpp - ColumnarLibrary column scans, lookups and compaction
+ * Random adds, edits that move books between categories, and deletes that fill the hole
+ * with the last row are checked against a reference map of the books present. A category
+ * scan must return, in row order, exactly the rows the ID index gives for the model's
+ * books of that category, stop at maxResults, and agree with the category counters.
+ */
+#include "test_util.h"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+const char* const CATEGORY_NAMES[] = { "Fiction", "Non-fiction" };
+const BookCategory CATEGORY_CODES[] = { CATEGORY_FICTION, CATEGORY_NON_FICTION };
+
+// Reference book: its category and title
+struct ModelBook {
+    int category; // Index into CATEGORY_NAMES
+    string title;
+};
+typedef map<string, ModelBook> Model;
+
+/**
+ * Helper function to check the columns, the ID index and the counters against the model
+ */
+static void checkColumns(const ColumnarLibrary& library, const Model& model) {
+    CHECK(library.getCount() == static_cast<int>(model.size()));
+    vector<int> rows(model.size() + 1);
+    for (int c = 0; c < 2; c++) {
+        // The rows the scan must find, in row order
+        vector<int> expected;
+        for (Model::const_iterator it = model.begin(); it != model.end(); ++it) {
+            if (it->second.category == c) {
+                expected.push_back(library.findBookById(it->first.c_str()));
+            }
+        }
+        sort(expected.begin(), expected.end());
+        int found = library.findBooksByCategory(CATEGORY_CODES[c], rows.data(), static_cast<int>(rows.size()));
+        CHECK(vector<int>(rows.begin(), rows.begin() + found) == expected);
+        CHECK(library.getCountByCategory(CATEGORY_NAMES[c]) == static_cast<int>(expected.size()));
+
+        // A short buffer takes the first matches only
+        int limit = static_cast<int>(expected.size() / 2);
+        CHECK(library.findBooksByCategory(CATEGORY_CODES[c], rows.data(), limit) == limit);
+        CHECK(vector<int>(rows.begin(), rows.begin() + limit) ==
+              vector<int>(expected.begin(), expected.begin() + limit));
+    }
+    CHECK(library.findBooksByCategory(CATEGORY_NONE, rows.data(), static_cast<int>(rows.size())) == 0);
+
+    // Every book reads back whole, into a pool of the test's own
+    StringPool pool;
+    bool same = true;
+    for (Model::const_iterator it = model.begin(); it != model.end(); ++it) {
+        Book book(pool);
+        same = same && library.getBookById(it->first.c_str(), book) && it->second.title == book.getTitle() &&
+               strcmp(book.getCategory(), CATEGORY_NAMES[it->second.category]) == 0;
+    }
+    CHECK(same);
+}
+
+/**
+ * Helper function to fill a book with a title and category
+ */
+static void fillBook(Book& book, const string& id, const ModelBook& entry) {
+    CHECK(makeBook(book, id.c_str(), "9780306406157", entry.title.c_str(), "Author",
+                   CATEGORY_NAMES[entry.category]));
+}
+
+static void testRandomChanges() {
+    ColumnarLibrary library(4);
+    Model model;
+    mt19937 random(10);
+    const int IDS = 500;
+    for (int op = 0; op < 6000; op++) {
+        string id = "M" + to_string(random() % IDS);
+        Model::iterator existing = model.find(id);
+        ModelBook entry = { static_cast<int>(random() % 3 == 0 ? 1 : 0), "Title " + to_string(op) };
+        Book book;
+        fillBook(book, id, entry);
+        if (existing == model.end()) {
+            CHECK(library.addBook(book));
+            model[id] = entry;
+        } else if (random() % 3 == 0) {
+            CHECK(library.deleteBook(id.c_str()));
+            model.erase(existing);
+        } else {
+            // An edit may move the book to the other category's scan
+            CHECK(library.editBook(id.c_str(), book));
+            existing->second = entry;
+        }
+        if (op % 500 == 0) {
+            checkColumns(library, model);
+        }
+    }
+    checkColumns(library, model);
+
+    // Compaction drops the text of edited and deleted books and keeps the rest readable
+    CHECK(library.compact());
+    checkColumns(library, model);
+}
+
+static void testEmptyAndFull() {
+    ColumnarLibrary library(2);
+    Model model;
+    checkColumns(library, model);
+    int rows[4];
+    CHECK(library.findBooksByCategory(CATEGORY_FICTION, rows, 4) == 0);
+
+    // A category holding every book, and a delete that fills the first row
+    for (int i = 0; i < 3; i++) {
+        string id = "F" + to_string(i);
+        ModelBook entry = { 0, "Only fiction" };
+        Book book;
+        fillBook(book, id, entry);
+        CHECK(library.addBook(book));
+        model[id] = entry;
+    }
+    checkColumns(library, model);
+    CHECK(library.findBooksByCategory(CATEGORY_FICTION, rows, 4) == 3);
+    CHECK(rows[0] == 0 && rows[1] == 1 && rows[2] == 2);
+    CHECK(library.deleteBook("F0"));
+    model.erase("F0");
+    CHECK(library.findBookById("F2") == 0); // The last row filled the hole
+    checkColumns(library, model);
+}
+
+int main() {
+    testRandomChanges();
+    testEmptyAndFull();
+    return finishTest("test_columnar");
+}
@@ -0,0 +1,186 @@
+/**
+ * test_concurrent.cpp - ConcurrentLibrary lookups from many threads while one thread writes
+ * The writer adds, edits, patches and deletes books whose title and author carry the same
+ * version number, increasing with every change. Reader threads look books up in place
+ * through visitBookById and copy them out through getBookById into pools of their own; a
+ * book whose title and author disagree was read torn, and a version lower than one the
+ * same reader saw before went back in time. Nothing may touch bookFieldPool() meanwhile.
+ * Run under -fsanitize=thread to check the locking as well.
+ */
+#include "test_util.h"
+#include <atomic>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int IDS = 400;
+const char* const TEST_ISBNS[] = { "9780306406157", "9781402894626" };
+
+// Shared state of the readers
+struct Readers {
+    atomic<bool> done;
+    atomic<int> lookups;
+    atomic<int> torn;
+    atomic<int> backwards;
+};
+
+/**
+ * Helper function to read the version a book was written with, or -1 if its fields disagree
+ */
+static int versionOf(const Book& book) {
+    int titleVersion = atoi(book.getTitle() + 1);
+    int authorVersion = atoi(book.getAuthor() + 1);
+    return titleVersion == authorVersion ? titleVersion : -1;
+}
+
+// Book visitor that records the version of the book visited
+static bool readVersion(const Book& book, void* context) {
+    *static_cast<int*>(context) = versionOf(book);
+    return true;
+}
+
+/**
+ * Helper function for a reader thread: looks up random IDs in place and by copy
+ */
+static void readBooks(const ConcurrentLibrary* library, Readers* readers, unsigned seed) {
+    mt19937 random(seed);
+    StringPool pool;
+    vector<int> lastSeen(IDS, -1);
+    char id[MAX_ID_LENGTH];
+    while (!readers->done) {
+        int number = static_cast<int>(random() % IDS);
+        snprintf(id, sizeof(id), "V%d", number);
+        int version = -2;
+        bool found;
+        if (random() % 2 == 0) {
+            found = library->visitBookById(id, readVersion, &version);
+        } else {
+            Book copy(pool);
+            found = library->getBookById(id, copy);
+            if (found) {
+                version = versionOf(copy);
+            }
+        }
+        if (found) {
+            if (version == -1) {
+                readers->torn++;
+            } else if (version < lastSeen[number]) {
+                readers->backwards++;
+            } else {
+                lastSeen[number] = version;
+            }
+        }
+        readers->lookups++;
+    }
+}
+
+/**
+ * Helper function to fill a book of the writer's pool at a version
+ */
+static void makeVersion(Book& book, const char* id, int version) {
+    string title = "T" + to_string(version);
+    string author = "A" + to_string(version);
+    CHECK(makeBook(book, id, TEST_ISBNS[version % 2], title.c_str(), author.c_str()));
+}
+
+static void testReadersAndWriter() {
+    const int READERS = 4;
+    const int OPERATIONS = 20000;
+    ConcurrentLibrary library;
+    size_t sharedPoolBytes = bookFieldPool().getUsedBytes();
+
+    Readers readers;
+    readers.done = false;
+    readers.lookups = 0;
+    readers.torn = 0;
+    readers.backwards = 0;
+    vector<thread> threads;
+    for (int r = 0; r < READERS; r++) {
+        threads.push_back(thread(readBooks, &library, &readers, 100 + r));
+    }
+
+    // The writer keeps its text in a pool of its own too
+    StringPool writerPool;
+    map<string, int> model; // ID -> version of every book present
+    mt19937 random(9);
+    char id[MAX_ID_LENGTH];
+    for (int version = 0; version < OPERATIONS; version++) {
+        snprintf(id, sizeof(id), "V%d", static_cast<int>(random() % IDS));
+        Book book(writerPool);
+        makeVersion(book, id, version);
+        int kind = static_cast<int>(random() % 4);
+        if (model.count(id) == 0) {
+            CHECK(library.addBook(book));
+        } else if (kind == 0) {
+            CHECK(library.deleteBook(id));
+            model.erase(id);
+            continue;
+        } else if (kind == 1) {
+            CHECK(library.editBook(id, book));
+        } else {
+            // Title and author change in one patch, under one lock
+            BookPatch patch(writerPool);
+            CHECK(patch.setTitle(book.getTitle()) && patch.setAuthor(book.getAuthor()));
+            CHECK(library.patchBook(id, patch));
+        }
+        model[id] = version;
+    }
+    readers.done = true;
+    for (thread& reader : threads) {
+        reader.join();
+    }
+    CHECK(readers.lookups > 0);
+    CHECK(readers.torn == 0);
+    CHECK(readers.backwards == 0);
+    CHECK(bookFieldPool().getUsedBytes() == sharedPoolBytes);
+
+    // Afterwards every book holds the version written last
+    CHECK(library.getCount() == static_cast<int>(model.size()));
+    bool matches = true;
+    for (int number = 0; number < IDS; number++) {
+        snprintf(id, sizeof(id), "V%d", number);
+        int version = -2;
+        bool found = library.visitBookById(id, readVersion, &version);
+        map<string, int>::const_iterator expected = model.find(id);
+        matches = matches && found == (expected != model.end()) && (!found || version == expected->second);
+    }
+    CHECK(matches);
+}
+
+static void testCopiesIntoAnyPool() {
+    ConcurrentLibrary library;
+    Book book;
+    CHECK(makeBook(book, "P1", TEST_ISBNS[0], "T1", "A1"));
+    CHECK(library.addBook(book));
+
+    // A copy into the shared pool is made as Library makes it; a missing book is just missing
+    Book shared;
+    CHECK(library.getBookById("P1", shared) && strcmp(shared.getTitle(), "T1") == 0);
+    Book sharedByIsbn;
+    CHECK(library.getBookByIsbn(9780306406157ULL, sharedByIsbn) && strcmp(sharedByIsbn.getId(), "P1") == 0);
+    CHECK(!library.getBookById("P2", shared) && !library.getBookByIsbn(9781402894626ULL, shared));
+    CHECK(strcmp(shared.getId(), "P1") == 0);
+
+    // So is a copy into the caller's pool
+    StringPool pool;
+    Book own(pool);
+    CHECK(library.getBookById("P1", own) && strcmp(own.getTitle(), "T1") == 0);
+    Book byIsbn(pool);
+    CHECK(library.getBookByIsbn(9780306406157ULL, byIsbn) && strcmp(byIsbn.getId(), "P1") == 0);
+    CHECK(!library.getBookById("P2", own));
+
+    // The in-place path needs no pool at all
+    int version = -2;
+    CHECK(library.visitBookById("P1", readVersion, &version) && version == 1);
+    CHECK(!library.visitBookById("P2", readVersion, &version));
+    CHECK(!library.visitBookById(nullptr, readVersion, &version));
+    CHECK(!library.visitBookById("P1", nullptr, nullptr));
+}
+
+int main() {
+    testReadersAndWriter();
+    testCopiesIntoAnyPool();
+    return finishTest("test_concurrent");
+}
@@ -0,0 +1,252 @@
+/**
+ * test_cursors.cpp - BookCursor paging while books are added, edited and deleted
+ * A reference list of IDs by serial (insertion order, empty once deleted) gives the exact
+ * page each fetch must return from the cursor's serial. Across a whole listing no book is returned
+ * twice, and every book present from start to end is returned once, however the library
+ * changed between pages. Snapshot cursors must list the snapshot whatever happens after it.
+ */
+#include "test_util.h"
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+const char* const CATEGORY_NAMES[] = { "Fiction", "Non-fiction" };
+
+// Reference row: the book given that serial, if it is still there
+struct ModelRow {
+    string id;      // Empty once the book is deleted
+    int category;   // Index into CATEGORY_NAMES
+};
+
+/**
+ * Helper function to list the next live rows of the model after a cursor, as fetchPage must
+ */
+static vector<string> expectedPage(const vector<ModelRow>& rows, const BookCursor& cursor, int pageSize) {
+    vector<string> page;
+    for (size_t row = cursor.nextSerial; row < rows.size() && static_cast<int>(page.size()) < pageSize; row++) {
+        bool wanted = cursor.category == CATEGORY_NONE ||
+                      parseCategory(CATEGORY_NAMES[rows[row].category]) == cursor.category;
+        if (!rows[row].id.empty() && wanted) {
+            page.push_back(rows[row].id);
+        }
+    }
+    return page;
+}
+
+/**
+ * Helper function to add a numbered book to the library and the model
+ */
+static void addNumbered(Library& library, vector<ModelRow>& rows, int number, int category) {
+    Book book;
+    char id[MAX_ID_LENGTH];
+    snprintf(id, sizeof(id), "C%d", number);
+    CHECK(makeBook(book, id, "9780306406157", "Title", "Author", CATEGORY_NAMES[category]));
+    CHECK(library.addBook(book));
+    ModelRow row = { id, category };
+    rows.push_back(row);
+}
+
+/**
+ * Helper function to delete a random live book, if there is one
+ */
+static void deleteRandom(Library& library, vector<ModelRow>& rows, mt19937& random) {
+    for (int attempt = 0; attempt < 8; attempt++) {
+        ModelRow& row = rows[random() % rows.size()];
+        if (!row.id.empty()) {
+            CHECK(library.deleteBook(row.id.c_str()));
+            row.id.clear();
+            return;
+        }
+    }
+}
+
+static void testPagingUnderChanges(Library::DeleteOrder order, BookCategory filter, unsigned seed) {
+    Library library(16);
+    library.setDeleteOrder(order);
+    vector<ModelRow> rows;
+    mt19937 random(seed);
+    int added = 0;
+    for (; added < 400; added++) {
+        addNumbered(library, rows, added, added % 3 == 0 ? 1 : 0);
+    }
+
+    for (int listing = 0; listing < 20; listing++) {
+        // Books present for the whole listing must each be seen exactly once
+        set<string> present;
+        for (const ModelRow& row : rows) {
+            if (!row.id.empty()) {
+                present.insert(row.id);
+            }
+        }
+        set<string> seen;
+        bool repeated = false;
+        BookCursor cursor(filter);
+        Book page[32];
+        for (;;) {
+            int pageSize = 1 + static_cast<int>(random() % 32);
+            vector<string> expected = expectedPage(rows, cursor, pageSize);
+            int found = library.fetchPage(cursor, page, pageSize);
+            vector<string> ids;
+            for (int i = 0; i < found; i++) {
+                ids.push_back(page[i].getId());
+                repeated = repeated || !seen.insert(ids.back()).second;
+            }
+            CHECK(ids == expected);
+            if (found == 0) {
+                break;
+            }
+
+            // Change the library between pages: adds land after every existing row
+            int changes = static_cast<int>(random() % 6);
+            for (int c = 0; c < changes; c++) {
+                int kind = static_cast<int>(random() % 4);
+                if (kind < 2) {
+                    addNumbered(library, rows, added++, static_cast<int>(random() % 2));
+                } else if (kind == 2) {
+                    deleteRandom(library, rows, random);
+                } else {
+                    // Edits keep the row; a category change moves the book in or out of a filter
+                    ModelRow& row = rows[random() % rows.size()];
+                    if (!row.id.empty()) {
+                        BookPatch patch;
+                        row.category = static_cast<int>(random() % 2);
+                        CHECK(patch.setCategory(CATEGORY_NAMES[row.category]));
+                        CHECK(library.patchBook(row.id.c_str(), patch));
+                    }
+                }
+            }
+        }
+        CHECK(!repeated);
+        // A category patch can take a book out of a filtered listing, so only the full one
+        // is checked for missed books
+        bool complete = true;
+        for (const ModelRow& row : rows) {
+            if (filter == CATEGORY_NONE && !row.id.empty() && present.count(row.id) > 0) {
+                complete = complete && seen.count(row.id) > 0;
+            }
+        }
+        CHECK(complete);
+        // A finished cursor stays finished until more books arrive
+        CHECK(library.fetchPage(cursor, page, 4) == 0);
+        addNumbered(library, rows, added++, 0);
+        CHECK(library.fetchPage(cursor, page, 4) == (filter == CATEGORY_NON_FICTION ? 0 : 1));
+    }
+}
+
+static void testStoredCursor() {
+    // A cursor can be stored as its serial and picked up later
+    Library library;
+    vector<ModelRow> rows;
+    for (int i = 0; i < 50; i++) {
+        addNumbered(library, rows, i, 0);
+    }
+    BookCursor first;
+    Book page[10];
+    CHECK(library.fetchPage(first, page, 10) == 10);
+    BookCursor resumed(CATEGORY_NONE, first.nextSerial);
+    CHECK(library.fetchPage(resumed, page, 10) == 10);
+    CHECK(strcmp(page[0].getId(), "C10") == 0 && strcmp(page[9].getId(), "C19") == 0);
+    BookCursor negative(CATEGORY_NONE, -5);
+    CHECK(library.fetchPage(negative, page, 1) == 1 && strcmp(page[0].getId(), "C0") == 0);
+    CHECK(library.fetchPage(negative, page, 0) == 0);
+
+    // clear() empties the library; a new cursor lists only the new books
+    library.clear();
+    rows.clear();
+    addNumbered(library, rows, 100, 0);
+    BookCursor fresh;
+    CHECK(library.fetchPage(fresh, page, 10) == 1 && strcmp(page[0].getId(), "C100") == 0);
+}
+
+static void testSparseCategory() {
+    // A rare category among many deleted rows: pages come from the row bitmaps, across
+    // whole words of rows with no match, and must still be exact
+    Library library(64);
+    vector<ModelRow> rows;
+    for (int i = 0; i < 5000; i++) {
+        addNumbered(library, rows, i, i % 97 == 5 ? 1 : 0);
+    }
+    for (int i = 0; i < 5000; i++) {
+        if (i % 10 != 0 && i % 97 != 5) {
+            CHECK(library.deleteBook(rows[i].id.c_str()));
+            rows[i].id.clear();
+        }
+    }
+    // A patched book joins the category at its old row
+    BookPatch patch;
+    CHECK(patch.setCategory(CATEGORY_NAMES[1]));
+    CHECK(library.patchBook(rows[2500].id.c_str(), patch));
+    rows[2500].category = 1;
+
+    const BookCategory filters[] = { CATEGORY_NON_FICTION, CATEGORY_FICTION, CATEGORY_NONE };
+    for (BookCategory filter : filters) {
+        BookCursor cursor(filter);
+        BookCursor whole(filter);
+        vector<string> expected = expectedPage(rows, whole, static_cast<int>(rows.size()));
+        vector<string> listed;
+        Book page[7];
+        int found;
+        while ((found = library.fetchPage(cursor, page, 7)) > 0) {
+            for (int i = 0; i < found; i++) {
+                listed.push_back(page[i].getId());
+            }
+        }
+        CHECK(listed == expected);
+    }
+    CHECK(library.getCountByCategory("Non-fiction") == 53);
+}
+
+static void testSnapshotPaging() {
+    Library library(8);
+    library.enableSnapshots();
+    vector<ModelRow> rows;
+    mt19937 random(17);
+    int added = 0;
+    for (; added < 300; added++) {
+        addNumbered(library, rows, added, added % 2);
+    }
+    for (int round = 0; round < 10; round++) {
+        shared_ptr<const CatalogSnapshot> snapshot = library.snapshot();
+        vector<ModelRow> frozen = rows;
+        BookCursor cursor(round % 2 == 0 ? CATEGORY_NONE : CATEGORY_FICTION);
+        Book page[16];
+        vector<string> listed;
+        for (;;) {
+            int pageSize = 1 + static_cast<int>(random() % 16);
+            vector<string> expected = expectedPage(frozen, cursor, pageSize);
+            int found = snapshot->fetchPage(cursor, page, pageSize);
+            vector<string> ids;
+            for (int i = 0; i < found; i++) {
+                ids.push_back(page[i].getId());
+            }
+            CHECK(ids == expected);
+            listed.insert(listed.end(), ids.begin(), ids.end());
+            if (found == 0) {
+                break;
+            }
+            // The library moves on; the snapshot does not
+            for (int c = 0; c < 3; c++) {
+                if (random() % 2 == 0) {
+                    addNumbered(library, rows, added++, static_cast<int>(random() % 2));
+                } else {
+                    deleteRandom(library, rows, random);
+                }
+            }
+        }
+        // The pages together are the whole listing as of the snapshot
+        BookCursor whole(cursor.category);
+        CHECK(listed == expectedPage(frozen, whole, static_cast<int>(frozen.size())));
+    }
+}
+
+int main() {
+    testPagingUnderChanges(Library::PRESERVE_ORDER, CATEGORY_NONE, 21);
+    testPagingUnderChanges(Library::SWAP_WITH_LAST, CATEGORY_NONE, 22);
+    testPagingUnderChanges(Library::SWAP_WITH_LAST, CATEGORY_FICTION, 23);
+    testPagingUnderChanges(Library::PRESERVE_ORDER, CATEGORY_NON_FICTION, 24);
+    testStoredCursor();
+    testSparseCategory();
+    testSnapshotPaging();
+    return finishTest("test_cursors");
+}
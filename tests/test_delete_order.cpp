@@ -0,0 +1,180 @@
+/**
+ * test_delete_order.cpp - the slot contracts of PRESERVE_ORDER and SWAP_WITH_LAST
+ * A reference array of IDs by slot is updated the way each policy promises: PRESERVE_ORDER
+ * closes the hole by shifting, SWAP_WITH_LAST moves only the last book into it. After each
+ * delete, single or batched, the listing and every index must agree with the array.
+ */
+#include "test_util.h"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+const char* const TEST_ISBNS[] = { "9780306406157", "9781402894626", "9780131103627" };
+
+// Book visitor that collects titles in listing order
+static bool collectTitle(const Book& book, void* context) {
+    static_cast<vector<string>*>(context)->push_back(book.getTitle());
+    return true;
+}
+
+/**
+ * Helper function to check the library's slots and indexes against the reference array
+ * isbnOf gives the ISBN index each ID was added with.
+ */
+static void checkSlots(const Library& library, const vector<string>& slots, const map<string, int>& isbnOf) {
+    vector<string> listed;
+    library.forEachBook(collectId, &listed);
+    CHECK(listed == slots);
+    bool indexed = true;
+    for (size_t s = 0; s < slots.size(); s++) {
+        indexed = indexed && library.findBookById(slots[s].c_str()) == static_cast<int>(s);
+    }
+    CHECK(indexed);
+
+    // Each ISBN lookup returns exactly the slots now holding that ISBN
+    int found[4096];
+    for (int i = 0; i < 3; i++) {
+        uint64_t isbn = 0;
+        CHECK(parseIsbn(TEST_ISBNS[i], isbn));
+        vector<int> expected;
+        for (size_t s = 0; s < slots.size(); s++) {
+            if (isbnOf.at(slots[s]) == i) {
+                expected.push_back(static_cast<int>(s));
+            }
+        }
+        int count = library.findBooksByIsbn(isbn, found, 4096);
+        vector<int> actual(found, found + count);
+        sort(actual.begin(), actual.end());
+        CHECK(actual == expected);
+    }
+}
+
+/**
+ * Helper function to fill a library and the reference array with numbered books
+ */
+static void fill(Library& library, vector<string>& slots, map<string, int>& isbnOf, int first, int bookCount) {
+    Book book;
+    char id[MAX_ID_LENGTH];
+    char title[32];
+    for (int i = first; i < first + bookCount; i++) {
+        snprintf(id, sizeof(id), "D%d", i);
+        snprintf(title, sizeof(title), "Title %d", i);
+        CHECK(makeBook(book, id, TEST_ISBNS[i % 3], title));
+        CHECK(library.addBook(book));
+        slots.push_back(id);
+        isbnOf[id] = i % 3;
+    }
+}
+
+static void testSingleDeletes(Library::DeleteOrder order, unsigned seed) {
+    Library library(8);
+    library.setDeleteOrder(order);
+    CHECK(library.getDeleteOrder() == order);
+    library.enableOrderIndex(SORT_BY_TITLE);
+    vector<string> slots;
+    map<string, int> isbnOf;
+    fill(library, slots, isbnOf, 0, 600);
+    mt19937 random(seed);
+    int added = 600;
+    for (int op = 0; op < 900; op++) {
+        if (slots.empty() || random() % 4 == 0) {
+            fill(library, slots, isbnOf, added++, 1);
+            continue;
+        }
+        // Deletes at the front, the back and in between
+        int pick = static_cast<int>(random() % 5);
+        int index = pick == 0 ? 0 : pick == 1 ? static_cast<int>(slots.size()) - 1
+                                              : static_cast<int>(random() % slots.size());
+        string id = slots[index];
+        CHECK(library.deleteBook(id.c_str()));
+        CHECK(!library.deleteBook(id.c_str()));
+        modelDelete(slots, index, order);
+        if (op % 25 == 0) {
+            checkSlots(library, slots, isbnOf);
+        }
+    }
+    checkSlots(library, slots, isbnOf);
+
+    // The order index follows the moved books: every title, in sorted order
+    vector<string> sorted;
+    CHECK(library.forEachBookSorted(SORT_BY_TITLE, nullptr, nullptr, collectTitle, &sorted));
+    CHECK(sorted.size() == slots.size());
+    CHECK(is_sorted(sorted.begin(), sorted.end()));
+}
+
+static void testBatchDeletes(Library::DeleteOrder order, unsigned seed) {
+    Library library(8);
+    library.setDeleteOrder(order);
+    vector<string> slots;
+    map<string, int> isbnOf;
+    fill(library, slots, isbnOf, 0, 1000);
+    mt19937 random(seed);
+    int added = 1000;
+    for (int round = 0; round < 40; round++) {
+        // A batch with repeats and missing IDs; entries apply in order
+        int batchCount = 1 + static_cast<int>(random() % 40);
+        vector<string> ids(batchCount);
+        vector<const char*> idPointers(batchCount);
+        vector<ItemOutcome> expected(batchCount);
+        int expectedDeleted = 0;
+        for (int i = 0; i < batchCount; i++) {
+            char id[MAX_ID_LENGTH];
+            snprintf(id, sizeof(id), "D%d", static_cast<int>(random() % (added + 10)));
+            ids[i] = id;
+            idPointers[i] = ids[i].c_str();
+            int index = slotOf(slots, ids[i]);
+            if (index == -1) {
+                expected[i] = ITEM_NOT_FOUND;
+            } else {
+                expected[i] = ITEM_DELETED;
+                expectedDeleted++;
+                // A batch under PRESERVE_ORDER compacts once at the end, which gives the same
+                // order as shifting after each delete
+                modelDelete(slots, index, order);
+            }
+        }
+        vector<ItemOutcome> outcomes(batchCount, ITEM_FAILED);
+        CHECK(library.deleteBooks(idPointers.data(), batchCount, outcomes.data()) == expectedDeleted);
+        CHECK(outcomes == expected);
+        checkSlots(library, slots, isbnOf);
+        fill(library, slots, isbnOf, added, 10);
+        added += 10;
+    }
+}
+
+static void testSwitchingPolicy() {
+    // A policy applies to the deletes made under it; earlier slots are left as they are
+    Library library(8);
+    vector<string> slots;
+    map<string, int> isbnOf;
+    fill(library, slots, isbnOf, 0, 10);
+    CHECK(library.getDeleteOrder() == Library::PRESERVE_ORDER);
+    CHECK(library.deleteBook("D2"));
+    modelDelete(slots, 2, Library::PRESERVE_ORDER);
+    library.setDeleteOrder(Library::SWAP_WITH_LAST);
+    CHECK(library.deleteBook("D4"));
+    modelDelete(slots, 3, Library::SWAP_WITH_LAST);
+    library.setDeleteOrder(Library::PRESERVE_ORDER);
+    CHECK(library.deleteBook("D0"));
+    modelDelete(slots, 0, Library::PRESERVE_ORDER);
+    checkSlots(library, slots, isbnOf);
+    const char* expected[] = { "D1", "D3", "D9", "D5", "D6", "D7", "D8" };
+    CHECK(slots == vector<string>(expected, expected + 7));
+
+    // Deleting the last book under SWAP_WITH_LAST moves nothing
+    library.setDeleteOrder(Library::SWAP_WITH_LAST);
+    CHECK(library.deleteBook("D8"));
+    modelDelete(slots, 6, Library::SWAP_WITH_LAST);
+    checkSlots(library, slots, isbnOf);
+}
+
+int main() {
+    testSingleDeletes(Library::PRESERVE_ORDER, 1);
+    testSingleDeletes(Library::SWAP_WITH_LAST, 2);
+    testBatchDeletes(Library::PRESERVE_ORDER, 3);
+    testBatchDeletes(Library::SWAP_WITH_LAST, 4);
+    testSwitchingPolicy();
+    return finishTest("test_delete_order");
+}
@@ -0,0 +1,179 @@
+/**
+ * test_growth.cpp - Library storage growth, reserve and shrinkToFit
+ * Books are added and deleted against a reference list in insertion order; after every
+ * resize the capacity is checked against the count and every book is looked up again
+ * through the ID, ISBN and category indexes.
+ */
+#include "test_util.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+const char* const TEST_ISBNS[] = { "9780306406157", "9781402894626" };
+const char* const TEST_CATEGORIES[] = { "Fiction", "Non-fiction" };
+
+// Reference book: what a listing must show for it
+struct ModelBook {
+    string id;
+    int isbn;     // Index into TEST_ISBNS
+    int category; // Index into TEST_CATEGORIES
+};
+
+// Book visitor that counts the books it is shown
+static bool countBook(const Book&, void* context) {
+    (*static_cast<int*>(context))++;
+    return true;
+}
+
+/**
+ * Helper function to check the library against the model: listing order, lookups and indexes
+ */
+static void checkAgainstModel(const Library& library, const vector<ModelBook>& model) {
+    CHECK(library.getCount() == static_cast<int>(model.size()));
+    CHECK(library.getCapacity() >= library.getCount());
+    vector<string> listed;
+    library.forEachBook(collectId, &listed);
+    bool sameOrder = listed.size() == model.size();
+    int isbnCounts[2] = { 0, 0 };
+    for (size_t i = 0; sameOrder && i < model.size(); i++) {
+        sameOrder = listed[i] == model[i].id && library.findBookById(model[i].id.c_str()) == static_cast<int>(i);
+        isbnCounts[model[i].isbn]++;
+    }
+    CHECK(sameOrder);
+
+    int* slots = new int[model.size() + 1];
+    for (int s = 0; s < 2; s++) {
+        uint64_t isbn = 0;
+        CHECK(parseIsbn(TEST_ISBNS[s], isbn));
+        CHECK(library.findBooksByIsbn(isbn, slots, static_cast<int>(model.size()) + 1) == isbnCounts[s]);
+    }
+    delete[] slots;
+    for (int c = 0; c < 2; c++) {
+        int expected = 0;
+        for (const ModelBook& book : model) {
+            expected += book.category == c ? 1 : 0;
+        }
+        int seen = 0;
+        library.forEachBookInCategory(parseCategory(TEST_CATEGORIES[c]), countBook, &seen);
+        CHECK(seen == expected);
+    }
+}
+
+/**
+ * Helper function to add a numbered book to the library and the model
+ */
+static bool addNumbered(Library& library, vector<ModelBook>& model, int number) {
+    ModelBook entry;
+    char id[MAX_ID_LENGTH];
+    snprintf(id, sizeof(id), "G%d", number);
+    entry.id = id;
+    entry.isbn = number % 2;
+    entry.category = number % 3 == 0 ? 1 : 0;
+    Book book;
+    CHECK(makeBook(book, id, TEST_ISBNS[entry.isbn], "Title", "Author", TEST_CATEGORIES[entry.category]));
+    if (!library.addBook(book)) {
+        return false;
+    }
+    model.push_back(entry);
+    return true;
+}
+
+static void testGrowsFromOne() {
+    const int BOOKS = 20000;
+    Library library(1);
+    CHECK(library.getCapacity() == 1);
+    vector<ModelBook> model;
+    int resizes = 0;
+    int capacity = library.getCapacity();
+    for (int i = 0; i < BOOKS; i++) {
+        CHECK(addNumbered(library, model, i));
+        if (library.getCapacity() != capacity) {
+            // Doubling: amortized O(1) appends
+            CHECK(library.getCapacity() >= 2 * capacity);
+            capacity = library.getCapacity();
+            resizes++;
+        }
+        if ((i & (i + 1)) == 0) {
+            checkAgainstModel(library, model);
+        }
+    }
+    CHECK(resizes <= 16);
+    checkAgainstModel(library, model);
+}
+
+static void testReserve() {
+    Library library(4);
+    vector<ModelBook> model;
+    library.reserve(5000);
+    CHECK(library.getCapacity() >= 5000);
+    int reserved = library.getCapacity();
+    for (int i = 0; i < 5000; i++) {
+        CHECK(addNumbered(library, model, i));
+    }
+    CHECK(library.getCapacity() == reserved);
+
+    // A smaller reserve never shrinks
+    library.reserve(10);
+    CHECK(library.getCapacity() == reserved);
+    checkAgainstModel(library, model);
+
+    // Invalid initial capacities fall back to the default
+    Library fallback(0);
+    CHECK(fallback.getCapacity() == DEFAULT_LIBRARY_CAPACITY);
+    Library negative(-5);
+    CHECK(negative.getCapacity() == DEFAULT_LIBRARY_CAPACITY);
+}
+
+static void testShrinkAfterMassDelete() {
+    const int BOOKS = 6000;
+    Library library;
+    vector<ModelBook> model;
+    for (int i = 0; i < BOOKS; i++) {
+        CHECK(addNumbered(library, model, i));
+    }
+
+    // Delete nine books in ten, in random order
+    mt19937 random(2);
+    vector<ModelBook> kept;
+    vector<string> doomed;
+    for (const ModelBook& book : model) {
+        if (random() % 10 != 0) {
+            doomed.push_back(book.id);
+        } else {
+            kept.push_back(book);
+        }
+    }
+    shuffle(doomed.begin(), doomed.end(), random);
+    for (const string& id : doomed) {
+        CHECK(library.deleteBook(id.c_str()));
+    }
+    model = kept;
+    checkAgainstModel(library, model);
+
+    library.shrinkToFit();
+    CHECK(library.getCapacity() == library.getCount());
+    checkAgainstModel(library, model);
+
+    // The fitted array grows again on the next add
+    CHECK(addNumbered(library, model, BOOKS));
+    checkAgainstModel(library, model);
+
+    // An empty library keeps one slot
+    for (const ModelBook& book : model) {
+        CHECK(library.deleteBook(book.id.c_str()));
+    }
+    model.clear();
+    library.shrinkToFit();
+    CHECK(library.getCapacity() == 1);
+    CHECK(addNumbered(library, model, 1));
+    CHECK(addNumbered(library, model, 2));
+    checkAgainstModel(library, model);
+}
+
+int main() {
+    testGrowsFromOne();
+    testReserve();
+    testShrinkAfterMassDelete();
+    return finishTest("test_growth");
+}
@@ -0,0 +1,189 @@
+/**
+ * test_id_index.cpp - IdIndex lookups after backward-shift deletes
+ * Random inserts, erases and slot moves are replayed against a std::map, from a key set
+ * small enough that the table stays at a few buckets, so probe runs are long and wrap
+ * around its end. Every key is looked up again after each change.
+ */
+#include "test_util.h"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Owner of the keys: the ID stored at each slot
+struct KeyTable {
+    vector<string> keys;
+};
+
+static const char* keyAt(const void* owner, int slot) {
+    return static_cast<const KeyTable*>(owner)->keys[slot].c_str();
+}
+
+/**
+ * Helper function to check every key of the universe against the model
+ */
+static void checkAgainstModel(const IdIndex& index, const KeyTable& table, const map<string, int>& model) {
+    CHECK(index.size() == static_cast<int>(model.size()));
+    for (size_t k = 0; k < table.keys.size(); k++) {
+        map<string, int>::const_iterator expected = model.find(table.keys[k]);
+        int found = index.find(table.keys[k].c_str());
+        CHECK(found == (expected != model.end() ? expected->second : -1));
+    }
+}
+
+/**
+ * Helper function to replay random operations on keys drawn from the first keyCount keys
+ * Each key lives at a slot of its own, and moves between two slots so updateSlot is covered.
+ */
+static void replay(unsigned seed, int keyCount, int operations) {
+    KeyTable table;
+    char key[MAX_ID_LENGTH];
+    // Slot 2k and 2k+1 both hold key k, so a move keeps keyAt consistent
+    for (int k = 0; k < keyCount; k++) {
+        snprintf(key, sizeof(key), "K%d", k);
+        table.keys.push_back(key);
+        table.keys.push_back(key);
+    }
+    KeyTable universe;
+    for (int k = 0; k < keyCount; k++) {
+        universe.keys.push_back(table.keys[2 * k]);
+    }
+
+    IdIndex index(&table, keyAt);
+    map<string, int> model;
+    mt19937 random(seed);
+    for (int op = 0; op < operations; op++) {
+        int k = static_cast<int>(random() % keyCount);
+        const char* id = table.keys[2 * k].c_str();
+        bool present = model.count(id) > 0;
+        int choice = static_cast<int>(random() % 3);
+        if (choice == 0) {
+            CHECK(index.insert(id, 2 * k) == !present);
+            if (!present) {
+                model[id] = 2 * k;
+            }
+        } else if (choice == 1) {
+            CHECK(index.erase(id) == present);
+            model.erase(id);
+        } else {
+            int moved = present && model[id] == 2 * k ? 2 * k + 1 : 2 * k;
+            CHECK(index.updateSlot(id, moved) == present);
+            if (present) {
+                model[id] = moved;
+            }
+        }
+        checkAgainstModel(index, universe, model);
+    }
+}
+
+static void testRandomAgainstModel() {
+    // 10 keys stay within 16 buckets: long, wrapping runs
+    replay(1, 10, 20000);
+    // More keys than the minimum table: growth and deletes across rehashes
+    replay(2, 400, 20000);
+}
+
+static void testEraseEveryOrder() {
+    // Fill to just below the load limit, erase in a random order, and check the rest each time
+    KeyTable table;
+    char key[MAX_ID_LENGTH];
+    for (int k = 0; k < 11; k++) {
+        snprintf(key, sizeof(key), "E%d", k);
+        table.keys.push_back(key);
+    }
+    mt19937 random(3);
+    for (int round = 0; round < 200; round++) {
+        IdIndex index(&table, keyAt);
+        map<string, int> model;
+        for (int k = 0; k < 11; k++) {
+            CHECK(index.insert(table.keys[k].c_str(), k));
+            model[table.keys[k]] = k;
+        }
+        vector<int> order;
+        for (int k = 0; k < 11; k++) {
+            order.push_back(k);
+        }
+        shuffle(order.begin(), order.end(), random);
+        for (int k : order) {
+            CHECK(index.erase(table.keys[k].c_str()));
+            CHECK(!index.erase(table.keys[k].c_str()));
+            model.erase(table.keys[k]);
+            checkAgainstModel(index, table, model);
+        }
+    }
+}
+
+static void testReserveShrinkAndClear() {
+    KeyTable table;
+    char key[MAX_ID_LENGTH];
+    for (int k = 0; k < 1000; k++) {
+        snprintf(key, sizeof(key), "R%d", k);
+        table.keys.push_back(key);
+    }
+    IdIndex index(&table, keyAt);
+    map<string, int> model;
+    index.reserve(1000);
+    for (int k = 0; k < 1000; k++) {
+        CHECK(index.insert(table.keys[k].c_str(), k));
+        model[table.keys[k]] = k;
+    }
+    for (int k = 0; k < 1000; k += 3) {
+        CHECK(index.erase(table.keys[k].c_str()));
+        model.erase(table.keys[k]);
+    }
+    index.shrinkToFit();
+    checkAgainstModel(index, table, model);
+    index.clear();
+    model.clear();
+    checkAgainstModel(index, table, model);
+    CHECK(index.insert("R1", 1));
+    CHECK(index.find("R1") == 1);
+}
+
+static void testLibraryIdLookups() {
+    // The index behind findBookById and isIdDuplicate, through deletes that move books
+    Library library(4);
+    library.setDeleteOrder(Library::SWAP_WITH_LAST);
+    map<string, string> model;
+    mt19937 random(4);
+    Book book;
+    char id[MAX_ID_LENGTH];
+    char title[32];
+    for (int op = 0; op < 5000; op++) {
+        snprintf(id, sizeof(id), "L%d", static_cast<int>(random() % 200));
+        if (random() % 2 == 0) {
+            snprintf(title, sizeof(title), "Title %d", op);
+            CHECK(makeBook(book, id, "9780306406157", title));
+            bool added = library.addBook(book);
+            CHECK(added == (model.count(id) == 0));
+            if (added) {
+                model[id] = title;
+            }
+        } else {
+            CHECK(library.deleteBook(id) == (model.erase(id) > 0));
+        }
+    }
+    CHECK(library.getCount() == static_cast<int>(model.size()));
+    for (int k = 0; k < 200; k++) {
+        snprintf(id, sizeof(id), "L%d", k);
+        map<string, string>::const_iterator expected = model.find(id);
+        CHECK(library.isIdDuplicate(id) == (expected != model.end()));
+        int slot = library.findBookById(id);
+        CHECK((slot != -1) == (expected != model.end()));
+        if (slot != -1 && expected != model.end()) {
+            CHECK(library.getBookById(id, book));
+            CHECK(expected->second == book.getTitle());
+        }
+    }
+    CHECK(library.findBookById("") == -1);
+    CHECK(library.findBookById(nullptr) == -1);
+}
+
+int main() {
+    testRandomAgainstModel();
+    testEraseEveryOrder();
+    testReserveShrinkAndClear();
+    testLibraryIdLookups();
+    return finishTest("test_id_index");
+}
@@ -0,0 +1,237 @@
+/**
+ * test_importer.cpp - CatalogImporter parsing, chunking and the rejection report
+ * Small files cover CSV quoting, bad quotes, header detection, CRLF endings, a last row
+ * without a newline, TSV and the per-line report. Files of several chunks place a CRLF
+ * row across the first chunk boundary and an over-long row in the middle, and a reference
+ * model of the rows says which books must be in the library afterwards.
+ */
+#include "test_util.h"
+#include <random>
+#include <string>
+#include <vector>
+
+const char* const IMPORT_PATH = "test_importer.csv";
+const char* const ROW_TAIL = ",9780306406157,\"Title\",Author,1st,Pub,Fiction";
+
+// Reference row: the book a valid row must add
+struct ModelRow {
+    string id;
+    string title;
+};
+
+static void writeFile(const char* path, const string& contents) {
+    FILE* file = fopen(path, "wb");
+    CHECK(file != nullptr);
+    if (file != nullptr) {
+        CHECK(fwrite(contents.data(), 1, contents.size(), file) == contents.size());
+        fclose(file);
+    }
+}
+
+/**
+ * Helper function to import a file's contents into a library
+ */
+static bool importText(Library& library, const string& contents, char delimiter, ImportReport& report) {
+    writeFile(IMPORT_PATH, contents);
+    CatalogImporter importer(library);
+    bool ok = importer.importFile(IMPORT_PATH, delimiter, report);
+    remove(IMPORT_PATH);
+    return ok;
+}
+
+/**
+ * Helper function to write a CSV row for a book with the given ID and title
+ * The title is quoted, with its quotes doubled.
+ */
+static string csvRow(const string& id, const string& title) {
+    string quoted;
+    for (char c : title) {
+        quoted += c;
+        if (c == '"') {
+            quoted += '"';
+        }
+    }
+    return id + ",978-0-306-40615-7,\"" + quoted + "\",Author,1st,Pub,Fiction";
+}
+
+/**
+ * Helper function to check the rows the library must hold and the report's totals
+ */
+static void checkImported(const Library& library, const vector<ModelRow>& rows, const ImportReport& report) {
+    CHECK(library.getCount() == static_cast<int>(rows.size()));
+    CHECK(report.rowsImported == static_cast<long>(rows.size()));
+    CHECK(report.rowsRead == report.rowsImported + report.rowsRejected);
+    for (const ModelRow& row : rows) {
+        const Book* book = library.viewBookById(row.id.c_str());
+        CHECK(book != nullptr && row.title == book->getTitle());
+    }
+}
+
+static void testCsvRows() {
+    // Header, CRLF endings, quoting, blank lines and a last row without a newline
+    string contents =
+        "Id,ISBN,Title,Author,Edition,Publication,Category\r\n"          // 1: header
+        "A1,9780306406157,Plain,Author,1st,Pub,Fiction\r\n"              // 2
+        "A2,9780306406157,\"Comma, inside\",Author,1st,Pub,Fiction\r\n"  // 3
+        "A3,9780306406157,\"Say \"\"hi\"\"\",Author,1st,Pub,Non-fiction\n"  // 4
+        "\r\n"                                                           // 5: blank
+        "A4,9780306406157,\"\"\"\",Author,1st,Pub,Fiction\n"             // 6: title is one quote
+        "B1,9780306406157,\"Open,Author,1st,Pub,Fiction\n"               // 7: unterminated quote
+        "B2,9780306406157,\"Closed\"x,Author,1st,Pub,Fiction\n"          // 8: text after the quote
+        "B3,9780306406157,Short\n"                                       // 9: too few fields
+        "B4,9780306406157,T,A,1st,Pub,Fiction,Extra\n"                   // 10: too many fields
+        "B-5,9780306406157,T,A,1st,Pub,Fiction\n"                        // 11: invalid ID
+        "B6,9780306406158,T,A,1st,Pub,Fiction\n"                         // 12: bad check digit
+        "B7,9780306406157,,A,1st,Pub,Fiction\n"                          // 13: empty title
+        "B8,9780306406157,T,A,1st,Pub,Poetry\n"                          // 14: invalid category
+        "A1,9780306406157,Again,Author,1st,Pub,Fiction\n"                // 15: duplicate ID
+        "ID,9780306406157,Not a header,Author,1st,Pub,Fiction\n"         // 16: data, not a header
+        "A5,9780306406157,Last,Author,1st,Pub,Fiction";                  // 17: no newline
+    Library library;
+    ImportReport report;
+    CHECK(importText(library, contents, 0, report));
+    vector<ModelRow> rows = { { "A1", "Plain" }, { "A2", "Comma, inside" }, { "A3", "Say \"hi\"" },
+                              { "A4", "\"" }, { "ID", "Not a header" }, { "A5", "Last" } };
+    checkImported(library, rows, report);
+    CHECK(report.rowsRead == 15);
+    CHECK(strcmp(library.viewBookById("A3")->getCategory(), "Non-fiction") == 0);
+
+    // Rejections are reported by line, in file order except duplicates found at the flush
+    const long lines[] = { 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+    const char* reasons[] = { "malformed quoted field", "malformed quoted field", "expected 7 fields",
+                              "expected 7 fields", "invalid ID", "invalid ISBN", "invalid title",
+                              "invalid category", "duplicate ID" };
+    CHECK(report.rowsRejected == 9 && report.reportedRejections == 9);
+    for (int i = 0; i < 9 && i < report.reportedRejections; i++) {
+        CHECK(report.rejections[i].line == lines[i]);
+        CHECK(strcmp(report.rejections[i].reason, reasons[i]) == 0);
+    }
+}
+
+static void testTsvRows() {
+    // A tab on the first line picks TSV, where quotes are ordinary characters
+    string contents =
+        "T1\t9780306406157\t\"Quoted\"\tAuthor\t1st\tPub\tFiction\n"
+        "T2\t9780306406157\tComma, kept\tAuthor\t1st\tPub\tFiction\r\n"
+        "T3\t9780306406157\tShort\n";
+    Library library;
+    ImportReport report;
+    CHECK(importText(library, contents, 0, report));
+    checkImported(library, { { "T1", "\"Quoted\"" }, { "T2", "Comma, kept" } }, report);
+    CHECK(report.rowsRejected == 1 && report.rejections[0].line == 3);
+
+    // An explicit delimiter overrides the guess
+    Library csvLibrary;
+    CHECK(importText(csvLibrary, contents, ',', report));
+    CHECK(csvLibrary.getCount() == 0 && report.rowsRejected == 3);
+}
+
+static void testReportCap() {
+    // Every rejection is counted, but only the first MAX_REPORTED_REJECTIONS are kept
+    string contents;
+    const int badRows = ImportReport::MAX_REPORTED_REJECTIONS + 15;
+    for (int i = 0; i < badRows; i++) {
+        contents += "Bad-" + to_string(i) + ROW_TAIL + "\n";
+    }
+    contents += "Good" + string(ROW_TAIL) + "\n";
+    Library library;
+    ImportReport report;
+    CHECK(importText(library, contents, 0, report));
+    checkImported(library, { { "Good", "Title" } }, report);
+    CHECK(report.rowsRejected == badRows);
+    CHECK(report.reportedRejections == ImportReport::MAX_REPORTED_REJECTIONS);
+    CHECK(report.rejections[ImportReport::MAX_REPORTED_REJECTIONS - 1].line ==
+          ImportReport::MAX_REPORTED_REJECTIONS);
+}
+
+static void testChunkBoundaries() {
+    mt19937 random(6);
+    string contents;
+    vector<ModelRow> rows;
+    long line = 0;
+    int nextId = 0;
+
+    // Random rows up to just short of the first chunk boundary
+    auto addRow = [&](const string& title, const char* ending) {
+        string id = "R" + to_string(nextId++);
+        contents += csvRow(id, title) + ending;
+        rows.push_back({ id, title });
+        line++;
+    };
+    auto randomTitle = [&]() {
+        string title(1 + random() % 60, 'a');
+        for (char& c : title) {
+            const char alphabet[] = "abc ,\"xyz";
+            c = alphabet[random() % (sizeof(alphabet) - 1)];
+        }
+        return title;
+    };
+    while (contents.size() + 200 < CatalogImporter::CHUNK_SIZE) {
+        addRow(randomTitle(), random() % 2 == 0 ? "\n" : "\r\n");
+    }
+    while (contents.size() + 100 < CatalogImporter::CHUNK_SIZE) {
+        addRow("x", "\n");
+    }
+
+    // A row whose \r ends the first chunk and whose \n starts the next one
+    string probe = csvRow("R" + to_string(nextId), "");
+    size_t titleLength = CatalogImporter::CHUNK_SIZE - 1 - contents.size() - probe.size();
+    CHECK(titleLength > 0 && titleLength < MAX_TITLE_LENGTH);
+    addRow(string(titleLength, 't'), "\r\n");
+    CHECK(contents.size() == CatalogImporter::CHUNK_SIZE + 1);
+    CHECK(contents[CatalogImporter::CHUNK_SIZE - 1] == '\r' && contents[CatalogImporter::CHUNK_SIZE] == '\n');
+
+    // More rows, an over-long row, and more rows again
+    while (contents.size() < 2 * CatalogImporter::CHUNK_SIZE) {
+        addRow(randomTitle(), random() % 2 == 0 ? "\n" : "\r\n");
+    }
+    contents += "L1" + string(CatalogImporter::CHUNK_SIZE + 1000, 'x') + "\n";
+    line++;
+    long longRowLine = line;
+    while (contents.size() < 4 * CatalogImporter::CHUNK_SIZE) {
+        addRow(randomTitle(), random() % 2 == 0 ? "\n" : "\r\n");
+    }
+    addRow("Last row", "");
+
+    Library library;
+    ImportReport report;
+    CHECK(importText(library, contents, 0, report));
+    checkImported(library, rows, report);
+    CHECK(report.rowsRejected == 1 && report.reportedRejections == 1);
+    CHECK(report.rejections[0].line == longRowLine);
+    CHECK(strcmp(report.rejections[0].reason, "row too long") == 0);
+}
+
+static void testLongFirstRow() {
+    // An over-long first row is counted as a data row, so the next row is not a header
+    string contents = string(CatalogImporter::CHUNK_SIZE * 2, 'x') + "\n" +
+                      "ID" + ROW_TAIL + "\n";
+    Library library;
+    ImportReport report;
+    CHECK(importText(library, contents, 0, report));
+    checkImported(library, { { "ID", "Title" } }, report);
+    CHECK(report.rowsRejected == 1 && report.rejections[0].line == 1);
+}
+
+static void testMissingFile() {
+    Library library;
+    CatalogImporter importer(library);
+    ImportReport report;
+    remove(IMPORT_PATH);
+    CHECK(!importer.importFile(IMPORT_PATH, 0, report));
+    CHECK(report.rowsRead == 0 && report.rowsRejected == 0);
+
+    // An empty file imports nothing and is not an error
+    CHECK(importText(library, "", 0, report));
+    CHECK(report.rowsRead == 0 && library.getCount() == 0);
+}
+
+int main() {
+    testCsvRows();
+    testTsvRows();
+    testReportCap();
+    testChunkBoundaries();
+    testLongFirstRow();
+    testMissingFile();
+    return finishTest("test_importer");
+}
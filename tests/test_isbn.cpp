@@ -0,0 +1,174 @@
+/**
+ * test_isbn.cpp - ISBN-10 and ISBN-13 check digits and the ISBN-10 to ISBN-13 conversion
+ * A reference implementation works on digit strings: it computes both check digits for
+ * random nine-digit stems, and parseIsbn must accept exactly those spellings and give the
+ * same 978-prefixed number for both. Single-digit errors must always be rejected.
+ */
+#include "test_util.h"
+#include <random>
+#include <string>
+
+/**
+ * Helper function to compute the ISBN-10 check character of a nine-digit stem
+ */
+static char isbn10Check(const string& stem) {
+    int sum = 0;
+    for (int i = 0; i < 9; i++) {
+        sum += (stem[i] - '0') * (10 - i);
+    }
+    int check = (11 - sum % 11) % 11;
+    return check == 10 ? 'X' : static_cast<char>('0' + check);
+}
+
+/**
+ * Helper function to compute the EAN-13 check digit of a twelve-digit stem
+ */
+static char isbn13Check(const string& stem) {
+    int sum = 0;
+    for (int i = 0; i < 12; i++) {
+        sum += (stem[i] - '0') * (i % 2 == 0 ? 1 : 3);
+    }
+    return static_cast<char>('0' + (10 - sum % 10) % 10);
+}
+
+/**
+ * Helper function to read a digit string as a number
+ */
+static uint64_t toNumber(const string& digits) {
+    uint64_t number = 0;
+    for (char c : digits) {
+        number = number * 10 + static_cast<uint64_t>(c - '0');
+    }
+    return number;
+}
+
+/**
+ * Helper function to insert hyphens or spaces at random places between characters
+ */
+static string scatterSeparators(mt19937& random, const string& text) {
+    string spelled;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (i > 0 && random() % 4 == 0) {
+            spelled += random() % 2 == 0 ? '-' : ' ';
+        }
+        spelled += text[i];
+    }
+    return spelled;
+}
+
+static void testRandomStems() {
+    mt19937 random(12);
+    for (int round = 0; round < 20000; round++) {
+        string stem;
+        for (int i = 0; i < 9; i++) {
+            stem += static_cast<char>('0' + random() % 10);
+        }
+        string isbn10 = stem + isbn10Check(stem);
+        string isbn13 = "978" + stem;
+        isbn13 += isbn13Check(isbn13);
+
+        // Both spellings give the same number, with or without separators
+        uint64_t from10 = 0;
+        uint64_t from13 = 0;
+        CHECK(parseIsbn(isbn10.c_str(), from10));
+        CHECK(parseIsbn(scatterSeparators(random, isbn13).c_str(), from13));
+        CHECK(from10 == toNumber(isbn13) && from13 == from10);
+        CHECK(isValidIsbn13(from10));
+        uint64_t spaced = 0;
+        CHECK(parseIsbn(scatterSeparators(random, isbn10).c_str(), spaced) && spaced == from10);
+        char formatted[MAX_ISBN_LENGTH];
+        formatIsbn(from10, formatted);
+        CHECK(isbn13 == formatted);
+
+        // Any single wrong digit is caught by either check, and leaves the output alone
+        int position = static_cast<int>(random() % 10);
+        string wrong10 = isbn10;
+        char replacement = static_cast<char>('0' + random() % 10);
+        if (replacement == wrong10[position]) {
+            replacement = replacement == '9' ? '0' : static_cast<char>(replacement + 1);
+        }
+        wrong10[position] = replacement;
+        uint64_t untouched = 42;
+        CHECK(!parseIsbn(wrong10.c_str(), untouched) && untouched == 42);
+        string wrong13 = isbn13;
+        position = 3 + static_cast<int>(random() % 10);
+        wrong13[position] = static_cast<char>('0' + (wrong13[position] - '0' + 1 + random() % 9) % 10);
+        CHECK(!parseIsbn(wrong13.c_str(), untouched) && untouched == 42);
+        CHECK(!isValidIsbn13(toNumber(wrong13)));
+
+        // 979 numbers have no ISBN-10 form but are valid ISBN-13s
+        string isbn979 = "979" + stem;
+        isbn979 += isbn13Check(isbn979);
+        uint64_t from979 = 0;
+        CHECK(parseIsbn(isbn979.c_str(), from979) && from979 == toNumber(isbn979));
+        string ean977 = "977" + stem;
+        ean977 += isbn13Check(ean977);
+        CHECK(!parseIsbn(ean977.c_str(), untouched));
+    }
+}
+
+static void testCheckCharacterX() {
+    // 0-8044-2957-X: the ISBN-10 check value ten is written X, in either case
+    uint64_t isbn = 0;
+    CHECK(parseIsbn("0-8044-2957-X", isbn) && isbn == 9780804429573ULL);
+    CHECK(parseIsbn("080442957x", isbn) && isbn == 9780804429573ULL);
+    CHECK(!parseIsbn("0804429571", isbn));
+    // Separators may follow the X like any other character, but digits may not
+    CHECK(parseIsbn("0-8044-2957-X ", isbn) && isbn == 9780804429573ULL);
+    CHECK(parseIsbn("080442957X-", isbn) && isbn == 9780804429573ULL);
+    CHECK(parseIsbn("080442957X - ", isbn) && isbn == 9780804429573ULL);
+    CHECK(!parseIsbn("080442957X0", isbn));
+    CHECK(!parseIsbn("080442957X-X", isbn));
+    // X is only a check character, and only in an ISBN-10
+    CHECK(!parseIsbn("08044X9573", isbn));
+    CHECK(!parseIsbn("978080442957X", isbn));
+    CHECK(!parseIsbn("X", isbn));
+}
+
+static void testMalformed() {
+    uint64_t isbn = 7;
+    const char* const rejected[] = { "", "-", "  ", "978030640615", "97803064061577", "030640615",
+                                     "03064061522", "978-0306-4061a-7", "9780306406157 extra", "+9780306406157" };
+    for (const char* text : rejected) {
+        CHECK(!parseIsbn(text, isbn));
+    }
+    CHECK(!parseIsbn(nullptr, isbn));
+    CHECK(isbn == 7);
+    CHECK(!isValidIsbn13(0));
+    CHECK(!isValidIsbn13(978030640615ULL));
+    CHECK(!isValidIsbn13(97803064061570ULL));
+    char formatted[MAX_ISBN_LENGTH];
+    formatIsbn(0, formatted);
+    CHECK(formatted[0] == '\0');
+}
+
+static void testLibraryLookup() {
+    // A book stored from its ISBN-10 is found by its ISBN-13, and the reverse
+    Library library;
+    Book book;
+    CHECK(makeBook(book, "I1", "0-306-40615-2", "Title"));
+    CHECK(library.addBook(book));
+    CHECK(makeBook(book, "I2", "978-1-4028-9462-6", "Title"));
+    CHECK(library.addBook(book));
+    uint64_t isbn = 0;
+    CHECK(parseIsbn("9780306406157", isbn));
+    Book found;
+    CHECK(library.getBookByIsbn(isbn, found) && strcmp(found.getId(), "I1") == 0);
+    CHECK(parseIsbn("1402894627", isbn));
+    CHECK(library.getBookByIsbn(isbn, found) && strcmp(found.getId(), "I2") == 0);
+    CHECK(found.getIsbn() == 9781402894626ULL);
+
+    // Setters leave the stored ISBN alone when given a bad one
+    CHECK(!book.setIsbn("0306406153"));
+    CHECK(!book.setIsbnValue(9780306406158ULL));
+    CHECK(book.getIsbn() == 9781402894626ULL);
+    CHECK(book.setIsbnValue(9780306406157ULL) && book.getIsbn() == 9780306406157ULL);
+}
+
+int main() {
+    testRandomStems();
+    testCheckCharacterX();
+    testMalformed();
+    testLibraryLookup();
+    return finishTest("test_isbn");
+}
@@ -0,0 +1,264 @@
+/**
+ * test_item_kinds.cpp - books and journals side by side in one Library
+ * Journals live in a typed array of their own next to the books. Adds, batches and deletes
+ * through the ItemManager interface must reach the array of the item's kind, an ID may be
+ * taken by one kind only, and forEachItem must visit the books and then the journals.
+ * Journals are not logged, so they cannot change while a write-ahead log is attached, and
+ * loading or recovering the books keeps them. Collections that hold only books refuse them.
+ */
+#include "test_util.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Helper function to fill a journal with valid fields
+ * Returns false if any field is rejected
+ */
+static bool makeJournal(Journal& journal, const char* id, const char* issn, const char* title, int volume = 1,
+                        int issue = 1) {
+    return journal.setId(id) && journal.setIssn(issn) && journal.setTitle(title) && journal.setVolume(volume) &&
+           journal.setIssue(issue) && journal.setPublisher("Press") && journal.setCategory("Non-fiction");
+}
+
+/**
+ * Helper function to run displayItemById with its output captured
+ * Returns what it printed; found is set to what it returned
+ */
+static string displayItem(const Library& library, const char* id, bool& found) {
+    ostringstream output;
+    streambuf* oldOutput = cout.rdbuf(output.rdbuf());
+    found = library.displayItemById(id);
+    cout.rdbuf(oldOutput);
+    return output.str();
+}
+
+// Visitor that records each item as "B:<id>" or "J:<id>", the overload telling the kind
+struct KindCollector {
+    vector<string> seen;
+    int limit; // Stop after this many items
+
+    bool operator()(const Book& book) {
+        seen.push_back(string("B:") + book.getId());
+        return static_cast<int>(seen.size()) < limit;
+    }
+
+    bool operator()(const Journal& journal) {
+        seen.push_back(string("J:") + journal.getId());
+        return static_cast<int>(seen.size()) < limit;
+    }
+};
+
+static void testIssn() {
+    uint32_t issn = 0;
+    char text[MAX_ISSN_LENGTH];
+    CHECK(parseIssn("0317-8471", issn) && issn == 317847);
+    formatIssn(issn, text);
+    CHECK(strcmp(text, "0317-8471") == 0);
+
+    // X stands for a check digit of ten, in either case
+    CHECK(parseIssn("2434-561x", issn) && issn == 2434561);
+    formatIssn(issn, text);
+    CHECK(strcmp(text, "2434-561X") == 0);
+
+    CHECK(!parseIssn("0317-8472", issn)); // Wrong check digit
+    CHECK(!parseIssn("031X-8471", issn)); // X only as the check digit
+    CHECK(!parseIssn("0317-847", issn));
+    CHECK(!parseIssn("0317-84711", issn));
+    CHECK(!parseIssn(nullptr, issn));
+    formatIssn(Journal::NO_ISSN, text);
+    CHECK(text[0] == '\0');
+
+    Journal journal;
+    CHECK(!journal.setIssn("0317-8472") && journal.getIssn() == Journal::NO_ISSN);
+    CHECK(!journal.setVolume(0) && !journal.setIssue(Journal::MAX_ISSUE + 1));
+    CHECK(makeJournal(journal, "J1", "0317-8471", "Quarterly", 12, 3));
+    CHECK(journal.getKind() == ITEM_KIND_JOURNAL && journal.getVolume() == 12 && journal.getIssue() == 3);
+    char row[Journal::TABLE_ROW_LENGTH];
+    CHECK(journal.formatTableRow(row) == Journal::TABLE_ROW_LENGTH);
+}
+
+static void testDispatch() {
+    Library library;
+    Book book;
+    Journal journal;
+    CHECK(makeBook(book, "A1", "9780306406157", "A book"));
+    CHECK(makeJournal(journal, "J1", "0317-8471", "A journal"));
+    const LibraryItem& bookItem = book;
+    const LibraryItem& journalItem = journal;
+    CHECK(library.addItem(bookItem));
+    CHECK(library.addItem(journalItem));
+    CHECK(library.getCount() == 1 && library.getJournalCount() == 1 && library.getItemCount() == 2);
+    CHECK(library.viewBookById("A1") != nullptr && library.viewJournalById("J1") != nullptr);
+    CHECK(library.viewBookById("J1") == nullptr && library.viewJournalById("A1") == nullptr);
+    CHECK(strcmp(library.viewJournalById("J1")->getTitle(), "A journal") == 0);
+
+    // An ID belongs to one kind only, whichever came first
+    Journal clash;
+    CHECK(makeJournal(clash, "A1", "2434-561X", "Clash"));
+    CHECK(!library.addItem(clash) && !library.addJournal(clash));
+    Book clashBook;
+    CHECK(makeBook(clashBook, "J1", "9780306406157", "Clash"));
+    CHECK(!library.addItem(clashBook) && !library.addBook(clashBook));
+    CHECK(!library.addJournal(journal));
+    CHECK(library.getItemCount() == 2);
+
+    // deleteItem finds the item in whichever array holds it
+    CHECK(library.deleteItem("J1") && library.getJournalCount() == 0);
+    CHECK(library.deleteItem("A1") && library.getCount() == 0);
+    CHECK(!library.deleteItem("J1"));
+}
+
+static void testMixedBatches() {
+    Library library;
+    Book books[3];
+    Journal journals[3];
+    CHECK(makeBook(books[0], "B0", "9780306406157", "First"));
+    CHECK(makeBook(books[1], "B1", "9780306406157", "Second"));
+    CHECK(makeBook(books[2], "J0", "9780306406157", "Book taking a journal ID"));
+    CHECK(makeJournal(journals[0], "J0", "0317-8471", "Monthly", 1, 1));
+    CHECK(makeJournal(journals[1], "J1", "2434-561X", "Weekly", 1, 1));
+    CHECK(makeJournal(journals[2], "B1", "0317-8471", "Journal taking a book ID"));
+
+    // Runs of books and single journals, applied in order
+    const LibraryItem* batch[] = { &books[0], &journals[0], &journals[1], &books[1], &books[2], &journals[2],
+                                   &journals[0] };
+    ItemOutcome outcomes[7];
+    CHECK(library.addItems(batch, 7, outcomes) == 4);
+    CHECK(outcomes[0] == ITEM_ADDED && outcomes[1] == ITEM_ADDED && outcomes[2] == ITEM_ADDED);
+    CHECK(outcomes[3] == ITEM_ADDED && outcomes[4] == ITEM_DUPLICATE && outcomes[5] == ITEM_DUPLICATE);
+    CHECK(outcomes[6] == ITEM_DUPLICATE);
+    CHECK(library.getCount() == 2 && library.getJournalCount() == 2);
+
+    // An upsert replaces a journal in place and still refuses a cross-kind ID
+    Journal nextIssue;
+    CHECK(makeJournal(nextIssue, "J0", "0317-8471", "Monthly", 1, 2));
+    const LibraryItem* upserts[] = { &nextIssue, &journals[2], &books[0] };
+    CHECK(library.upsertItems(upserts, 3, outcomes) == 2);
+    CHECK(outcomes[0] == ITEM_UPDATED && outcomes[1] == ITEM_DUPLICATE && outcomes[2] == ITEM_UPDATED);
+    CHECK(library.viewJournalById("J0")->getIssue() == 2);
+
+    // Deletes reach both kinds; an ID deleted earlier in the batch is gone
+    const char* ids[] = { "J1", "B0", "nope", "J1", "J0" };
+    CHECK(library.deleteItems(ids, 5, outcomes) == 3);
+    CHECK(outcomes[0] == ITEM_DELETED && outcomes[1] == ITEM_DELETED && outcomes[2] == ITEM_NOT_FOUND);
+    CHECK(outcomes[3] == ITEM_NOT_FOUND && outcomes[4] == ITEM_DELETED);
+    CHECK(library.getItemCount() == 1 && library.viewBookById("B1") != nullptr);
+    CHECK(library.deleteItems(ids, 5, nullptr) == 0);
+}
+
+static void testTypedWalk() {
+    Library library;
+    char id[MAX_ID_LENGTH];
+    for (int i = 0; i < 5; i++) {
+        snprintf(id, sizeof(id), "J%d", i);
+        Journal journal;
+        CHECK(makeJournal(journal, id, "0317-8471", "Journal", 1, i + 1));
+        CHECK(library.addJournal(journal));
+        snprintf(id, sizeof(id), "B%d", i);
+        Book book;
+        CHECK(makeBook(book, id, "9780306406157", "Book"));
+        CHECK(library.addBook(book));
+    }
+
+    // Books first and then journals, each in array order
+    KindCollector all = { vector<string>(), 100 };
+    library.forEachItem(all);
+    vector<string> expected = { "B:B0", "B:B1", "B:B2", "B:B3", "B:B4", "J:J0", "J:J1", "J:J2", "J:J3", "J:J4" };
+    CHECK(all.seen == expected);
+    KindCollector firstSix = { vector<string>(), 6 };
+    library.forEachItem(firstSix);
+    CHECK(firstSix.seen == vector<string>(expected.begin(), expected.begin() + 6));
+
+    // A delete moves the last journal into the hole; the ID index follows it
+    CHECK(library.deleteJournal("J1"));
+    CHECK(library.viewJournalById("J1") == nullptr);
+    CHECK(library.viewJournalById("J4") != nullptr && library.viewJournalById("J4")->getIssue() == 5);
+    KindCollector afterDelete = { vector<string>(), 100 };
+    library.forEachItem(afterDelete);
+    CHECK(afterDelete.seen.size() == 9 && afterDelete.seen[6] == "J:J4");
+    bool found = false;
+    string shown = displayItem(library, "J4", found);
+    CHECK(found && shown.find("ID: J4\n") != string::npos && shown.find("Issue: 5\n") != string::npos);
+    displayItem(library, "J1", found);
+    CHECK(!found);
+
+    library.clear();
+    CHECK(library.getItemCount() == 0 && library.getJournalCount() == 0);
+    Journal again;
+    CHECK(makeJournal(again, "J0", "0317-8471", "Journal"));
+    CHECK(library.addJournal(again) && library.getItemCount() == 1);
+}
+
+static void testUnloggedJournals() {
+    const char* journalPath = "test_item_kinds.wal";
+    const char* snapshotPath = "test_item_kinds.dat";
+    remove(journalPath);
+    remove(snapshotPath);
+    Library library;
+    Journal kept;
+    CHECK(makeJournal(kept, "J0", "0317-8471", "Kept"));
+    CHECK(library.addJournal(kept));
+
+    // Recovery and loading restore the books only and keep the journals
+    CatalogJournal log;
+    int replayed = -1;
+    CHECK(library.recover(snapshotPath, log, journalPath, replayed));
+    CHECK(library.getJournalCount() == 1);
+    Book book;
+    CHECK(makeBook(book, "B0", "9780306406157", "Logged"));
+    CHECK(library.addBook(book));
+
+    // With a log attached, journals cannot change, one at a time or in a batch
+    Journal refused;
+    CHECK(makeJournal(refused, "J1", "2434-561X", "Refused"));
+    CHECK(!library.addItem(refused) && !library.addJournal(refused));
+    const LibraryItem* batch[] = { &refused, &kept };
+    ItemOutcome outcomes[2];
+    CHECK(library.upsertItems(batch, 2, outcomes) == 0);
+    CHECK(outcomes[0] == ITEM_FAILED && outcomes[1] == ITEM_FAILED);
+    CHECK(!library.deleteItem("J0") && !library.deleteJournal("J0"));
+    const char* ids[] = { "J0", "J1", "B0" };
+    CHECK(library.deleteItems(ids, 3, outcomes) == 1);
+    CHECK(outcomes[0] == ITEM_FAILED && outcomes[1] == ITEM_NOT_FOUND);
+    CHECK(library.getJournalCount() == 1 && library.viewJournalById("J1") == nullptr);
+
+    CHECK(library.checkpoint(snapshotPath));
+    CHECK(library.addBook(book));
+    CHECK(library.loadCatalogue(snapshotPath));
+    CHECK(library.getCount() == 0 && library.getJournalCount() == 1);
+
+    // Once the log is detached they can change again
+    library.attachJournal(nullptr);
+    CHECK(library.deleteJournal("J0") && library.addJournal(refused));
+    CHECK(log.close());
+    remove(journalPath);
+    remove(snapshotPath);
+}
+
+static void testBookOnlyCollections() {
+    Journal journal;
+    CHECK(makeJournal(journal, "J1", "0317-8471", "A journal"));
+    const LibraryItem* batch[] = { &journal };
+    ItemOutcome outcome = ITEM_ADDED;
+
+    ColumnarLibrary columnar;
+    CHECK(!columnar.addItem(journal));
+    CHECK(columnar.addItems(batch, 1, &outcome) == 0 && outcome == ITEM_INVALID);
+
+    outcome = ITEM_ADDED;
+    ConcurrentLibrary concurrent;
+    CHECK(!concurrent.addItem(journal));
+    CHECK(concurrent.addItems(batch, 1, &outcome) == 0 && outcome == ITEM_INVALID);
+    CHECK(concurrent.getItemCount() == 0 && columnar.getItemCount() == 0);
+}
+
+int main() {
+    testIssn();
+    testDispatch();
+    testMixedBatches();
+    testTypedWalk();
+    testUnloggedJournals();
+    testBookOnlyCollections();
+    return finishTest("test_item_kinds");
+}
@@ -0,0 +1,463 @@
+/**
+ * test_journal.cpp - CatalogJournal records and Library::recover after a crash
+ * A random run of adds, edits and deletes is journaled while a reference model records
+ * the catalogue after every record. The journal is then cut or corrupted at many offsets
+ * and recover() must replay exactly the intact records before the damage, restore the
+ * matching catalogue, and cut the file back to them.
+ */
+#include "test_util.h"
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/resource.h>
+#endif
+
+const char* const JOURNAL_PATH = "test_journal.wal";
+const char* const SNAPSHOT_PATH = "test_journal.dat";
+
+// Reference catalogue: ID -> title of every book present
+typedef map<string, string> Model;
+
+/**
+ * Helper function to read a whole file into a string; empty if it cannot be opened
+ */
+static string readFile(const char* path) {
+    string contents;
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return contents;
+    }
+    char block[65536];
+    size_t got;
+    while ((got = fread(block, 1, sizeof(block), file)) > 0) {
+        contents.append(block, got);
+    }
+    fclose(file);
+    return contents;
+}
+
+/**
+ * Helper function to replace a file with the given bytes
+ */
+static void writeFile(const char* path, const string& contents) {
+    FILE* file = fopen(path, "wb");
+    CHECK(file != nullptr);
+    if (file != nullptr) {
+        CHECK(fwrite(contents.data(), 1, contents.size(), file) == contents.size());
+        fclose(file);
+    }
+}
+
+// Book visitor that records each book's title under its ID
+static bool collectTitle(const Book& book, void* context) {
+    (*static_cast<Model*>(context))[book.getId()] = book.getTitle();
+    return true;
+}
+
+/**
+ * Helper function to describe a library the way the model does
+ */
+static Model contents(const Library& library) {
+    Model books;
+    library.forEachBook(collectTitle, &books);
+    CHECK(static_cast<int>(books.size()) == library.getCount());
+    return books;
+}
+
+/**
+ * Helper function to recover a library from the journal file alone and check the result
+ * expectedLength is the length the journal must be cut back to.
+ */
+static void checkRecovery(const Model& expected, int expectedRecords, size_t expectedLength) {
+    Library library;
+    CatalogJournal journal;
+    int replayed = -1;
+    CHECK(library.recover(SNAPSHOT_PATH, journal, JOURNAL_PATH, replayed));
+    CHECK(replayed == expectedRecords);
+    CHECK(contents(library) == expected);
+    CHECK(journal.close());
+    CHECK(readFile(JOURNAL_PATH).size() == expectedLength);
+}
+
+/**
+ * Helper function to journal a random run of mutations into a fresh journal file
+ * Fills the catalogue after each record (states[0] is empty) and the file length at
+ * each record boundary (boundaries[k] is where record k starts).
+ */
+static void journalRandomRun(vector<Model>& states, vector<size_t>& boundaries) {
+    const int IDS = 30;
+    const int OPERATIONS = 120;
+    remove(JOURNAL_PATH);
+    remove(SNAPSHOT_PATH);
+    Library library;
+    CatalogJournal journal;
+    int replayed = -1;
+    CHECK(library.recover(SNAPSHOT_PATH, journal, JOURNAL_PATH, replayed));
+    CHECK(replayed == 0);
+
+    mt19937 random(5);
+    Model model;
+    states.assign(1, model);
+    boundaries.assign(1, readFile(JOURNAL_PATH).size());
+    CHECK(boundaries[0] == sizeof(JournalHeader));
+    Book book;
+    char id[MAX_ID_LENGTH];
+    char title[32];
+    for (int i = 0; i < OPERATIONS; i++) {
+        snprintf(id, sizeof(id), "J%d", static_cast<int>(random() % IDS));
+        snprintf(title, sizeof(title), "Title %d", i);
+        bool present = model.count(id) > 0;
+        bool logged;
+        if (present && random() % 2 == 0) {
+            logged = library.deleteBook(id);
+            model.erase(id);
+        } else {
+            CHECK(makeBook(book, id, "9780306406157", title));
+            logged = present ? library.editBook(id, book) : library.addBook(book);
+            model[id] = title;
+        }
+        CHECK(logged);
+        // Group size one: the record is on disk once the mutation returns
+        states.push_back(model);
+        boundaries.push_back(readFile(JOURNAL_PATH).size());
+        CHECK(boundaries.back() > boundaries[boundaries.size() - 2]);
+    }
+    CHECK(contents(library) == model);
+    CHECK(journal.close());
+}
+
+static void testReplayRestoresEveryRecord() {
+    vector<Model> states;
+    vector<size_t> boundaries;
+    journalRandomRun(states, boundaries);
+    int records = static_cast<int>(states.size()) - 1;
+    checkRecovery(states[records], records, boundaries[records]);
+
+    // The recovered journal keeps appending after the replayed records
+    {
+        Library library;
+        CatalogJournal journal;
+        int replayed = -1;
+        CHECK(library.recover(SNAPSHOT_PATH, journal, JOURNAL_PATH, replayed));
+        Book book;
+        CHECK(makeBook(book, "After", "9780306406157", "Added after recovery"));
+        CHECK(library.addBook(book));
+    }
+    Model expected = states[records];
+    expected["After"] = "Added after recovery";
+    checkRecovery(expected, records + 1, readFile(JOURNAL_PATH).size());
+}
+
+static void testTornTail() {
+    vector<Model> states;
+    vector<size_t> boundaries;
+    journalRandomRun(states, boundaries);
+    string full = readFile(JOURNAL_PATH);
+    int records = static_cast<int>(states.size()) - 1;
+
+    // Cut inside each record: in its length, checksum, operation byte and payload
+    for (int k = 0; k < records; k += 7) {
+        size_t recordLength = boundaries[k + 1] - boundaries[k];
+        const size_t cuts[] = { 0, 1, 4, 8, 9, recordLength / 2, recordLength - 1 };
+        for (size_t cut : cuts) {
+            writeFile(JOURNAL_PATH, full.substr(0, boundaries[k] + cut));
+            checkRecovery(states[k], k, boundaries[k]);
+        }
+    }
+
+    // A file cut inside its header, or empty, starts a fresh journal
+    const size_t headerCuts[] = { 0, 1, sizeof(JournalHeader) - 1 };
+    for (size_t cut : headerCuts) {
+        writeFile(JOURNAL_PATH, full.substr(0, cut));
+        checkRecovery(Model(), 0, sizeof(JournalHeader));
+    }
+}
+
+static void testChecksumMismatch() {
+    vector<Model> states;
+    vector<size_t> boundaries;
+    journalRandomRun(states, boundaries);
+    string full = readFile(JOURNAL_PATH);
+    int records = static_cast<int>(states.size()) - 1;
+
+    // A flipped bit anywhere in a record stops replay before it, even with intact records after it
+    for (int k = 0; k < records; k += 5) {
+        size_t recordLength = boundaries[k + 1] - boundaries[k];
+        const size_t offsets[] = { 0, 4, 8, 10, recordLength / 2, recordLength - 1 };
+        for (size_t offset : offsets) {
+            string damaged = full;
+            damaged[boundaries[k] + offset] ^= 0x10;
+            writeFile(JOURNAL_PATH, damaged);
+            checkRecovery(states[k], k, boundaries[k]);
+        }
+    }
+
+    // A journal with a damaged header is not replayed at all
+    string damaged = full;
+    damaged[0] ^= 0x01;
+    writeFile(JOURNAL_PATH, damaged);
+    checkRecovery(Model(), 0, sizeof(JournalHeader));
+    damaged = full;
+    damaged[8] ^= 0x01; // Version
+    writeFile(JOURNAL_PATH, damaged);
+    checkRecovery(Model(), 0, sizeof(JournalHeader));
+}
+
+static void testStaleGeneration() {
+    remove(JOURNAL_PATH);
+    remove(SNAPSHOT_PATH);
+    Model model;
+    string staleJournal;
+    {
+        Library library;
+        CatalogJournal journal;
+        int replayed = -1;
+        CHECK(library.recover(SNAPSHOT_PATH, journal, JOURNAL_PATH, replayed));
+        Book book;
+        CHECK(makeBook(book, "S1", "9780306406157", "First"));
+        CHECK(library.addBook(book));
+        CHECK(makeBook(book, "S2", "9780306406157", "Second"));
+        CHECK(library.addBook(book));
+        CHECK(library.deleteBook("S1"));
+        CHECK(makeBook(book, "S1", "9780306406157", "First again"));
+        CHECK(library.addBook(book));
+        staleJournal = readFile(JOURNAL_PATH);
+        CHECK(library.checkpoint(SNAPSHOT_PATH));
+        CHECK(journal.getCheckpoint() == 1);
+        CHECK(readFile(JOURNAL_PATH).size() == sizeof(JournalHeader));
+        model = contents(library);
+    }
+
+    // A crash after the snapshot was written but before the journal was reset leaves the
+    // records the snapshot already holds, under the previous generation
+    writeFile(JOURNAL_PATH, staleJournal);
+    {
+        Library library;
+        CatalogJournal journal;
+        int replayed = -1;
+        CHECK(library.recover(SNAPSHOT_PATH, journal, JOURNAL_PATH, replayed));
+        CHECK(replayed == 0);
+        CHECK(contents(library) == model);
+        CHECK(journal.getCheckpoint() == 1);
+
+        // The journal now starts over at the snapshot's generation
+        JournalHeader header;
+        string reset = readFile(JOURNAL_PATH);
+        CHECK(CatalogJournal::readHeader(reset.data(), reset.size(), header));
+        CHECK(header.checkpoint == 1);
+        CHECK(reset.size() == sizeof(JournalHeader));
+
+        Book book;
+        CHECK(library.getBookById("S2", book));
+        CHECK(book.setTitle("Second edited"));
+        CHECK(library.editBook("S2", book));
+        CHECK(library.deleteBook("S1"));
+    }
+    Model edited = model;
+    edited["S2"] = "Second edited";
+    edited.erase("S1");
+    checkRecovery(edited, 2, readFile(JOURNAL_PATH).size());
+
+    // A journal from a later generation than the snapshot is just as stale
+    string later = readFile(JOURNAL_PATH);
+    JournalHeader header;
+    memcpy(&header, later.data(), sizeof(header));
+    header.checkpoint = 2;
+    memcpy(&later[0], &header, sizeof(header));
+    writeFile(JOURNAL_PATH, later);
+    checkRecovery(model, 0, sizeof(JournalHeader));
+}
+
+static void testGroupCommit() {
+    remove(JOURNAL_PATH);
+    remove(SNAPSHOT_PATH);
+    Library library;
+    CatalogJournal journal;
+    int replayed = -1;
+    CHECK(library.recover(SNAPSHOT_PATH, journal, JOURNAL_PATH, replayed));
+    journal.setGroupSize(8);
+
+    // Nothing reaches the file until eight records are buffered
+    Book book;
+    char id[MAX_ID_LENGTH];
+    Model model;
+    for (int i = 0; i < 7; i++) {
+        snprintf(id, sizeof(id), "G%d", i);
+        CHECK(makeBook(book, id, "9780306406157", "Grouped"));
+        CHECK(library.addBook(book));
+        model[id] = "Grouped";
+        CHECK(readFile(JOURNAL_PATH).size() == sizeof(JournalHeader));
+    }
+    CHECK(makeBook(book, "G7", "9780306406157", "Grouped"));
+    CHECK(library.addBook(book));
+    model["G7"] = "Grouped";
+    string committed = readFile(JOURNAL_PATH);
+    CHECK(committed.size() > sizeof(JournalHeader));
+
+    // A crash now loses the uncommitted records but none of the committed ones
+    CHECK(library.deleteBook("G0"));
+    CHECK(readFile(JOURNAL_PATH) == committed);
+    {
+        Library crashed;
+        CatalogJournal crashedJournal;
+        CHECK(crashed.recover(SNAPSHOT_PATH, crashedJournal, JOURNAL_PATH, replayed));
+        CHECK(replayed == 8);
+        CHECK(contents(crashed) == model);
+    }
+    // Recovery kept the committed records; the live journal still holds G0's delete
+    CHECK(readFile(JOURNAL_PATH) == committed);
+    CHECK(journal.commit());
+    model.erase("G0");
+
+    // A batch shares one commit regardless of the group size
+    journal.setGroupSize(1);
+    vector<Book> batch(20);
+    for (int i = 0; i < 20; i++) {
+        snprintf(id, sizeof(id), "H%d", i);
+        CHECK(makeBook(batch[i], id, "9780306406157", "Batched"));
+        model[id] = "Batched";
+    }
+    ItemOutcome outcomes[20];
+    CHECK(library.addBooks(batch.data(), 20, outcomes) == 20);
+    CHECK(journal.close());
+    library.attachJournal(nullptr);
+    checkRecovery(model, 29, readFile(JOURNAL_PATH).size());
+}
+
+#ifndef _WIN32
+/**
+ * Helper function to cap the size of files this process may write
+ */
+static void limitFileSize(rlim_t bytes) {
+    struct rlimit limit;
+    CHECK(getrlimit(RLIMIT_FSIZE, &limit) == 0);
+    limit.rlim_cur = bytes;
+    CHECK(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+}
+
+static void testRetryAfterFailedCommit() {
+    remove(JOURNAL_PATH);
+    remove(SNAPSHOT_PATH);
+    struct rlimit original;
+    CHECK(getrlimit(RLIMIT_FSIZE, &original) == 0);
+    // Writes past the limit fail with EFBIG instead of killing the process
+    signal(SIGXFSZ, SIG_IGN);
+
+    Model model;
+    {
+        Library library;
+        CatalogJournal journal;
+        int replayed = -1;
+        CHECK(library.recover(SNAPSHOT_PATH, journal, JOURNAL_PATH, replayed));
+        journal.setGroupSize(4);
+        Book book;
+        char id[MAX_ID_LENGTH];
+        for (int i = 0; i < 3; i++) {
+            snprintf(id, sizeof(id), "R%d", i);
+            CHECK(makeBook(book, id, "9780306406157", "Before the failure"));
+            CHECK(library.addBook(book));
+            model[id] = "Before the failure";
+        }
+
+        // The fourth record triggers a commit that can only write part of the buffer
+        limitFileSize(sizeof(JournalHeader) + 40);
+        CHECK(makeBook(book, "R3", "9780306406157", "Rejected"));
+        CHECK(!library.addBook(book));
+        CHECK(library.findBookById("R3") == -1);
+        CHECK(!library.checkpoint(SNAPSHOT_PATH));
+        limitFileSize(original.rlim_cur);
+        // The partial write was cut off again
+        CHECK(readFile(JOURNAL_PATH).size() == sizeof(JournalHeader));
+
+        // The three applied records are still buffered and go out with the next commit
+        CHECK(makeBook(book, "R4", "9780306406157", "After the failure"));
+        CHECK(library.addBook(book));
+        model["R4"] = "After the failure";
+        CHECK(readFile(JOURNAL_PATH).size() > sizeof(JournalHeader));
+
+        // A failure with group size one rejects just that edit
+        journal.setGroupSize(1);
+        size_t synced = readFile(JOURNAL_PATH).size();
+        limitFileSize(synced);
+        CHECK(makeBook(book, "R0", "9780306406157", "Rejected edit"));
+        CHECK(!library.editBook("R0", book));
+        limitFileSize(original.rlim_cur);
+        CHECK(readFile(JOURNAL_PATH).size() == synced);
+        CHECK(contents(library) == model);
+        CHECK(library.deleteBook("R1"));
+        model.erase("R1");
+    }
+    CHECK(setrlimit(RLIMIT_FSIZE, &original) == 0);
+    signal(SIGXFSZ, SIG_DFL);
+    checkRecovery(model, 5, readFile(JOURNAL_PATH).size());
+}
+
+static void testFailedBatchCommit() {
+    remove(JOURNAL_PATH);
+    remove(SNAPSHOT_PATH);
+    struct rlimit original;
+    CHECK(getrlimit(RLIMIT_FSIZE, &original) == 0);
+    signal(SIGXFSZ, SIG_IGN);
+
+    Model model;
+    {
+        Library library;
+        CatalogJournal journal;
+        int replayed = -1;
+        CHECK(library.recover(SNAPSHOT_PATH, journal, JOURNAL_PATH, replayed));
+        vector<Book> batch(4);
+        char id[MAX_ID_LENGTH];
+        for (int i = 0; i < 4; i++) {
+            snprintf(id, sizeof(id), "S%d", i);
+            CHECK(makeBook(batch[i], id, "9780306406157", "Batched"));
+        }
+        ItemOutcome outcomes[4];
+        CHECK(library.addBooks(batch.data(), 3, outcomes) == 3);
+        for (int i = 0; i < 3; i++) {
+            model[batch[i].getId()] = "Batched";
+        }
+
+        // The batch's one commit fails: no outcome may claim a change was made durable
+        size_t synced = readFile(JOURNAL_PATH).size();
+        limitFileSize(synced);
+        const Book* added[] = { &batch[3], &batch[0] };
+        CHECK(library.addBooks(added, 2, outcomes) == 0);
+        CHECK(outcomes[0] == ITEM_FAILED && outcomes[1] == ITEM_DUPLICATE);
+        const char* ids[] = { "S1", "S9" };
+        CHECK(library.deleteBooks(ids, 2, outcomes) == 0);
+        CHECK(outcomes[0] == ITEM_FAILED && outcomes[1] == ITEM_NOT_FOUND);
+        CHECK(makeBook(batch[2], "S2", "9780306406157", "Upserted"));
+        CHECK(library.upsertBooks(&batch[2], 1, outcomes) == 0 && outcomes[0] == ITEM_FAILED);
+        limitFileSize(original.rlim_cur);
+        CHECK(readFile(JOURNAL_PATH).size() == synced);
+
+        // The records stayed buffered and go out with the next commit
+        model["S3"] = "Batched";
+        model.erase("S1");
+        model["S2"] = "Upserted";
+        CHECK(contents(library) == model);
+        CHECK(journal.commit());
+    }
+    CHECK(setrlimit(RLIMIT_FSIZE, &original) == 0);
+    signal(SIGXFSZ, SIG_DFL);
+    checkRecovery(model, 6, readFile(JOURNAL_PATH).size());
+}
+#endif
+
+int main() {
+    testReplayRestoresEveryRecord();
+    testTornTail();
+    testChecksumMismatch();
+    testStaleGeneration();
+    testGroupCommit();
+#ifndef _WIN32
+    testRetryAfterFailedCommit();
+    testFailedBatchCommit();
+#endif
+    remove(JOURNAL_PATH);
+    remove(SNAPSHOT_PATH);
+    return finishTest("test_journal");
+}
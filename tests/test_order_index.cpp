@@ -0,0 +1,348 @@
+/**
+ * test_order_index.cpp - OrderIndex order after adds, removes and rebuilds, and sorted ranges
+ * A reference set of (case-folded key, row) pairs answers every walk; keys share long
+ * prefixes and differ only in case, so both the 8-byte prefix compare and the full key
+ * compare are exercised, and removes go far enough to rebuild the tree many times. The
+ * Library's sorted listings, ranges and sorted pages are checked against a model of its books.
+ */
+#include "test_util.h"
+#include <deque>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+// Reference entries ordered as OrderIndex orders them
+typedef set<pair<string, int> > Model;
+
+const char* const KEY_STEMS[] = { "Chronicles of Amber", "chronicles of AMBER", "Chronicles", "chronicl",
+                                  "Alpha", "alphabet", "Beta", "C", "Cz", "czar", "D", "The Long Road",
+                                  "THE LONG ROAD HOME", "Zed", "zed" };
+const int KEY_STEM_COUNT = 15;
+
+/**
+ * Helper function to make a key from a stem, sometimes with a numbered suffix
+ */
+static string randomKey(mt19937& random) {
+    string key = KEY_STEMS[random() % KEY_STEM_COUNT];
+    if (random() % 2 == 0) {
+        key += " " + to_string(random() % 20);
+    }
+    return key;
+}
+
+// Entry visitor that collects (folded key, row) pairs, up to a limit
+struct Collected {
+    vector<pair<string, int> > entries;
+    size_t limit;
+};
+
+static bool collectEntry(const OrderIndex::Entry& entry, void* context) {
+    Collected* collected = static_cast<Collected*>(context);
+    collected->entries.push_back(make_pair(fold(entry.key), entry.row));
+    return collected->entries.size() < collected->limit;
+}
+
+/**
+ * Helper function to compare a walk from (key, row) with the model's entries from there
+ */
+static void checkWalk(const OrderIndex& index, const Model& model, const string& key, int row, size_t limit) {
+    Collected collected;
+    collected.limit = limit;
+    index.walk(key.c_str(), row, collectEntry, &collected);
+    vector<pair<string, int> > expected;
+    for (Model::const_iterator it = model.lower_bound(make_pair(fold(key), row));
+         it != model.end() && expected.size() < limit; ++it) {
+        expected.push_back(*it);
+    }
+    CHECK(collected.entries == expected);
+}
+
+static void testTreeAgainstModel() {
+    OrderIndex index;
+    Model model;
+    map<int, string> keyOf;
+    deque<string> keys;  // The index keeps pointers, so keys must not move
+    mt19937 random(18);
+    int nextRow = 0;
+    for (int round = 0; round < 6; round++) {
+        // Grow to a few levels, then remove most entries to force rebuilds
+        int adds = 5000 + static_cast<int>(random() % 5000);
+        for (int i = 0; i < adds; i++) {
+            keys.push_back(randomKey(random));
+            int row = nextRow++;
+            index.add(keys.back().c_str(), row);
+            model.insert(make_pair(fold(keys.back()), row));
+            keyOf[row] = keys.back();
+        }
+        CHECK(index.getCount() == static_cast<int>(model.size()));
+        for (int w = 0; w < 50; w++) {
+            checkWalk(index, model, randomKey(random), static_cast<int>(random() % nextRow) - 1, 1 + random() % 200);
+        }
+        int removeOdds = round % 2 == 0 ? 90 : 50;
+        for (map<int, string>::iterator it = keyOf.begin(); it != keyOf.end();) {
+            if (static_cast<int>(random() % 100) < removeOdds) {
+                // A remove must match the row as well as the key, and only works once
+                CHECK(!index.remove(it->second.c_str(), it->first + nextRow));
+                CHECK(index.remove(it->second.c_str(), it->first));
+                CHECK(!index.remove(it->second.c_str(), it->first));
+                model.erase(make_pair(fold(it->second), it->first));
+                keyOf.erase(it++);
+            } else {
+                ++it;
+            }
+            if (random() % 500 == 0) {
+                checkWalk(index, model, randomKey(random), -1, 100);
+            }
+        }
+        CHECK(index.getCount() == static_cast<int>(model.size()));
+        checkWalk(index, model, "", -1, model.size() + 1);
+        for (int w = 0; w < 50; w++) {
+            checkWalk(index, model, randomKey(random), static_cast<int>(random() % nextRow), 1 + random() % 200);
+        }
+    }
+
+    // Remove everything: an empty walk, and the tree takes new entries again
+    for (map<int, string>::iterator it = keyOf.begin(); it != keyOf.end(); ++it) {
+        CHECK(index.remove(it->second.c_str(), it->first));
+    }
+    model.clear();
+    CHECK(index.getCount() == 0);
+    checkWalk(index, model, "", -1, 10);
+    keys.push_back("Again");
+    index.add(keys.back().c_str(), nextRow);
+    model.insert(make_pair(fold(keys.back()), nextRow));
+    checkWalk(index, model, "", -1, 10);
+    index.clear();
+    model.clear();
+    checkWalk(index, model, "", -1, 10);
+}
+
+// Reference book: its sort keys by field, and whether it is still in the library
+struct ModelBook {
+    string id;
+    string keys[SORT_FIELD_COUNT];
+    bool live;
+};
+
+/**
+ * Helper function to list the IDs the model puts in a sorted range, after (afterKey, afterRow)
+ */
+static vector<string> expectedRange(const vector<ModelBook>& books, SortField field, const string& from,
+                                    const string& to, const string& afterKey = "", int afterRow = -2) {
+    Model ordered;
+    for (size_t row = 0; row < books.size(); row++) {
+        if (books[row].live) {
+            ordered.insert(make_pair(fold(books[row].keys[field]), static_cast<int>(row)));
+        }
+    }
+    string start = afterRow == -2 ? fold(from) : fold(afterKey);
+    int startRow = afterRow == -2 ? -1 : afterRow + 1;
+    string foldedTo = fold(to);
+    vector<string> ids;
+    for (Model::const_iterator it = ordered.lower_bound(make_pair(start, startRow)); it != ordered.end(); ++it) {
+        if (!foldedTo.empty() && it->first.compare(0, foldedTo.size(), foldedTo) > 0) {
+            break;
+        }
+        ids.push_back(books[it->second].id);
+    }
+    return ids;
+}
+
+/**
+ * Helper function to check every sorted field over a random range against the model
+ */
+static void checkRanges(const Library& library, const vector<ModelBook>& books, mt19937& random) {
+    for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+        SortField field = static_cast<SortField>(f);
+        string from = random() % 3 == 0 ? "" : randomKey(random).substr(0, random() % 4);
+        string to = random() % 3 == 0 ? "" : randomKey(random).substr(0, 1 + random() % 3);
+        vector<string> listed;
+        CHECK(library.forEachBookSorted(field, from.c_str(), to.c_str(), collectId, &listed));
+        CHECK(listed == expectedRange(books, field, from, to));
+    }
+}
+
+/**
+ * Helper function to add a book with random keys to the library and the model
+ */
+static void addRandom(Library& library, vector<ModelBook>& books, mt19937& random) {
+    ModelBook entry;
+    entry.id = "S" + to_string(books.size());
+    for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+        entry.keys[f] = randomKey(random);
+    }
+    entry.live = true;
+    Book book;
+    CHECK(makeBook(book, entry.id.c_str(), "9780306406157", entry.keys[SORT_BY_TITLE].c_str(),
+                   entry.keys[SORT_BY_AUTHOR].c_str()));
+    CHECK(book.setPublication(entry.keys[SORT_BY_PUBLICATION].c_str()));
+    CHECK(library.addBook(book));
+    books.push_back(entry);
+}
+
+static void testLibraryRanges(Library::DeleteOrder order, unsigned seed) {
+    Library library(8);
+    library.setDeleteOrder(order);
+    library.enableOrderIndex(SORT_BY_TITLE);
+    library.enableOrderIndex(SORT_BY_AUTHOR);
+    vector<ModelBook> books;  // By row, which is insertion order
+    mt19937 random(seed);
+    for (int i = 0; i < 1500; i++) {
+        addRandom(library, books, random);
+    }
+    // An index enabled late is built from the books already there
+    CHECK(!library.hasOrderIndex(SORT_BY_PUBLICATION));
+    library.enableOrderIndex(SORT_BY_PUBLICATION);
+    CHECK(library.hasOrderIndex(SORT_BY_PUBLICATION));
+    checkRanges(library, books, random);
+
+    for (int op = 0; op < 6000; op++) {
+        ModelBook& target = books[random() % books.size()];
+        int kind = static_cast<int>(random() % 10);
+        if (kind < 3) {
+            addRandom(library, books, random);
+        } else if (kind < 7 && target.live) {
+            // Deletes outpace adds, so the indexes are rebuilt along the way
+            CHECK(library.deleteBook(target.id.c_str()));
+            target.live = false;
+        } else if (target.live) {
+            // A patch moves the book within the fields it changes
+            BookPatch patch;
+            int f = static_cast<int>(random() % SORT_FIELD_COUNT);
+            target.keys[f] = randomKey(random);
+            if (f == SORT_BY_TITLE) {
+                CHECK(patch.setTitle(target.keys[f].c_str()));
+            } else if (f == SORT_BY_AUTHOR) {
+                CHECK(patch.setAuthor(target.keys[f].c_str()));
+            } else {
+                CHECK(patch.setPublication(target.keys[f].c_str()));
+            }
+            CHECK(library.patchBook(target.id.c_str(), patch));
+        }
+        if (op % 200 == 0) {
+            checkRanges(library, books, random);
+        }
+    }
+    checkRanges(library, books, random);
+
+    // compactText rebuilds the indexes over the new pool
+    CHECK(library.compactText());
+    checkRanges(library, books, random);
+}
+
+static void testSortedPaging() {
+    Library library(8);
+    library.enableOrderIndex(SORT_BY_AUTHOR);
+    vector<ModelBook> books;
+    mt19937 random(118);
+    for (int i = 0; i < 800; i++) {
+        addRandom(library, books, random);
+    }
+    for (int listing = 0; listing < 10; listing++) {
+        string from = listing % 2 == 0 ? "" : "b";
+        string to = listing % 3 == 0 ? "" : "c";
+        SortedCursor cursor(SORT_BY_AUTHOR, from.c_str(), to.c_str());
+        set<string> present;
+        for (const string& id : expectedRange(books, SORT_BY_AUTHOR, from, to)) {
+            present.insert(id);
+        }
+        set<string> seen;
+        bool repeated = false;
+        Book page[24];
+        for (;;) {
+            // Each page starts strictly after the last book of the one before
+            int pageSize = 1 + static_cast<int>(random() % 24);
+            vector<string> expected = cursor.lastSerial == -1
+                                          ? expectedRange(books, SORT_BY_AUTHOR, from, to)
+                                          : expectedRange(books, SORT_BY_AUTHOR, from, to, cursor.lastKey, cursor.lastSerial);
+            if (static_cast<int>(expected.size()) > pageSize) {
+                expected.resize(pageSize);
+            }
+            int found = library.fetchSortedPage(cursor, page, pageSize);
+            vector<string> ids;
+            for (int i = 0; i < found; i++) {
+                ids.push_back(page[i].getId());
+                repeated = repeated || !seen.insert(ids.back()).second;
+            }
+            CHECK(ids == expected);
+            if (found == 0) {
+                break;
+            }
+            for (int c = 0; c < 4; c++) {
+                ModelBook& target = books[random() % books.size()];
+                if (random() % 2 == 0) {
+                    addRandom(library, books, random);
+                } else if (target.live) {
+                    CHECK(library.deleteBook(target.id.c_str()));
+                    target.live = false;
+                }
+            }
+        }
+        CHECK(!repeated);
+        bool complete = true;
+        for (const ModelBook& book : books) {
+            if (book.live && present.count(book.id) > 0) {
+                complete = complete && seen.count(book.id) > 0;
+            }
+        }
+        CHECK(complete);
+    }
+}
+
+static void testRangeBounds() {
+    Library library;
+    const char* const titles[] = { "Abel", "azure", "B", "c", "Cz", "CZAR", "Czech Tales", "D", "d", "" };
+    Book book;
+    char id[MAX_ID_LENGTH];
+    for (int i = 0; titles[i][0] != '\0'; i++) {
+        snprintf(id, sizeof(id), "R%d", i);
+        CHECK(makeBook(book, id, "9780306406157", titles[i]));
+        CHECK(library.addBook(book));
+    }
+    vector<string> listed;
+    CHECK(!library.forEachBookSorted(SORT_BY_TITLE, "", "", collectId, &listed));
+    SortedCursor unindexed(SORT_BY_TITLE);
+    Book page[4];
+    CHECK(library.fetchSortedPage(unindexed, page, 4) == 0);
+    library.enableOrderIndex(SORT_BY_TITLE);
+
+    // "A" to "C" takes in every key starting with c, in any case, but nothing from d on
+    CHECK(library.forEachBookSorted(SORT_BY_TITLE, "A", "C", collectId, &listed));
+    const char* aToC[] = { "R0", "R1", "R2", "R3", "R4", "R5", "R6" };
+    CHECK(listed == vector<string>(aToC, aToC + 7));
+    // Lower bounds are inclusive; an upper bound longer than a key still takes the key in
+    listed.clear();
+    CHECK(library.forEachBookSorted(SORT_BY_TITLE, "cz", "czar", collectId, &listed));
+    const char* czToCzar[] = { "R4", "R5" };
+    CHECK(listed == vector<string>(czToCzar, czToCzar + 2));
+    // Equal keys in insertion order; open bounds and null bounds list everything
+    listed.clear();
+    CHECK(library.forEachBookSorted(SORT_BY_TITLE, "d", nullptr, collectId, &listed));
+    const char* fromD[] = { "R7", "R8" };
+    CHECK(listed == vector<string>(fromD, fromD + 2));
+    listed.clear();
+    CHECK(library.forEachBookSorted(SORT_BY_TITLE, nullptr, "", collectId, &listed));
+    CHECK(listed.size() == 9);
+    // An empty or inverted range lists nothing
+    listed.clear();
+    CHECK(library.forEachBookSorted(SORT_BY_TITLE, "e", "", collectId, &listed));
+    CHECK(library.forEachBookSorted(SORT_BY_TITLE, "c", "b", collectId, &listed));
+    CHECK(listed.empty());
+    SortedCursor bounded(SORT_BY_TITLE, "b", "c");
+    CHECK(library.fetchSortedPage(bounded, page, 4) == 4);
+    CHECK(strcmp(page[0].getId(), "R2") == 0 && strcmp(page[3].getId(), "R5") == 0);
+    CHECK(library.fetchSortedPage(bounded, page, 0) == 0);
+    CHECK(library.fetchSortedPage(bounded, page, 4) == 1 && strcmp(page[0].getId(), "R6") == 0);
+    CHECK(library.fetchSortedPage(bounded, page, 4) == 0);
+}
+
+int main() {
+    testTreeAgainstModel();
+    testLibraryRanges(Library::PRESERVE_ORDER, 28);
+    testLibraryRanges(Library::SWAP_WITH_LAST, 38);
+    testSortedPaging();
+    testRangeBounds();
+    return finishTest("test_order_index");
+}
@@ -0,0 +1,313 @@
+/**
+ * test_patches.cpp - patchBook narrowing a patch to the fields that really change
+ * Random patches set each field either to its current value or to a new one, with text in
+ * the shared patch pool or a pool of its own. A reference model of every field says what
+ * the book must hold afterwards and whether anything changed: a patch that changes nothing
+ * must log no journal record, publish no new snapshot and store no text, and one that
+ * changes some fields must leave the indexes over the others alone.
+ */
+#include "test_util.h"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+const char* const JOURNAL_PATH = "test_patches.wal";
+const char* const SNAPSHOT_PATH = "test_patches.dat";
+const char* const TEST_ISBNS[] = { "9780306406157", "9781402894626", "9780131103627" };
+const char* const TEST_CATEGORIES[] = { "Fiction", "Non-fiction" };
+const char* const TITLES[] = { "Dune", "Emma", "Ulysses" };
+const char* const AUTHORS[] = { "Herbert", "Austen", "Joyce" };
+const char* const EDITIONS[] = { "1st", "2nd", "3rd" };
+const char* const PUBLICATIONS[] = { "Penguin", "Vintage", "Faber" };
+
+// Reference book: each field as an index into its list of values
+struct ModelBook {
+    string id;
+    int row;
+    int fields[6];  // Category, ISBN, title, author, edition, publication
+};
+
+/**
+ * Helper function to get the text of a field value in the model
+ */
+static const char* fieldText(int field, int value) {
+    switch (field) {
+        case 0:
+            return TEST_CATEGORIES[value];
+        case 1:
+            return TEST_ISBNS[value];
+        case 2:
+            return TITLES[value];
+        case 3:
+            return AUTHORS[value];
+        case 4:
+            return EDITIONS[value];
+        default:
+            return PUBLICATIONS[value];
+    }
+}
+
+/**
+ * Helper function to set one field of a patch through its setter
+ */
+static bool setField(BookPatch& patch, int field, const char* value) {
+    switch (field) {
+        case 0:
+            return patch.setCategory(value);
+        case 1:
+            return patch.setIsbn(value);
+        case 2:
+            return patch.setTitle(value);
+        case 3:
+            return patch.setAuthor(value);
+        case 4:
+            return patch.setEdition(value);
+        default:
+            return patch.setPublication(value);
+    }
+}
+
+/**
+ * Helper function to get the size of a file, 0 if it cannot be opened
+ */
+static long fileSize(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+/**
+ * Helper function to check a book holds every field of its model
+ */
+static bool matchesModel(const Book* book, const ModelBook& model) {
+    if (book == nullptr) {
+        return false;
+    }
+    uint64_t isbn = 0;
+    parseIsbn(TEST_ISBNS[model.fields[1]], isbn);
+    return strcmp(book->getCategory(), TEST_CATEGORIES[model.fields[0]]) == 0 && book->getIsbn() == isbn &&
+           strcmp(book->getTitle(), TITLES[model.fields[2]]) == 0 &&
+           strcmp(book->getAuthor(), AUTHORS[model.fields[3]]) == 0 &&
+           strcmp(book->getEdition(), EDITIONS[model.fields[4]]) == 0 &&
+           strcmp(book->getPublication(), PUBLICATIONS[model.fields[5]]) == 0;
+}
+
+/**
+ * Helper function to check the books and every index over the patched fields against the model
+ */
+static void checkIndexes(const Library& library, const vector<ModelBook>& books) {
+    bool fieldsMatch = true;
+    for (const ModelBook& model : books) {
+        fieldsMatch = fieldsMatch && matchesModel(library.viewBookById(model.id.c_str()), model);
+    }
+    CHECK(fieldsMatch);
+
+    int slots[1024];
+    for (int v = 0; v < 3; v++) {
+        int counts[6] = { 0, 0, 0, 0, 0, 0 };
+        for (const ModelBook& model : books) {
+            for (int f = 0; f < 6; f++) {
+                counts[f] += model.fields[f] == v ? 1 : 0;
+            }
+        }
+        uint64_t isbn = 0;
+        CHECK(parseIsbn(TEST_ISBNS[v], isbn));
+        CHECK(library.findBooksByIsbn(isbn, slots, 1024) == counts[1]);
+        CHECK(library.searchBooks(TITLES[v], slots, 1024) == counts[2]);
+        CHECK(library.searchBooks(AUTHORS[v], slots, 1024) == counts[3]);
+        Suggestion out[1];
+        CHECK(library.suggestTitles(TITLES[v], out, 1) == (counts[2] > 0 ? 1 : 0));
+        CHECK(counts[2] == 0 || out[0].count == counts[2]);
+        CHECK(library.suggestAuthors(AUTHORS[v], out, 1) == (counts[3] > 0 ? 1 : 0));
+        CHECK(counts[3] == 0 || out[0].count == counts[3]);
+        if (v < 2) {
+            CHECK(library.getCountByCategory(TEST_CATEGORIES[v]) == counts[0]);
+        }
+    }
+
+    // The title and publication order indexes: by value, ties in insertion order
+    const int sortFields[] = { SORT_BY_TITLE, SORT_BY_PUBLICATION };
+    const int modelFields[] = { 2, 5 };
+    for (int s = 0; s < 2; s++) {
+        vector<pair<string, int> > order;
+        for (const ModelBook& model : books) {
+            string key = fieldText(modelFields[s], model.fields[modelFields[s]]);
+            transform(key.begin(), key.end(), key.begin(), ::tolower);
+            order.push_back(make_pair(key, model.row));
+        }
+        sort(order.begin(), order.end());
+        vector<string> expected;
+        for (const pair<string, int>& entry : order) {
+            expected.push_back(books[entry.second].id);
+        }
+        vector<string> listed;
+        CHECK(library.forEachBookSorted(static_cast<SortField>(sortFields[s]), "", "", collectId, &listed));
+        CHECK(listed == expected);
+    }
+}
+
+static void testRandomPatches() {
+    remove(JOURNAL_PATH);
+    remove(SNAPSHOT_PATH);
+    Library library(8);
+    CatalogJournal journal;
+    int replayed = -1;
+    CHECK(library.recover(SNAPSHOT_PATH, journal, JOURNAL_PATH, replayed));
+    library.enableSnapshots();
+    library.enableOrderIndex(SORT_BY_TITLE);
+    library.enableOrderIndex(SORT_BY_PUBLICATION);
+
+    mt19937 random(20);
+    vector<ModelBook> books;
+    Book book;
+    for (int i = 0; i < 60; i++) {
+        ModelBook model;
+        model.id = "P" + to_string(i);
+        model.row = i;
+        for (int f = 0; f < 6; f++) {
+            model.fields[f] = static_cast<int>(random() % (f == 0 ? 2 : 3));
+        }
+        CHECK(makeBook(book, model.id.c_str(), TEST_ISBNS[model.fields[1]], TITLES[model.fields[2]],
+                       AUTHORS[model.fields[3]], TEST_CATEGORIES[model.fields[0]]));
+        CHECK(book.setEdition(EDITIONS[model.fields[4]]) && book.setPublication(PUBLICATIONS[model.fields[5]]));
+        CHECK(library.addBook(book));
+        books.push_back(model);
+    }
+    checkIndexes(library, books);
+
+    StringPool ownPool;
+    int noOps = 0;
+    for (int op = 0; op < 3000; op++) {
+        ModelBook& model = books[random() % books.size()];
+        const Book* current = library.viewBookById(model.id.c_str());
+        int style = static_cast<int>(random() % 3);
+        BookPatch shared;
+        BookPatch own(ownPool);
+        BookPatch& patch = style == 1 ? own : shared;
+        if (style == 2) {
+            // Seeded from the book: setters mark only values that differ
+            current->startPatch(patch);
+        }
+        int values[6];
+        bool changes = false;
+        bool textChanges = false;
+        unsigned expectedMask = 0;
+        for (int f = 0; f < 6; f++) {
+            values[f] = model.fields[f];
+            if (random() % 2 == 0) {
+                // Half the fields set are set to the value they already hold
+                values[f] = random() % 2 == 0 ? model.fields[f] : static_cast<int>(random() % (f == 0 ? 2 : 3));
+                CHECK(setField(patch, f, fieldText(f, values[f])));
+                changes = changes || values[f] != model.fields[f];
+                textChanges = textChanges || (f >= 2 && values[f] != model.fields[f]);
+                if (style != 2 || values[f] != model.fields[f]) {
+                    expectedMask |= 1u << f;
+                }
+            }
+        }
+        CHECK(patch.fields == expectedMask);
+
+        shared_ptr<const CatalogSnapshot> before = library.snapshot();
+        long journalBefore = fileSize(JOURNAL_PATH);
+        size_t textBefore = library.getTextBytes();
+        size_t droppedBefore = library.getDroppedTextBytes();
+        // A changed title is dropped; an author, edition or publication only once no book holds it
+        size_t droppedText = values[2] != model.fields[2] ? strlen(TITLES[model.fields[2]]) + 1 : 0;
+        for (int f = 3; f < 6; f++) {
+            int holders = 0;
+            for (const ModelBook& other : books) {
+                holders += other.fields[f] == model.fields[f] ? 1 : 0;
+            }
+            if (values[f] != model.fields[f] && holders == 1) {
+                droppedText += strlen(fieldText(f, model.fields[f])) + 1;
+            }
+        }
+        CHECK(library.patchBook(model.id.c_str(), patch));
+        for (int f = 0; f < 6; f++) {
+            model.fields[f] = values[f];
+        }
+        CHECK(matchesModel(library.viewBookById(model.id.c_str()), model));
+
+        // Only real changes are logged, published, stored and dropped
+        CHECK((fileSize(JOURNAL_PATH) > journalBefore) == changes);
+        CHECK((library.snapshot() != before) == changes);
+        if (!textChanges) {
+            CHECK(library.getTextBytes() == textBefore);
+        }
+        CHECK(library.getDroppedTextBytes() == droppedBefore + droppedText);
+        noOps += changes ? 0 : 1;
+        if (op % 100 == 0) {
+            checkIndexes(library, books);
+        }
+    }
+    CHECK(noOps > 100);
+    checkIndexes(library, books);
+
+    // The journal replays to the same books
+    CHECK(journal.close());
+    Library recovered;
+    CatalogJournal recoveredJournal;
+    CHECK(recovered.recover(SNAPSHOT_PATH, recoveredJournal, JOURNAL_PATH, replayed));
+    recovered.enableOrderIndex(SORT_BY_TITLE);
+    recovered.enableOrderIndex(SORT_BY_PUBLICATION);
+    checkIndexes(recovered, books);
+    CHECK(recoveredJournal.close());
+    remove(JOURNAL_PATH);
+    remove(SNAPSHOT_PATH);
+}
+
+static void testDroppedText() {
+    // Only a title that really changes leaves its old text behind in the pool, and an
+    // author only once the last book by it changes
+    Library library;
+    Book book;
+    CHECK(makeBook(book, "T1", "9780306406157", "Dune", "Herbert"));
+    CHECK(library.addBook(book));
+    CHECK(makeBook(book, "T2", "9780306406157", "Emma", "Herbert"));
+    CHECK(library.addBook(book));
+    size_t dropped = library.getDroppedTextBytes();
+    StringPool ownPool;
+    BookPatch same(ownPool);
+    CHECK(same.setTitle("Dune") && same.setAuthor("Frank Herbert"));
+    CHECK(library.patchBook("T1", same));
+    CHECK(library.getDroppedTextBytes() == dropped);
+    BookPatch renamed;
+    CHECK(renamed.setTitle("Dune Messiah") && renamed.setAuthor("Frank Herbert"));
+    CHECK(library.patchBook("T1", renamed));
+    CHECK(library.getDroppedTextBytes() == dropped + strlen("Dune") + 1);
+    CHECK(library.deleteBook("T2"));
+    dropped += strlen("Dune") + 1 + strlen("Emma") + 1 + strlen("Herbert") + 1;
+    CHECK(library.getDroppedTextBytes() == dropped);
+
+    // Editing with an unchanged copy of the book changes nothing at all
+    size_t text = library.getTextBytes();
+    CHECK(library.getBookById("T1", book));
+    CHECK(library.editBook("T1", book));
+    CHECK(library.getTextBytes() == text);
+    CHECK(library.getDroppedTextBytes() == dropped);
+
+    // A rejected value leaves the field unset; an empty patch changes nothing
+    BookPatch rejected;
+    CHECK(!rejected.setIsbn("9780306406158"));
+    CHECK(!rejected.setCategory("Poetry"));
+    CHECK(!rejected.setTitle(""));
+    CHECK(rejected.fields == 0);
+    CHECK(library.patchBook("T1", rejected));
+    CHECK(!library.patchBook("Missing", renamed));
+    const Book* view = library.viewBookById("T1");
+    CHECK(view != nullptr && strcmp(view->getTitle(), "Dune Messiah") == 0 &&
+          strcmp(view->getAuthor(), "Frank Herbert") == 0);
+}
+
+int main() {
+    testRandomPatches();
+    testDroppedText();
+    return finishTest("test_patches");
+}
@@ -0,0 +1,104 @@
+/**
+ * test_patrons.cpp - registration, lookup, removal and the patron file in PatronRegistry
+ */
+#include "test_util.h"
+
+static void testAddAndLookup() {
+    PatronRegistry registry(2); // Small, so adding patrons grows the array
+    CHECK(registry.addPatron("P1", "Ada Lovelace") == 0);
+    CHECK(registry.addPatron("P2", "Grace Hopper") == 1);
+    CHECK(registry.addPatron("P3", "Alan Turing") == 2);
+    CHECK(registry.addPatron("P2", "Someone Else") == -1); // Duplicate card ID
+    CHECK(registry.addPatron("P-4", "Bad Id") == -1);      // Not alphanumeric
+    CHECK(registry.addPatron("P4", "") == -1);
+    CHECK(registry.getCount() == 3);
+
+    CHECK(registry.findPatron("P2") == 1);
+    CHECK(registry.findPatron("P9") == -1);
+    CHECK(registry.findPatron("") == -1);
+    const PatronRecord* record = registry.viewPatron(2);
+    CHECK(record != nullptr && strcmp(record->id, "P3") == 0 && strcmp(record->name, "Alan Turing") == 0);
+    CHECK(registry.viewPatron(3) == nullptr);
+
+    CHECK(registry.renamePatron(0, "Augusta Ada King"));
+    CHECK(strcmp(registry.viewPatron(0)->name, "Augusta Ada King") == 0);
+    CHECK(!registry.renamePatron(7, "Nobody"));
+}
+
+static void testRemoveChecksCirculation() {
+    Library library;
+    Book book;
+    CHECK(makeBook(book, "B1", "9780306406157", "Title"));
+    CHECK(library.addBook(book));
+    Circulation circulation(library);
+    PatronRegistry registry;
+    int ada = registry.addPatron("P1", "Ada");
+    int grace = registry.addPatron("P2", "Grace");
+
+    // A patron with a loan or a hold stays registered
+    CHECK(circulation.checkout("B1", ada, 10) == CIRC_OK);
+    CHECK(!registry.removePatron("P1", circulation));
+    CHECK(circulation.placeHold(9780306406157ULL, grace) == CIRC_OK);
+    CHECK(!registry.removePatron("P2", circulation));
+
+    int holdPatron = -1;
+    CHECK(circulation.returnCopy("B1", holdPatron) == CIRC_OK && holdPatron == grace);
+    CHECK(registry.removePatron("P1", circulation));
+    CHECK(!registry.removePatron("P2", circulation)); // The copy is held for Grace
+    CHECK(circulation.cancelHold(9780306406157ULL, grace) == CIRC_OK);
+    CHECK(registry.removePatron("P2", circulation));
+    CHECK(!registry.removePatron("P2", circulation)); // Already removed
+    CHECK(registry.getCount() == 0);
+    CHECK(registry.findPatron("P1") == -1);
+    CHECK(registry.viewPatron(ada) == nullptr);
+
+    // Freed numbers are reused before new ones are handed out
+    int first = registry.addPatron("P3", "Alan");
+    int second = registry.addPatron("P4", "Barbara");
+    CHECK((first == ada && second == grace) || (first == grace && second == ada));
+    CHECK(registry.addPatron("P5", "Edsger") == 2);
+    CHECK(registry.getNextNumber() == 3);
+}
+
+static void testSaveAndLoad() {
+    const char* path = "test_patrons.dat";
+    Library library;
+    Circulation circulation(library);
+    {
+        PatronRegistry registry;
+        CHECK(registry.addPatron("P1", "Ada") == 0);
+        CHECK(registry.addPatron("P2", "Grace") == 1);
+        CHECK(registry.addPatron("P3", "Alan") == 2);
+        CHECK(registry.removePatron("P2", circulation));
+        CHECK(registry.savePatrons(path));
+    }
+
+    PatronRegistry loaded;
+    CHECK(loaded.loadPatrons(path));
+    CHECK(loaded.getCount() == 2);
+    CHECK(loaded.getNextNumber() == 3);
+    CHECK(loaded.findPatron("P1") == 0);
+    CHECK(loaded.findPatron("P3") == 2);
+    CHECK(loaded.findPatron("P2") == -1);
+    CHECK(strcmp(loaded.viewPatron(2)->name, "Alan") == 0);
+    CHECK(loaded.addPatron("P4", "Barbara") == 1); // The removed patron's number is free again
+
+    // A damaged file is rejected: bad magic leaves the registry as it was
+    FILE* file = fopen(path, "r+b");
+    CHECK(file != nullptr);
+    if (file != nullptr) {
+        fputc('X', file);
+        fclose(file);
+    }
+    CHECK(!loaded.loadPatrons(path));
+    CHECK(loaded.getCount() == 3);
+    CHECK(!loaded.loadPatrons("no_such_patron_file.dat"));
+    remove(path);
+}
+
+int main() {
+    testAddAndLookup();
+    testRemoveChecksCirculation();
+    testSaveAndLoad();
+    return finishTest("test_patrons");
+}
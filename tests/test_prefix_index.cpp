@@ -0,0 +1,205 @@
+/**
+ * test_prefix_index.cpp - PrefixIndex best-first top-k completions after adds and removes
+ * Values come from a tiny alphabet so they share long prefixes and split edges often. A
+ * reference map of book counts per value answers each prefix query by brute force; ties
+ * may come back in any order, so the suggestions are checked as a valid top k.
+ * Library::compactText must leave the tries holding only the values books still have.
+ */
+#include "test_util.h"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Reference values: folded value -> books with it, and the text it was first entered as
+struct ModelValue {
+    int count;
+    string text;
+};
+typedef map<string, ModelValue> Model;
+
+/**
+ * Helper function to make a random value over a small alphabet, in random case
+ */
+static string randomValue(mt19937& random) {
+    const char alphabet[] = "abAB c";
+    int length = 1 + static_cast<int>(random() % 6);
+    string value;
+    for (int i = 0; i < length; i++) {
+        value += alphabet[random() % 6];
+    }
+    return value;
+}
+
+/**
+ * Helper function to check one query: counts descending, each a real value with that count,
+ * and no value left out that has more books than the last one returned
+ */
+static void checkSuggest(const PrefixIndex& index, const Model& model, const string& prefix, int maxResults) {
+    string folded = fold(prefix);
+    vector<int> counts;
+    for (Model::const_iterator it = model.begin(); it != model.end(); ++it) {
+        if (it->second.count > 0 && it->first.compare(0, folded.size(), folded) == 0) {
+            counts.push_back(it->second.count);
+        }
+    }
+    sort(counts.rbegin(), counts.rend());
+    int expectedFound = static_cast<int>(counts.size()) < maxResults ? static_cast<int>(counts.size()) : maxResults;
+
+    vector<Suggestion> out(maxResults > 0 ? maxResults : 1);
+    int found = index.suggest(prefix.c_str(), out.data(), maxResults);
+    CHECK(found == expectedFound);
+    bool valid = true;
+    map<string, int> seen;
+    for (int i = 0; i < found && i < expectedFound; i++) {
+        // The same counts as the true top k, in order
+        valid = valid && out[i].count == counts[i];
+        Model::const_iterator value = model.find(fold(out[i].text));
+        valid = valid && value != model.end() && value->second.count == out[i].count &&
+                value->second.text == out[i].text && value->first.compare(0, folded.size(), folded) == 0;
+        valid = valid && seen[out[i].text]++ == 0;
+    }
+    CHECK(valid);
+}
+
+static void testRandomAgainstModel() {
+    PrefixIndex index;
+    Model model;
+    mt19937 random(8);
+    vector<string> added;
+    for (int op = 0; op < 30000; op++) {
+        int kind = static_cast<int>(random() % 10);
+        if (kind < 6 || added.empty()) {
+            // Some values are added far more often than others
+            string value = random() % 4 == 0 && !added.empty() ? added[random() % added.size()] : randomValue(random);
+            index.add(value.c_str());
+            ModelValue& entry = model[fold(value)];
+            if (entry.text.empty()) {
+                entry.text = value;
+            }
+            entry.count++;
+            added.push_back(value);
+        } else {
+            // Removes of values with no books left, or never added, change nothing
+            string value = kind < 9 ? added[random() % added.size()] : randomValue(random);
+            index.remove(value.c_str());
+            Model::iterator entry = model.find(fold(value));
+            if (entry != model.end() && entry->second.count > 0) {
+                entry->second.count--;
+            }
+        }
+        if (op % 50 == 0) {
+            string prefix = randomValue(random).substr(0, random() % 4);
+            checkSuggest(index, model, prefix, 1 + static_cast<int>(random() % 8));
+            checkSuggest(index, model, "", 5);
+        }
+    }
+
+    // Remove every book: no suggestions, though the nodes stay for reuse
+    for (Model::iterator it = model.begin(); it != model.end(); ++it) {
+        for (; it->second.count > 0; it->second.count--) {
+            index.remove(it->first.c_str());
+        }
+    }
+    checkSuggest(index, model, "", 10);
+    checkSuggest(index, model, "a", 10);
+    index.clear();
+    Suggestion out[1];
+    CHECK(index.suggest("", out, 1) == 0);
+}
+
+static void testBestFirstAfterDeletes() {
+    PrefixIndex index;
+    for (int i = 0; i < 5; i++) {
+        index.add("Dune");
+    }
+    for (int i = 0; i < 3; i++) {
+        index.add("Dune Messiah");
+    }
+    index.add("Dubliners");
+    index.add("DUNE Messiah");
+
+    Suggestion out[4];
+    CHECK(index.suggest("du", out, 4) == 3);
+    CHECK(strcmp(out[0].text, "Dune") == 0 && out[0].count == 5);
+    CHECK(strcmp(out[1].text, "Dune Messiah") == 0 && out[1].count == 4);
+    CHECK(strcmp(out[2].text, "Dubliners") == 0 && out[2].count == 1);
+
+    // Removing books from the leader lowers the stored subtree maxima
+    for (int i = 0; i < 4; i++) {
+        index.remove("dune");
+    }
+    CHECK(index.suggest("DUN", out, 2) == 2);
+    CHECK(strcmp(out[0].text, "Dune Messiah") == 0 && out[0].count == 4);
+    CHECK(strcmp(out[1].text, "Dune") == 0 && out[1].count == 1);
+    index.remove("Dune");
+    CHECK(index.suggest("dune", out, 4) == 1);
+    CHECK(index.suggest("dune m", out, 4) == 1);
+    CHECK(index.suggest("dunes", out, 4) == 0);
+    CHECK(index.suggest(nullptr, out, 4) == 0);
+    CHECK(index.suggest("d", out, 0) == 0);
+}
+
+static void testLibrarySuggestions() {
+    Library library;
+    Book book;
+    char id[MAX_ID_LENGTH];
+    for (int i = 0; i < 30; i++) {
+        snprintf(id, sizeof(id), "P%d", i);
+        CHECK(makeBook(book, id, "9780306406157", i < 20 ? "Emma" : "Emmanuelle", i % 2 == 0 ? "Austen" : "Arsan"));
+        CHECK(library.addBook(book));
+    }
+    Suggestion out[2];
+    CHECK(library.suggestTitles("em", out, 2) == 2);
+    CHECK(strcmp(out[0].text, "Emma") == 0 && out[0].count == 20);
+
+    // Deletes and an edit move the counts
+    for (int i = 0; i < 15; i++) {
+        snprintf(id, sizeof(id), "P%d", i);
+        CHECK(library.deleteBook(id));
+    }
+    CHECK(makeBook(book, "P25", "9780306406157", "Persuasion", "Austen"));
+    CHECK(library.editBook("P25", book));
+    CHECK(library.suggestTitles("EMM", out, 2) == 2);
+    CHECK(strcmp(out[0].text, "Emmanuelle") == 0 && out[0].count == 9);
+    CHECK(strcmp(out[1].text, "Emma") == 0 && out[1].count == 5);
+    CHECK(library.suggestAuthors("a", out, 2) == 2);
+    CHECK(out[0].count + out[1].count == 15);
+}
+
+static void testCompactionDropsDeadValues() {
+    // Every add brings a new title, so the tries grow with the adds until compactText
+    Library library;
+    Book book;
+    char id[MAX_ID_LENGTH];
+    char title[32];
+    for (int i = 0; i < 2000; i++) {
+        snprintf(id, sizeof(id), "C%d", i);
+        snprintf(title, sizeof(title), "Churn %d", i);
+        CHECK(makeBook(book, id, "9780306406157", title, i % 2 == 0 ? "Austen" : "Arsan"));
+        CHECK(library.addBook(book));
+        if (i >= 10) {
+            snprintf(id, sizeof(id), "C%d", i - 10);
+            CHECK(library.deleteBook(id));
+        }
+    }
+    size_t grown = library.getSuggestionTextBytes();
+    CHECK(library.compactText());
+    CHECK(library.getSuggestionTextBytes() < grown / 50);
+
+    // The live values are all still suggested, with their counts
+    Suggestion out[20];
+    CHECK(library.suggestTitles("churn 19", out, 20) == 10);
+    CHECK(library.suggestTitles("churn 18", out, 20) == 0);
+    CHECK(library.suggestAuthors("a", out, 20) == 2);
+    CHECK(out[0].count == 5 && out[1].count == 5);
+}
+
+int main() {
+    testRandomAgainstModel();
+    testBestFirstAfterDeletes();
+    testLibrarySuggestions();
+    testCompactionDropsDeadValues();
+    return finishTest("test_prefix_index");
+}
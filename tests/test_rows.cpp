@@ -0,0 +1,199 @@
+/**
+ * test_rows.cpp - row renumbering under add/delete churn
+ * A small set of live books is deleted and replaced many thousands of times. The rows in
+ * use must stay proportional to the live books, not to every add ever made, while a
+ * reference map of live books says what the ISBN, text and order indexes, the snapshot,
+ * handles taken along the way and a cursor paging through the churn must show.
+ */
+#include "test_util.h"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+const char* const TEST_ISBNS[] = { "9780306406157", "9781402894626", "9780131103627" };
+const char* const WORDS[] = { "amber", "birch", "cedar", "delta", "ember" };
+
+// Reference book: its fields, insertion number and the handle taken when it was added
+struct ModelBook {
+    int isbn;     // Index into TEST_ISBNS
+    int word;     // Index into WORDS, the title
+    int serial;   // Insertion number, which orders ties
+    BookHandle handle;
+};
+typedef map<string, ModelBook> Model;
+
+/**
+ * Helper function to check the indexes, snapshot and handles against the model
+ */
+static void checkLibrary(const Library& library, const Model& model) {
+    CHECK(library.getCount() == static_cast<int>(model.size()));
+    int* slots = new int[model.size() + 1];
+    for (int i = 0; i < 3; i++) {
+        uint64_t isbn = 0;
+        CHECK(parseIsbn(TEST_ISBNS[i], isbn));
+        int expected = 0;
+        for (Model::const_iterator it = model.begin(); it != model.end(); ++it) {
+            expected += it->second.isbn == i ? 1 : 0;
+        }
+        CHECK(library.findBooksByIsbn(isbn, slots, static_cast<int>(model.size()) + 1) == expected);
+    }
+    for (int w = 0; w < 5; w++) {
+        // Matches come back in insertion order
+        vector<pair<int, string>> expected;
+        for (Model::const_iterator it = model.begin(); it != model.end(); ++it) {
+            if (it->second.word == w) {
+                expected.push_back(make_pair(it->second.serial, it->first));
+            }
+        }
+        sort(expected.begin(), expected.end());
+        int found = library.searchBooks(WORDS[w], slots, static_cast<int>(model.size()) + 1);
+        bool same = found == static_cast<int>(expected.size());
+        for (int i = 0; same && i < found; i++) {
+            same = library.findBookById(expected[i].second.c_str()) == slots[i];
+        }
+        CHECK(same);
+    }
+    delete[] slots;
+
+    // Sorted by title, ties in insertion order
+    vector<pair<pair<int, int>, string>> sorted;
+    for (Model::const_iterator it = model.begin(); it != model.end(); ++it) {
+        sorted.push_back(make_pair(make_pair(it->second.word, it->second.serial), it->first));
+    }
+    sort(sorted.begin(), sorted.end());
+    vector<string> expectedIds;
+    for (size_t i = 0; i < sorted.size(); i++) {
+        expectedIds.push_back(sorted[i].second);
+    }
+    vector<string> listed;
+    CHECK(library.forEachBookSorted(SORT_BY_TITLE, "", "", collectId, &listed));
+    CHECK(listed == expectedIds);
+
+    // The snapshot and every handle agree with the library
+    shared_ptr<const CatalogSnapshot> snapshot = library.snapshot();
+    CHECK(snapshot != nullptr && snapshot->getCount() == library.getCount());
+    bool resolved = true;
+    for (Model::const_iterator it = model.begin(); it != model.end(); ++it) {
+        const Book* book = library.resolveBook(it->second.handle);
+        resolved = resolved && book != nullptr && book == library.viewBookById(it->first.c_str()) &&
+                   snapshot->findBookById(it->first.c_str()) != nullptr;
+    }
+    CHECK(resolved);
+}
+
+static void testChurn(Library::DeleteOrder order, unsigned seed) {
+    Library library(4);
+    library.setDeleteOrder(order);
+    library.enableOrderIndex(SORT_BY_TITLE);
+    library.enableSnapshots();
+    Model model;
+    vector<BookHandle> deadHandles;
+    mt19937 random(seed);
+    int serial = 0;
+    const int LIVE_BOOKS = 60;
+
+    // A cursor pages through the churn; books present throughout must each be seen once
+    BookCursor cursor;
+    set<string> seen;
+    set<string> present;
+    bool repeated = false;
+    Book page[8];
+
+    for (int op = 0; op < 30000; op++) {
+        // Adds and deletes alternate at random while the live books stay within 40 of LIVE_BOOKS
+        int live = static_cast<int>(model.size());
+        if (live < LIVE_BOOKS || (live < LIVE_BOOKS + 40 && random() % 2 == 0)) {
+            string id = "K" + to_string(serial);
+            ModelBook entry;
+            entry.isbn = static_cast<int>(random() % 3);
+            entry.word = static_cast<int>(random() % 5);
+            entry.serial = serial++;
+            Book book;
+            CHECK(makeBook(book, id.c_str(), TEST_ISBNS[entry.isbn], WORDS[entry.word]));
+            CHECK(library.addBook(book));
+            entry.handle = library.getBookHandle(id.c_str());
+            model[id] = entry;
+        } else {
+            Model::iterator victim = model.begin();
+            advance(victim, random() % model.size());
+            CHECK(library.deleteBook(victim->first.c_str()));
+            present.erase(victim->first);
+            if (deadHandles.size() < 100) {
+                deadHandles.push_back(victim->second.handle);
+            }
+            model.erase(victim);
+        }
+
+        // The rows in use stay within a small multiple of the live books
+        CHECK(library.getRowCount() <= 4 * (LIVE_BOOKS + 40));
+
+        if (op % 50 == 0) {
+            int found = library.fetchPage(cursor, page, 8);
+            for (int i = 0; i < found; i++) {
+                repeated = repeated || !seen.insert(page[i].getId()).second;
+            }
+            if (found == 0) {
+                // A listing is done: check it and start the next one
+                for (const string& id : present) {
+                    CHECK(seen.count(id) == 1);
+                }
+                cursor = BookCursor();
+                seen.clear();
+                present.clear();
+                for (Model::const_iterator it = model.begin(); it != model.end(); ++it) {
+                    present.insert(it->first);
+                }
+            }
+        }
+        if (op % 1000 == 0) {
+            checkLibrary(library, model);
+        }
+    }
+    CHECK(!repeated);
+    checkLibrary(library, model);
+    for (const BookHandle& handle : deadHandles) {
+        CHECK(library.resolveBook(handle) == nullptr);
+    }
+
+    // compactText leaves one row per live book
+    CHECK(library.compactText());
+    CHECK(library.getRowCount() == library.getCount());
+    checkLibrary(library, model);
+}
+
+static void testCheckpointRenumbers() {
+    // A checkpoint renumbers the rows once deleted books hold at least half of them
+    const char* snapshotPath = "test_rows.dat";
+    Library library(64);
+    library.enableOrderIndex(SORT_BY_TITLE);
+    Model model;
+    for (int i = 0; i < 40; i++) {
+        string id = "C" + to_string(i);
+        Book book;
+        CHECK(makeBook(book, id.c_str(), TEST_ISBNS[i % 3], WORDS[i % 5]));
+        CHECK(library.addBook(book));
+        ModelBook entry = { i % 3, i % 5, i, library.getBookHandle(id.c_str()) };
+        model[id] = entry;
+    }
+    for (int i = 0; i < 40; i += 2) {
+        string id = "C" + to_string(i);
+        CHECK(library.deleteBook(id.c_str()));
+        model.erase(id);
+    }
+    CHECK(library.getRowCount() == 40);
+    CHECK(library.checkpoint(snapshotPath));
+    CHECK(library.getRowCount() == 20);
+    library.enableSnapshots();
+    checkLibrary(library, model);
+    remove(snapshotPath);
+}
+
+int main() {
+    testChurn(Library::SWAP_WITH_LAST, 71);
+    testChurn(Library::PRESERVE_ORDER, 73);
+    testCheckpointRenumbers();
+    return finishTest("test_rows");
+}
@@ -0,0 +1,184 @@
+/**
+ * test_scan_pool.cpp - ScanPool task scheduling and the parallel scans built on it
+ * Every parallel result is compared with a serial pass over the same data; the pools are
+ * sized explicitly so the tests steal work even on a machine with one core.
+ */
+#include "test_util.h"
+#include <atomic>
+#include <vector>
+
+// Counters shared by the tasks of one run: how often each task ran
+struct TaskCounts {
+    atomic<int>* runs;
+    ScanPool* pool;
+    atomic<int> nestedRuns;
+};
+
+// Task body that records its run and does work proportional to its number, so shares are uneven
+static void countTask(int task, void* context) {
+    TaskCounts* counts = static_cast<TaskCounts*>(context);
+    volatile unsigned spin = 0;
+    for (int i = 0; i < task * 200; i++) {
+        spin = spin + i;
+    }
+    counts->runs[task]++;
+}
+
+// Task body for the nested run: counts its inner tasks
+static void innerTask(int, void* context) {
+    static_cast<TaskCounts*>(context)->nestedRuns++;
+}
+
+// Task body that starts another run on the same pool from inside a task
+static void nestingTask(int task, void* context) {
+    TaskCounts* counts = static_cast<TaskCounts*>(context);
+    counts->runs[task]++;
+    counts->pool->run(10, innerTask, counts);
+}
+
+static void testEveryTaskRunsOnce() {
+    const int TASKS = 1000;
+    ScanPool pool(3);
+    CHECK(pool.getThreadCount() == 4);
+    TaskCounts counts;
+    counts.runs = new atomic<int>[TASKS];
+    counts.pool = &pool;
+    for (int round = 0; round < 20; round++) {
+        for (int t = 0; t < TASKS; t++) {
+            counts.runs[t] = 0;
+        }
+        int taskCount = round == 0 ? 1 : TASKS - round * 37;
+        pool.run(taskCount, countTask, &counts);
+        for (int t = 0; t < TASKS; t++) {
+            CHECK(counts.runs[t] == (t < taskCount ? 1 : 0));
+        }
+    }
+    pool.run(0, countTask, &counts); // No tasks: returns without calling the body
+    delete[] counts.runs;
+}
+
+static void testNestedRun() {
+    const int TASKS = 64;
+    ScanPool pool(3);
+    TaskCounts counts;
+    counts.runs = new atomic<int>[TASKS];
+    counts.pool = &pool;
+    counts.nestedRuns = 0;
+    for (int t = 0; t < TASKS; t++) {
+        counts.runs[t] = 0;
+    }
+
+    // Inner runs find the pool busy and run on their own thread; all of them finish
+    pool.run(TASKS, nestingTask, &counts);
+    for (int t = 0; t < TASKS; t++) {
+        CHECK(counts.runs[t] == 1);
+    }
+    CHECK(counts.nestedRuns == TASKS * 10);
+    delete[] counts.runs;
+}
+
+// Context of a thread that keeps the pool busy alongside the main thread
+struct RunnerState {
+    ScanPool* pool;
+    TaskCounts* counts;
+    int taskCount;
+};
+
+static void runRepeatedly(RunnerState* state) {
+    for (int round = 0; round < 50; round++) {
+        state->pool->run(state->taskCount, countTask, state->counts);
+    }
+}
+
+static void testConcurrentCallers() {
+    const int TASKS = 200;
+    ScanPool pool(2);
+    TaskCounts first;
+    TaskCounts second;
+    first.runs = new atomic<int>[TASKS];
+    second.runs = new atomic<int>[TASKS];
+    for (int t = 0; t < TASKS; t++) {
+        first.runs[t] = 0;
+        second.runs[t] = 0;
+    }
+
+    // One caller gets the pool and the other runs serially; neither loses a task
+    RunnerState a = { &pool, &first, TASKS };
+    RunnerState b = { &pool, &second, TASKS };
+    thread other(runRepeatedly, &b);
+    runRepeatedly(&a);
+    other.join();
+    for (int t = 0; t < TASKS; t++) {
+        CHECK(first.runs[t] == 50);
+        CHECK(second.runs[t] == 50);
+    }
+    delete[] first.runs;
+    delete[] second.runs;
+}
+
+// Predicate: the book's title ends in a digit below the given one
+static bool titleDigitBelow(const Book& book, const void* context) {
+    const char* title = book.getTitle();
+    size_t length = strlen(title);
+    return length > 0 && title[length - 1] - '0' < *static_cast<const int*>(context);
+}
+
+// Serial reference for findBooksWhere: collects matching slots in order
+struct SerialScan {
+    const int* limit;
+    int slot;
+    vector<int> found;
+};
+
+static bool serialStep(const Book& book, void* context) {
+    SerialScan* scan = static_cast<SerialScan*>(context);
+    if (titleDigitBelow(book, scan->limit)) {
+        scan->found.push_back(scan->slot);
+    }
+    scan->slot++;
+    return true;
+}
+
+static void testFindBooksMatchesSerialScan() {
+    // Several chunks, the last one partial
+    const int BOOKS = 100000;
+    Library library(BOOKS);
+    Book book;
+    char id[MAX_ID_LENGTH];
+    char title[32];
+    for (int i = 0; i < BOOKS; i++) {
+        snprintf(id, sizeof(id), "B%d", i);
+        snprintf(title, sizeof(title), "Title %u", static_cast<unsigned>(i * 2654435761u) % 1000);
+        CHECK(makeBook(book, id, "9780306406157", title));
+        CHECK(library.addBook(book));
+    }
+
+    int* slots = new int[BOOKS];
+    const int limits[] = { 0, 1, 5, 10 };
+    for (int limit : limits) {
+        SerialScan serial;
+        serial.limit = &limit;
+        serial.slot = 0;
+        library.forEachBook(serialStep, &serial);
+
+        int found = library.findBooksWhere(titleDigitBelow, &limit, slots, BOOKS);
+        CHECK(found == static_cast<int>(serial.found.size()));
+        CHECK(found == 0 || memcmp(slots, serial.found.data(), found * sizeof(int)) == 0);
+        CHECK(library.countBooksWhere(titleDigitBelow, &limit) == found);
+
+        // A short output array keeps the first matches in slot order
+        int capped = library.findBooksWhere(titleDigitBelow, &limit, slots, 25);
+        int expected = found < 25 ? found : 25;
+        CHECK(capped == expected);
+        CHECK(capped == 0 || memcmp(slots, serial.found.data(), capped * sizeof(int)) == 0);
+    }
+    delete[] slots;
+}
+
+int main() {
+    testEveryTaskRunsOnce();
+    testNestedRun();
+    testConcurrentCallers();
+    testFindBooksMatchesSerialScan();
+    return finishTest("test_scan_pool");
+}
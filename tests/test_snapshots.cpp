@@ -0,0 +1,305 @@
+/**
+ * test_snapshots.cpp - copy-on-write isolation of CatalogSnapshot versions
+ * Every version published by a Library is kept with the reference catalogue it was taken
+ * from, and all of them are compared again after each later add, edit, delete, clear and
+ * compactText. Run under -fsanitize=thread for the test with concurrent readers.
+ */
+#include "test_util.h"
+#include <atomic>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// Reference catalogue: ID -> "title|author" of every book present
+typedef map<string, string> Model;
+
+// A published version and the catalogue it must keep showing
+struct Version {
+    shared_ptr<const CatalogSnapshot> snapshot;
+    Model expected;
+};
+
+// Book visitor that records each book the way the model does
+static bool collectBook(const Book& book, void* context) {
+    (*static_cast<Model*>(context))[book.getId()] = string(book.getTitle()) + "|" + book.getAuthor();
+    return true;
+}
+
+/**
+ * Helper function to describe a snapshot the way the model does
+ * Every book listed must also be found through the ID buckets.
+ */
+static Model contents(const CatalogSnapshot& snapshot) {
+    Model books;
+    snapshot.forEachBook(collectBook, &books);
+    bool consistent = static_cast<int>(books.size()) == snapshot.getCount();
+    for (Model::const_iterator it = books.begin(); consistent && it != books.end(); ++it) {
+        const Book* book = snapshot.findBookById(it->first.c_str());
+        consistent = book != nullptr && it->second == string(book->getTitle()) + "|" + book->getAuthor();
+    }
+    CHECK(consistent);
+    return books;
+}
+
+/**
+ * Helper function to check every version still shows its own catalogue
+ */
+static void checkVersions(const vector<Version>& versions) {
+    for (const Version& version : versions) {
+        CHECK(contents(*version.snapshot) == version.expected);
+    }
+}
+
+/**
+ * Helper function to add or replace a book in both the library and the model
+ */
+static void putBook(Library& library, Model& model, const char* id, const char* title, const char* author) {
+    Book book;
+    CHECK(makeBook(book, id, "9780306406157", title, author));
+    if (model.count(id) > 0) {
+        CHECK(library.editBook(id, book));
+    } else {
+        CHECK(library.addBook(book));
+    }
+    model[id] = string(title) + "|" + author;
+}
+
+/**
+ * Helper function to publish the library's current version and keep it with the model
+ */
+static void publish(Library& library, const Model& model, vector<Version>& versions) {
+    Version version;
+    version.snapshot = library.snapshot();
+    version.expected = model;
+    CHECK(version.snapshot != nullptr);
+    versions.push_back(version);
+    checkVersions(versions);
+}
+
+static void testVersionsSurviveEveryChange() {
+    // Enough books for several chunks of pages and a few bucket doublings
+    const int BOOKS = 20000;
+    Library library;
+    library.enableSnapshots();
+    mt19937 random(14);
+    Model model;
+    vector<Version> versions;
+    char id[MAX_ID_LENGTH];
+    char title[32];
+    for (int i = 0; i < BOOKS; i++) {
+        snprintf(id, sizeof(id), "V%d", i);
+        snprintf(title, sizeof(title), "Title %d", i);
+        putBook(library, model, id, title, "Author");
+    }
+    publish(library, model, versions);
+
+    // Adds that open new pages, and a new chunk of pages
+    for (int i = BOOKS; i < BOOKS + 3000; i++) {
+        snprintf(id, sizeof(id), "V%d", i);
+        putBook(library, model, id, "Added", "Author");
+    }
+    publish(library, model, versions);
+
+    // Edits scattered over every page, then a few on one page
+    for (int e = 0; e < 500; e++) {
+        snprintf(id, sizeof(id), "V%d", static_cast<int>(random() % BOOKS));
+        snprintf(title, sizeof(title), "Edited %d", e);
+        putBook(library, model, id, title, "Editor");
+    }
+    publish(library, model, versions);
+    for (int i = 300; i < 310; i++) {
+        snprintf(id, sizeof(id), "V%d", i);
+        putBook(library, model, id, "Edited again", "Editor");
+    }
+    publish(library, model, versions);
+
+    // Deletes, including every book of the first page
+    for (int i = 0; i < 256; i++) {
+        snprintf(id, sizeof(id), "V%d", i);
+        CHECK(library.deleteBook(id));
+        model.erase(id);
+    }
+    for (int d = 0; d < 2000; d++) {
+        snprintf(id, sizeof(id), "V%d", static_cast<int>(random() % (BOOKS + 3000)));
+        CHECK(library.deleteBook(id) == (model.erase(id) > 0));
+    }
+    publish(library, model, versions);
+
+    // compactText moves the library to a new pool; older versions keep theirs
+    CHECK(library.getDroppedTextBytes() > 0);
+    CHECK(library.compactText());
+    publish(library, model, versions);
+    putBook(library, model, "V1", "After compaction", "Author");
+    publish(library, model, versions);
+
+    // clear starts an empty version; every earlier one is untouched
+    library.clear();
+    model.clear();
+    publish(library, model, versions);
+    CHECK(versions.back().snapshot->getCount() == 0);
+    putBook(library, model, "V1", "After clear", "Author");
+    publish(library, model, versions);
+}
+
+static void testSharedPageCopiedBeforeWrite() {
+    Library library;
+    library.enableSnapshots();
+    Model model;
+    char id[MAX_ID_LENGTH];
+    for (int i = 0; i < 3 * 256; i++) {
+        snprintf(id, sizeof(id), "C%d", i);
+        putBook(library, model, id, "Original", "Author");
+    }
+
+    // With no change in between, the same version is handed out again
+    shared_ptr<const CatalogSnapshot> first = library.snapshot();
+    CHECK(library.snapshot() == first);
+
+    // An edit on the second page copies that page and leaves the others shared
+    putBook(library, model, "C300", "Edited", "Author");
+    shared_ptr<const CatalogSnapshot> second = library.snapshot();
+    CHECK(second != first);
+    CHECK(first->findBookById("C5") == second->findBookById("C5"));
+    CHECK(first->findBookById("C600") == second->findBookById("C600"));
+    CHECK(first->findBookById("C301") != second->findBookById("C301"));
+    CHECK(strcmp(first->findBookById("C300")->getTitle(), "Original") == 0);
+    CHECK(strcmp(second->findBookById("C300")->getTitle(), "Edited") == 0);
+    CHECK(strcmp(second->findBookById("C301")->getTitle(), "Original") == 0);
+
+    // Two edits in one epoch share one copy of the page, which differs from the published one
+    putBook(library, model, "C301", "Edited", "Author");
+    putBook(library, model, "C302", "Edited", "Author");
+    shared_ptr<const CatalogSnapshot> third = library.snapshot();
+    CHECK(third->findBookById("C302") - third->findBookById("C301") == 1);
+    CHECK(third->findBookById("C301") != second->findBookById("C301"));
+    CHECK(third->findBookById("C5") == first->findBookById("C5"));
+    CHECK(strcmp(second->findBookById("C301")->getTitle(), "Original") == 0);
+
+    // Deleting a page's last book drops the page from new versions only
+    for (int i = 512; i < 768; i++) {
+        snprintf(id, sizeof(id), "C%d", i);
+        CHECK(library.deleteBook(id));
+        model.erase(id);
+    }
+    shared_ptr<const CatalogSnapshot> fourth = library.snapshot();
+    CHECK(fourth->findBookById("C600") == nullptr);
+    CHECK(first->findBookById("C600") == second->findBookById("C600"));
+    CHECK(strcmp(first->findBookById("C600")->getTitle(), "Original") == 0);
+    CHECK(contents(*fourth) == model);
+    CHECK(contents(*first).size() == 3 * 256);
+}
+
+// The latest version handed from the writer to the readers, with its catalogue
+struct Exchange {
+    mutex lock;
+    shared_ptr<const CatalogSnapshot> snapshot;
+    shared_ptr<const Model> expected;
+    atomic<bool> done;
+    atomic<int> checks;
+    atomic<int> mismatches;
+};
+
+/**
+ * Helper function for a reader thread: checks each new version, and the one before it
+ * again, with no lock held while reading
+ */
+static void readVersions(Exchange* exchange) {
+    shared_ptr<const CatalogSnapshot> previous;
+    shared_ptr<const Model> previousExpected;
+    while (!exchange->done) {
+        shared_ptr<const CatalogSnapshot> snapshot;
+        shared_ptr<const Model> expected;
+        {
+            lock_guard<mutex> guard(exchange->lock);
+            snapshot = exchange->snapshot;
+            expected = exchange->expected;
+        }
+        if (!snapshot) {
+            this_thread::yield();
+            continue;
+        }
+        Model seen;
+        snapshot->forEachBook(collectBook, &seen);
+        if (seen != *expected || snapshot->getCount() != static_cast<int>(expected->size())) {
+            exchange->mismatches++;
+        }
+        for (Model::const_iterator it = expected->begin(); it != expected->end(); ++it) {
+            const Book* book = snapshot->findBookById(it->first.c_str());
+            if (book == nullptr || it->second != string(book->getTitle()) + "|" + book->getAuthor()) {
+                exchange->mismatches++;
+                break;
+            }
+        }
+        if (previous) {
+            seen.clear();
+            previous->forEachBook(collectBook, &seen);
+            if (seen != *previousExpected) {
+                exchange->mismatches++;
+            }
+        }
+        previous = snapshot;
+        previousExpected = expected;
+        exchange->checks++;
+    }
+}
+
+static void testConcurrentReaders() {
+    const int READERS = 4;
+    const int IDS = 700;
+    const int OPERATIONS = 6000;
+    Library library;
+    library.enableSnapshots();
+    Exchange exchange;
+    exchange.done = false;
+    exchange.checks = 0;
+    exchange.mismatches = 0;
+    vector<thread> readers;
+    for (int r = 0; r < READERS; r++) {
+        readers.push_back(thread(readVersions, &exchange));
+    }
+
+    // The single writer changes the library and publishes a version every few changes
+    mt19937 random(41);
+    Model model;
+    char id[MAX_ID_LENGTH];
+    char title[32];
+    for (int op = 0; op < OPERATIONS; op++) {
+        snprintf(id, sizeof(id), "W%d", static_cast<int>(random() % IDS));
+        if (model.count(id) > 0 && random() % 3 == 0) {
+            CHECK(library.deleteBook(id));
+            model.erase(id);
+        } else {
+            snprintf(title, sizeof(title), "Title %d", op);
+            putBook(library, model, id, title, "Writer");
+        }
+        if (op == OPERATIONS / 2) {
+            CHECK(library.compactText());
+        }
+        if (op % 10 == 9) {
+            shared_ptr<const CatalogSnapshot> snapshot = library.snapshot();
+            shared_ptr<const Model> expected = make_shared<const Model>(model);
+            lock_guard<mutex> guard(exchange.lock);
+            exchange.snapshot = snapshot;
+            exchange.expected = expected;
+        }
+    }
+    // Let each reader see the last version before stopping
+    int seenBefore = exchange.checks;
+    while (exchange.checks < seenBefore + READERS) {
+        this_thread::yield();
+    }
+    exchange.done = true;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+    CHECK(exchange.mismatches == 0);
+    CHECK(exchange.checks > 0);
+}
+
+int main() {
+    testVersionsSurviveEveryChange();
+    testSharedPageCopiedBeforeWrite();
+    testConcurrentReaders();
+    return finishTest("test_snapshots");
+}
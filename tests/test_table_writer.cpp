@@ -0,0 +1,118 @@
+/**
+ * test_table_writer.cpp - the book table rendered by Book::formatTableRow and TableWriter
+ * Random books are rendered through a TableWriter into a temporary file and compared byte
+ * for byte with the printf format the table used before TableWriter replaced it.
+ */
+#include "test_util.h"
+#include <random>
+#include <string>
+
+/**
+ * Helper function to make random printable text of the given length
+ */
+static string randomText(mt19937& random, int length) {
+    string text;
+    for (int i = 0; i < length; i++) {
+        text += static_cast<char>(' ' + random() % 95);
+    }
+    return text;
+}
+
+/**
+ * Helper function to append a book's row as the old printf-based displayInTable wrote it
+ */
+static void appendPrintfRow(string& expected, const Book& book) {
+    char isbnText[MAX_ISBN_LENGTH];
+    formatIsbn(book.getIsbn(), isbnText);
+    char row[256];
+    int length = snprintf(row, sizeof(row), "| %-6.6s | %-13.13s | %-30.30s | %-20.20s | %-8.8s | %-20.20s | %-11.11s |\n",
+                          book.getId(), isbnText, book.getTitle(), book.getAuthor(), book.getEdition(),
+                          book.getPublication(), book.getCategory());
+    expected.append(row, length);
+}
+
+/**
+ * Helper function to read a whole file into a string
+ */
+static string readAll(FILE* file) {
+    string contents;
+    char block[65536];
+    rewind(file);
+    size_t got;
+    while ((got = fread(block, 1, sizeof(block), file)) > 0) {
+        contents.append(block, got);
+    }
+    return contents;
+}
+
+static void testRowsMatchPrintfFormat() {
+    // Enough rows to fill the 1 MB buffer several times, so rows straddle buffer writes
+    const int BOOKS = 20000;
+    const char* separator =
+        "+--------+---------------+--------------------------------+----------------------+----------+----------------------+-------------+\n";
+    const char* header =
+        "| ID     | ISBN          | Title                          | Author               | Edition  | Publication          | Category    |\n";
+    mt19937 random(16);
+    FILE* file = tmpfile();
+    CHECK(file != nullptr);
+    if (file == nullptr) {
+        return;
+    }
+
+    string expected = string(separator) + header + separator;
+    {
+        TableWriter table(file);
+        table.writeHeader();
+        Book book;
+        char id[MAX_ID_LENGTH];
+        for (int i = 0; i < BOOKS; i++) {
+            // IDs and text run from empty-ish to past each column's width
+            snprintf(id, sizeof(id), "%0*d", 1 + static_cast<int>(random() % 12), i);
+            CHECK(book.setId(id));
+            CHECK(book.setIsbn(i % 2 == 0 ? "9780306406157" : "978-1-4028-9462-6"));
+            CHECK(book.setTitle(randomText(random, 1 + random() % 60).c_str()));
+            CHECK(book.setAuthor(randomText(random, 1 + random() % 40).c_str()));
+            CHECK(book.setEdition(randomText(random, 1 + random() % 15).c_str()));
+            CHECK(book.setPublication(randomText(random, 1 + random() % 40).c_str()));
+            CHECK(book.setCategory(i % 3 == 0 ? "Non-fiction" : "Fiction"));
+            table.writeBook(book);
+            appendPrintfRow(expected, book);
+            expected += separator;
+        }
+        CHECK(table.getRowCount() == BOOKS);
+    }
+
+    string written = readAll(file);
+    fclose(file);
+    CHECK(written.size() == expected.size());
+    CHECK(written == expected);
+}
+
+static void testFlushKeepsOrder() {
+    FILE* file = tmpfile();
+    CHECK(file != nullptr);
+    if (file == nullptr) {
+        return;
+    }
+    Book book;
+    CHECK(makeBook(book, "B1", "9780306406157", "A title longer than its thirty-character column"));
+    TableWriter table(file);
+    table.writeBook(book);
+    table.flush();
+    fputs("after\n", file);
+    table.writeBook(book);
+    table.flush();
+
+    string row;
+    appendPrintfRow(row, book);
+    string separator =
+        "+--------+---------------+--------------------------------+----------------------+----------+----------------------+-------------+\n";
+    CHECK(readAll(file) == row + separator + "after\n" + row + separator);
+    fclose(file);
+}
+
+int main() {
+    testRowsMatchPrintfFormat();
+    testFlushKeepsOrder();
+    return finishTest("test_table_writer");
+}
@@ -0,0 +1,221 @@
+/**
+ * test_text_index.cpp - TextIndex multi-word AND queries and their galloping intersection
+ * Documents are drawn from a small vocabulary where some words are in almost every book and
+ * others in very few, so the posting lists of one query differ in length by orders of
+ * magnitude. Every query is compared with a scan of the reference documents, before and
+ * after documents are removed and re-indexed.
+ */
+#include "test_util.h"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+const char* const VOCABULARY[] = { "the", "history", "of", "river", "garden", "night", "quantum",
+                                   "zebra", "violin", "harbour", "ember", "xylophone" };
+const int VOCABULARY_SIZE = 12;
+// Chance in 1000 that a document holds each word: from nearly all to a handful
+const int WORD_ODDS[] = { 900, 600, 400, 200, 100, 50, 20, 10, 5, 3, 2, 1 };
+const char* const SEPARATORS[] = { " ", ", ", "-", ": ", "  ", "'" };
+
+// Reference documents: the set of lower-case words of each indexed row
+typedef map<int, set<string> > Model;
+
+/**
+ * Helper function to write a word with randomly changed case
+ */
+static string randomCase(mt19937& random, const string& word) {
+    string text = word;
+    for (char& c : text) {
+        if (random() % 2 == 0) {
+            c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+        }
+    }
+    return text;
+}
+
+/**
+ * Helper function to make a random document; its words go to words, its text to title and author
+ */
+static void randomDocument(mt19937& random, set<string>& words, string& title, string& author) {
+    words.clear();
+    title.clear();
+    author.clear();
+    for (int w = 0; w < VOCABULARY_SIZE; w++) {
+        if (static_cast<int>(random() % 1000) < WORD_ODDS[w]) {
+            words.insert(VOCABULARY[w]);
+            string& field = random() % 3 == 0 ? author : title;
+            if (!field.empty()) {
+                field += SEPARATORS[random() % 6];
+            }
+            field += randomCase(random, VOCABULARY[w]);
+        }
+    }
+}
+
+/**
+ * Helper function to answer a query from the model: rows holding every word, ascending
+ */
+static vector<int> expectedRows(const Model& model, const vector<string>& terms, int maxResults) {
+    vector<int> rows;
+    for (Model::const_iterator it = model.begin(); it != model.end() && static_cast<int>(rows.size()) < maxResults; ++it) {
+        bool all = true;
+        for (const string& term : terms) {
+            all = all && it->second.count(term) > 0;
+        }
+        if (all) {
+            rows.push_back(it->first);
+        }
+    }
+    return rows;
+}
+
+/**
+ * Helper function to run random queries of one to four words against the model
+ */
+static void checkQueries(const TextIndex& index, const Model& model, mt19937& random, int queries) {
+    vector<int> found(model.size() + 1);
+    for (int q = 0; q < queries; q++) {
+        int termCount = 1 + static_cast<int>(random() % 4);
+        vector<string> terms;
+        string query;
+        for (int t = 0; t < termCount; t++) {
+            // Rare words are picked as often as common ones
+            string word = VOCABULARY[random() % VOCABULARY_SIZE];
+            terms.push_back(word);
+            query += randomCase(random, word) + SEPARATORS[random() % 6];
+        }
+        int maxResults = random() % 4 == 0 ? 1 + static_cast<int>(random() % 20) : static_cast<int>(found.size());
+        vector<int> expected = expectedRows(model, terms, maxResults);
+        int count = index.search(query.c_str(), found.data(), maxResults);
+        CHECK(vector<int>(found.begin(), found.begin() + count) == expected);
+    }
+}
+
+static void testRandomQueries() {
+    const int ROWS = 20000;
+    TextIndex index;
+    Model model;
+    mt19937 random(7);
+
+    // Rows arrive out of order, so postings are inserted in the middle as well as appended
+    vector<int> order;
+    for (int row = 0; row < ROWS; row++) {
+        order.push_back(row);
+    }
+    shuffle(order.begin(), order.end(), random);
+    map<int, pair<string, string> > texts;
+    set<string> words;
+    string title;
+    string author;
+    for (int row : order) {
+        randomDocument(random, words, title, author);
+        index.addDocument(row, title.c_str(), author.c_str());
+        model[row] = words;
+        texts[row] = make_pair(title, author);
+    }
+    checkQueries(index, model, random, 400);
+
+    // Remove a third of the documents and re-index a tenth with new text
+    for (int row = 0; row < ROWS; row++) {
+        int pick = static_cast<int>(random() % 30);
+        if (pick < 10) {
+            index.removeDocument(row, texts[row].first.c_str(), texts[row].second.c_str());
+            model.erase(row);
+        } else if (pick < 13) {
+            index.removeDocument(row, texts[row].first.c_str(), texts[row].second.c_str());
+            randomDocument(random, words, title, author);
+            index.addDocument(row, title.c_str(), author.c_str());
+            model[row] = words;
+        }
+    }
+    checkQueries(index, model, random, 400);
+
+    index.clear();
+    int found[4];
+    CHECK(index.search("the", found, 4) == 0);
+}
+
+static void testTokenizing() {
+    TextIndex index;
+    index.addDocument(3, "Hello-World: A Tale", "O'Brien, J.R.R.");
+    index.addDocument(5, "hello again", "Anon");
+    string longWord(40, 'q');
+    index.addDocument(9, ("The " + longWord).c_str(), "Writer");
+
+    int found[8];
+    CHECK(index.search("HELLO", found, 8) == 2 && found[0] == 3 && found[1] == 5);
+    CHECK(index.search("world hello", found, 8) == 1 && found[0] == 3);
+    CHECK(index.search("brien", found, 8) == 1 && found[0] == 3);
+    CHECK(index.search("r", found, 8) == 1 && found[0] == 3);
+    CHECK(index.search("hello missing", found, 8) == 0);
+    CHECK(index.search("", found, 8) == 0);
+    CHECK(index.search(" -,; ", found, 8) == 0);
+    CHECK(index.search("hello", found, 0) == 0);
+    CHECK(index.search("hello", nullptr, 8) == 0);
+    // Words are indexed by their first MAX_TOKEN_LENGTH characters
+    CHECK(index.search(longWord.c_str(), found, 8) == 1 && found[0] == 9);
+    CHECK(index.search(string(TextIndex::MAX_TOKEN_LENGTH, 'q').c_str(), found, 8) == 1);
+    // A word repeated in the query or the document counts once
+    CHECK(index.search("hello HELLO hello", found, 8) == 2);
+
+    // A query of more than MAX_QUERY_TERMS distinct words is rejected, not cut short
+    string query = "hello";
+    for (int i = 1; i < TextIndex::MAX_QUERY_TERMS; i++) {
+        query += " hello";
+    }
+    for (int i = 1; i < TextIndex::MAX_QUERY_TERMS; i++) {
+        query += " w" + to_string(i);
+    }
+    index.addDocument(11, query.c_str(), "Anon");
+    CHECK(index.search(query.c_str(), found, 8) == 1 && found[0] == 11);
+    CHECK(index.search((query + " missing").c_str(), found, 8) == -1);
+    CHECK(index.search((query + " w1 HELLO").c_str(), found, 8) == 1);
+}
+
+static void testLibrarySearch() {
+    // searchBooks gives slots of the matching books in the order they were added
+    Library library(8);
+    library.setDeleteOrder(Library::SWAP_WITH_LAST);
+    Book book;
+    char id[MAX_ID_LENGTH];
+    for (int i = 0; i < 300; i++) {
+        snprintf(id, sizeof(id), "T%d", i);
+        CHECK(makeBook(book, id, "9780306406157", i % 3 == 0 ? "Night Garden" : "Night Music",
+                       i % 5 == 0 ? "Ember Lee" : "Ash Lee"));
+        CHECK(library.addBook(book));
+    }
+    for (int i = 0; i < 300; i += 7) {
+        snprintf(id, sizeof(id), "T%d", i);
+        CHECK(library.deleteBook(id));
+    }
+    // One edit takes a match out of the results, another brings a book in
+    CHECK(makeBook(book, "T15", "9780306406157", "Night Music", "Ember Lee"));
+    CHECK(library.editBook("T15", book));
+    CHECK(makeBook(book, "T1", "9780306406157", "Garden Paths", "Ember Stone"));
+    CHECK(library.editBook("T1", book));
+
+    int slots[300];
+    int found = library.searchBooks("garden EMBER", slots, 300);
+    vector<int> expected;
+    for (int i = 0; i < 300; i++) {
+        if (i % 7 != 0 && ((i % 15 == 0 && i != 15) || i == 1)) {
+            expected.push_back(i);
+        }
+    }
+    CHECK(found == static_cast<int>(expected.size()));
+    CHECK(library.searchBooks("a b c d e f g h i j k l m n o p q", slots, 300) == -1);
+    for (int r = 0; r < found && r < static_cast<int>(expected.size()); r++) {
+        snprintf(id, sizeof(id), "T%d", expected[r]);
+        CHECK(library.findBookById(id) == slots[r]);
+    }
+}
+
+int main() {
+    testRandomQueries();
+    testTokenizing();
+    testLibrarySearch();
+    return finishTest("test_text_index");
+}
@@ -0,0 +1,97 @@
+/**
+ * test_util.h - shared helpers for the tests
+ * Includes the program without its main function and provides CHECK, which reports a
+ * failed condition with its line and counts it instead of stopping the test.
+ */
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#define LIBRARY_MANAGEMENT_NO_MAIN
+#include "../library_management.cpp"
+#include <cctype>
+#include <string>
+#include <vector>
+
+static int testFailures = 0;
+
+#define CHECK(condition)                                                   \
+    do {                                                                   \
+        if (!(condition)) {                                                \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            testFailures++;                                                \
+        }                                                                  \
+    } while (0)
+
+/**
+ * Helper function to fill a book with valid fields
+ * Returns false if any field is rejected
+ */
+inline bool makeBook(Book& book, const char* id, const char* isbn, const char* title,
+                     const char* author = "Author", const char* category = "Fiction") {
+    return book.setId(id) && book.setIsbn(isbn) && book.setTitle(title) && book.setAuthor(author) &&
+           book.setEdition("1st") && book.setPublication("Publisher") && book.setCategory(category);
+}
+
+// Book visitor that collects IDs in listing order
+inline bool collectId(const Book& book, void* context) {
+    static_cast<vector<string>*>(context)->push_back(book.getId());
+    return true;
+}
+
+/**
+ * Helper function to lowercase a string the way the indexes fold keys
+ */
+inline string fold(const string& text) {
+    string folded = text;
+    for (char& c : folded) {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    return folded;
+}
+
+/**
+ * Helper function to get the ID of a reference slot that is just the ID
+ * Tests whose slots carry more define their own modelSlotId for their slot type.
+ */
+inline const string& modelSlotId(const string& slot) {
+    return slot;
+}
+
+/**
+ * Helper function to find an ID's position in a reference array of slots, -1 if absent
+ */
+template <typename Slot>
+inline int slotOf(const vector<Slot>& slots, const string& id) {
+    for (size_t s = 0; s < slots.size(); s++) {
+        if (modelSlotId(slots[s]) == id) {
+            return static_cast<int>(s);
+        }
+    }
+    return -1;
+}
+
+/**
+ * Helper function to apply one delete to a reference array of slots as the delete order promises
+ */
+template <typename Slot>
+inline void modelDelete(vector<Slot>& slots, int index, Library::DeleteOrder order) {
+    if (order == Library::SWAP_WITH_LAST) {
+        slots[index] = slots.back();
+        slots.pop_back();
+    } else {
+        slots.erase(slots.begin() + index);
+    }
+}
+
+/**
+ * Helper function to end a test: prints a summary and gives the exit status
+ */
+static int finishTest(const char* name) {
+    if (testFailures > 0) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, testFailures);
+        return 1;
+    }
+    return 0;
+}
+
+#endif
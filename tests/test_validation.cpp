@@ -0,0 +1,151 @@
+/**
+ * test_validation.cpp - checkField and the setters and prompts built on it
+ * Every byte value is checked against a reference predicate for each character class, and
+ * the ID, category and title fields are tried at the length limit, one past it, empty,
+ * null and with high-bit bytes. getValidId reads scripted lines from a redirected cin.
+ */
+#include "test_util.h"
+#include <sstream>
+#include <string>
+
+/**
+ * Helper function to decide whether a byte belongs to a character class, the slow way
+ */
+static bool referenceClass(int c, unsigned char charClass) {
+    if (c == 0) {
+        return false;
+    }
+    bool digit = c >= '0' && c <= '9';
+    bool letter = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+    switch (charClass) {
+        case CHAR_TEXT:
+            return true;
+        case CHAR_ALNUM:
+            return digit || letter;
+        case CHAR_ISBN:
+            return digit || c == 'X' || c == 'x' || c == '-' || c == ' ';
+        default:
+            return false;
+    }
+}
+
+static void testEveryByte() {
+    const unsigned char classes[] = { CHAR_TEXT, CHAR_ALNUM, CHAR_ISBN };
+    for (unsigned char charClass : classes) {
+        for (int c = 0; c < 256; c++) {
+            // The byte alone, and the byte between two characters every class accepts
+            char alone[2] = { static_cast<char>(c), '\0' };
+            char inside[4] = { '1', static_cast<char>(c), '2', '\0' };
+            size_t length = 0;
+            bool expected = referenceClass(c, charClass);
+            CHECK(checkField(alone, 8, charClass, length) == expected);
+            CHECK(!expected || length == 1);
+            if (c != 0) {
+                CHECK(checkField(inside, 8, charClass, length) == expected);
+                CHECK(!expected || length == 3);
+            }
+        }
+    }
+}
+
+static void testLengthLimit() {
+    // maxLength counts the terminator, so the longest field is one byte shorter
+    size_t length = 99;
+    CHECK(!checkField(nullptr, MAX_ID_LENGTH, CHAR_TEXT, length));
+    CHECK(!checkField("", MAX_ID_LENGTH, CHAR_TEXT, length));
+    CHECK(length == 99);
+    string longest(MAX_ID_LENGTH - 1, 'a');
+    string tooLong(MAX_ID_LENGTH, 'a');
+    CHECK(checkField(longest.c_str(), MAX_ID_LENGTH, CHAR_ALNUM, length) && length == longest.size());
+    CHECK(!checkField(tooLong.c_str(), MAX_ID_LENGTH, CHAR_ALNUM, length));
+    CHECK(checkField("a", 2, CHAR_ALNUM, length) && length == 1);
+    CHECK(!checkField("ab", 2, CHAR_ALNUM, length));
+    CHECK(!checkField("a", 1, CHAR_ALNUM, length));
+
+    // A buffer of maxLength bytes with no terminator is rejected without reading past it
+    char unterminated[MAX_ID_LENGTH];
+    memset(unterminated, 'a', sizeof(unterminated));
+    CHECK(!checkField(unterminated, sizeof(unterminated), CHAR_ALNUM, length));
+}
+
+static void testBookSetters() {
+    Book book;
+    CHECK(makeBook(book, "A1", "9780306406157", "Dune"));
+
+    // IDs: ASCII letters and digits only, up to MAX_ID_LENGTH - 1 of them
+    string longestId(MAX_ID_LENGTH - 1, 'Z');
+    CHECK(book.setId(longestId.c_str()) && longestId == book.getId());
+    CHECK(!book.setId(string(MAX_ID_LENGTH, 'Z').c_str()));
+    CHECK(!book.setId(""));
+    CHECK(!book.setId(nullptr));
+    const char* badIds[] = { "A 1", "A-1", "A_1", "A/1", "A:1", "A@1", "A[1", "A`1", "A{1", "A\xC3\xA9" };
+    for (const char* id : badIds) {
+        CHECK(!book.setId(id));
+    }
+    CHECK(book.setId("09azAZ") && strcmp(book.getId(), "09azAZ") == 0);
+
+    // Categories: exactly one of the two names, case-sensitive
+    CHECK(book.setCategory("Non-fiction") && book.getCategoryCode() == CATEGORY_NON_FICTION);
+    CHECK(book.setCategory("Fiction") && book.getCategoryCode() == CATEGORY_FICTION);
+    const char* badCategories[] = { "", "fiction", "Fiction ", " Fiction", "Non-Fiction", "Fictio",
+                                     "Non-fiction\xC2\xA0", "Poetry" };
+    for (const char* category : badCategories) {
+        CHECK(!book.setCategory(category));
+    }
+    CHECK(!book.setCategory(string(MAX_CATEGORY_LENGTH, 'F').c_str()));
+    CHECK(!book.setCategory(nullptr));
+    CHECK(book.getCategoryCode() == CATEGORY_FICTION);
+
+    // Text fields take any byte but the terminator, high-bit bytes included
+    CHECK(book.setTitle("Caf\xC3\xA9 \x80\xFF") && strcmp(book.getTitle(), "Caf\xC3\xA9 \x80\xFF") == 0);
+    string longestTitle(MAX_TITLE_LENGTH - 1, 't');
+    CHECK(book.setTitle(longestTitle.c_str()) && longestTitle == book.getTitle());
+    CHECK(!book.setTitle(string(MAX_TITLE_LENGTH, 't').c_str()));
+    CHECK(!book.setTitle(""));
+    CHECK(longestTitle == book.getTitle());
+}
+
+/**
+ * Helper function to run getValidId on scripted input lines
+ * Returns the ID it accepted; the script must end with an acceptable line.
+ */
+static string readId(const string& script, const Library& library, bool checkDuplicate) {
+    istringstream input(script);
+    ostringstream output;
+    streambuf* oldInput = cin.rdbuf(input.rdbuf());
+    streambuf* oldOutput = cout.rdbuf(output.rdbuf());
+    char buffer[MAX_ID_LENGTH];
+    bool read = getValidId(buffer, sizeof(buffer), "", library, checkDuplicate);
+    cin.rdbuf(oldInput);
+    cout.rdbuf(oldOutput);
+    cin.clear();
+    return read ? string(buffer) : string();
+}
+
+static void testGetValidId() {
+    Library library;
+    Book book;
+    CHECK(makeBook(book, "Taken1", "9780306406157", "Dune"));
+    CHECK(library.addBook(book));
+
+    // Empty, punctuated, high-bit and over-long lines are all asked again
+    string tooLong(MAX_ID_LENGTH, 'a');
+    string script = "\nab-1\nab 1\nab\xC3\xA9\n" + tooLong + "\nGood42\n";
+    CHECK(readId(script, library, true) == "Good42");
+
+    // The longest ID that fits the buffer is taken as it is
+    string longest(MAX_ID_LENGTH - 1, 'b');
+    CHECK(readId(longest + "\n", library, true) == longest);
+
+    // A taken ID is asked again only when duplicates are checked
+    CHECK(readId("Taken1\nFree1\n", library, true) == "Free1");
+    CHECK(readId("Taken1\n", library, false) == "Taken1");
+}
+
+int main() {
+    testEveryByte();
+    testLengthLimit();
+    testBookSetters();
+    testGetValidId();
+    return finishTest("test_validation");
+}